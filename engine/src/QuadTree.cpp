@@ -0,0 +1,252 @@
+//#include "pch.h"
+#include "QuadTree.h"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+
+// ============ tests ============
+
+typedef QuadTree<u32>::Item QuadTreeTestItem;
+
+static f32 QuadTreeTestDistSq(glm::vec2 a, glm::vec2 b)
+{
+    glm::vec2 d = a - b;
+    return glm::dot(d, d);
+}
+
+// runs random box/radius/nearest queries on the tree and a plain array of the same items, they have to agree
+static void QuadTreeCheckAgainstBruteForce(const QuadTree<u32>& tree, const std::vector<QuadTreeTestItem>& reference, std::mt19937& rng)
+{
+    TINY_ASSERT(tree.GetSize() == reference.size());
+    std::uniform_real_distribution<f32> coord(-550.0f, 550.0f);
+    std::uniform_real_distribution<f32> extent(0.0f, 200.0f);
+    std::vector<u32> found;
+    std::vector<u32> expected;
+    for (u32 q = 0; q < 100; q++)
+    {
+        glm::vec2 center(coord(rng), coord(rng));
+        // every so often, right on top of the pile of identical points
+        if (q % 10 == 0) center = glm::vec2(100.0f, 100.0f);
+        glm::vec2 halfSize(extent(rng), extent(rng));
+        BoundingBox2D box(center - halfSize, center + halfSize);
+        found.clear();
+        expected.clear();
+        tree.Query(box, [&](const QuadTreeTestItem& item) { found.push_back(item.data); });
+        for (const QuadTreeTestItem& item : reference)
+        {
+            if (item.point.x >= box.min.x && item.point.x <= box.max.x && item.point.y >= box.min.y && item.point.y <= box.max.y)
+            {
+                expected.push_back(item.data);
+            }
+        }
+        std::sort(found.begin(), found.end());
+        std::sort(expected.begin(), expected.end());
+        TINY_ASSERT(found == expected);
+
+        f32 radius = halfSize.x;
+        found.clear();
+        expected.clear();
+        tree.QueryRadius(center, radius, [&](const QuadTreeTestItem& item) { found.push_back(item.data); });
+        for (const QuadTreeTestItem& item : reference)
+        {
+            if (QuadTreeTestDistSq(item.point, center) <= radius * radius) expected.push_back(item.data);
+        }
+        std::sort(found.begin(), found.end());
+        std::sort(expected.begin(), expected.end());
+        TINY_ASSERT(found == expected);
+
+        // ties make the exact items ambiguous, the distances aren't
+        u32 k = q % 3 == 0 ? 1 : (q % 3 == 1 ? 7 : 40);
+        QuadTreeTestItem nearest[40];
+        f32 nearestDistSq[40];
+        u32 numNearest = tree.FindNearest(center, k, nearest, nearestDistSq);
+        std::vector<f32> expectedDistSq;
+        for (const QuadTreeTestItem& item : reference) expectedDistSq.push_back(QuadTreeTestDistSq(item.point, center));
+        std::sort(expectedDistSq.begin(), expectedDistSq.end());
+        TINY_ASSERT(numNearest == std::min<size_t>(k, reference.size()));
+        for (u32 i = 0; i < numNearest; i++)
+        {
+            TINY_ASSERT(nearestDistSq[i] == expectedDistSq[i]);
+            TINY_ASSERT(nearestDistSq[i] == QuadTreeTestDistSq(nearest[i].point, center));
+        }
+    }
+}
+
+void QuadTreeTests()
+{
+    LOG_INFO("Running QuadTree tests...");
+    for (u32 bucketCapacity : {1u, 4u, 16u})
+    {
+        std::mt19937 rng(bucketCapacity);
+        std::uniform_real_distribution<f32> coord(-500.0f, 500.0f);
+        QuadTree<u32> tree(glm::vec2(-500), glm::vec2(500), bucketCapacity);
+        std::vector<QuadTreeTestItem> reference;
+        u32 nextId = 0;
+        auto insert = [&](glm::vec2 point)
+        {
+            TINY_ASSERT(tree.Insert(point, nextId));
+            reference.push_back({ point, nextId++ });
+        };
+        TINY_ASSERT(tree.GetSize() == 0 && tree.FindNearest(glm::vec2(0), 3, nullptr) == 0);
+
+        // uniform, a pile of points on the exact same spot (runs into max depth), and the edges/corners of the bounds
+        for (u32 i = 0; i < 5000; i++) insert(glm::vec2(coord(rng), coord(rng)));
+        for (u32 i = 0; i < 300; i++) insert(glm::vec2(100.0f, 100.0f));
+        for (glm::vec2 edge : { glm::vec2(-500), glm::vec2(500), glm::vec2(500, -500), glm::vec2(0, 500), glm::vec2(-500, 0) }) insert(edge);
+        TINY_ASSERT(!tree.Insert(glm::vec2(500.01f, 0), 12345) && !tree.Insert(glm::vec2(0, -600), 12345));
+        QuadTreeCheckAgainstBruteForce(tree, reference, rng);
+
+        // remove half, including plenty from the pile
+        std::shuffle(reference.begin(), reference.end(), rng);
+        for (u32 i = 0; i < 2650; i++)
+        {
+            TINY_ASSERT(tree.Remove(reference.back().point, reference.back().data));
+            reference.pop_back();
+        }
+        TINY_ASSERT(!tree.Remove(glm::vec2(1, 2), 99999));
+        TINY_ASSERT(!tree.Remove(reference[0].point + glm::vec2(0.5f, 0), reference[0].data));
+        QuadTreeCheckAgainstBruteForce(tree, reference, rng);
+
+        // small moves (mostly stay in their leaf) and big ones
+        std::uniform_real_distribution<f32> jitter(-0.5f, 0.5f);
+        for (u32 i = 0; i < reference.size(); i++)
+        {
+            QuadTreeTestItem& item = reference[i];
+            glm::vec2 moved = i % 2 ? glm::vec2(coord(rng), coord(rng)) : glm::clamp(item.point + glm::vec2(jitter(rng), jitter(rng)), glm::vec2(-500), glm::vec2(500));
+            TINY_ASSERT(tree.Update(item.point, moved, item.data));
+            item.point = moved;
+        }
+        TINY_ASSERT(!tree.Update(reference[0].point, glm::vec2(1000, 0), reference[0].data));
+        TINY_ASSERT(!tree.Update(glm::vec2(3, 3), glm::vec2(4, 4), 99999));
+        QuadTreeCheckAgainstBruteForce(tree, reference, rng);
+
+        // emptying it collapses everything back into the root
+        for (const QuadTreeTestItem& item : reference) TINY_ASSERT(tree.Remove(item.point, item.data));
+        u32 numFound = 0;
+        tree.Query(BoundingBox2D(glm::vec2(-500), glm::vec2(500)), [&](const QuadTreeTestItem&) { numFound++; });
+        TINY_ASSERT(tree.GetSize() == 0 && numFound == 0);
+
+        // bulk build from the same kind of data, then keep editing it
+        reference.clear();
+        for (u32 i = 0; i < 5000; i++) reference.push_back({ glm::vec2(coord(rng), coord(rng)), i });
+        for (u32 i = 0; i < 300; i++) reference.push_back({ glm::vec2(100.0f, 100.0f), 5000 + i });
+        reference.push_back({ glm::vec2(500), 6000 });
+        std::vector<QuadTreeTestItem> withOutOfBounds = reference;
+        withOutOfBounds.push_back({ glm::vec2(-501, 0), 7000 });
+        TINY_ASSERT(tree.Build(withOutOfBounds.data(), (u32)withOutOfBounds.size()) == reference.size());
+        QuadTreeCheckAgainstBruteForce(tree, reference, rng);
+        nextId = 10000;
+        for (u32 i = 0; i < 1000; i++) insert(glm::vec2(coord(rng), coord(rng)));
+        for (u32 i = 0; i < 2000; i++)
+        {
+            TINY_ASSERT(tree.Remove(reference[i].point, reference[i].data));
+        }
+        reference.erase(reference.begin(), reference.begin() + 2000);
+        QuadTreeCheckAgainstBruteForce(tree, reference, rng);
+    }
+    LOG_INFO("QuadTree tests passed");
+}
+
+// ============ benchmarks ============
+
+template <typename Func>
+static f64 TimeMs(Func func)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    func();
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<f64, std::milli>(end - start).count();
+}
+
+void QuadTreeBenchmarks()
+{
+    LOG_INFO("Running QuadTree benchmarks...");
+    constexpr u32 numPoints = 1000000;
+    constexpr u32 numQueries = 10000;
+    // brute force is slow enough that it gets fewer queries, everything's reported per query
+    constexpr u32 numBruteForceQueries = 50;
+    constexpr u32 k = 16;
+    constexpr f32 worldSize = 1000.0f;
+
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<f32> coord(0.0f, worldSize);
+    std::vector<QuadTreeTestItem> points(numPoints);
+    for (u32 i = 0; i < numPoints; i++) points[i] = { glm::vec2(coord(rng), coord(rng)), i };
+    std::vector<glm::vec2> queryPoints(numQueries);
+    for (glm::vec2& p : queryPoints) p = glm::vec2(coord(rng), coord(rng));
+
+    QuadTree<u32> tree(glm::vec2(0), glm::vec2(worldSize));
+    f64 insertMs = TimeMs([&]() {
+        for (const QuadTreeTestItem& p : points) tree.Insert(p.point, p.data);
+    });
+    u32 insertNodes = tree.GetNodeCount();
+    f64 buildMs = TimeMs([&]() { tree.Build(points.data(), numPoints); });
+    LOG_INFO("[QUADTREE] %u points | bulk build (morton): %7.2f ms | insert one by one: %7.2f ms | %.2fx | %u vs %u nodes",
+        numPoints, buildMs, insertMs, insertMs / buildMs, tree.GetNodeCount(), insertNodes);
+
+    // 20x20 boxes, ~400 points each
+    u64 sum = 0;
+    f64 boxMs = TimeMs([&]() {
+        for (glm::vec2 p : queryPoints)
+        {
+            tree.Query(BoundingBox2D(p - glm::vec2(10), p + glm::vec2(10)), [&](const QuadTreeTestItem& item) { sum += item.data; });
+        }
+    });
+    f64 boxBruteMs = TimeMs([&]() {
+        for (u32 q = 0; q < numBruteForceQueries; q++)
+        {
+            glm::vec2 min = queryPoints[q] - glm::vec2(10), max = queryPoints[q] + glm::vec2(10);
+            for (const QuadTreeTestItem& item : points)
+            {
+                if (item.point.x >= min.x && item.point.x <= max.x && item.point.y >= min.y && item.point.y <= max.y) sum += item.data;
+            }
+        }
+    });
+    f64 radiusMs = TimeMs([&]() {
+        for (glm::vec2 p : queryPoints)
+        {
+            tree.QueryRadius(p, 10.0f, [&](const QuadTreeTestItem& item) { sum += item.data; });
+        }
+    });
+    QuadTreeTestItem nearest[k];
+    f64 nearestMs = TimeMs([&]() {
+        for (glm::vec2 p : queryPoints)
+        {
+            sum += tree.FindNearest(p, k, nearest);
+        }
+    });
+    std::vector<f32> distances(numPoints);
+    f64 nearestBruteMs = TimeMs([&]() {
+        for (u32 q = 0; q < numBruteForceQueries; q++)
+        {
+            for (u32 i = 0; i < numPoints; i++) distances[i] = QuadTreeTestDistSq(points[i].point, queryPoints[q]);
+            std::nth_element(distances.begin(), distances.begin() + k, distances.end());
+            sum += (u64)distances[0];
+        }
+    });
+    TINY_ASSERT(sum != 0);
+    f64 boxUs = boxMs * 1000.0 / numQueries, boxBruteUs = boxBruteMs * 1000.0 / numBruteForceQueries;
+    f64 nearestUs = nearestMs * 1000.0 / numQueries, nearestBruteUs = nearestBruteMs * 1000.0 / numBruteForceQueries;
+    LOG_INFO("[QUADTREE] box query (~400 hits) | tree: %8.2f us | brute force: %9.2f us | %.0fx", boxUs, boxBruteUs, boxBruteUs / boxUs);
+    LOG_INFO("[QUADTREE] radius query (r=10)   | tree: %8.2f us", radiusMs * 1000.0 / numQueries);
+    LOG_INFO("[QUADTREE] %u nearest            | tree: %8.2f us | brute force: %9.2f us | %.0fx", k, nearestUs, nearestBruteUs, nearestBruteUs / nearestUs);
+
+    // everything jitters a bit, like things moving around a scene for a frame
+    std::uniform_real_distribution<f32> jitter(-0.5f, 0.5f);
+    std::vector<glm::vec2> moved(numPoints);
+    for (u32 i = 0; i < numPoints; i++) moved[i] = glm::clamp(points[i].point + glm::vec2(jitter(rng), jitter(rng)), glm::vec2(0), glm::vec2(worldSize));
+    f64 updateMs = TimeMs([&]() {
+        for (u32 i = 0; i < numPoints; i++) tree.Update(points[i].point, moved[i], points[i].data);
+    });
+    for (u32 i = 0; i < numPoints; i++) points[i].point = moved[i];
+    f64 rebuildMs = TimeMs([&]() { tree.Build(points.data(), numPoints); });
+    f64 removeMs = TimeMs([&]() {
+        for (u32 i = 0; i < numPoints; i += 10) tree.Remove(points[i].point, points[i].data);
+    });
+    TINY_ASSERT(tree.GetSize() == numPoints - numPoints / 10);
+    LOG_INFO("[QUADTREE] move all %u points | Update each: %7.2f ms | rebuild: %7.2f ms | remove 10%%: %6.2f ms",
+        numPoints, updateMs, rebuildMs, removeMs);
+    LOG_INFO("QuadTree benchmarks complete");
+}
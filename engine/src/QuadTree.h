@@ -2,251 +2,765 @@
 
 //#include "pch.h"
 #include "tiny_types.h"
-#include <functional>
-
-template<typename T>
-struct QuadTreeNode {
-    glm::vec2 point = glm::vec2(0);
-    T data;
-    bool hasData = false;
-    QuadTreeNode() = default;
-    QuadTreeNode(glm::vec2 pos, T _data) {
-        point = pos;
-        data = _data;
-        hasData = true;
-    }
-};
+#include "containers/dynarray.h"
+#include "mem/tiny_arena.h"
+#include "render/shapes.h"
+#include <utility>
 
-enum QuadTreeChildDirection {
-    NORTHWEST,
-    SOUTHWEST,
-    NORTHEAST,
-    SOUTHEAST,
-};
+// Point quadtree over a fixed rectangle.
+// Nodes live in one flat array, and the 4 children of a node are always next to each other, so a node only stores the
+// index of its first child. Items only live in leaves, in buckets of bucketCapacity items that are also slices of one
+// flat array. A full leaf splits in 4, except at maxDepth where it chains another bucket instead (lots of items on
+// the same spot can't be split apart anyway).
+// Children are in Morton order, (x bit) | (y bit << 1), and which child a point goes to is decided by its position
+// quantized to the maxDepth grid. So Build can sort everything by Morton code once and then cut the sorted
+// array into nodes without looking at a single point again. Building from scratch is much faster than inserting one
+// at a time when a lot of things moved.
+// Queries take callbacks/caller buffers and never allocate.
+// T is copied around with memcpy (DynArray) and compared with == by Remove/Update, think EntityRef or a pointer
 
-template<typename T>
-struct QuadTree {
+#define QUADTREE_MAX_DEPTH 16
+
+template <typename T>
+struct QuadTree
+{
+    struct Item
+    {
+        glm::vec2 point = glm::vec2(0);
+        T data = {};
+    };
+    struct Node
+    {
+        // first of the 4 children, U32_INVALID_ID for leaves. Freed node groups are linked through this too
+        u32 firstChild = U32_INVALID_ID;
+        // leaves: first bucket of items, U32_INVALID_ID while there aren't any
+        u32 firstBucket = U32_INVALID_ID;
+        // items in this whole subtree
+        u32 count = 0;
+    };
 
+    // empty and refuses everything, for trees that get moved into later
     QuadTree() = default;
-    QuadTree(glm::vec2 min, glm::vec2 max) : QuadTree() {
-        this->bounds = BoundingBox2D(min, max);
-    }
-    QuadTree(BoundingBox2D bounds) : QuadTree() {
-        this->bounds = bounds;
-    }
-    ~QuadTree() {
-        Clear();
-    }
-    void Clear() {
-        children.clear();
-        node = {};
-    }
-    void Draw();
-    void insert(const QuadTreeNode<T>& node);
-    void search(BoundingBox2D bounds, std::vector<T>& results);
-    void Transform(std::function<void(QuadTreeNode<T>*)> func);
-    u32 GetSize();
+    QuadTree(BoundingBox2D bounds, u32 bucketCapacity = 8, u32 maxDepth = QUADTREE_MAX_DEPTH);
+    QuadTree(glm::vec2 min, glm::vec2 max, u32 bucketCapacity = 8, u32 maxDepth = QUADTREE_MAX_DEPTH)
+        : QuadTree(BoundingBox2D(min, max), bucketCapacity, maxDepth) {}
+    QuadTree(const QuadTree&) = delete;
+    QuadTree& operator=(const QuadTree&) = delete;
+    QuadTree(QuadTree&&) = default;
+    QuadTree& operator=(QuadTree&&) = default;
+
+    // keeps the memory around
+    void Clear();
+    // false (and nothing happens) if the point is outside the tree's bounds
+    bool Insert(glm::vec2 point, const T& data);
+    // removes one item with this data at this point. False if there isn't one
+    bool Remove(glm::vec2 point, const T& data);
+    // moves an item. If it stays in the same leaf that's just an overwrite, otherwise it's Remove + Insert.
+    // False if the item isn't there or newPoint is out of bounds, in which case nothing changes
+    bool Update(glm::vec2 oldPoint, glm::vec2 newPoint, const T& data);
+    // throws away the current contents and builds the tree from scratch. Items outside the bounds are skipped.
+    // Returns how many made it in
+    u32 Build(const Item* items, u32 count);
+
+    // func(const Item&) for every item inside area (edges included)
+    template <typename Func>
+    void Query(const BoundingBox2D& area, Func&& func) const;
+    // func(const Item&) for every item within radius of center (edge included)
+    template <typename Func>
+    void QueryRadius(glm::vec2 center, f32 radius, Func&& func) const;
+    // the k items closest to point, nearest first. outItems needs room for k, outDistancesSq (optional) too.
+    // Returns how many were written, less than k if the tree doesn't have k items
+    u32 FindNearest(glm::vec2 point, u32 k, Item* outItems, f32* outDistancesSq = nullptr) const;
+
+    inline u32 GetSize() const { return nodes.empty() ? 0 : nodes[0].count; }
+    // allocated nodes, free ones included
+    inline u32 GetNodeCount() const { return nodes.size(); }
+    // debug draw of every node + every item
+    void Draw() const;
 
     BoundingBox2D bounds = {};
-    QuadTreeNode<T> node = {};
-    // TODO: (?) access array of children with array-based tree lookups
-    std::vector<QuadTree> children = {};
+    u32 bucketCapacity = 8;
+    u32 maxDepth = QUADTREE_MAX_DEPTH;
 
 private:
-    bool inBoundary(glm::vec2 point);
-    static QuadTree<T> GenerateChildQuadTree(BoundingBox2D bounds, QuadTreeChildDirection direction);
+    // a node about to be visited, with its cell on the grid of its depth (so its bounds can be worked out)
+    struct Visit
+    {
+        u32 node;
+        u32 depth;
+        u32 cellX;
+        u32 cellY;
+    };
+    // every visit pushes at most 4 and pops 1, so this covers QUADTREE_MAX_DEPTH levels
+    static constexpr u32 MAX_VISITS = 3 * QUADTREE_MAX_DEPTH + 4;
+
+    inline bool InBounds(glm::vec2 point) const;
+    inline void Quantize(glm::vec2 point, u32& qx, u32& qy) const;
+    inline u32 ChildIndex(u32 qx, u32 qy, u32 depth) const;
+    inline u32 MortonCode(glm::vec2 point) const;
+    // bounds of a visit's cell, grown by one maxDepth cell so points that quantized across an edge aren't missed
+    inline BoundingBox2D CellBounds(const Visit& visit) const;
+    inline Item* Bucket(u32 bucket) { return &items[bucket * bucketCapacity]; }
+    inline const Item* Bucket(u32 bucket) const { return &items[bucket * bucketCapacity]; }
+    // func(const Item&/Item&) for every item in a leaf
+    template <typename Func>
+    void ForEachLeafItem(u32 leaf, Func&& func) const;
+
+    u32 AllocBucket();
+    void FreeBucket(u32 bucket);
+    u32 AllocNodeGroup();
+    // stores an item in a leaf whose count already includes it
+    void Append(u32 leaf, const Item& item);
+    void Split(u32 leaf, u32 depth);
+    // turns a subtree that fits in one bucket back into a leaf
+    void Collapse(u32 node);
+    // the leaf's item at index (in bucket order)
+    Item& LeafItem(u32 leaf, u32 index);
+    // removes the leaf's item at index by moving its last item into the hole. Doesn't touch any counts
+    void RemoveFromLeaf(u32 leaf, u32 index);
+    u32 BuildNode(u32 node, u32 depth, const u64* keys, u32 begin, u32 end, const Item* source);
+
+    DynArray<Node> nodes = {};
+    // bucketCapacity items per bucket
+    DynArray<Item> items = {};
+    // next bucket in a leaf's chain, or in the free list
+    DynArray<u32> bucketNext = {};
+    u32 freeBuckets = U32_INVALID_ID;
+    u32 freeNodeGroups = U32_INVALID_ID;
+    // maxDepth grid cells per unit, on each axis
+    glm::vec2 cellScale = glm::vec2(0);
 };
 
+// ============ implementation ============
+
+template <typename T>
+QuadTree<T>::QuadTree(BoundingBox2D bounds, u32 bucketCapacity, u32 maxDepth)
+    : bounds(bounds), bucketCapacity(bucketCapacity ? bucketCapacity : 1), maxDepth(maxDepth < QUADTREE_MAX_DEPTH ? maxDepth : QUADTREE_MAX_DEPTH)
+{
+    glm::vec2 extent = bounds.max - bounds.min;
+    TINY_ASSERT(extent.x > 0 && extent.y > 0 && "QuadTree bounds are empty");
+    cellScale = glm::vec2((f32)(1u << this->maxDepth)) / extent;
+    Clear();
+}
+
 template <typename T>
-u32 QuadTree<T>::GetSize()  {
-    u32 s = node.hasData ? 1 : 0;
-    for (QuadTree<T>& child : children) {
-        if (!child.children.empty()) {
-            s += child.GetSize();
+void QuadTree<T>::Clear()
+{
+    nodes.clear();
+    items.clear();
+    bucketNext.clear();
+    freeBuckets = U32_INVALID_ID;
+    freeNodeGroups = U32_INVALID_ID;
+    nodes.push_back(Node());
+}
+
+template <typename T>
+inline bool QuadTree<T>::InBounds(glm::vec2 point) const
+{
+    return !nodes.empty() && point.x >= bounds.min.x && point.x <= bounds.max.x && point.y >= bounds.min.y && point.y <= bounds.max.y;
+}
+
+template <typename T>
+inline void QuadTree<T>::Quantize(glm::vec2 point, u32& qx, u32& qy) const
+{
+    u32 last = (1u << maxDepth) - 1;
+    glm::vec2 cell = (point - bounds.min) * cellScale;
+    qx = cell.x > 0 ? ((u32)cell.x < last ? (u32)cell.x : last) : 0;
+    qy = cell.y > 0 ? ((u32)cell.y < last ? (u32)cell.y : last) : 0;
+}
+
+template <typename T>
+inline u32 QuadTree<T>::ChildIndex(u32 qx, u32 qy, u32 depth) const
+{
+    u32 shift = maxDepth - 1 - depth;
+    return ((qx >> shift) & 1) | (((qy >> shift) & 1) << 1);
+}
+
+// 16 bits of x and y interleaved, x in the low bit
+static inline u32 QuadTreeSpreadBits(u32 v)
+{
+    v &= 0x0000FFFF;
+    v = (v | (v << 8)) & 0x00FF00FF;
+    v = (v | (v << 4)) & 0x0F0F0F0F;
+    v = (v | (v << 2)) & 0x33333333;
+    v = (v | (v << 1)) & 0x55555555;
+    return v;
+}
+
+template <typename T>
+inline u32 QuadTree<T>::MortonCode(glm::vec2 point) const
+{
+    u32 qx, qy;
+    Quantize(point, qx, qy);
+    return QuadTreeSpreadBits(qx) | (QuadTreeSpreadBits(qy) << 1);
+}
+
+template <typename T>
+inline BoundingBox2D QuadTree<T>::CellBounds(const Visit& visit) const
+{
+    glm::vec2 cellSize = (bounds.max - bounds.min) / (f32)(1u << visit.depth);
+    glm::vec2 slop = 1.0f / cellScale;
+    glm::vec2 min = bounds.min + glm::vec2((f32)visit.cellX, (f32)visit.cellY) * cellSize;
+    return BoundingBox2D(min - slop, min + cellSize + slop);
+}
+
+template <typename T>
+template <typename Func>
+void QuadTree<T>::ForEachLeafItem(u32 leaf, Func&& func) const
+{
+    u32 remaining = nodes[leaf].count;
+    for (u32 bucket = nodes[leaf].firstBucket; bucket != U32_INVALID_ID && remaining; bucket = bucketNext[bucket])
+    {
+        u32 inBucket = remaining < bucketCapacity ? remaining : bucketCapacity;
+        const Item* bucketItems = Bucket(bucket);
+        for (u32 i = 0; i < inBucket; i++)
+        {
+            func(bucketItems[i]);
         }
+        remaining -= inBucket;
     }
-    return s;
 }
 
 template <typename T>
-void QuadTree<T>::Transform(std::function<void(QuadTreeNode<T>*)> func) {
-    func(this);
-    for (auto& child : neighbors) {
-        child.Transform(func);
+u32 QuadTree<T>::AllocBucket()
+{
+    u32 bucket = freeBuckets;
+    if (bucket != U32_INVALID_ID)
+    {
+        freeBuckets = bucketNext[bucket];
+    }
+    else
+    {
+        bucket = bucketNext.size();
+        bucketNext.push_back(U32_INVALID_ID);
+        // resize only grows to exactly what it's asked for
+        if (items.capacity() < (bucket + 1) * bucketCapacity) items.reserve(items.capacity() * 2 + bucketCapacity);
+        items.resize((bucket + 1) * bucketCapacity);
     }
+    bucketNext[bucket] = U32_INVALID_ID;
+    return bucket;
 }
 
 template <typename T>
-QuadTree<T> QuadTree<T>::GenerateChildQuadTree(BoundingBox2D bounds, QuadTreeChildDirection direction) {
-    glm::vec2 topLeft = bounds.min;
-    glm::vec2 botRight = bounds.max;
-    switch (direction) {
-        case NORTHWEST:
-        {
-            return QuadTree<T>(
-                        glm::vec2(topLeft.x, topLeft.y),
-                        glm::vec2((topLeft.x + botRight.x) / 2,
-                            (topLeft.y + botRight.y) / 2));
-        } break;
-        case SOUTHWEST:
+void QuadTree<T>::FreeBucket(u32 bucket)
+{
+    bucketNext[bucket] = freeBuckets;
+    freeBuckets = bucket;
+}
+
+template <typename T>
+u32 QuadTree<T>::AllocNodeGroup()
+{
+    u32 group = freeNodeGroups;
+    if (group != U32_INVALID_ID)
+    {
+        freeNodeGroups = nodes[group].firstChild;
+    }
+    else
+    {
+        group = nodes.size();
+        if (nodes.capacity() < group + 4) nodes.reserve(nodes.capacity() * 2 + 4);
+        nodes.resize(group + 4);
+    }
+    for (u32 i = 0; i < 4; i++)
+    {
+        nodes[group + i] = Node();
+    }
+    return group;
+}
+
+template <typename T>
+typename QuadTree<T>::Item& QuadTree<T>::LeafItem(u32 leaf, u32 index)
+{
+    u32 bucket = nodes[leaf].firstBucket;
+    for (u32 i = 0; i < index / bucketCapacity; i++)
+    {
+        bucket = bucketNext[bucket];
+    }
+    return Bucket(bucket)[index % bucketCapacity];
+}
+
+template <typename T>
+void QuadTree<T>::Append(u32 leaf, const Item& item)
+{
+    u32 index = nodes[leaf].count - 1;
+    if (index % bucketCapacity == 0)
+    {
+        // first item, or the last bucket is full
+        u32 bucket = AllocBucket();
+        if (index == 0)
         {
-            return QuadTree<T>(
-                        glm::vec2(topLeft.x,
-                            (topLeft.y + botRight.y) / 2),
-                        glm::vec2((topLeft.x + botRight.x) / 2,
-                            botRight.y));
-        } break;
-        case NORTHEAST:
+            nodes[leaf].firstBucket = bucket;
+        }
+        else
         {
-            return QuadTree<T>(
-                        glm::vec2((topLeft.x + botRight.x) / 2,
-                            topLeft.y),
-                        glm::vec2(botRight.x,
-                            (topLeft.y + botRight.y) / 2));
-        } break;
-        case SOUTHEAST:
+            u32 last = nodes[leaf].firstBucket;
+            while (bucketNext[last] != U32_INVALID_ID) last = bucketNext[last];
+            bucketNext[last] = bucket;
+        }
+    }
+    LeafItem(leaf, index) = item;
+}
+
+template <typename T>
+void QuadTree<T>::RemoveFromLeaf(u32 leaf, u32 index)
+{
+    u32 last = nodes[leaf].count - 1;
+    if (index != last)
+    {
+        LeafItem(leaf, index) = LeafItem(leaf, last);
+    }
+    if (last % bucketCapacity == 0)
+    {
+        // the last bucket is empty now
+        u32 prev = U32_INVALID_ID;
+        u32 bucket = nodes[leaf].firstBucket;
+        while (bucketNext[bucket] != U32_INVALID_ID)
         {
-            return QuadTree<T>(
-                        glm::vec2((topLeft.x + botRight.x) / 2,
-                            (topLeft.y + botRight.y) / 2),
-                        glm::vec2(botRight.x, botRight.y));
-        } break;
-        default:
+            prev = bucket;
+            bucket = bucketNext[bucket];
+        }
+        if (prev == U32_INVALID_ID) nodes[leaf].firstBucket = U32_INVALID_ID;
+        else bucketNext[prev] = U32_INVALID_ID;
+        FreeBucket(bucket);
+    }
+}
+
+template <typename T>
+void QuadTree<T>::Split(u32 leaf, u32 depth)
+{
+    u32 group = AllocNodeGroup();
+    u32 bucket = nodes[leaf].firstBucket;
+    u32 remaining = nodes[leaf].count - 1; // the item being inserted isn't in there yet
+    // only leaves at maxDepth chain buckets, and those never split, so this is a single bucket
+    for (u32 i = 0; i < remaining; i++)
+    {
+        Item item = Bucket(bucket)[i];
+        u32 qx, qy;
+        Quantize(item.point, qx, qy);
+        u32 child = group + ChildIndex(qx, qy, depth);
+        nodes[child].count++;
+        Append(child, item);
+    }
+    FreeBucket(bucket);
+    nodes[leaf].firstBucket = U32_INVALID_ID;
+    nodes[leaf].firstChild = group;
+}
+
+template <typename T>
+void QuadTree<T>::Collapse(u32 node)
+{
+    u32 bucket = AllocBucket();
+    u32 numItems = 0;
+    u32 stack[MAX_VISITS];
+    u32 stackSize = 0;
+    stack[stackSize++] = nodes[node].firstChild;
+    while (stackSize)
+    {
+        u32 group = stack[--stackSize];
+        for (u32 i = 0; i < 4; i++)
         {
-            TINY_ASSERT(false && "Invalid QuadTreeChildDirection passed to GenerateChildQuadTree");
-            return QuadTree<T>();
-        } break;
+            u32 child = group + i;
+            if (nodes[child].firstChild != U32_INVALID_ID)
+            {
+                stack[stackSize++] = nodes[child].firstChild;
+            }
+            else if (nodes[child].count)
+            {
+                ForEachLeafItem(child, [&](const Item& item) { Bucket(bucket)[numItems++] = item; });
+                FreeBucket(nodes[child].firstBucket);
+            }
+        }
+        nodes[group].firstChild = freeNodeGroups;
+        freeNodeGroups = group;
     }
+    TINY_ASSERT(numItems == nodes[node].count && numItems <= bucketCapacity);
+    nodes[node].firstChild = U32_INVALID_ID;
+    nodes[node].firstBucket = numItems ? bucket : U32_INVALID_ID;
+    if (!numItems) FreeBucket(bucket);
 }
 
 template <typename T>
-void QuadTree<T>::insert(const QuadTreeNode<T>& nodeToInsert) {
-    glm::vec2 topLeft = bounds.min;
-    glm::vec2 botRight = bounds.max;
-    if (children.empty()) {
-        // populate all 4 directions
-        for (u32 i = 0; i < 4; i++) {
-            children.emplace_back(GenerateChildQuadTree(this->bounds, (QuadTreeChildDirection)i));
+bool QuadTree<T>::Insert(glm::vec2 point, const T& data)
+{
+    if (!InBounds(point))
+    {
+        return false;
+    }
+    u32 qx, qy;
+    Quantize(point, qx, qy);
+    u32 node = 0;
+    for (u32 depth = 0; ; depth++)
+    {
+        nodes[node].count++;
+        if (nodes[node].firstChild == U32_INVALID_ID)
+        {
+            if (nodes[node].count <= bucketCapacity || depth == maxDepth)
+            {
+                Append(node, Item{ point, data });
+                return true;
+            }
+            // full, split it and keep going down
+            Split(node, depth);
         }
+        node = nodes[node].firstChild + ChildIndex(qx, qy, depth);
     }
-    // don't insert empty nodes
-    if (!nodeToInsert.hasData) {
-        std::cout << "Tried to insert node without data to quadtree";
-        return;
+}
+
+template <typename T>
+bool QuadTree<T>::Remove(glm::vec2 point, const T& data)
+{
+    if (!InBounds(point))
+    {
+        return false;
     }
-    // node not in bounds of this tree, can't insert
-    if (!inBoundary(nodeToInsert.point)) {
-        std::cout << "Tried to insert node out of bounds to quadtree";
-        return;
+    u32 qx, qy;
+    Quantize(point, qx, qy);
+    u32 path[QUADTREE_MAX_DEPTH + 1];
+    u32 depth = 0;
+    u32 node = 0;
+    for (; nodes[node].firstChild != U32_INVALID_ID; depth++)
+    {
+        path[depth] = node;
+        node = nodes[node].firstChild + ChildIndex(qx, qy, depth);
     }
+    path[depth] = node;
 
+    u32 index = U32_INVALID_ID;
+    u32 i = 0;
+    ForEachLeafItem(node, [&](const Item& item)
+    {
+        if (index == U32_INVALID_ID && item.point == point && item.data == data) index = i;
+        i++;
+    });
+    if (index == U32_INVALID_ID)
+    {
+        return false;
+    }
+    RemoveFromLeaf(node, index);
+    for (u32 d = 0; d <= depth; d++)
+    {
+        nodes[path[d]].count--;
+    }
+    // the highest node on the path that fits in a bucket again turns back into a leaf
+    for (u32 d = 0; d < depth; d++)
+    {
+        if (nodes[path[d]].count <= bucketCapacity)
+        {
+            Collapse(path[d]);
+            break;
+        }
+    }
+    return true;
+}
 
-    constexpr f32 minimumQuadTreeCellSize = 1.0f;
-    bool isSizeOfBoundsLessThanOne = abs(topLeft.x - botRight.x) <= minimumQuadTreeCellSize
-                                  && abs(topLeft.y - botRight.y) <= minimumQuadTreeCellSize;
-    // cannot subdivide further
-    if (isSizeOfBoundsLessThanOne) {
-        if (!this->node.hasData) {
-            this->node = nodeToInsert;
+template <typename T>
+bool QuadTree<T>::Update(glm::vec2 oldPoint, glm::vec2 newPoint, const T& data)
+{
+    if (!InBounds(oldPoint) || !InBounds(newPoint))
+    {
+        return false;
+    }
+    u32 oldX, oldY, newX, newY;
+    Quantize(oldPoint, oldX, oldY);
+    Quantize(newPoint, newX, newY);
+    u32 depth = 0;
+    u32 node = 0;
+    for (; nodes[node].firstChild != U32_INVALID_ID; depth++)
+    {
+        node = nodes[node].firstChild + ChildIndex(oldX, oldY, depth);
+    }
+    // same leaf if the cells match down to the leaf's depth
+    u32 shift = maxDepth - depth;
+    if ((oldX >> shift) == (newX >> shift) && (oldY >> shift) == (newY >> shift))
+    {
+        u32 remaining = nodes[node].count;
+        for (u32 bucket = nodes[node].firstBucket; bucket != U32_INVALID_ID && remaining; bucket = bucketNext[bucket])
+        {
+            u32 inBucket = remaining < bucketCapacity ? remaining : bucketCapacity;
+            Item* bucketItems = Bucket(bucket);
+            for (u32 i = 0; i < inBucket; i++)
+            {
+                if (bucketItems[i].point == oldPoint && bucketItems[i].data == data)
+                {
+                    bucketItems[i].point = newPoint;
+                    return true;
+                }
+            }
+            remaining -= inBucket;
         }
-        else {
-            // if this is being hit, there are too many entities too close together
-            // TODO: it might be a good idea to change the QuadTree
-            // implementation to store more than 1 piece of data per level
-            // and allow users to specify the capacity of each level of the tree
-            std::cout << "QuadTree max depth reached. Too many entities too close together!";
+        return false;
+    }
+    return Remove(oldPoint, data) && Insert(newPoint, data);
+}
+
+// sorts by the upper 32 bits (morton code) in 8 bit passes, only as many as there are code bits
+static inline void QuadTreeRadixSort(u64* keys, u64* scratch, u32 count, u32 codeBits)
+{
+    for (u32 shift = 32; shift < 32 + codeBits; shift += 8)
+    {
+        u32 offsets[256] = {};
+        for (u32 i = 0; i < count; i++) offsets[(keys[i] >> shift) & 0xFF]++;
+        u32 sum = 0;
+        for (u32 b = 0; b < 256; b++)
+        {
+            u32 bucketSize = offsets[b];
+            offsets[b] = sum;
+            sum += bucketSize;
         }
-        return;
+        for (u32 i = 0; i < count; i++) scratch[offsets[(keys[i] >> shift) & 0xFF]++] = keys[i];
+        std::swap(keys, scratch);
+    }
+    // odd number of passes leaves the result in the scratch buffer
+    if (((codeBits + 7) / 8) & 1)
+    {
+        TMEMCPY(scratch, keys, count * sizeof(u64));
     }
+}
 
-    // indicates LEFT
-    if ((topLeft.x + botRight.x) / 2 >= nodeToInsert.point.x) {
-		// Indicates top left
-		if ((topLeft.y + botRight.y) / 2 >= nodeToInsert.point.y) {
-            if (!node.hasData) {
-                node = nodeToInsert;
-            }
-            else {
-                children[NORTHWEST].insert(nodeToInsert);
-            }
-		}
-		// Indicates bottom left
-		else {
-            if (!node.hasData) {
-                node = nodeToInsert;
-            }
-            else {
-                children[SOUTHWEST].insert(nodeToInsert);
-            }
-		}
-	}
-    // indicates RIGHT
-	else {
-		// Indicates topRightTree
-		if ((topLeft.y + botRight.y) / 2 >= nodeToInsert.point.y) {
-            if (!node.hasData) {
-                node = nodeToInsert;
-            }
-            else {
-                children[NORTHEAST].insert(nodeToInsert);
-            }
-		}
-		// Indicates botRightTree
-		else {
-            if (!node.hasData) {
-                node = nodeToInsert;
+template <typename T>
+u32 QuadTree<T>::BuildNode(u32 node, u32 depth, const u64* keys, u32 begin, u32 end, const Item* source)
+{
+    u32 count = end - begin;
+    nodes[node].count = count;
+    if (count <= bucketCapacity || depth == maxDepth)
+    {
+        for (u32 i = 0; i < count; i++)
+        {
+            u32 bucketSlot = i % bucketCapacity;
+            if (bucketSlot == 0)
+            {
+                u32 bucket = AllocBucket();
+                if (i == 0) nodes[node].firstBucket = bucket;
+                else bucketNext[bucket - 1] = bucket; // buckets are handed out in order while building
             }
-            else {
-                children[SOUTHEAST].insert(nodeToInsert);
+            items[(bucketNext.size() - 1) * bucketCapacity + bucketSlot] = source[(u32)keys[begin + i]];
+        }
+        return count;
+    }
+    u32 group = AllocNodeGroup();
+    nodes[node].firstChild = group;
+    // everything in this range shares the digits above this depth, so the children are consecutive runs
+    u32 shift = 32 + 2 * (maxDepth - 1 - depth);
+    u32 childBegin = begin;
+    for (u32 child = 0; child < 4; child++)
+    {
+        u32 childEnd = childBegin;
+        if (child == 3) childEnd = end;
+        else
+        {
+            // binary search for the first key with a higher digit
+            u32 lo = childBegin, hi = end;
+            while (lo < hi)
+            {
+                u32 mid = (lo + hi) / 2;
+                if (((keys[mid] >> shift) & 3) <= child) lo = mid + 1;
+                else hi = mid;
             }
-		}
-	}
+            childEnd = lo;
+        }
+        BuildNode(group + child, depth + 1, keys, childBegin, childEnd, source);
+        childBegin = childEnd;
+    }
+    return count;
 }
 
 template <typename T>
-void QuadTree<T>::search(BoundingBox2D boundsToSearch, std::vector<T>& results) {
-    if (!node.hasData) {
-        // if this node doesn't have data, we are a leaf
-        // and have therefore exhausted the search
-        return;
+u32 QuadTree<T>::Build(const Item* sourceItems, u32 count)
+{
+    Clear();
+    ArenaTemp scratch = scratch_begin();
+    u64* keys = arena_alloc_type(scratch.arena, u64, count);
+    u64* sortScratch = arena_alloc_type(scratch.arena, u64, count);
+    u32 numKeys = 0;
+    for (u32 i = 0; i < count; i++)
+    {
+        if (InBounds(sourceItems[i].point))
+        {
+            keys[numKeys++] = ((u64)MortonCode(sourceItems[i].point) << 32) | i;
+        }
     }
+    QuadTreeRadixSort(keys, sortScratch, numKeys, 2 * maxDepth);
+    // roughly what a tree of full-ish buckets ends up needing
+    items.reserve(numKeys + numKeys / 2 + bucketCapacity);
+    bucketNext.reserve(items.capacity() / bucketCapacity + 1);
+    nodes.reserve(numKeys / bucketCapacity * 2 + 1);
+    BuildNode(0, 0, keys, 0, numKeys, sourceItems);
+    scratch_end(scratch);
+    return numKeys;
+}
 
-    // if the range we are searching for is not within our
-    // bounds, then we don't care about this quadtree
-    if (!bounds.isIntersecting(boundsToSearch)) {
-        return;
+template <typename T>
+template <typename Func>
+void QuadTree<T>::Query(const BoundingBox2D& area, Func&& func) const
+{
+    if (nodes.empty()) return;
+    Visit stack[MAX_VISITS];
+    u32 stackSize = 0;
+    stack[stackSize++] = { 0, 0, 0, 0 };
+    while (stackSize)
+    {
+        Visit visit = stack[--stackSize];
+        const Node& node = nodes[visit.node];
+        if (!node.count) continue;
+        BoundingBox2D cell = CellBounds(visit);
+        if (cell.min.x > area.max.x || cell.max.x < area.min.x || cell.min.y > area.max.y || cell.max.y < area.min.y)
+        {
+            continue;
+        }
+        if (node.firstChild != U32_INVALID_ID)
+        {
+            for (u32 i = 0; i < 4; i++)
+            {
+                stack[stackSize++] = { node.firstChild + i, visit.depth + 1, visit.cellX * 2 + (i & 1), visit.cellY * 2 + (i >> 1) };
+            }
+            continue;
+        }
+        ForEachLeafItem(visit.node, [&](const Item& item)
+        {
+            if (item.point.x >= area.min.x && item.point.x <= area.max.x && item.point.y >= area.min.y && item.point.y <= area.max.y)
+            {
+                func(item);
+            }
+        });
     }
+}
 
-    // if we get here, this *quadtree* is in range of the search bounds
-    // however, that doesn't necessarily mean the node is
+template <typename T>
+template <typename Func>
+void QuadTree<T>::QueryRadius(glm::vec2 center, f32 radius, Func&& func) const
+{
+    f32 radiusSq = radius * radius;
+    Query(BoundingBox2D(center - glm::vec2(radius), center + glm::vec2(radius)), [&](const Item& item)
+    {
+        glm::vec2 d = item.point - center;
+        if (glm::dot(d, d) <= radiusSq) func(item);
+    });
+}
 
-    // now check if the actual node's position is within the search
-    // bounds. If so, we care about it
-    if (boundsToSearch.isInBounds(node.point)) {
-        results.push_back(node.data);
-    }
+static inline f32 QuadTreeBoxDistanceSq(const BoundingBox2D& box, glm::vec2 point)
+{
+    glm::vec2 d = glm::max(glm::max(box.min - point, point - box.max), glm::vec2(0));
+    return glm::dot(d, d);
+}
 
-    for (auto& child : children) {
-        child.search(boundsToSearch, results);
+template <typename T>
+u32 QuadTree<T>::FindNearest(glm::vec2 point, u32 k, Item* outItems, f32* outDistancesSq) const
+{
+    if (k == 0 || nodes.empty()) return 0;
+    // outItems is a max heap on distance while searching, so the worst of the current k is on top
+    u32 found = 0;
+    auto distSq = [&](const Item& item) { glm::vec2 d = item.point - point; return glm::dot(d, d); };
+    auto siftDown = [&](u32 i, u32 size)
+    {
+        while (true)
+        {
+            u32 largest = i;
+            u32 left = i * 2 + 1, right = i * 2 + 2;
+            if (left < size && distSq(outItems[left]) > distSq(outItems[largest])) largest = left;
+            if (right < size && distSq(outItems[right]) > distSq(outItems[largest])) largest = right;
+            if (largest == i) return;
+            std::swap(outItems[i], outItems[largest]);
+            i = largest;
+        }
+    };
+
+    struct NearVisit
+    {
+        Visit visit;
+        f32 distSq;
+    };
+    NearVisit stack[MAX_VISITS];
+    u32 stackSize = 0;
+    stack[stackSize++] = { { 0, 0, 0, 0 }, 0.0f };
+    while (stackSize)
+    {
+        NearVisit next = stack[--stackSize];
+        const Node& node = nodes[next.visit.node];
+        if (!node.count || (found == k && next.distSq > distSq(outItems[0])))
+        {
+            continue;
+        }
+        if (node.firstChild != U32_INVALID_ID)
+        {
+            // push the farthest first so the nearest gets searched first and the k best shrink quickly
+            NearVisit children[4];
+            for (u32 i = 0; i < 4; i++)
+            {
+                Visit child = { node.firstChild + i, next.visit.depth + 1, next.visit.cellX * 2 + (i & 1), next.visit.cellY * 2 + (i >> 1) };
+                children[i] = { child, QuadTreeBoxDistanceSq(CellBounds(child), point) };
+            }
+            for (u32 i = 1; i < 4; i++)
+            {
+                for (u32 j = i; j > 0 && children[j - 1].distSq < children[j].distSq; j--) std::swap(children[j - 1], children[j]);
+            }
+            for (u32 i = 0; i < 4; i++)
+            {
+                stack[stackSize++] = children[i];
+            }
+            continue;
+        }
+        ForEachLeafItem(next.visit.node, [&](const Item& item)
+        {
+            if (found < k)
+            {
+                // sift up
+                u32 i = found++;
+                outItems[i] = item;
+                while (i > 0 && distSq(outItems[(i - 1) / 2]) < distSq(outItems[i]))
+                {
+                    std::swap(outItems[(i - 1) / 2], outItems[i]);
+                    i = (i - 1) / 2;
+                }
+            }
+            else if (distSq(item) < distSq(outItems[0]))
+            {
+                outItems[0] = item;
+                siftDown(0, found);
+            }
+        });
     }
-}
-template<typename T>
-bool QuadTree<T>::inBoundary(glm::vec2 p) {
-    return bounds.isInBounds(p);
+    // heap -> nearest first
+    for (u32 size = found; size > 1; size--)
+    {
+        std::swap(outItems[0], outItems[size - 1]);
+        siftDown(0, size - 1);
+    }
+    if (outDistancesSq)
+    {
+        for (u32 i = 0; i < found; i++) outDistancesSq[i] = distSq(outItems[i]);
+    }
+    return found;
 }
 
-template<typename T>
-void QuadTree<T>::Draw() {
-    if (bounds.min == glm::vec2(0) && bounds.max == glm::vec2(0)) return;
-    //std::cout << glm::to_string(bounds.min) << " -> " << glm::to_string(bounds.max) << ""; 
-    if (node.hasData) {
-        Shapes2D::DrawCircle(node.point, 1.0f);
-        //std::cout << "QuadTreeNode pos: " << glm::to_string(node.point) << "";
-        //std::cout << " real ent pos: " << glm::to_string(node.data->tf.position) << "";
+template <typename T>
+void QuadTree<T>::Draw() const
+{
+    if (nodes.empty()) return;
+    Visit stack[MAX_VISITS];
+    u32 stackSize = 0;
+    stack[stackSize++] = { 0, 0, 0, 0 };
+    glm::vec2 slop = 1.0f / cellScale;
+    while (stackSize)
+    {
+        Visit visit = stack[--stackSize];
+        const Node& node = nodes[visit.node];
+        BoundingBox2D cell = CellBounds(visit);
+        Shapes2D::DrawWireframeSquare(cell.min + slop, cell.max - slop, glm::vec4(1));
+        if (node.firstChild != U32_INVALID_ID)
+        {
+            for (u32 i = 0; i < 4; i++)
+            {
+                stack[stackSize++] = { node.firstChild + i, visit.depth + 1, visit.cellX * 2 + (i & 1), visit.cellY * 2 + (i >> 1) };
+            }
+            continue;
+        }
+        ForEachLeafItem(visit.node, [&](const Item& item) { Shapes2D::DrawCircle(item.point, 1.0f); });
     }
+}
 
-    Shapes2D::DrawWireframeSquare(bounds.min, bounds.max, glm::vec4(1), 0.5f);
-    for (QuadTree<T>& child : children) {
-        child.Draw();
-    }
-}
\ No newline at end of file
+// correctness against brute force: inserts/removes/updates, bulk builds, box/radius/k-nearest queries, piles of
+// points on the same spot
+TAPI void QuadTreeTests();
+// 1M points: bulk build vs inserting, queries vs brute force
+TAPI void QuadTreeBenchmarks();
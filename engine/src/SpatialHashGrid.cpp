@@ -0,0 +1,301 @@
+//#include "pch.h"
+#include "SpatialHashGrid.h"
+
+#include "job_system.h"
+#include "tiny_profiler.h"
+#include <atomic>
+
+void SpatialHashGrid::Clear()
+{
+    bucketStart.clear();
+    sortedIndices.clear();
+    sortedPositions.clear();
+    sortedCells.clear();
+    bucketMask = 0;
+}
+
+void SpatialHashGrid::Build(const glm::vec3* positions, u32 count, bool parallel)
+{
+    PROFILE_FUNCTION();
+    // about one bucket per point, rounded up to a power of two so the hash can be masked
+    u32 numBuckets = 16;
+    while (numBuckets < count) numBuckets *= 2;
+    bucketMask = numBuckets - 1;
+    // same sizes as last frame = nothing to do here
+    bucketStart.resize(numBuckets + 1);
+    sortedIndices.resize(count);
+    sortedPositions.resize(count);
+    sortedCells.resize(count);
+    pointBuckets.resize(count);
+    u32* starts = bucketStart.data();
+    u32* buckets = pointBuckets.data();
+    u32* indices = sortedIndices.data();
+    glm::vec3* sorted = sortedPositions.data();
+    glm::ivec3* cells = sortedCells.data();
+    TMEMSET(starts, 0, sizeof(u32) * (numBuckets + 1));
+
+    // counting sort by bucket: count, scan, then scatter. Scattering walks each bucket's cursor backwards from its end,
+    // so the cursors end up at the bucket starts and no separate array of them is needed
+    if (parallel && count >= SPATIAL_HASH_PARALLEL_MIN_COUNT)
+    {
+        JobSystem& jobs = JobSystem::Instance();
+        jobs.ParallelFor(0, count, SPATIAL_HASH_GRAIN_SIZE, [=, this](u32 i) {
+            buckets[i] = BucketOf(CellOf(positions[i]));
+            std::atomic_ref<u32>(starts[buckets[i]]).fetch_add(1, std::memory_order_relaxed);
+        });
+        jobs.ParallelScan(starts, starts, numBuckets, SPATIAL_HASH_GRAIN_SIZE, 0u, [](u32 a, u32 b) { return a + b; });
+        jobs.ParallelFor(0, count, SPATIAL_HASH_GRAIN_SIZE, [=, this](u32 i) {
+            u32 slot = std::atomic_ref<u32>(starts[buckets[i]]).fetch_sub(1, std::memory_order_relaxed) - 1;
+            indices[slot] = i;
+            sorted[slot] = positions[i];
+            cells[slot] = CellOf(positions[i]);
+        });
+    }
+    else
+    {
+        for (u32 i = 0; i < count; i++)
+        {
+            buckets[i] = BucketOf(CellOf(positions[i]));
+            starts[buckets[i]]++;
+        }
+        for (u32 b = 1; b < numBuckets; b++)
+        {
+            starts[b] += starts[b - 1];
+        }
+        // backwards, so each bucket ends up in index order
+        for (u32 i = count; i-- > 0;)
+        {
+            u32 slot = --starts[buckets[i]];
+            indices[slot] = i;
+            sorted[slot] = positions[i];
+            cells[slot] = CellOf(positions[i]);
+        }
+    }
+    starts[numBuckets] = count;
+}
+
+// ============ tests ============
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+#include "scene/bvh.h"
+
+// the grid's answers for random cells/neighborhoods/radii/boxes against checking every point
+static void SpatialHashCheckAgainstBruteForce(const SpatialHashGrid& grid, const std::vector<glm::vec3>& points, std::mt19937& rng, f32 worldSize)
+{
+    TINY_ASSERT(grid.GetSize() == points.size());
+    std::uniform_real_distribution<f32> coord(-worldSize, worldSize);
+    std::uniform_real_distribution<f32> radiusDist(0.0f, worldSize * 0.1f);
+    std::vector<u32> found;
+    std::vector<u32> expected;
+    auto compare = [&]() {
+        std::sort(found.begin(), found.end());
+        std::sort(expected.begin(), expected.end());
+        TINY_ASSERT(found == expected);
+        found.clear();
+        expected.clear();
+    };
+    for (u32 q = 0; q < 100; q++)
+    {
+        glm::vec3 center = glm::vec3(coord(rng), coord(rng), coord(rng));
+        // every so often, on top of the pile of identical points at the origin
+        if (q % 10 == 0) center = glm::vec3(0.0f);
+        // and sometimes bigger than the whole grid, which reads every point instead of going cell by cell
+        f32 radius = q % 25 == 1 ? worldSize * 4.0f : radiusDist(rng);
+
+        grid.QueryRadius(center, radius, [&](u32 index, const glm::vec3& position, f32 distanceSq) {
+            TINY_ASSERT(position == points[index]);
+            glm::vec3 d = points[index] - center;
+            TINY_ASSERT(distanceSq == glm::dot(d, d));
+            found.push_back(index);
+        });
+        for (u32 i = 0; i < points.size(); i++)
+        {
+            glm::vec3 d = points[i] - center;
+            if (glm::dot(d, d) <= radius * radius) expected.push_back(i);
+        }
+        compare();
+
+        BoundingBox area = BoundingBox(center - glm::vec3(radius, radius * 0.5f, radius * 2.0f), center + glm::vec3(radius));
+        grid.QueryBox(area, [&](u32 index, const glm::vec3&) { found.push_back(index); });
+        for (u32 i = 0; i < points.size(); i++)
+        {
+            if (glm::all(glm::greaterThanEqual(points[i], area.min)) && glm::all(glm::lessThanEqual(points[i], area.max))) expected.push_back(i);
+        }
+        compare();
+
+        glm::ivec3 cell = grid.CellOf(center);
+        grid.ForEachNear(center, [&](u32 index, const glm::vec3&) { found.push_back(index); });
+        for (u32 i = 0; i < points.size(); i++)
+        {
+            glm::ivec3 d = glm::abs(grid.CellOf(points[i]) - cell);
+            if (d.x <= 1 && d.y <= 1 && d.z <= 1) expected.push_back(i);
+        }
+        compare();
+    }
+    // every point is in exactly its own cell
+    std::vector<u32> seen(points.size(), 0);
+    for (u32 i = 0; i < points.size(); i++)
+    {
+        glm::ivec3 cell = grid.CellOf(points[i]);
+        grid.ForEachInCell(cell, [&](u32 index, const glm::vec3&) {
+            TINY_ASSERT(grid.CellOf(points[index]) == cell);
+            if (index == i) seen[i]++;
+        });
+        TINY_ASSERT(seen[i] == 1);
+    }
+}
+
+void SpatialHashGridTests()
+{
+    LOG_INFO("Running SpatialHashGrid tests...");
+    std::mt19937 rng(99);
+    constexpr f32 worldSize = 100.0f;
+    std::uniform_real_distribution<f32> coord(-worldSize, worldSize);
+
+    SpatialHashGrid grid(4.0f);
+    grid.Build(nullptr, 0);
+    TINY_ASSERT(grid.GetSize() == 0);
+    grid.QueryRadius(glm::vec3(0), 1000.0f, [](u32, const glm::vec3&, f32) { TINY_ASSERT(false); });
+
+    // cells round towards -inf, so -0.5 isn't in the same cell as 0.5
+    TINY_ASSERT(grid.CellOf(glm::vec3(0.5f, -0.5f, -4.0f)) == glm::ivec3(0, -1, -1));
+    TINY_ASSERT(grid.CellOf(glm::vec3(-4.01f, 7.99f, 8.0f)) == glm::ivec3(-2, 1, 2));
+
+    for (u32 size : { 1u, 50u, 5000u, 40000u })
+    {
+        std::vector<glm::vec3> points(size);
+        for (glm::vec3& p : points) p = glm::vec3(coord(rng), coord(rng), coord(rng));
+        // a pile on one spot, and points right on cell edges
+        for (u32 i = 0; i < size / 10; i++) points[i] = glm::vec3(0.0f);
+        for (u32 i = size / 10; i < size / 5; i++) points[i] = glm::floor(points[i] / 4.0f) * 4.0f;
+        grid.Build(points.data(), size, false);
+        SpatialHashCheckAgainstBruteForce(grid, points, rng, worldSize);
+        // the parallel build (40k is above SPATIAL_HASH_PARALLEL_MIN_COUNT) gives the same answers
+        grid.Build(points.data(), size, true);
+        SpatialHashCheckAgainstBruteForce(grid, points, rng, worldSize);
+        // everything moves, rebuild in place
+        for (glm::vec3& p : points) p += glm::vec3(coord(rng), coord(rng), coord(rng)) * 0.05f;
+        grid.Build(points.data(), size, true);
+        SpatialHashCheckAgainstBruteForce(grid, points, rng, worldSize);
+    }
+
+    // a tiny cell size packs tons of cells into each bucket, answers are still exact
+    SpatialHashGrid fineGrid(0.01f);
+    std::vector<glm::vec3> points(2000);
+    for (glm::vec3& p : points) p = glm::vec3(coord(rng), coord(rng), coord(rng)) * 0.1f;
+    fineGrid.Build(points.data(), (u32)points.size());
+    SpatialHashCheckAgainstBruteForce(fineGrid, points, rng, worldSize * 0.1f);
+    LOG_INFO("SpatialHashGrid tests passed");
+}
+
+template <typename Func>
+static f64 TimeMs(Func func)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    func();
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<f64, std::milli>(end - start).count();
+}
+
+void SpatialHashGridBenchmarks()
+{
+    LOG_INFO("Running SpatialHashGrid benchmarks...");
+    // a crowd/particle-ish density: ~4 other points within the interaction radius of each point
+    constexpr u32 numPoints = 1000000;
+    constexpr u32 numQueries = 100000;
+    constexpr u32 numBruteForceQueries = 20;
+    constexpr u32 numFrames = 10;
+    constexpr f32 worldSize = 1000.0f;
+    constexpr f32 radius = 10.0f;
+
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<f32> coord(0.0f, worldSize);
+    std::uniform_real_distribution<f32> step(-1.0f, 1.0f);
+    std::vector<glm::vec3> points(numPoints);
+    for (glm::vec3& p : points) p = glm::vec3(coord(rng), coord(rng), coord(rng));
+    std::vector<glm::vec3> velocities(numPoints);
+    for (glm::vec3& v : velocities) v = glm::vec3(step(rng), step(rng), step(rng));
+    auto moveAll = [&]() {
+        for (u32 i = 0; i < numPoints; i++) points[i] += velocities[i];
+    };
+
+    // every frame everything moves, then the structure catches up
+    SpatialHashGrid grid(radius);
+    f64 serialMs = 0.0, parallelMs = 0.0, bvhMs = 0.0;
+    Bvh* bvh = new Bvh();
+    std::vector<u32> proxies(numPoints);
+    for (u32 i = 0; i < numPoints; i++) proxies[i] = bvh->CreateProxy(BoundingBox(points[i], points[i]), i, true);
+    bvh->Rebuild();
+    for (u32 frame = 0; frame < numFrames; frame++)
+    {
+        moveAll();
+        serialMs += TimeMs([&]() { grid.Build(points.data(), numPoints, false); });
+        parallelMs += TimeMs([&]() { grid.Build(points.data(), numPoints, true); });
+        // the tree's best case: only leaves that left their fat box get touched, then one SAH rebuild
+        bvhMs += TimeMs([&]() {
+            for (u32 i = 0; i < numPoints; i++) bvh->MoveProxy(proxies[i], BoundingBox(points[i], points[i]), true);
+            if (bvh->NeedsRebuild()) bvh->Rebuild();
+        });
+    }
+    LOG_INFO("[SPATIALHASH] %u points, all moving, ms per frame | grid rebuild serial: %7.2f | parallel: %7.2f | bvh refit + rebuild: %7.2f (%.1fx serial)",
+        numPoints, serialMs / numFrames, parallelMs / numFrames, bvhMs / numFrames, bvhMs / serialMs);
+
+    std::vector<glm::vec3> queryPoints(numQueries);
+    for (glm::vec3& p : queryPoints) p = glm::vec3(coord(rng), coord(rng), coord(rng));
+    u64 gridFound = 0, bvhFound = 0, bruteFound = 0;
+    f64 gridMs = TimeMs([&]() {
+        for (const glm::vec3& p : queryPoints) grid.QueryRadius(p, radius, [&](u32, const glm::vec3&, f32) { gridFound++; });
+    });
+    f64 bvhQueryMs = TimeMs([&]() {
+        for (const glm::vec3& p : queryPoints)
+        {
+            bvh->QueryAabb(BoundingBox(p - glm::vec3(radius), p + glm::vec3(radius)), [&](u32 i) {
+                glm::vec3 d = points[i] - p;
+                bvhFound += glm::dot(d, d) <= radius * radius;
+            });
+        }
+    });
+    f64 bruteMs = TimeMs([&]() {
+        for (u32 q = 0; q < numBruteForceQueries; q++)
+        {
+            for (const glm::vec3& point : points)
+            {
+                glm::vec3 d = point - queryPoints[q];
+                bruteFound += glm::dot(d, d) <= radius * radius;
+            }
+        }
+    });
+    TINY_ASSERT(gridFound == bvhFound && bruteFound > 0);
+    LOG_INFO("[SPATIALHASH] radius %.0f query | grid: %6.2f us | bvh: %6.2f us | brute force: %9.1f us | %.1f points found on average",
+        radius, gridMs * 1000.0 / numQueries, bvhQueryMs * 1000.0 / numQueries, bruteMs * 1000.0 / numBruteForceQueries, (f64)gridFound / numQueries);
+
+    // what a crowd/boids update does: every point looks at its neighbors
+    auto countNeighbors = [&](u32 i) {
+        u32 neighbors = 0;
+        grid.ForEachNear(points[i], [&](u32 other, const glm::vec3& position) {
+            glm::vec3 d = position - points[i];
+            neighbors += other != i && glm::dot(d, d) <= radius * radius;
+        });
+        return neighbors;
+    };
+    u64 serialPairs = 0;
+    f64 neighborSerialMs = TimeMs([&]() {
+        for (u32 i = 0; i < numPoints; i++) serialPairs += countNeighbors(i);
+    });
+    std::atomic<u64> parallelPairs = 0;
+    f64 neighborParallelMs = TimeMs([&]() {
+        JobSystem::Instance().ParallelForRange(0, numPoints, SPATIAL_HASH_GRAIN_SIZE, [&](u32 begin, u32 end) {
+            u64 pairs = 0;
+            for (u32 i = begin; i < end; i++) pairs += countNeighbors(i);
+            parallelPairs += pairs;
+        });
+    });
+    TINY_ASSERT(serialPairs == parallelPairs);
+    LOG_INFO("[SPATIALHASH] neighbor pass over all %u points | serial: %7.2f ms | parallel: %7.2f ms | %.1f neighbors each",
+        numPoints, neighborSerialMs, neighborParallelMs, (f64)serialPairs / numPoints);
+    delete bvh;
+    LOG_INFO("SpatialHashGrid benchmarks complete");
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+//#include "pch.h"
+#include "tiny_types.h"
+#include "containers/dynarray.h"
+
+// Uniform 3D grid for points that all move every frame (particles, projectiles, crowds). There's no incremental update,
+// Build throws everything away and counting sorts the points by cell again, which for things that all moved anyway is
+// cheaper than refitting a tree (QuadTree/Bvh) one point at a time.
+// The grid is unbounded: cells are hashed into about one bucket per point, so memory only depends on the number of points.
+// A bucket can hold several cells that hashed to the same spot, queries skip points from cells they didn't ask for.
+// After Build the points are stored by bucket in flat arrays (with their own copy of the position), so walking a cell
+// is a linear read.
+// Build can use the JobSystem. Queries are const and don't allocate, so job threads can run them at the same time,
+// but not while something is building.
+// Within a cell, points come out in index order after a serial build and in no particular order after a parallel one
+
+// below this many points Build doesn't bother with jobs
+#define SPATIAL_HASH_PARALLEL_MIN_COUNT 16384
+#define SPATIAL_HASH_GRAIN_SIZE 8192
+
+struct SpatialHashGrid
+{
+    // queries within cellSize of a point only need to look at the 3x3x3 cells around it (ForEachNear), so the usual
+    // choice is the biggest interaction radius
+    explicit SpatialHashGrid(f32 cellSize = 1.0f) : cellSize(cellSize), invCellSize(1.0f / cellSize) {}
+    SpatialHashGrid(const SpatialHashGrid&) = delete;
+    SpatialHashGrid& operator=(const SpatialHashGrid&) = delete;
+
+    // replaces the contents with positions[0..count). The index handed to query callbacks is the position's index in
+    // that array. positions isn't needed after this
+    TAPI void Build(const glm::vec3* positions, u32 count, bool parallel = true);
+    // keeps the memory around
+    TAPI void Clear();
+
+    inline glm::ivec3 CellOf(const glm::vec3& point) const { return glm::ivec3(glm::floor(point * invCellSize)); }
+    inline u32 BucketOf(glm::ivec3 cell) const
+    {
+        // spatial hash with large odd multipliers, then the high bits folded down since the mask keeps the low ones
+        u32 hash = ((u32)cell.x * 0x8da6b343u) ^ ((u32)cell.y * 0xd8163841u) ^ ((u32)cell.z * 0xcb1ab31fu);
+        return (hash ^ (hash >> 16)) & bucketMask;
+    }
+
+    // func(u32 index, const glm::vec3& position) for every point in cells minCell to maxCell (inclusive), once each
+    template <typename Func>
+    void ForEachInCells(glm::ivec3 minCell, glm::ivec3 maxCell, Func&& func) const;
+    template <typename Func>
+    inline void ForEachInCell(glm::ivec3 cell, Func&& func) const { ForEachInCells(cell, cell, func); }
+    // the point's cell and the 26 around it. With cellSize >= the interaction radius, that's everything that can be in range
+    template <typename Func>
+    inline void ForEachNear(const glm::vec3& point, Func&& func) const
+    {
+        glm::ivec3 cell = CellOf(point);
+        ForEachInCells(cell - glm::ivec3(1), cell + glm::ivec3(1), func);
+    }
+    // func(u32 index, const glm::vec3& position, f32 distanceSq) for every point within radius of center (edge included)
+    template <typename Func>
+    void QueryRadius(const glm::vec3& center, f32 radius, Func&& func) const;
+    // func(u32 index, const glm::vec3& position) for every point inside area (edges included)
+    template <typename Func>
+    void QueryBox(const BoundingBox& area, Func&& func) const;
+
+    inline u32 GetSize() const { return sortedIndices.size(); }
+    inline u32 GetBucketCount() const { return bucketMask + 1; }
+
+    f32 cellSize = 1.0f;
+    f32 invCellSize = 1.0f;
+
+private:
+    // bucketStart[b] .. bucketStart[b + 1] is bucket b's slice of the sorted arrays
+    DynArray<u32> bucketStart = {};
+    DynArray<u32> sortedIndices = {};
+    DynArray<glm::vec3> sortedPositions = {};
+    // cell of every sorted point, telling apart the cells that share a bucket
+    DynArray<glm::ivec3> sortedCells = {};
+    // bucket of every input point, scratch for Build
+    DynArray<u32> pointBuckets = {};
+    u32 bucketMask = 0;
+};
+
+// ============ implementation ============
+
+template <typename Func>
+void SpatialHashGrid::ForEachInCells(glm::ivec3 minCell, glm::ivec3 maxCell, Func&& func) const
+{
+    if (sortedIndices.empty()) return;
+    glm::i64vec3 extent = glm::i64vec3(maxCell) - glm::i64vec3(minCell) + glm::i64vec3(1);
+    if (extent.x <= 0 || extent.y <= 0 || extent.z <= 0) return;
+    const glm::vec3* positions = sortedPositions.data();
+    const glm::ivec3* cells = sortedCells.data();
+    if (extent.x * extent.y * extent.z >= (s64)GetBucketCount())
+    {
+        // more cells than buckets, going cell by cell would read every bucket (some more than once) anyway
+        for (u32 slot = 0; slot < sortedIndices.size(); slot++)
+        {
+            const glm::ivec3& cell = cells[slot];
+            if (glm::all(glm::greaterThanEqual(cell, minCell)) && glm::all(glm::lessThanEqual(cell, maxCell)))
+            {
+                func(sortedIndices[slot], positions[slot]);
+            }
+        }
+        return;
+    }
+    for (s32 z = minCell.z; z <= maxCell.z; z++)
+    {
+        for (s32 y = minCell.y; y <= maxCell.y; y++)
+        {
+            for (s32 x = minCell.x; x <= maxCell.x; x++)
+            {
+                glm::ivec3 cell = glm::ivec3(x, y, z);
+                u32 bucket = BucketOf(cell);
+                for (u32 slot = bucketStart[bucket]; slot < bucketStart[bucket + 1]; slot++)
+                {
+                    // other cells in the same bucket either aren't wanted or come up when we get to them
+                    if (cells[slot] == cell)
+                    {
+                        func(sortedIndices[slot], positions[slot]);
+                    }
+                }
+            }
+        }
+    }
+}
+
+template <typename Func>
+void SpatialHashGrid::QueryRadius(const glm::vec3& center, f32 radius, Func&& func) const
+{
+    f32 radiusSq = radius * radius;
+    ForEachInCells(CellOf(center - glm::vec3(radius)), CellOf(center + glm::vec3(radius)), [&](u32 index, const glm::vec3& position) {
+        glm::vec3 d = position - center;
+        f32 distanceSq = glm::dot(d, d);
+        if (distanceSq <= radiusSq)
+        {
+            func(index, position, distanceSq);
+        }
+    });
+}
+
+template <typename Func>
+void SpatialHashGrid::QueryBox(const BoundingBox& area, Func&& func) const
+{
+    ForEachInCells(CellOf(area.min), CellOf(area.max), [&](u32 index, const glm::vec3& position) {
+        if (glm::all(glm::greaterThanEqual(position, area.min)) && glm::all(glm::lessThanEqual(position, area.max)))
+        {
+            func(index, position);
+        }
+    });
+}
+
+// against brute force: cells, neighbors, radius/box queries (small and huge), negative coordinates, piles of points
+// on one spot, serial vs parallel builds
+TAPI void SpatialHashGridTests();
+// 1M moving points: serial/parallel rebuild vs refitting a Bvh, radius queries vs brute force, a neighbor pass over
+// every point
+TAPI void SpatialHashGridBenchmarks();
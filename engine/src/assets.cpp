@@ -3,15 +3,16 @@
 #include "mem/tiny_arena.h"
 #include "tiny_fs.h"
 #include "tiny_log.h"
+#include "containers/hash_map.h"
 
-#include <unordered_map>
+#include <string>
 
 namespace Assets
 {
 #define PREALLOCATED_ASSET_MEM_MB 10
 
 // TODO: put in engine mem
-static std::unordered_map<u32, void*> assetRecord = {};
+static HashMap<u32, void*> assetRecord = {};
 
 /*Arena& GetAssetArena()
 {
@@ -31,7 +32,7 @@ u32 Load(const char* filepath)
 
     //Arena& assetArena = GetAssetArena();
     //void* assetData = arena_alloc(&assetArena, size);
-    void* assetData = TSYSALLOC(size);
+    void* assetData = TSYSALLOC_TAGGED(size, MemTag::ASSETS);
     u32 assetID = 0;
     if (ReadFileContentsBinary(filepath, assetData, size))
     {
@@ -47,20 +48,17 @@ u32 Load(const char* filepath)
 }
 void Unload(u32 id)
 {
-    if (assetRecord.count(id))
+    if (void** assetData = assetRecord.find(id))
     {
-        void* assetData = assetRecord[id];
+        void* data = *assetData;
         assetRecord.erase(id);
-        TSYSFREE(assetData);
+        TSYSFREE(data);
     }
 }
 void* Get(u32 id)
 {
-    if (assetRecord.count(id))
-    {
-        return assetRecord[id];
-    }
-    return nullptr;
+    void** assetData = assetRecord.find(id);
+    return assetData ? *assetData : nullptr;
 }
 
 
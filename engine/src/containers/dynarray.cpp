@@ -4,29 +4,11 @@
 #include "tiny_log.h"
 #include "mem/tiny_arena.h"
 
-#define ARRAY_CHECKS 1
-
+#include <vector>
+#include <chrono>
 
-struct DynArrayHeader
-{
-    // number of elements currently in the array
-    u32 size;
-    // number of *elements* we can hold in our backing memory
-    u32 capacity;
-    // size in bytes of each element
-    u32 stride;
-    // allocation function
-    DynArrayAllocFunc allocFunc;
-    DynArrayFreeFunc freeFunc;
-};
+#define ARRAY_CHECKS 1
 
-inline DynArrayHeader* GetHeaderPointer(DynArray array)
-{
-    u32 headerSize = sizeof(DynArrayHeader);
-    // our header will always be 'behind' our array pointer.
-    DynArrayHeader* headerPtr = (DynArrayHeader*)(((u8*)array) - headerSize);
-    return headerPtr;
-}
 
 // ===== Create & Destroy =====
 
@@ -34,7 +16,7 @@ void* DynArrayInternalAlloc(DynArrayAllocFunc allocFunc, size_t size)
 {
     if (allocFunc == nullptr)
     {
-        return TSYSALLOC(size);
+        return TSYSALLOC_TAGGED(size, MemTag::CONTAINERS);
     }
     else
     {
@@ -54,28 +36,35 @@ void DynArrayInternalFree(DynArrayFreeFunc freeFunc, void* data)
     }
 }
 
-DynArray __DynArrayCreate(u32 stride, u32 initialCapacity, DynArrayAllocFunc allocFunc, DynArrayFreeFunc freeFunc)
+// header is filled in, elements are left uninitialized
+static DynArrayRaw DynArrayAllocate(u32 stride, u32 capacity, DynArrayAllocFunc allocFunc, DynArrayFreeFunc freeFunc, f32 growthFactor)
 {
     u32 headerSize = sizeof(DynArrayHeader);
-    u32 arraySize = initialCapacity * stride;
-    u32 allocSize = headerSize + arraySize;
-    // TODO: allow custom allocator
+    size_t allocSize = headerSize + (size_t)capacity * stride;
     u8* arrayBackingMem = (u8*)DynArrayInternalAlloc(allocFunc, allocSize);
-    TMEMSET(arrayBackingMem, 0, allocSize);
+    TINY_ASSERT(arrayBackingMem && "DynArray allocation failed");
     // populate header
     DynArrayHeader* headerPointer = (DynArrayHeader*)arrayBackingMem;
     headerPointer->size = 0;
-    headerPointer->capacity = initialCapacity;
+    headerPointer->capacity = capacity;
     headerPointer->stride = stride;
+    headerPointer->growthFactor = growthFactor;
     headerPointer->allocFunc = allocFunc;
     headerPointer->freeFunc = freeFunc;
     // our DynArray is a pointer to our array elements, and metadata about the array
     // is stored just before that pointer
-    DynArray result = arrayBackingMem + headerSize; 
+    return arrayBackingMem + headerSize;
+}
+
+DynArrayRaw __DynArrayCreate(u32 stride, u32 initialCapacity, DynArrayAllocFunc allocFunc, DynArrayFreeFunc freeFunc, f32 growthFactor)
+{
+    TINY_ASSERT(growthFactor > 1.0f);
+    DynArrayRaw result = DynArrayAllocate(stride, initialCapacity, allocFunc, freeFunc, growthFactor);
+    TMEMSET(result, 0, (size_t)initialCapacity * stride);
     return result;
 }
 
-void DynArrayDestroy(DynArray& array)
+void DynArrayDestroy(DynArrayRaw& array)
 {
     // since header info is stored before the array pointer, move back to the beginning of the allocation to free it
     DynArrayHeader* baseArrayPtr = GetHeaderPointer(array);
@@ -83,26 +72,61 @@ void DynArrayDestroy(DynArray& array)
     array = (void*)0;
 }
 
-constexpr static u32 GROWTH_FACTOR = 2;
-DynArray DynArrayResize(DynArray array)
+// moves the array to a new allocation that holds newCapacity elements
+static DynArrayRaw DynArrayReallocate(DynArrayRaw array, u32 newCapacity)
 {
     DynArrayHeader* header = GetHeaderPointer(array);
-#if ARRAY_CHECKS
-    TINY_ASSERT(header->capacity != 0 && "resize called on array with 0 capacity");
-#endif
-    u32 newCapacity = header->size * GROWTH_FACTOR;
-    DynArray newArray = __DynArrayCreate(header->stride, newCapacity, header->allocFunc, header->freeFunc);
-    DynArrayHeader* newArrayBasePtr = GetHeaderPointer(newArray);
-    u32 totalOldArraySize = (header->size * header->stride) + sizeof(DynArrayHeader);
-    TMEMCPY(newArrayBasePtr, header, totalOldArraySize);
-    newArrayBasePtr->capacity = newCapacity;
+    TINY_ASSERT(newCapacity >= header->size);
+    DynArrayRaw newArray = DynArrayAllocate(header->stride, newCapacity, header->allocFunc, header->freeFunc, header->growthFactor);
+    DynArrayHeader* newHeader = GetHeaderPointer(newArray);
+    newHeader->size = header->size;
+    TMEMCPY(newArray, array, (size_t)header->size * header->stride);
     DynArrayDestroy(array);
     return newArray;
 }
 
+// makes room for numToAdd more elements, growing by the growth factor (or to exactly what's needed if that's more)
+static DynArrayRaw DynArrayGrow(DynArrayRaw array, u32 numToAdd)
+{
+    DynArrayHeader* header = GetHeaderPointer(array);
+    u32 needed = header->size + numToAdd;
+    if (needed <= header->capacity)
+    {
+        return array;
+    }
+    u32 newCapacity = (u32)(header->capacity * header->growthFactor);
+    if (newCapacity < needed) newCapacity = needed;
+    return DynArrayReallocate(array, newCapacity);
+}
+
+void* __DynArrayReserve(DynArrayRaw array, u32 capacity)
+{
+    DynArrayHeader* header = GetHeaderPointer(array);
+    return capacity > header->capacity ? DynArrayReallocate(array, capacity) : array;
+}
+
+void* __DynArrayResize(DynArrayRaw array, u32 size)
+{
+    DynArrayHeader* header = GetHeaderPointer(array);
+    if (size > header->size)
+    {
+        array = __DynArrayReserve(array, size);
+        header = GetHeaderPointer(array);
+        TMEMSET((u8*)array + (size_t)header->size * header->stride, 0, (size_t)(size - header->size) * header->stride);
+    }
+    header->size = size;
+    return array;
+}
+
+void DynArraySetGrowthFactor(DynArrayRaw array, f32 growthFactor)
+{
+    TINY_ASSERT(growthFactor > 1.0f);
+    GetHeaderPointer(array)->growthFactor = growthFactor;
+}
+
 // ===== Modify array ======
 
-void* __DynArrayPushAt(DynArray array, void* obj, u32 index)
+void* __DynArrayPushAt(DynArrayRaw array, void* obj, u32 index)
 {
     DynArrayHeader* header = GetHeaderPointer(array);
 #if ARRAY_CHECKS
@@ -112,16 +136,13 @@ void* __DynArrayPushAt(DynArray array, void* obj, u32 index)
         return nullptr;
     }
 #endif
-    if (header->size >= header->capacity)
-    {
-        array = DynArrayResize(array);
-        header = GetHeaderPointer(array);
-    }
-    u32 arrSize =header->size;
+    array = DynArrayGrow(array, 1);
+    header = GetHeaderPointer(array);
+    u32 arrSize = header->size;
     u32 stride = header->stride;
     u8* arrayMem = (u8*)array;
     // if not on last element, copy all elements 1 to the right
-    if (index < arrSize-1)
+    if (index < arrSize)
     {
         u32 moveSize = (arrSize - index) * stride;
         u8* moveTo   = arrayMem + ((index+1) * stride);
@@ -134,18 +155,28 @@ void* __DynArrayPushAt(DynArray array, void* obj, u32 index)
     return array;
 }
 
+void* __DynArrayPush(DynArrayRaw array, void* obj)
+{
+    array = DynArrayGrow(array, 1);
+    DynArrayHeader* header = GetHeaderPointer(array);
+    TMEMCPY((u8*)array + (size_t)header->size * header->stride, obj, header->stride);
+    header->size++;
+    return array;
+}
 
-
-void* __DynArrayPush(DynArray array, void* obj)
+void* __DynArrayPushN(DynArrayRaw array, const void* objs, u32 count)
 {
-    return __DynArrayPushAt(array, obj, DynArrayGetSize(array));
+    array = DynArrayGrow(array, count);
+    DynArrayHeader* header = GetHeaderPointer(array);
+    TMEMCPY((u8*)array + (size_t)header->size * header->stride, objs, (size_t)count * header->stride);
+    header->size += count;
+    return array;
 }
 
-void __DynArrayPopAt(DynArray array, u32 index, void* out)
+void __DynArrayPopAt(DynArrayRaw array, u32 index, void* out)
 {
     DynArrayHeader* header = GetHeaderPointer(array);
     u32 arrSize = header->size;
-    u32 capacity = header->capacity;
     u32 stride = header->stride;
 #if ARRAY_CHECKS
     if (index >= arrSize)
@@ -162,7 +193,7 @@ void __DynArrayPopAt(DynArray array, u32 index, void* out)
     // if not last element, copy everything to the right of it 1 spot to the left
     if (index != arrSize-1)
     {
-        u32 moveSize = (arrSize - index) * stride;
+        u32 moveSize = (arrSize - index - 1) * stride;
         u8* moveTo   = arrayMem + ((index+0) * stride);
         u8* moveFrom = arrayMem + ((index+1) * stride);
         TMEMMOVE(moveTo, moveFrom, moveSize);
@@ -170,12 +201,12 @@ void __DynArrayPopAt(DynArray array, u32 index, void* out)
     header->size--;
 }
 
-void __DynArrayPop(DynArray array, void* out)
+void __DynArrayPop(DynArrayRaw array, void* out)
 {
     return __DynArrayPopAt(array, DynArrayGetSize(array)-1, out);
 }
 
-void DynArrayClear(DynArray array)
+void DynArrayClear(DynArrayRaw array)
 {
     DynArrayHeader* header = GetHeaderPointer(array);
     header->size = 0;
@@ -183,25 +214,74 @@ void DynArrayClear(DynArray array)
 
 // ===== Get header info ======
 
-u32 DynArrayGetSize(DynArray array)
+u32 DynArrayGetSize(DynArrayRaw array)
 {
     DynArrayHeader* headerPtr = GetHeaderPointer(array);
     return headerPtr->size;
 }
 
-u32 DynArrayGetCapacity(DynArray array)
+u32 DynArrayGetCapacity(DynArrayRaw array)
 {
     DynArrayHeader* headerPtr = GetHeaderPointer(array);
     return headerPtr->capacity;
 }
 
-u32 DynArrayGetStride(DynArray array)
+u32 DynArrayGetStride(DynArrayRaw array)
 {
     DynArrayHeader* headerPtr = GetHeaderPointer(array);
     return headerPtr->stride;
 }
 
 
+static u32 dynArrayTestNumAllocs = 0;
+static u32 dynArrayTestNumFrees = 0;
+static void* DynArrayTestAlloc(size_t size) { dynArrayTestNumAllocs++; return TSYSALLOC(size); }
+static void DynArrayTestFree(void* data) { dynArrayTestNumFrees++; TSYSFREE(data); }
+
+static void TypedDynArrayTests()
+{
+    {
+        DynArray<u32> arr;
+        TINY_ASSERT(arr.size() == 0 && arr.capacity() == 0 && arr.begin() == arr.end()); // nothing allocated yet
+        for (u32 i = 0; i < 100; i++) arr.push_back(i);
+        u32 sum = 0;
+        for (u32 val : arr) sum += val;
+        TINY_ASSERT(arr.size() == 100 && sum == 99 * 100 / 2);
+        arr.insert(1000, 0);
+        TINY_ASSERT(arr[0] == 1000 && arr[1] == 0 && arr[100] == 99);
+        TINY_ASSERT(arr.erase(0) == 1000 && arr[0] == 0 && arr.pop_back() == 99 && arr.size() == 99);
+        // pushing one of our own elements while full
+        arr.resize(arr.capacity());
+        arr.push_back(arr[5]);
+        TINY_ASSERT(arr[arr.size() - 1] == 5);
+        // resize zeroes new elements, clear keeps memory
+        arr.resize(500);
+        TINY_ASSERT(arr.size() == 500 && arr[499] == 0 && arr[98] == 98);
+        u32 capacity = arr.capacity();
+        arr.clear();
+        TINY_ASSERT(arr.empty() && arr.capacity() == capacity);
+        u32 bulk[1000];
+        for (u32 i = 0; i < ARRAY_SIZE(bulk); i++) bulk[i] = i;
+        arr.append(bulk, ARRAY_SIZE(bulk));
+        TINY_ASSERT(arr.size() == 1000 && arr.capacity() == 1000 && arr[999] == 999); // grew once, to exactly what's needed
+        DynArray<u32> moved = std::move(arr);
+        TINY_ASSERT(arr.size() == 0 && moved.size() == 1000 && moved[500] == 500);
+    }
+    // growth factor and allocator binding
+    {
+        DynArray<u64> arr(4, DynArrayTestAlloc, DynArrayTestFree, 1.5f);
+        TINY_ASSERT(dynArrayTestNumAllocs == 1 && arr.capacity() == 4);
+        for (u32 i = 0; i < 5; i++) arr.push_back(i);
+        TINY_ASSERT(arr.capacity() == 6 && dynArrayTestNumAllocs == 2 && dynArrayTestNumFrees == 1);
+        arr.set_growth_factor(4.0f);
+        for (u32 i = 0; i < 2; i++) arr.push_back(i);
+        TINY_ASSERT(arr.capacity() == 24);
+        arr.reserve(100);
+        TINY_ASSERT(arr.capacity() == 100 && arr[4] == 4 && arr.size() == 7);
+    }
+    TINY_ASSERT(dynArrayTestNumAllocs == dynArrayTestNumFrees);
+}
+
 void DynArrayTests()
 {
     LOG_INFO("Testing DynArray...");
@@ -254,7 +334,94 @@ void DynArrayTests()
     DynArrayPop(arr, shouldntChange);
     DynArrayPopAt(arr, 0, shouldntChange);
     TINY_ASSERT(shouldntChange == 0xDEADBEEF);
+    DynArrayRaw rawArr = arr;
+    DynArrayDestroy(rawArr);
 
+    TypedDynArrayTests();
     LOG_INFO("DynArray Tests complete");
 }
 
+
+template <typename Func>
+static f64 TimeMs(Func func)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    func();
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<f64, std::milli>(end - start).count();
+}
+
+// per frame list of something like a draw command
+struct DynArrayBenchElement
+{
+    u32 data[5];
+};
+
+void DynArrayBenchmarks()
+{
+    LOG_INFO("Running DynArray benchmarks...");
+    constexpr u32 numElements = 1000000;
+    constexpr u32 numRounds = 20;
+    typedef DynArrayBenchElement Element;
+    std::vector<Element> source(numElements);
+    for (u32 i = 0; i < numElements; i++) source[i].data[0] = i;
+    volatile u64 sink = 0;
+
+    // a fresh list every round, pushed one at a time
+    f64 vectorPushMs = TimeMs([&]() {
+        for (u32 round = 0; round < numRounds; round++)
+        {
+            std::vector<Element> vec;
+            for (u32 i = 0; i < numElements; i++) vec.push_back(source[i]);
+            sink = sink + vec.size();
+        }
+    });
+    f64 dynArrayPushMs = TimeMs([&]() {
+        for (u32 round = 0; round < numRounds; round++)
+        {
+            DynArray<Element> arr;
+            for (u32 i = 0; i < numElements; i++) arr.push_back(source[i]);
+            sink = sink + arr.size();
+        }
+    });
+    // reused list: cleared and refilled in bulk every round
+    std::vector<Element> vec;
+    DynArray<Element> arr;
+    f64 vectorAppendMs = TimeMs([&]() {
+        for (u32 round = 0; round < numRounds; round++)
+        {
+            vec.clear();
+            vec.insert(vec.end(), source.begin(), source.end());
+        }
+    });
+    f64 dynArrayAppendMs = TimeMs([&]() {
+        for (u32 round = 0; round < numRounds; round++)
+        {
+            arr.clear();
+            arr.append(source.data(), numElements);
+        }
+    });
+    f64 vectorIterateMs = TimeMs([&]() {
+        u64 sum = 0;
+        for (u32 round = 0; round < numRounds; round++)
+        {
+            for (const Element& element : vec) sum += element.data[0];
+        }
+        sink = sink + sum;
+    });
+    f64 dynArrayIterateMs = TimeMs([&]() {
+        u64 sum = 0;
+        for (u32 round = 0; round < numRounds; round++)
+        {
+            for (const Element& element : arr) sum += element.data[0];
+        }
+        sink = sink + sum;
+    });
+
+    f64 numOps = (f64)numElements * numRounds;
+    LOG_INFO("[DYNARRAY] %u x %u byte elements, %u rounds (ns per element)", numElements, (u32)sizeof(Element), numRounds);
+    LOG_INFO("[DYNARRAY] push_back      | std::vector: %6.2f ns | DynArray: %6.2f ns | %.2fx", vectorPushMs * 1e6 / numOps, dynArrayPushMs * 1e6 / numOps, vectorPushMs / dynArrayPushMs);
+    LOG_INFO("[DYNARRAY] clear + append | std::vector: %6.2f ns | DynArray: %6.2f ns | %.2fx", vectorAppendMs * 1e6 / numOps, dynArrayAppendMs * 1e6 / numOps, vectorAppendMs / dynArrayAppendMs);
+    LOG_INFO("[DYNARRAY] iterate        | std::vector: %6.2f ns | DynArray: %6.2f ns | %.2fx", vectorIterateMs * 1e6 / numOps, dynArrayIterateMs * 1e6 / numOps, vectorIterateMs / dynArrayIterateMs);
+    LOG_INFO("DynArray benchmarks complete");
+}
@@ -1,43 +1,77 @@
 #ifndef TINY_DYNARRAY_H
 #define TINY_DYNARRAY_H
 
+#include <type_traits>
+#include <utility>
 #include "tiny_defines.h"
 #include "tiny_log.h"
 
 // "stretchy buffer" implementation
 // dynamic array that resizes itself when capacity is reached
 // stores capacity/size in a header section stored *before* the actual array pointer
+// Elements are moved around with memcpy, so only use this for trivially copyable types
 
-typedef void* DynArray;
+typedef void* DynArrayRaw;
 constexpr static u32 INITIAL_CAPACITY = 5;
+// capacity is multiplied by this when we run out of space
+#define DYNARRAY_DEFAULT_GROWTH_FACTOR 2.0f
 
+// Memory for the array (header + elements). Arena backed hooks can make freeFunc a no-op, I.E. FrameAlloc/FrameFree
+// in tiny_engine.h for lists that only live for a frame. Null means the engine heap
 typedef void* (*DynArrayAllocFunc)(size_t size);
 typedef void (*DynArrayFreeFunc)(void* data);
 
+struct DynArrayHeader
+{
+    // number of elements currently in the array
+    u32 size;
+    // number of *elements* we can hold in our backing memory
+    u32 capacity;
+    // size in bytes of each element
+    u32 stride;
+    // capacity multiplier when we run out of space
+    f32 growthFactor;
+    // allocation function
+    DynArrayAllocFunc allocFunc;
+    DynArrayFreeFunc freeFunc;
+};
+// keeps the elements after the header aligned like any other allocation
+static_assert(sizeof(DynArrayHeader) % 16 == 0);
+
+inline DynArrayHeader* GetHeaderPointer(DynArrayRaw array)
+{
+    u32 headerSize = sizeof(DynArrayHeader);
+    // our header will always be 'behind' our array pointer.
+    DynArrayHeader* headerPtr = (DynArrayHeader*)(((u8*)array) - headerSize);
+    return headerPtr;
+}
+
 // Create an array with an optional initial capacity (number of elements)
-DynArray __DynArrayCreate(u32 stride, u32 initialCapacity, DynArrayAllocFunc allocFunc, DynArrayFreeFunc freeFunc);
+DynArrayRaw __DynArrayCreate(u32 stride, u32 initialCapacity, DynArrayAllocFunc allocFunc, DynArrayFreeFunc freeFunc, f32 growthFactor = DYNARRAY_DEFAULT_GROWTH_FACTOR);
 template<typename T>
 T* DynArrayCreate(u32 initialCapacity = INITIAL_CAPACITY, DynArrayAllocFunc allocFunc = nullptr, DynArrayFreeFunc freeFunc = nullptr)
 {
     return (T*)__DynArrayCreate(sizeof(T), initialCapacity, allocFunc, freeFunc);
 }
 // Frees backing memory
-void DynArrayDestroy(DynArray& array);
+void DynArrayDestroy(DynArrayRaw& array);
 
 // Retrives the size from the DynArray header
-u32 DynArrayGetSize(DynArray array);
+u32 DynArrayGetSize(DynArrayRaw array);
 // Retrives the capacity from the DynArray header
-u32 DynArrayGetCapacity(DynArray array);
+u32 DynArrayGetCapacity(DynArrayRaw array);
 // Retrives the stride from the DynArray header
-u32 DynArrayGetStride(DynArray array);
+u32 DynArrayGetStride(DynArrayRaw array);
+// growth factor has to be > 1. Growing always makes room for at least one more element
+void DynArraySetGrowthFactor(DynArrayRaw array, f32 growthFactor);
 
 template <typename T>
-inline T& DynArrayGet(DynArray array, u32 index)
+inline T& DynArrayGet(DynArrayRaw array, u32 index)
 {
     return ((T*)array)[index];
 }
 
-void* __DynArrayPushAt(DynArray array, void* obj, u32 index);
+void* __DynArrayPushAt(DynArrayRaw array, void* obj, u32 index);
 // Copies an object to a specified index (and moves all other elements over)
 // passing reference as this could potentially reallocate if backing mem is full
 // pushing to an index outside the range [0,length] returns nullptr, logs an error, and does nothing
@@ -46,39 +80,201 @@ void DynArrayPushAt(T*& array, T obj, u32 index)
 {
     array = (T*)__DynArrayPushAt(array, &obj, index);
 }
-inline void* __DynArrayPush(DynArray array, void* obj);
+void* __DynArrayPush(DynArrayRaw array, void* obj);
 // Copies an object to the end of the array
 template <typename T>
 void DynArrayPush(T*& array, T obj)
 {
-    array = (T*)__DynArrayPush((DynArray*)array, (void*)&obj);
+    array = (T*)__DynArrayPush(array, (void*)&obj);
+}
+void* __DynArrayPushN(DynArrayRaw array, const void* objs, u32 count);
+// Copies count objects to the end of the array, growing at most once
+template <typename T>
+void DynArrayPushN(T*& array, const T* objs, u32 count)
+{
+    array = (T*)__DynArrayPushN(array, objs, count);
+}
+// Makes sure the array can hold capacity elements without growing. Can reallocate
+void* __DynArrayReserve(DynArrayRaw array, u32 capacity);
+template <typename T>
+void DynArrayReserve(T*& array, u32 capacity)
+{
+    array = (T*)__DynArrayReserve(array, capacity);
+}
+// Sets the number of elements. New elements are zeroed. Can reallocate
+void* __DynArrayResize(DynArrayRaw array, u32 size);
+template <typename T>
+void DynArrayResize(T*& array, u32 size)
+{
+    array = (T*)__DynArrayResize(array, size);
 }
 
-void __DynArrayPopAt(DynArray array, u32 index, void* out = 0);
+void __DynArrayPopAt(DynArrayRaw array, u32 index, void* out = 0);
 // remove (and optionally return element) at specified index
 // popping at an index outside the range [0,length-1] does nothing and logs an error
 template <typename T>
-inline void DynArrayPopAt(DynArray array, u32 index, T& out)
+inline void DynArrayPopAt(DynArrayRaw array, u32 index, T& out)
 {
     __DynArrayPopAt(array, index, &out);
 }
 
 // remove (and optionally return) the last element
-inline void __DynArrayPop(DynArray array, void* out = 0);
+void __DynArrayPop(DynArrayRaw array, void* out = 0);
 template <typename T>
-inline void DynArrayPop(DynArray array, T& out)
+inline void DynArrayPop(DynArrayRaw array, T& out)
 {
     __DynArrayPop(array, &out);
 }
 
 // sets array size to 0, does not free backing memory
-void DynArrayClear(DynArray array);
+void DynArrayClear(DynArrayRaw array);
 
 
 #define DynArrayForEach(arr, idx) \
-    int idx = 0; idx < DynArrayGetSize(arr); i++
+    u32 idx = 0; idx < DynArrayGetSize(arr); idx++
 
-#endif
 
+// Typed, owning wrapper around the functions above. Doesn't allocate until something is pushed (or reserved), so
+// default constructed ones are free. Move only.
+// Pointers to elements are invalidated by anything that can grow the array
+template <typename T>
+struct DynArray
+{
+    static_assert(std::is_trivially_copyable_v<T>, "DynArray moves elements with memcpy");
+
+    DynArray() = default;
+    explicit DynArray(u32 initialCapacity, DynArrayAllocFunc allocFunc = nullptr, DynArrayFreeFunc freeFunc = nullptr, f32 growthFactor = DYNARRAY_DEFAULT_GROWTH_FACTOR)
+        : allocFunc(allocFunc), freeFunc(freeFunc), growthFactor(growthFactor)
+    {
+        if (initialCapacity) create(initialCapacity);
+    }
+    // binds an allocator without allocating yet
+    DynArray(DynArrayAllocFunc allocFunc, DynArrayFreeFunc freeFunc, f32 growthFactor = DYNARRAY_DEFAULT_GROWTH_FACTOR)
+        : allocFunc(allocFunc), freeFunc(freeFunc), growthFactor(growthFactor) {}
+    DynArray(const DynArray&) = delete;
+    DynArray& operator=(const DynArray&) = delete;
+    DynArray(DynArray&& other) noexcept { *this = std::move(other); }
+    DynArray& operator=(DynArray&& other) noexcept
+    {
+        if (this != &other)
+        {
+            destroy();
+            elements = other.elements;
+            allocFunc = other.allocFunc;
+            freeFunc = other.freeFunc;
+            growthFactor = other.growthFactor;
+            other.elements = nullptr;
+        }
+        return *this;
+    }
+    ~DynArray() { destroy(); }
 
-void DynArrayTests();
\ No newline at end of file
+    inline void push_back(const T& element)
+    {
+        if (elements)
+        {
+            DynArrayHeader* header = GetHeaderPointer(elements);
+            if (header->size < header->capacity)
+            {
+                elements[header->size++] = element;
+                return;
+            }
+        }
+        else
+        {
+            create(INITIAL_CAPACITY);
+        }
+        T copy = element; // element could live in our buffer, which growing moves
+        elements = (T*)__DynArrayPush(elements, &copy);
+    }
+    // bulk push, grows at most once
+    inline void append(const T* data, u32 count)
+    {
+        if (!count) return;
+        if (!elements) create(count);
+        elements = (T*)__DynArrayPushN(elements, data, count);
+    }
+    inline void insert(const T& element, u32 index)
+    {
+        if (!elements) create(INITIAL_CAPACITY);
+        T copy = element;
+        elements = (T*)__DynArrayPushAt(elements, &copy, index);
+    }
+    inline T pop_back()
+    {
+        T result;
+        __DynArrayPop(elements, &result);
+        return result;
+    }
+    inline T erase(u32 index)
+    {
+        T result;
+        __DynArrayPopAt(elements, index, &result);
+        return result;
+    }
+    inline void reserve(u32 newCapacity)
+    {
+        if (!elements) create(newCapacity);
+        else elements = (T*)__DynArrayReserve(elements, newCapacity);
+    }
+    // new elements are zeroed
+    inline void resize(u32 newSize)
+    {
+        if (!elements) create(newSize);
+        elements = (T*)__DynArrayResize(elements, newSize);
+    }
+    // keeps the memory
+    inline void clear() { if (elements) DynArrayClear(elements); }
+    inline void set_growth_factor(f32 factor)
+    {
+        growthFactor = factor;
+        if (elements) DynArraySetGrowthFactor(elements, factor);
+    }
+
+    inline u32 size() const { return elements ? GetHeaderPointer(elements)->size : 0; }
+    inline u32 capacity() const { return elements ? GetHeaderPointer(elements)->capacity : 0; }
+    inline bool empty() const { return size() == 0; }
+    inline T& operator[](u32 index)
+    {
+        TINY_ASSERT(index < size());
+        return elements[index];
+    }
+    inline const T& operator[](u32 index) const
+    {
+        TINY_ASSERT(index < size());
+        return elements[index];
+    }
+    inline T* data() { return elements; }
+    inline const T* data() const { return elements; }
+    inline T* begin() { return elements; }
+    inline T* end() { return elements + size(); }
+    inline const T* begin() const { return elements; }
+    inline const T* end() const { return elements + size(); }
+
+private:
+    inline void create(u32 initialCapacity)
+    {
+        elements = (T*)__DynArrayCreate(sizeof(T), initialCapacity ? initialCapacity : 1, allocFunc, freeFunc, growthFactor);
+    }
+    inline void destroy()
+    {
+        if (elements)
+        {
+            DynArrayRaw raw = elements;
+            DynArrayDestroy(raw);
+            elements = nullptr;
+        }
+    }
+
+    // points at the first element, the header sits right before it. Null until the first allocation
+    T* elements = nullptr;
+    DynArrayAllocFunc allocFunc = nullptr;
+    DynArrayFreeFunc freeFunc = nullptr;
+    f32 growthFactor = DYNARRAY_DEFAULT_GROWTH_FACTOR;
+};
+
+void DynArrayTests();
+// push/bulk push/iterate, DynArray<T> vs std::vector
+void DynArrayBenchmarks();
+
+#endif
@@ -0,0 +1,201 @@
+//#include "pch.h"
+#include "fixed_growable_array.h"
+
+#include <string>
+#include <vector>
+#include <chrono>
+
+struct FixedGrowableArrayTestObject
+{
+    static inline s32 numAlive = 0;
+    std::string name = "";
+    FixedGrowableArrayTestObject() { numAlive++; }
+    FixedGrowableArrayTestObject(const char* name) : name(name) { numAlive++; }
+    FixedGrowableArrayTestObject(const FixedGrowableArrayTestObject& other) : name(other.name) { numAlive++; }
+    FixedGrowableArrayTestObject(FixedGrowableArrayTestObject&& other) : name(std::move(other.name)) { numAlive++; }
+    FixedGrowableArrayTestObject& operator=(const FixedGrowableArrayTestObject&) = default;
+    FixedGrowableArrayTestObject& operator=(FixedGrowableArrayTestObject&&) = default;
+    ~FixedGrowableArrayTestObject() { numAlive--; }
+};
+
+static void NonTrivialElementTests()
+{
+    typedef FixedGrowableArray<FixedGrowableArrayTestObject, 4> TestArray;
+    {
+        TestArray arr;
+        TINY_ASSERT(FixedGrowableArrayTestObject::numAlive == 0); // inline storage doesn't construct anything
+        for (u32 i = 0; i < 3; i++) arr.emplace_back(std::to_string(i).c_str());
+        // moving an inline array moves the elements over
+        TestArray movedInline = std::move(arr);
+        TINY_ASSERT(arr.size == 0 && movedInline.size == 3 && movedInline.is_inline());
+        TINY_ASSERT(movedInline[2].name == "2" && FixedGrowableArrayTestObject::numAlive == 3);
+        // copies are deep, so both can be destroyed
+        for (u32 i = 3; i < 10; i++) movedInline.emplace_back(std::to_string(i).c_str());
+        TINY_ASSERT(!movedInline.is_inline());
+        TestArray copy = movedInline;
+        TINY_ASSERT(copy.size == 10 && copy.get_elements() != movedInline.get_elements() && copy[9].name == "9");
+        TINY_ASSERT(FixedGrowableArrayTestObject::numAlive == 20);
+        // moving a spilled array just takes the heap buffer
+        FixedGrowableArrayTestObject* spilledElements = movedInline.get_elements();
+        TestArray movedSpilled;
+        movedSpilled = std::move(movedInline);
+        TINY_ASSERT(movedSpilled.get_elements() == spilledElements && movedInline.size == 0 && movedInline.is_inline());
+        TINY_ASSERT(FixedGrowableArrayTestObject::numAlive == 20);
+        // erase/insert keep everything constructed exactly once
+        TINY_ASSERT(copy.erase(0).name == "0" && copy[0].name == "1" && copy.size == 9);
+        TINY_ASSERT(copy.erase_and_fill(0).name == "1" && copy[0].name == "9" && copy.size == 8);
+        copy.insert(FixedGrowableArrayTestObject("inserted"), 1);
+        TINY_ASSERT(copy[1].name == "inserted" && copy[2].name == "2" && copy.size == 9);
+        copy.push_back(copy[0]); // pushing one of our own elements
+        TINY_ASSERT(copy[copy.size - 1].name == "9");
+        TINY_ASSERT(FixedGrowableArrayTestObject::numAlive == 20);
+        // shrinking back down to inline storage
+        while (copy.size > 2) copy.pop_back();
+        copy.shrink_to_fit();
+        TINY_ASSERT(copy.is_inline() && copy.capacity == 4 && copy[0].name == "9" && copy[1].name == "inserted");
+        TINY_ASSERT(FixedGrowableArrayTestObject::numAlive == 12);
+    }
+    TINY_ASSERT(FixedGrowableArrayTestObject::numAlive == 0);
+}
+
+void FixedGrowableArrayTests()
+{
+    LOG_INFO("Running FixedGrowableArray tests...");
+    constexpr u32 testFixedSize = 10;
+    FixedGrowableArray<u32, testFixedSize> arr = {};
+    TINY_ASSERT(arr.size == 0);
+    arr.push_back(0);
+    arr.push_back(1);
+    arr.push_back(2);
+    arr.push_back(3);
+    TINY_ASSERT(arr.size == 4);
+    TINY_ASSERT(arr.is_inline());
+    while (arr.size < testFixedSize)
+    {
+        arr.push_back(arr.size);
+    }
+    TINY_ASSERT(arr.is_inline());
+    arr.push_back(testFixedSize); // this should trigger a reallocation of the entire memory
+    TINY_ASSERT(!arr.is_inline());
+    TINY_ASSERT(arr.erase(0) == 0);
+    TINY_ASSERT(arr.at(0) == 1);
+    TINY_ASSERT(arr.size == testFixedSize);
+    TINY_ASSERT(arr.at(arr.size-1) == testFixedSize);
+    TINY_ASSERT(arr.erase_and_fill(0) == 1); // removes "1" and puts the last element "testFixedSize" in its place
+    TINY_ASSERT(arr.at(0) == testFixedSize); // first element should now be what was the last element
+    arr.insert(99, 1);
+    TINY_ASSERT(arr.at(0) == testFixedSize); // should still be the case...
+    TINY_ASSERT(arr.at(1) == 99);
+    TINY_ASSERT(arr.at(2) == 2);
+    TINY_ASSERT(arr.at(arr.size-1) == 9);
+    arr.insert(100, arr.size); // inserting at the end is a push
+    TINY_ASSERT(arr.at(arr.size-1) == 100);
+    u32 sum = 0;
+    for (u32 val : arr) sum += val;
+    TINY_ASSERT(sum == testFixedSize + 99 + (2+3+4+5+6+7+8+9) + 100);
+    // clear keeps the heap buffer, shrink_to_fit gives it back
+    arr.clear();
+    TINY_ASSERT(arr.size == 0 && !arr.is_inline());
+    arr.shrink_to_fit();
+    TINY_ASSERT(arr.is_inline() && arr.capacity == testFixedSize);
+    //arr.insert(999, 3); // should report an error
+    // bulk append grows once, straight to what's needed
+    u32 bulk[100];
+    for (u32 i = 0; i < ARRAY_SIZE(bulk); i++) bulk[i] = i;
+    arr.append(bulk, 5);
+    TINY_ASSERT(arr.is_inline() && arr.size == 5);
+    arr.append(bulk, ARRAY_SIZE(bulk));
+    TINY_ASSERT(arr.size == 105 && arr.capacity == 105 && arr.at(4) == 4 && arr.at(104) == 99);
+    arr.reserve(500);
+    TINY_ASSERT(arr.capacity == 500 && arr.at(104) == 99);
+    NonTrivialElementTests();
+    LOG_INFO("FixedGrowableArray tests successful!");
+}
+
+template <typename Func>
+static f64 TimeNs(u32 numIterations, Func func)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    for (u32 i = 0; i < numIterations; i++)
+    {
+        func(i);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<f64, std::nano>(end - start).count() / numIterations;
+}
+
+// about the size of an RMesh
+struct FixedGrowableArrayBenchElement
+{
+    u64 data[6];
+};
+
+void FixedGrowableArrayBenchmarks()
+{
+    LOG_INFO("Running FixedGrowableArray benchmarks...");
+    typedef FixedGrowableArrayBenchElement Element;
+    volatile u64 sink = 0;
+    Element element = {};
+    std::vector<Element> bulk(1000, element);
+
+    // short lived arrays that fit inline: push 12, read them, throw the array away
+    f64 smallArrayNs = TimeNs(1000000, [&](u32 iter) {
+        FixedGrowableArray<Element, 16> arr;
+        for (u32 i = 0; i < 12; i++) { element.data[0] = i + iter; arr.push_back(element); }
+        sink = sink + arr[11].data[0];
+    });
+    f64 smallVectorNs = TimeNs(1000000, [&](u32 iter) {
+        std::vector<Element> vec;
+        for (u32 i = 0; i < 12; i++) { element.data[0] = i + iter; vec.push_back(element); }
+        sink = sink + vec[11].data[0];
+    });
+    // same thing with a big inline buffer (like MeshBatch's 500 meshes), only a few of which get used
+    f64 bigInlineNs = TimeNs(100000, [&](u32 iter) {
+        FixedGrowableArray<Element, 500> arr;
+        for (u32 i = 0; i < 4; i++) { element.data[0] = i + iter; arr.push_back(element); }
+        sink = sink + arr[3].data[0];
+    });
+    // grows well past the inline storage one push at a time
+    f64 spillArrayNs = TimeNs(1000, [&](u32 iter) {
+        FixedGrowableArray<Element, 16> arr;
+        for (u32 i = 0; i < 10000; i++) { element.data[0] = i + iter; arr.push_back(element); }
+        sink = sink + arr[9999].data[0];
+    });
+    f64 spillVectorNs = TimeNs(1000, [&](u32 iter) {
+        std::vector<Element> vec;
+        for (u32 i = 0; i < 10000; i++) { element.data[0] = i + iter; vec.push_back(element); }
+        sink = sink + vec[9999].data[0];
+    });
+    // bulk append into a reused array (per frame list that gets cleared and refilled)
+    FixedGrowableArray<Element, 16> appendArr;
+    std::vector<Element> appendVec;
+    f64 appendArrayNs = TimeNs(10000, [&](u32 iter) {
+        appendArr.clear();
+        for (u32 i = 0; i < 4; i++) appendArr.append(bulk.data(), (u32)bulk.size());
+        sink = sink + appendArr.size;
+    });
+    f64 appendVectorNs = TimeNs(10000, [&](u32 iter) {
+        appendVec.clear();
+        for (u32 i = 0; i < 4; i++) appendVec.insert(appendVec.end(), bulk.begin(), bulk.end());
+        sink = sink + appendVec.size();
+    });
+    // copying a spilled array around
+    FixedGrowableArray<Element, 16> copySrc;
+    copySrc.append(bulk.data(), (u32)bulk.size());
+    f64 copyArrayNs = TimeNs(10000, [&](u32 iter) {
+        FixedGrowableArray<Element, 16> copy = copySrc;
+        sink = sink + copy.size;
+    });
+    f64 copyVectorNs = TimeNs(10000, [&](u32 iter) {
+        std::vector<Element> copy = bulk;
+        sink = sink + copy.size();
+    });
+
+    LOG_INFO("[FIXEDARRAY] %u byte elements, ns per array", (u32)sizeof(Element));
+    LOG_INFO("[FIXEDARRAY] 12 pushes, fits inline   | std::vector: %9.2f ns | FixedGrowableArray: %9.2f ns | %.2fx", smallVectorNs, smallArrayNs, smallVectorNs / smallArrayNs);
+    LOG_INFO("[FIXEDARRAY] 4 pushes, 500 inline     | FixedGrowableArray: %9.2f ns", bigInlineNs);
+    LOG_INFO("[FIXEDARRAY] 10000 pushes, spilled    | std::vector: %9.2f ns | FixedGrowableArray: %9.2f ns | %.2fx", spillVectorNs, spillArrayNs, spillVectorNs / spillArrayNs);
+    LOG_INFO("[FIXEDARRAY] clear + 4x1000 append    | std::vector: %9.2f ns | FixedGrowableArray: %9.2f ns | %.2fx", appendVectorNs, appendArrayNs, appendVectorNs / appendArrayNs);
+    LOG_INFO("[FIXEDARRAY] copy 1000 elements       | std::vector: %9.2f ns | FixedGrowableArray: %9.2f ns | %.2fx", copyVectorNs, copyArrayNs, copyVectorNs / copyArrayNs);
+    LOG_INFO("FixedGrowableArray benchmarks complete");
+}
@@ -1,78 +1,88 @@
 #pragma once
 
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <type_traits>
 #include "tiny_defines.h"
-#include "dynarray.h"
 
 // array that stores a fixed-size number of elements in place
 // if we go over the fixed size of this array, we dynamically allocate
 // more space for extra elements in addition to the fixed size buffer
-// extra elements will always be allocated with the system allocator right now. 
+// extra elements will always be allocated with the system allocator right now.
 // The extra elements are meant as a fallback/backup allocation strat - for that reason
 // I won't be allowing those to be allocated with an Arena or things like that
 
-// TODO: when we dip below the fixedSize limit, switch back to using fixed mem
-// as of rn, as soon as we transition to dyn mem, we never switch back
+// The inline storage is raw memory - elements are only constructed when they're pushed, so making one of these
+// doesn't touch fixedSize elements. Copies are deep, moves steal the heap buffer if we spilled (and move the elements
+// one by one if we didn't). Once spilled we stay on the heap until shrink_to_fit, so arrays that get cleared and
+// refilled every frame don't bounce between the two.
+// Pointers to elements are invalidated by anything that can reallocate (push/append/insert/reserve/shrink_to_fit),
+// and by moving the array while it's inline. Use indices instead
 
 template <typename T, u32 fixedSize>
 struct FixedGrowableArray
 {
-    TAPI FixedGrowableArray();
-    TAPI FixedGrowableArray(const FixedGrowableArray&& arr)
-    {
-        size = arr.size;
-        capacity = arr.capacity;
-        elements = arr.elements;
-        if (arr.elements == &arr.fixedMem[0])
-        { // don't need to copy fixedmem over if we've switched to dynamic mem
-            TMEMCPY(fixedMem, arr.fixedMem, sizeof(T) * size);
-        }
-    }
-    TAPI FixedGrowableArray& operator=(const FixedGrowableArray& arr)
-    {
-        size = arr.size;
-        capacity = arr.capacity;
-        elements = arr.elements;
-        if (arr.elements == &arr.fixedMem[0])
-        { // don't need to copy fixedmem over if we've switched to dynamic mem
-            TMEMCPY(fixedMem, arr.fixedMem, sizeof(T) * size);
-        }
-        return *this;
-    }
-    TAPI ~FixedGrowableArray()
-    {
-        if (elements != &fixedMem[0])
-        {
-            TSYSFREE(elements);
-        }
-    }
+	static_assert(fixedSize > 0, "Use DynArray if there's no inline storage");
+	static_assert(alignof(T) <= alignof(std::max_align_t), "Spilled elements come from TSYSALLOC, can't over-align");
 
-    // adds element to end of array
-    TAPI void push_back(const T& element);
-    // inserts element at specified index - pushes elements to the right. Clamps index to within bounds
-    TAPI void insert(const T& element, u32 index);
-    // zeroes out specified element (*DOES NOT CALL DTOR/DELETE*) and places the rightmost element in it's place
-    TAPI T erase_and_fill(u32 index);
-    // zeroes out specified element (*DOES NOT CALL DTOR/DELETE*) and moves elements to the right of it to fill the gap
-    TAPI T erase(u32 index);
+	TAPI FixedGrowableArray();
+	TAPI FixedGrowableArray(const FixedGrowableArray& arr);
+	TAPI FixedGrowableArray(FixedGrowableArray&& arr) noexcept;
+	TAPI FixedGrowableArray& operator=(const FixedGrowableArray& arr);
+	TAPI FixedGrowableArray& operator=(FixedGrowableArray&& arr) noexcept;
+	TAPI ~FixedGrowableArray();
 
-    // returns element at index
-    TAPI T& at(u32 index);
-    TAPI const T& at(u32 index) const;
-    // sets size to 0 - does not zero out internal memory or do any deallocation
-    TAPI void clear();
- 
-    TAPI inline T* get_elements() { return elements; }
+	// adds element to end of array
+	TAPI void push_back(const T& element);
+	TAPI void push_back(T&& element);
+	template <typename... Args>
+	T& emplace_back(Args&&... args);
+	// copies count elements to the end of the array, growing at most once
+	TAPI void append(const T* data, u32 count);
+	// inserts element at specified index - pushes elements to the right. Index has to be in [0, size]
+	TAPI void insert(const T& element, u32 index);
+	// removes and returns the specified element, and moves the rightmost element in it's place
+	TAPI T erase_and_fill(u32 index);
+	// removes and returns the specified element, and moves elements to the right of it to fill the gap
+	TAPI T erase(u32 index);
+	TAPI void pop_back();
 
-    // this points to the current array of elements.
-    // when size < fixedSize, elements points to fixedMem.
-    // when size >= fixedSize elements points to a heap-allocated array
-    T* elements = nullptr;
-    T fixedMem[fixedSize] = {};
-    // both in terms of number of elements
-    u32 size = 0;
-    u32 capacity = 0;
+	// returns element at index
+	TAPI T& at(u32 index);
+	TAPI const T& at(u32 index) const;
+	inline T& operator[](u32 index) { return at(index); }
+	inline const T& operator[](u32 index) const { return at(index); }
+	// destroys all elements and sets size to 0 - keeps the current buffer (inline or heap)
+	TAPI void clear();
+	// makes sure we can hold newCapacity elements without growing
+	TAPI void reserve(u32 newCapacity);
+	// moves back into the inline storage if everything fits, otherwise shrinks the heap buffer down to size
+	TAPI void shrink_to_fit();
+
+	TAPI inline T* get_elements() { return elements; }
+	TAPI inline const T* get_elements() const { return elements; }
+	inline bool is_inline() const { return elements == inline_elements(); }
+	inline T* begin() { return elements; }
+	inline T* end() { return elements + size; }
+	inline const T* begin() const { return elements; }
+	inline const T* end() const { return elements + size; }
+
+	inline T* inline_elements() { return (T*)&fixedMem[0]; }
+	inline const T* inline_elements() const { return (const T*)&fixedMem[0]; }
+
+	// this points to the current array of elements.
+	// when size < fixedSize, elements points to fixedMem.
+	// when size >= fixedSize elements points to a heap-allocated array
+	T* elements = nullptr;
+	alignas(T) u8 fixedMem[sizeof(T) * fixedSize];
+	// both in terms of number of elements
+	u32 size = 0;
+	u32 capacity = 0;
 };
 
 TAPI void FixedGrowableArrayTests();
+// push/append/copy of small and spilled arrays, FixedGrowableArray vs std::vector
+TAPI void FixedGrowableArrayBenchmarks();
 
-#include "fixed_growable_array.tcc"
\ No newline at end of file
+#include "fixed_growable_array.tcc"
@@ -4,154 +4,303 @@
 #include "mem/tiny_mem.h"
 
 constexpr u32 GROWTH_FACTOR = 2;
+
+// moves count elements from src into uninitialized dst, and destroys what was in src
+template <typename T>
+static inline void RelocateElements(T* dst, T* src, u32 count)
+{
+	if constexpr (std::is_trivially_copyable_v<T>)
+	{
+		if (count) TMEMCPY((void*)dst, (const void*)src, sizeof(T) * count);
+	}
+	else
+	{
+		for (u32 i = 0; i < count; i++)
+		{
+			new(&dst[i]) T(std::move(src[i]));
+			src[i].~T();
+		}
+	}
+}
+
+template <typename T>
+static inline void DestroyElements(T* elements, u32 count)
+{
+	if constexpr (!std::is_trivially_destructible_v<T>)
+	{
+		for (u32 i = 0; i < count; i++)
+		{
+			elements[i].~T();
+		}
+	}
+}
+
+// moves everything into a buffer of newCapacity elements. Goes back to the inline buffer if it fits there
 template <typename T, u32 fixedSize>
-static void CheckArrayResize(FixedGrowableArray<T, fixedSize>& array)
+static void ReallocateArray(FixedGrowableArray<T, fixedSize>& array, u32 newCapacity)
 {
-    TINY_ASSERT(array.size <= array.capacity);
-    if (array.size >= array.capacity)
-    {
-        array.capacity = array.size * GROWTH_FACTOR;
-        // moving old buffer (could be our fixed mem or a dyn alloc) to a new allocation
-        T* prevAlloc = array.elements == &array.fixedMem[0] ? nullptr : array.elements;
-        T* prevElements = array.elements;
-        array.elements = (T*)TSYSALLOC(sizeof(T) * array.capacity);
-        TMEMMOVE(array.elements, prevElements, sizeof(T) * array.size);
-        if (prevElements != &array.fixedMem[0])
-        {
-            TSYSFREE(prevElements);
-        }
-        // move elements from prev buffer to new one
-        // notably... this will invalidate pointers to these elements. This is fine, use indices instead
-    }
+	TINY_ASSERT(newCapacity >= array.size);
+	T* prevElements = array.elements;
+	bool wasInline = array.is_inline();
+	if (newCapacity <= fixedSize)
+	{
+		if (wasInline) return;
+		array.elements = array.inline_elements();
+		newCapacity = fixedSize;
+	}
+	else
+	{
+		array.elements = (T*)TSYSALLOC_TAGGED(sizeof(T) * newCapacity, MemTag::CONTAINERS);
+	}
+	// notably... this will invalidate pointers to these elements. This is fine, use indices instead
+	RelocateElements(array.elements, prevElements, array.size);
+	if (!wasInline)
+	{
+		TSYSFREE(prevElements);
+	}
+	array.capacity = newCapacity;
+}
+
+template <typename T, u32 fixedSize>
+static inline void CheckArrayResize(FixedGrowableArray<T, fixedSize>& array, u32 numToAdd = 1)
+{
+	TINY_ASSERT(array.size <= array.capacity);
+	if (array.size + numToAdd > array.capacity)
+	{
+		u32 newCapacity = array.capacity * GROWTH_FACTOR;
+		if (newCapacity < array.size + numToAdd) newCapacity = array.size + numToAdd;
+		ReallocateArray(array, newCapacity);
+	}
 }
 
 template <typename T, u32 fixedSize>
 FixedGrowableArray<T, fixedSize>::FixedGrowableArray()
 {
-    elements = &fixedMem[0];
-    capacity = fixedSize;
-    size = 0;
+	elements = inline_elements();
+	capacity = fixedSize;
+	size = 0;
+}
+
+template <typename T, u32 fixedSize>
+FixedGrowableArray<T, fixedSize>::FixedGrowableArray(const FixedGrowableArray& arr) : FixedGrowableArray()
+{
+	append(arr.elements, arr.size);
+}
+
+template <typename T, u32 fixedSize>
+FixedGrowableArray<T, fixedSize>::FixedGrowableArray(FixedGrowableArray&& arr) noexcept : FixedGrowableArray()
+{
+	*this = std::move(arr);
+}
+
+template <typename T, u32 fixedSize>
+FixedGrowableArray<T, fixedSize>& FixedGrowableArray<T, fixedSize>::operator=(const FixedGrowableArray& arr)
+{
+	if (this != &arr)
+	{
+		clear();
+		append(arr.elements, arr.size);
+	}
+	return *this;
+}
+
+template <typename T, u32 fixedSize>
+FixedGrowableArray<T, fixedSize>& FixedGrowableArray<T, fixedSize>::operator=(FixedGrowableArray&& arr) noexcept
+{
+	if (this == &arr) return *this;
+	clear();
+	if (!arr.is_inline())
+	{
+		// take their heap buffer, and leave them with their (empty) inline one
+		if (!is_inline())
+		{
+			TSYSFREE(elements);
+		}
+		elements = arr.elements;
+		capacity = arr.capacity;
+		size = arr.size;
+		arr.elements = arr.inline_elements();
+		arr.capacity = fixedSize;
+		arr.size = 0;
+	}
+	else
+	{
+		// their elements live inside of them, so they have to be moved over one at a time
+		CheckArrayResize(*this, arr.size);
+		RelocateElements(elements, arr.elements, arr.size);
+		size = arr.size;
+		arr.size = 0;
+	}
+	return *this;
+}
+
+template <typename T, u32 fixedSize>
+FixedGrowableArray<T, fixedSize>::~FixedGrowableArray()
+{
+	DestroyElements(elements, size);
+	if (!is_inline())
+	{
+		TSYSFREE(elements);
+	}
 }
 
 template <typename T, u32 fixedSize>
 void FixedGrowableArray<T, fixedSize>::push_back(const T& element)
 {
-    CheckArrayResize(*this);
-    DynArrayGet<T>(elements, size) = element;
-    size++;
+	if (size == capacity && &element >= elements && &element < elements + size)
+	{
+		// element lives in our buffer, which is about to go away
+		T tmp = element;
+		emplace_back(std::move(tmp));
+		return;
+	}
+	emplace_back(element);
+}
+
+template <typename T, u32 fixedSize>
+void FixedGrowableArray<T, fixedSize>::push_back(T&& element)
+{
+	if (size == capacity && &element >= elements && &element < elements + size)
+	{
+		T tmp = std::move(element);
+		emplace_back(std::move(tmp));
+		return;
+	}
+	emplace_back(std::move(element));
+}
+
+template <typename T, u32 fixedSize>
+template <typename... Args>
+T& FixedGrowableArray<T, fixedSize>::emplace_back(Args&&... args)
+{
+	CheckArrayResize(*this);
+	T* element = new(&elements[size]) T(std::forward<Args>(args)...);
+	size++;
+	return *element;
+}
+
+template <typename T, u32 fixedSize>
+void FixedGrowableArray<T, fixedSize>::append(const T* data, u32 count)
+{
+	TINY_ASSERT((data + count <= elements || data >= elements + capacity) && "Can't append a FixedGrowableArray to itself");
+	CheckArrayResize(*this, count);
+	if constexpr (std::is_trivially_copyable_v<T>)
+	{
+		if (count) TMEMCPY((void*)&elements[size], (const void*)data, sizeof(T) * count);
+	}
+	else
+	{
+		for (u32 i = 0; i < count; i++)
+		{
+			new(&elements[size + i]) T(data[i]);
+		}
+	}
+	size += count;
 }
 
 template <typename T, u32 fixedSize>
 void FixedGrowableArray<T, fixedSize>::insert(const T& element, u32 index)
 {
-    CheckArrayResize(*this);
-    if (index >= size)
-    {
-        LOG_ERROR("Attempted to insert into FixedGrowableArray at invalid index");
-        return;
-    }
-    if (index == size)
-    {
-        DynArrayGet<T>(elements, size) = element;
-    }
-    else
-    {
-        u32 elementsToMove = size - index;
-        TMEMMOVE(&DynArrayGet<T>(elements, index + 1), &DynArrayGet<T>(elements, index), sizeof(T) * elementsToMove);
-        DynArrayGet<T>(elements, index) = element;
-    }
-    size++;
+	if (index > size)
+	{
+		LOG_ERROR("Attempted to insert into FixedGrowableArray at invalid index");
+		return;
+	}
+	if (index == size)
+	{
+		push_back(element);
+		return;
+	}
+	T tmp = element; // element could be in our buffer
+	CheckArrayResize(*this);
+	// last element moves into uninitialized memory, everything else shifts over by one
+	new(&elements[size]) T(std::move(elements[size - 1]));
+	for (u32 i = size - 1; i > index; i--)
+	{
+		elements[i] = std::move(elements[i - 1]);
+	}
+	elements[index] = std::move(tmp);
+	size++;
 }
 
 template <typename T, u32 fixedSize>
 T FixedGrowableArray<T, fixedSize>::erase_and_fill(u32 index)
 {
-    if (index >= size)
-    {
-        LOG_ERROR("attempted to erase invalid index");
-        return {};
-    }
-    T tmp = DynArrayGet<T>(elements, index); // copy
-    // swap element to erase with last element
-    DynArrayGet<T>(elements, index) = DynArrayGet<T>(elements, size-1);
-    size--;
-    return tmp;
+	if (index >= size)
+	{
+		LOG_ERROR("attempted to erase invalid index");
+		return {};
+	}
+	T tmp = std::move(elements[index]);
+	// swap element to erase with last element
+	if (index != size - 1)
+	{
+		elements[index] = std::move(elements[size - 1]);
+	}
+	pop_back();
+	return tmp;
 }
 
 template <typename T, u32 fixedSize>
 T FixedGrowableArray<T, fixedSize>::erase(u32 index)
 {
-    if (index >= size)
-    {
-        LOG_ERROR("attempted to erase invalid index");
-        return {};
-    }
-    T tmp = DynArrayGet<T>(elements, index); // copy
-    // move everything from the right of this index to the left
-    size_t moveSize = sizeof(T) * (size-index);
-    TMEMMOVE(&DynArrayGet<T>(elements, index), &DynArrayGet<T>(elements, index+1), moveSize); 
-    size--;
-    return tmp;
+	if (index >= size)
+	{
+		LOG_ERROR("attempted to erase invalid index");
+		return {};
+	}
+	T tmp = std::move(elements[index]);
+	// move everything from the right of this index to the left
+	for (u32 i = index; i + 1 < size; i++)
+	{
+		elements[i] = std::move(elements[i + 1]);
+	}
+	pop_back();
+	return tmp;
+}
+
+template <typename T, u32 fixedSize>
+void FixedGrowableArray<T, fixedSize>::pop_back()
+{
+	TINY_ASSERT(size > 0);
+	size--;
+	DestroyElements(&elements[size], 1);
 }
 
 template <typename T, u32 fixedSize>
 T& FixedGrowableArray<T, fixedSize>::at(u32 index)
 {
-    TINY_ASSERT(index < size);
-    return DynArrayGet<T>(elements, index);
+	TINY_ASSERT(index < size);
+	return elements[index];
 }
 template <typename T, u32 fixedSize>
 const T& FixedGrowableArray<T, fixedSize>::at(u32 index) const
 {
-    TINY_ASSERT(index < size);
-    return DynArrayGet<T>(elements, index);
+	TINY_ASSERT(index < size);
+	return elements[index];
 }
 
 template <typename T, u32 fixedSize>
 void FixedGrowableArray<T, fixedSize>::clear()
 {
-    size = 0;
-}
-
-
-void FixedGrowableArrayTests()
-{
-    LOG_INFO("Running FixedGrowableArray tests...");
-    constexpr u32 testFixedSize = 10;
-    FixedGrowableArray<u32, testFixedSize> arr = {};
-    TINY_ASSERT(arr.size == 0);
-    arr.push_back(0);
-    arr.push_back(1);
-    arr.push_back(2);
-    arr.push_back(3);
-    TINY_ASSERT(arr.size == 4);
-    TINY_ASSERT(arr.elements == &arr.fixedMem[0]);
-    while (arr.size < testFixedSize)
-    {
-        arr.push_back(arr.size);
-    }
-    for(u32 i = 0; i < arr.size; i++)
-    {
-        LOG_INFO("arr[%i] = %i", i, arr.at(i));
-    }
-    LOG_INFO("Filled array");
-    TINY_ASSERT(arr.elements == &arr.fixedMem[0]);
-    arr.push_back(testFixedSize); // this should trigger a reallocation of the entire memory
-    TINY_ASSERT(arr.elements != &arr.fixedMem[0]);
-    TINY_ASSERT(arr.erase(0) == 0);
-    LOG_INFO("Removed first element. New first element: %i", arr.at(0));
-    TINY_ASSERT(arr.at(0) == 1);
-    TINY_ASSERT(arr.size == testFixedSize);
-    TINY_ASSERT(arr.at(arr.size-1) == testFixedSize);
-    TINY_ASSERT(arr.erase_and_fill(0) == 1); // removes "1" and puts the last element "testFixedSize" in its place
-    TINY_ASSERT(arr.at(0) == testFixedSize); // first element should now be what was the last element
-    arr.insert(99, 1);
-    TINY_ASSERT(arr.at(0) == testFixedSize); // should still be the case...
-    TINY_ASSERT(arr.at(1) == 99);
-    TINY_ASSERT(arr.at(2) == 2);
-    TINY_ASSERT(arr.at(arr.size-1) == 9);
-    arr.clear();
-    TINY_ASSERT(arr.size == 0);
-    //arr.insert(999, 3); // should report an error
-    LOG_INFO("FixedGrowableArray tests successful!");
-}
\ No newline at end of file
+	DestroyElements(elements, size);
+	size = 0;
+}
+
+template <typename T, u32 fixedSize>
+void FixedGrowableArray<T, fixedSize>::reserve(u32 newCapacity)
+{
+	if (newCapacity > capacity)
+	{
+		ReallocateArray(*this, newCapacity);
+	}
+}
+
+template <typename T, u32 fixedSize>
+void FixedGrowableArray<T, fixedSize>::shrink_to_fit()
+{
+	if (!is_inline() && size < capacity)
+	{
+		ReallocateArray(*this, size);
+	}
+}
@@ -0,0 +1,218 @@
+//#include "pch.h"
+#include "hash_map.h"
+
+#include <unordered_map>
+#include <string>
+#include <vector>
+#include <chrono>
+
+struct HashMapTestValue
+{
+    static inline s32 numAlive = 0;
+    std::string name = "";
+    u32 value = 0;
+    HashMapTestValue() { numAlive++; }
+    HashMapTestValue(const char* name, u32 value) : name(name), value(value) { numAlive++; }
+    HashMapTestValue(const HashMapTestValue& other) : name(other.name), value(other.value) { numAlive++; }
+    HashMapTestValue(HashMapTestValue&& other) : name(std::move(other.name)), value(other.value) { numAlive++; }
+    HashMapTestValue& operator=(const HashMapTestValue&) = default;
+    HashMapTestValue& operator=(HashMapTestValue&&) = default;
+    ~HashMapTestValue() { numAlive--; }
+};
+
+// all ids land on the same hash, so everything collides
+struct HashMapCollidingHasher
+{
+    size_t operator()(u32 key) const { return 7; }
+};
+
+void HashMapTests()
+{
+    LOG_INFO("Running HashMap tests...");
+    // basic insert/find/erase against std::unordered_map, with enough keys to rehash a bunch of times
+    {
+        HashMap<u32, u32> map;
+        std::unordered_map<u32, u32> reference;
+        TINY_ASSERT(!map.find(0) && !map.erase(0) && map.empty());
+        u32 rng = 0x12345678;
+        for (u32 i = 0; i < 200000; i++)
+        {
+            rng ^= rng << 13; rng ^= rng >> 17; rng ^= rng << 5;
+            u32 key = rng % 50000;
+            if (rng & 0x100000)
+            {
+                map[key] = i;
+                reference[key] = i;
+            }
+            else
+            {
+                TINY_ASSERT(map.erase(key) == (reference.erase(key) > 0));
+            }
+        }
+        TINY_ASSERT(map.size() == reference.size());
+        for (const auto& [key, value] : reference)
+        {
+            TINY_ASSERT(map.find(key) && *map.find(key) == value && map.at(key) == value);
+        }
+        u32 visited = 0;
+        for (const auto& [key, value] : map)
+        {
+            TINY_ASSERT(reference.at(key) == value);
+            visited++;
+        }
+        TINY_ASSERT(visited == map.size());
+        // clear keeps memory around
+        u32 capacity = map.capacity();
+        u32 numBuckets = map.bucket_count();
+        map.clear();
+        TINY_ASSERT(map.empty() && !map.find(reference.begin()->first));
+        TINY_ASSERT(map.capacity() == capacity && map.bucket_count() == numBuckets);
+        for (u32 i = 0; i < 1000; i++) map[i] = i;
+        TINY_ASSERT(map.capacity() == capacity && map.bucket_count() == numBuckets && map.size() == 1000);
+    }
+    // worst case hasher still works, just slowly
+    {
+        HashMap<u32, u32, HashMapCollidingHasher> map;
+        for (u32 i = 0; i < 500; i++) map[i] = i * 2;
+        for (u32 i = 0; i < 500; i += 2) TINY_ASSERT(map.erase(i));
+        for (u32 i = 0; i < 500; i++)
+        {
+            TINY_ASSERT((map.find(i) != nullptr) == (i % 2 == 1));
+            TINY_ASSERT(!map.find(i) || *map.find(i) == i * 2);
+        }
+    }
+    // non trivial keys/values get constructed/destroyed properly, and references survive growing
+    {
+        HashMap<std::string, HashMapTestValue>* map = new HashMap<std::string, HashMapTestValue>();
+        HashMapTestValue& first = (*map)["first"];
+        first.value = 1;
+        for (u32 i = 0; i < 5000; i++)
+        {
+            std::string key = "key" + std::to_string(i);
+            std::pair<HashMapTestValue*, bool> result = map->try_emplace(key, key.c_str(), i);
+            TINY_ASSERT(result.second && result.first->value == i);
+        }
+        TINY_ASSERT(&first == map->find("first") && first.value == 1);
+        TINY_ASSERT(!map->try_emplace("key10", "dupe", 0u).second && map->at("key10").name == "key10");
+        TINY_ASSERT(HashMapTestValue::numAlive == 5001);
+        // erasing pulls the last entry into the hole
+        TINY_ASSERT(map->erase("first"));
+        TINY_ASSERT(!map->find("first") && map->at("key4999").value == 4999);
+        TINY_ASSERT(HashMapTestValue::numAlive == 5000);
+        map->insert("key10", HashMapTestValue("overwritten", 10));
+        TINY_ASSERT(map->at("key10").name == "overwritten" && map->size() == 5000);
+        // moving hands over the memory
+        HashMap<std::string, HashMapTestValue> moved = std::move(*map);
+        TINY_ASSERT(map->empty() && moved.size() == 5000 && moved.at("key42").value == 42);
+        delete map;
+        TINY_ASSERT(HashMapTestValue::numAlive == 5000);
+        moved.clear();
+        TINY_ASSERT(HashMapTestValue::numAlive == 0);
+    }
+    // arena backed, reserved up front so nothing gets left behind in the arena
+    {
+        ArenaTemp scratch = scratch_begin();
+        HashMap<u64, u32> map(scratch.arena);
+        map.reserve(1000);
+        size_t arenaUsed = scratch.arena->offset;
+        for (u64 i = 0; i < 1000; i++) map[i * 0x100000000ull] = (u32)i;
+        TINY_ASSERT(scratch.arena->offset == arenaUsed);
+        for (u64 i = 0; i < 1000; i++) TINY_ASSERT(map.at(i * 0x100000000ull) == i);
+        scratch_end(scratch);
+    }
+    LOG_INFO("HashMap tests passed");
+}
+
+template <typename Func>
+static f64 TimeMs(Func func)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    func();
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<f64, std::milli>(end - start).count();
+}
+
+// roughly what a registry value weighs (EntityData is a good bit bigger than this)
+struct HashMapBenchValue
+{
+    u32 id = 0;
+    u8 payload[60] = {};
+};
+
+static inline const HashMapBenchValue* MapFind(std::unordered_map<u32, HashMapBenchValue>& map, u32 key)
+{
+    auto it = map.find(key);
+    return it == map.end() ? nullptr : &it->second;
+}
+static inline const HashMapBenchValue* MapFind(HashMap<u32, HashMapBenchValue>& map, u32 key)
+{
+    return map.find(key);
+}
+
+// times insert, lookups that hit, lookups that miss, iteration and erase. Results are in ms
+template <typename Map>
+static void BenchmarkMap(const u32* keys, const u32* missingKeys, u32 numKeys, u32 numLookupRounds, f64* results)
+{
+    Map* map = new Map();
+    u64 sum = 0;
+    results[0] = TimeMs([&]() {
+        for (u32 i = 0; i < numKeys; i++) (*map)[keys[i]].id = i;
+    });
+    results[1] = TimeMs([&]() {
+        for (u32 round = 0; round < numLookupRounds; round++)
+        {
+            for (u32 i = 0; i < numKeys; i++) sum += MapFind(*map, keys[i])->id;
+        }
+    });
+    results[2] = TimeMs([&]() {
+        for (u32 round = 0; round < numLookupRounds; round++)
+        {
+            for (u32 i = 0; i < numKeys; i++) sum += MapFind(*map, missingKeys[i]) == nullptr;
+        }
+    });
+    results[3] = TimeMs([&]() {
+        for (u32 round = 0; round < numLookupRounds; round++)
+        {
+            for (const auto& [key, value] : *map) sum += value.id;
+        }
+    });
+    results[4] = TimeMs([&]() {
+        for (u32 i = 0; i < numKeys; i++) map->erase(keys[i]);
+    });
+    TINY_ASSERT(sum != 0 && map->size() == 0);
+    delete map;
+}
+
+void HashMapBenchmarks()
+{
+    LOG_INFO("Running HashMap benchmarks...");
+    const char* opNames[] = { "insert", "lookup hit", "lookup miss", "iterate", "erase" };
+    for (u32 numKeys : { 1000u, 100000u, 1000000u })
+    {
+        u32 numLookupRounds = 10000000 / numKeys;
+        std::vector<u32> keys(numKeys);
+        std::vector<u32> missingKeys(numKeys);
+        u32 rng = 0x9E3779B9;
+        for (u32 i = 0; i < numKeys; i++)
+        {
+            // entity ids are name hashes, so random 32 bit keys. Odd keys are in the map, even keys miss
+            rng ^= rng << 13; rng ^= rng >> 17; rng ^= rng << 5;
+            keys[i] = rng | 1;
+            missingKeys[i] = rng & ~1u;
+        }
+        f64 stdResults[5] = {};
+        f64 hashMapResults[5] = {};
+        BenchmarkMap<std::unordered_map<u32, HashMapBenchValue>>(keys.data(), missingKeys.data(), numKeys, numLookupRounds, stdResults);
+        BenchmarkMap<HashMap<u32, HashMapBenchValue>>(keys.data(), missingKeys.data(), numKeys, numLookupRounds, hashMapResults);
+        for (u32 op = 0; op < ARRAY_SIZE(opNames); op++)
+        {
+            // lookups/iteration are repeated numLookupRounds times, report per element
+            f64 numOps = (op >= 1 && op <= 3) ? (f64)numKeys * numLookupRounds : (f64)numKeys;
+            f64 stdNs = stdResults[op] * 1000000.0 / numOps;
+            f64 hashMapNs = hashMapResults[op] * 1000000.0 / numOps;
+            LOG_INFO("[HASHMAP] %7u keys | %-11s | unordered_map: %7.2f ns | HashMap: %7.2f ns | %.2fx",
+                numKeys, opNames[op], stdNs, hashMapNs, stdNs / hashMapNs);
+        }
+    }
+    LOG_INFO("HashMap benchmarks complete");
+}
@@ -0,0 +1,335 @@
+#ifndef HASH_MAP_H
+#define HASH_MAP_H
+
+#include <functional>
+#include <utility>
+#include <new>
+#include <bit>
+#include "tiny_defines.h"
+#include "tiny_log.h"
+#include "mem/tiny_mem.h"
+#include "mem/tiny_arena.h"
+
+// Open addressing (Robin Hood) hash map for engine registries.
+// Buckets are a flat array of 8 bytes each: distance from the home bucket + an 8 bit fingerprint of the hash, and the
+// index of the entry. Lookups walk a few adjacent buckets and only touch an entry when the fingerprint matches.
+// Entries (key + value) are packed densely in fixed size pages. Pages never move, so
+//	- pointers/references to values stay valid across inserts and rehashes (like std::unordered_map)
+//	- erase moves the last entry into the hole, so that entry's address changes (and iteration order with it)
+//	- iteration walks the pages front to back, only over live entries. Order is insertion order until something is erased
+// Memory comes from the engine heap, or from an arena if one is passed in. With an arena, outgrown bucket arrays are
+// just left behind, so reserve() up front if the size is known. clear() keeps all memory around for reuse.
+// Any hasher works (std::hash, TextureHasher, ...), the result gets mixed so identity hashes on ids are fine
+template <typename K, typename V, typename Hasher = std::hash<K>>
+class HashMap
+{
+public:
+	struct Entry
+	{
+		K key;
+		V value;
+	};
+
+private:
+	struct Bucket
+	{
+		// 0 = empty. Otherwise (distance from home bucket + 1) << 8 | fingerprint
+		u32 distAndFingerprint;
+		u32 entryIndex;
+	};
+	static constexpr u32 DIST_INC = 1u << 8;
+	static constexpr u32 FINGERPRINT_MASK = DIST_INC - 1;
+	static constexpr u32 MIN_BUCKETS = 8;
+	// keep pages around 16KB
+	static constexpr u32 ENTRIES_PER_PAGE = std::bit_floor(sizeof(Entry) >= KILOBYTES_BYTES(1) ? 16u : (u32)(KILOBYTES_BYTES(16) / sizeof(Entry)));
+	static constexpr u32 PAGE_SHIFT = std::countr_zero(ENTRIES_PER_PAGE);
+	static_assert(alignof(Entry) <= alignof(std::max_align_t), "HashMap pages can't be over-aligned");
+
+public:
+	template <bool isConst>
+	struct IteratorBase
+	{
+		using EntryType = std::conditional_t<isConst, const Entry, Entry>;
+		Entry* const* pages;
+		u32 index;
+		inline EntryType& operator*() const { return pages[index >> PAGE_SHIFT][index & (ENTRIES_PER_PAGE - 1)]; }
+		inline EntryType* operator->() const { return &**this; }
+		inline IteratorBase& operator++() { index++; return *this; }
+		inline bool operator==(const IteratorBase& other) const { return index == other.index; }
+		inline bool operator!=(const IteratorBase& other) const { return index != other.index; }
+	};
+	typedef IteratorBase<false> Iterator;
+	typedef IteratorBase<true> ConstIterator;
+
+	HashMap() = default;
+	explicit HashMap(Arena* arena) : arena(arena) {}
+	HashMap(const HashMap&) = delete;
+	HashMap& operator=(const HashMap&) = delete;
+	HashMap(HashMap&& other) noexcept { steal(other); }
+	HashMap& operator=(HashMap&& other) noexcept
+	{
+		if (this != &other)
+		{
+			release();
+			steal(other);
+		}
+		return *this;
+	}
+	~HashMap() { release(); }
+
+	// null if the key isn't in the map
+	inline V* find(const K& key)
+	{
+		u32 bucketIdx = find_bucket(key, hash(key));
+		return bucketIdx == U32_INVALID_ID ? nullptr : &entry_at(buckets[bucketIdx].entryIndex).value;
+	}
+	inline const V* find(const K& key) const { return const_cast<HashMap*>(this)->find(key); }
+	inline bool contains(const K& key) const { return find(key) != nullptr; }
+	// key has to be in the map
+	inline V& at(const K& key)
+	{
+		V* value = find(key);
+		TINY_ASSERT(value && "HashMap::at with a key that isn't in the map");
+		return *value;
+	}
+	inline const V& at(const K& key) const { return const_cast<HashMap*>(this)->at(key); }
+	// default constructs the value if the key isn't in the map yet
+	inline V& operator[](const K& key) { return *try_emplace(key).first; }
+
+	// constructs the value from args if the key isn't in the map yet. Returns the value, and whether it was inserted
+	template <typename... Args>
+	std::pair<V*, bool> try_emplace(const K& key, Args&&... args)
+	{
+		u64 keyHash = hash(key);
+		u32 bucketIdx = find_bucket(key, keyHash);
+		if (bucketIdx != U32_INVALID_ID)
+		{
+			return { &entry_at(buckets[bucketIdx].entryIndex).value, false };
+		}
+		if (needs_rehash(numEntries + 1))
+		{
+			rehash(numBuckets ? numBuckets * 2 : MIN_BUCKETS);
+		}
+		ensure_pages(numEntries + 1);
+		u32 entryIdx = numEntries;
+		Entry* entry = &entry_at(entryIdx);
+		new(entry) Entry{ key, V(std::forward<Args>(args)...) };
+		numEntries++;
+		place_bucket(keyHash, entryIdx);
+		return { &entry->value, true };
+	}
+	// overwrites the value if the key is already in the map
+	inline V& insert(const K& key, const V& value)
+	{
+		std::pair<V*, bool> result = try_emplace(key, value);
+		if (!result.second) *result.first = value;
+		return *result.first;
+	}
+
+	// returns false if the key wasn't in the map
+	bool erase(const K& key)
+	{
+		u32 bucketIdx = find_bucket(key, hash(key));
+		if (bucketIdx == U32_INVALID_ID) return false;
+		u32 entryIdx = buckets[bucketIdx].entryIndex;
+		// backward shift: pull the following buckets one closer to home until one is already home (or empty)
+		u32 mask = numBuckets - 1;
+		u32 nextIdx = (bucketIdx + 1) & mask;
+		while (buckets[nextIdx].distAndFingerprint >= DIST_INC * 2)
+		{
+			buckets[bucketIdx] = { buckets[nextIdx].distAndFingerprint - DIST_INC, buckets[nextIdx].entryIndex };
+			bucketIdx = nextIdx;
+			nextIdx = (nextIdx + 1) & mask;
+		}
+		buckets[bucketIdx] = {};
+		// keep entries packed, last one fills the hole
+		u32 lastIdx = numEntries - 1;
+		if (entryIdx != lastIdx)
+		{
+			Entry& last = entry_at(lastIdx);
+			buckets[find_bucket_of_entry(hash(last.key), lastIdx)].entryIndex = entryIdx;
+			entry_at(entryIdx) = std::move(last);
+		}
+		entry_at(lastIdx).~Entry();
+		numEntries--;
+		return true;
+	}
+
+	// destroys every entry, keeps the memory
+	void clear()
+	{
+		for (u32 i = 0; i < numEntries; i++)
+		{
+			entry_at(i).~Entry();
+		}
+		numEntries = 0;
+		if (buckets) TMEMSET(buckets, 0, sizeof(Bucket) * numBuckets);
+	}
+	// makes sure count entries fit without allocating
+	void reserve(u32 count)
+	{
+		u32 wantedBuckets = numBuckets ? numBuckets : MIN_BUCKETS;
+		while (wantedBuckets * 4 < count * 5) wantedBuckets *= 2;
+		if (wantedBuckets > numBuckets) rehash(wantedBuckets);
+		ensure_pages(count);
+	}
+
+	inline u32 size() const { return numEntries; }
+	inline bool empty() const { return numEntries == 0; }
+	inline u32 capacity() const { return numPages * ENTRIES_PER_PAGE; }
+	inline u32 bucket_count() const { return numBuckets; }
+	inline Iterator begin() { return { pages, 0 }; }
+	inline Iterator end() { return { pages, numEntries }; }
+	inline ConstIterator begin() const { return { pages, 0 }; }
+	inline ConstIterator end() const { return { pages, numEntries }; }
+
+private:
+	static inline u64 hash(const K& key)
+	{
+		// murmur3 finalizer. Hashers here are often just the id, which would pile up in a few buckets
+		u64 h = (u64)Hasher{}(key);
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccdull;
+		h ^= h >> 33;
+		h *= 0xc4ceb9fe1a85ec53ull;
+		h ^= h >> 33;
+		return h;
+	}
+	inline Entry& entry_at(u32 index) const { return pages[index >> PAGE_SHIFT][index & (ENTRIES_PER_PAGE - 1)]; }
+	inline u32 home_bucket(u64 keyHash) const { return (u32)(keyHash >> bucketShift); }
+	inline bool needs_rehash(u32 count) const { return count * 5 > numBuckets * 4; } // 80% max load
+
+	// index of the key's bucket, or U32_INVALID_ID
+	u32 find_bucket(const K& key, u64 keyHash) const
+	{
+		if (!numEntries) return U32_INVALID_ID;
+		u32 mask = numBuckets - 1;
+		u32 distAndFingerprint = DIST_INC | (u32)(keyHash & FINGERPRINT_MASK);
+		u32 bucketIdx = home_bucket(keyHash);
+		while (true)
+		{
+			const Bucket& bucket = buckets[bucketIdx];
+			if (bucket.distAndFingerprint == distAndFingerprint && entry_at(bucket.entryIndex).key == key)
+			{
+				return bucketIdx;
+			}
+			// anything that could be our key would've displaced this bucket
+			if (bucket.distAndFingerprint < distAndFingerprint)
+			{
+				return U32_INVALID_ID;
+			}
+			distAndFingerprint += DIST_INC;
+			bucketIdx = (bucketIdx + 1) & mask;
+		}
+	}
+	u32 find_bucket_of_entry(u64 keyHash, u32 entryIdx) const
+	{
+		u32 mask = numBuckets - 1;
+		u32 bucketIdx = home_bucket(keyHash);
+		while (buckets[bucketIdx].entryIndex != entryIdx || !buckets[bucketIdx].distAndFingerprint)
+		{
+			bucketIdx = (bucketIdx + 1) & mask;
+		}
+		return bucketIdx;
+	}
+	// robin hood insert: take the slot of anything closer to its home than we are, and keep going with that one instead
+	void place_bucket(u64 keyHash, u32 entryIdx)
+	{
+		u32 mask = numBuckets - 1;
+		Bucket toPlace = { DIST_INC | (u32)(keyHash & FINGERPRINT_MASK), entryIdx };
+		u32 bucketIdx = home_bucket(keyHash);
+		while (buckets[bucketIdx].distAndFingerprint >= toPlace.distAndFingerprint)
+		{
+			toPlace.distAndFingerprint += DIST_INC;
+			bucketIdx = (bucketIdx + 1) & mask;
+		}
+		while (buckets[bucketIdx].distAndFingerprint)
+		{
+			std::swap(toPlace, buckets[bucketIdx]);
+			toPlace.distAndFingerprint += DIST_INC;
+			bucketIdx = (bucketIdx + 1) & mask;
+		}
+		buckets[bucketIdx] = toPlace;
+	}
+	void rehash(u32 newNumBuckets)
+	{
+		release_mem(buckets);
+		buckets = (Bucket*)alloc_mem(sizeof(Bucket) * newNumBuckets);
+		TMEMSET(buckets, 0, sizeof(Bucket) * newNumBuckets);
+		numBuckets = newNumBuckets;
+		bucketShift = 64 - std::countr_zero(newNumBuckets);
+		for (u32 i = 0; i < numEntries; i++)
+		{
+			place_bucket(hash(entry_at(i).key), i);
+		}
+	}
+	void ensure_pages(u32 count)
+	{
+		u32 neededPages = (count + ENTRIES_PER_PAGE - 1) >> PAGE_SHIFT;
+		if (neededPages <= numPages) return;
+		if (neededPages > pageTableCapacity)
+		{
+			u32 newCapacity = pageTableCapacity ? pageTableCapacity : 4;
+			while (newCapacity < neededPages) newCapacity *= 2;
+			Entry** newPages = (Entry**)alloc_mem(sizeof(Entry*) * newCapacity);
+			if (pages) TMEMCPY(newPages, pages, sizeof(Entry*) * numPages);
+			release_mem(pages);
+			pages = newPages;
+			pageTableCapacity = newCapacity;
+		}
+		while (numPages < neededPages)
+		{
+			pages[numPages++] = (Entry*)alloc_mem(sizeof(Entry) * ENTRIES_PER_PAGE);
+		}
+	}
+	inline void* alloc_mem(size_t size)
+	{
+		return arena ? arena_alloc(arena, size) : TSYSALLOC_TAGGED(size, MemTag::CONTAINERS);
+	}
+	template <typename T>
+	inline void release_mem(T*& mem)
+	{
+		if (!arena && mem) TSYSFREE(mem);
+		mem = nullptr;
+	}
+	void release()
+	{
+		clear();
+		for (u32 i = 0; i < numPages; i++)
+		{
+			release_mem(pages[i]);
+		}
+		release_mem(pages);
+		release_mem(buckets);
+		numPages = pageTableCapacity = numBuckets = 0;
+	}
+	void steal(HashMap& other)
+	{
+		pages = other.pages;
+		buckets = other.buckets;
+		arena = other.arena;
+		numEntries = other.numEntries;
+		numPages = other.numPages;
+		pageTableCapacity = other.pageTableCapacity;
+		numBuckets = other.numBuckets;
+		bucketShift = other.bucketShift;
+		other.pages = nullptr;
+		other.buckets = nullptr;
+		other.numEntries = other.numPages = other.pageTableCapacity = other.numBuckets = 0;
+	}
+
+	Entry** pages = nullptr;
+	Bucket* buckets = nullptr;
+	Arena* arena = nullptr;
+	u32 numEntries = 0;
+	u32 numPages = 0;
+	u32 pageTableCapacity = 0;
+	u32 numBuckets = 0;
+	u32 bucketShift = 64;
+};
+
+TAPI void HashMapTests();
+// insert/lookup/iterate/erase, HashMap vs std::unordered_map
+TAPI void HashMapBenchmarks();
+
+#endif
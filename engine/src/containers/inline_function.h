@@ -0,0 +1,124 @@
+#ifndef INLINE_FUNCTION_H
+#define INLINE_FUNCTION_H
+
+#include <new>
+#include <utility>
+#include <cstddef>
+#include <type_traits>
+#include "tiny_defines.h"
+#include "mem/tiny_mem.h"
+#include "tiny_log.h"
+
+// Move-only std::function<void()> replacement that never allocates.
+// The callable is constructed directly into a fixed size buffer, and a callable that doesn't fit is a compile error
+// instead of a silent heap allocation.
+// Trivially copyable callables (lambdas capturing pointers/ints/etc) are moved with a plain memcpy.
+template <size_t _capacity>
+class InlineFunction
+{
+public:
+
+	InlineFunction() = default;
+	InlineFunction(std::nullptr_t) {}
+
+	template <typename Func, typename = std::enable_if_t<!std::is_same<std::decay_t<Func>, InlineFunction>::value>>
+	InlineFunction(Func&& fn)
+	{
+		typedef std::decay_t<Func> FuncType;
+		static_assert(sizeof(FuncType) <= _capacity, "Callable is too big to store inline. Capture pointers instead of copies, or use JobSystem::FrameJob");
+		static_assert(alignof(FuncType) <= alignof(std::max_align_t), "Callable is over-aligned");
+		new(storage) FuncType(std::forward<Func>(fn));
+		invokeFn = [](void* callable) { (*(FuncType*)callable)(); };
+		if (!std::is_trivially_copyable<FuncType>::value)
+		{
+			manageFn = [](void* dst, void* src) {
+				if (dst)
+				{
+					new(dst) FuncType(std::move(*(FuncType*)src));
+				}
+				((FuncType*)src)->~FuncType();
+			};
+		}
+	}
+
+	InlineFunction(InlineFunction&& other)
+	{
+		MoveFrom(other);
+	}
+
+	InlineFunction& operator=(InlineFunction&& other)
+	{
+		if (this != &other)
+		{
+			reset();
+			MoveFrom(other);
+		}
+		return *this;
+	}
+
+	InlineFunction& operator=(std::nullptr_t)
+	{
+		reset();
+		return *this;
+	}
+
+	InlineFunction(const InlineFunction&) = delete;
+	InlineFunction& operator=(const InlineFunction&) = delete;
+
+	~InlineFunction()
+	{
+		reset();
+	}
+
+	inline void operator()() const
+	{
+		TINY_ASSERT(invokeFn && "calling an empty InlineFunction");
+		invokeFn((void*)storage);
+	}
+
+	inline explicit operator bool() const
+	{
+		return invokeFn != nullptr;
+	}
+
+	inline void reset()
+	{
+		if (manageFn)
+		{
+			manageFn(nullptr, storage);
+		}
+		invokeFn = nullptr;
+		manageFn = nullptr;
+	}
+
+	static constexpr size_t capacity()
+	{
+		return _capacity;
+	}
+
+private:
+
+	inline void MoveFrom(InlineFunction& other)
+	{
+		if (!other.invokeFn) return;
+		if (other.manageFn)
+		{
+			other.manageFn(storage, other.storage);
+		}
+		else
+		{
+			TMEMCPY(storage, other.storage, _capacity);
+		}
+		invokeFn = other.invokeFn;
+		manageFn = other.manageFn;
+		other.invokeFn = nullptr;
+		other.manageFn = nullptr;
+	}
+
+	alignas(std::max_align_t) u8 storage[_capacity];
+	void (*invokeFn)(void* callable) = nullptr;
+	// moves the callable in src into dst (if dst isn't null) and destroys src. null for trivially copyable callables
+	void (*manageFn)(void* dst, void* src) = nullptr;
+};
+
+#endif
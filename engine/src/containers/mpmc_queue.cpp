@@ -0,0 +1,165 @@
+//#include "pch.h"
+#include "mpmc_queue.h"
+#include "mutex_queue.h"
+
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <memory>
+
+void MPMCQueueTests()
+{
+    LOG_INFO("Running MPMCQueue tests...");
+    // single threaded FIFO/full/empty behavior, over a few laps so the sequence numbers wrap around the cells
+    {
+        constexpr u32 capacity = 8;
+        MPMCQueue<u32, capacity>* queue = new MPMCQueue<u32, capacity>();
+        u32 item = 0;
+        TINY_ASSERT(!queue->pop_front(item));
+        TINY_ASSERT(queue->size() == 0);
+        u32 nextPush = 0, nextPop = 0;
+        for (u32 lap = 0; lap < 5; lap++)
+        {
+            while (queue->push_back(nextPush)) { nextPush++; }
+            TINY_ASSERT(queue->size() == capacity); // every cell is usable
+            for (u32 i = 0; i < capacity / 2; i++)
+            {
+                TINY_ASSERT(queue->pop_front(item));
+                TINY_ASSERT(item == nextPop++);
+            }
+            TINY_ASSERT(queue->size() == capacity / 2);
+        }
+        queue->clear();
+        TINY_ASSERT(queue->size() == 0);
+        TINY_ASSERT(!queue->pop_front(item));
+        delete queue;
+    }
+    // move only items
+    {
+        MPMCQueue<std::unique_ptr<u32>, 4>* queue = new MPMCQueue<std::unique_ptr<u32>, 4>();
+        TINY_ASSERT(queue->push_back(std::make_unique<u32>(42)));
+        std::unique_ptr<u32> item;
+        TINY_ASSERT(queue->pop_front(item));
+        TINY_ASSERT(item && *item == 42);
+        delete queue;
+    }
+    // every item pushed by many producers is popped exactly once by many consumers
+    {
+        constexpr u32 numProducers = 4;
+        constexpr u32 numConsumers = 4;
+        constexpr u32 itemsPerProducer = 50000;
+        constexpr u32 totalItems = numProducers * itemsPerProducer;
+        MPMCQueue<u32, 256>* queue = new MPMCQueue<u32, 256>();
+        std::atomic<u8>* seen = new std::atomic<u8>[totalItems];
+        for (u32 i = 0; i < totalItems; i++) seen[i] = 0;
+        std::atomic<u32> numPopped = 0;
+        std::vector<std::thread> threads;
+        for (u32 p = 0; p < numProducers; p++)
+        {
+            threads.emplace_back([queue, p]() {
+                for (u32 i = 0; i < itemsPerProducer; i++)
+                {
+                    while (!queue->push_back(p * itemsPerProducer + i)) { std::this_thread::yield(); }
+                }
+            });
+        }
+        for (u32 c = 0; c < numConsumers; c++)
+        {
+            threads.emplace_back([queue, seen, &numPopped]() {
+                u32 item = 0;
+                while (numPopped.load() < totalItems)
+                {
+                    if (queue->pop_front(item))
+                    {
+                        seen[item]++;
+                        numPopped++;
+                    }
+                    else
+                    {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        }
+        for (std::thread& thread : threads) thread.join();
+        for (u32 i = 0; i < totalItems; i++)
+        {
+            TINY_ASSERT(seen[i].load() == 1);
+        }
+        TINY_ASSERT(queue->size() == 0);
+        delete[] seen;
+        delete queue;
+    }
+    LOG_INFO("MPMCQueue tests passed");
+}
+
+// producers push totalItems between them, consumers pop until everything is through. Returns items/sec
+template <typename Queue>
+static f64 BenchmarkQueueContention(u32 numProducers, u32 numConsumers, u32 totalItems)
+{
+    Queue* queue = new Queue();
+    std::atomic<u32> numPopped = 0;
+    std::atomic<u64> poppedSum = 0;
+    std::atomic<bool> go = false;
+    u32 itemsPerProducer = totalItems / numProducers;
+    totalItems = itemsPerProducer * numProducers;
+    std::vector<std::thread> threads;
+    for (u32 p = 0; p < numProducers; p++)
+    {
+        threads.emplace_back([queue, &go, itemsPerProducer]() {
+            while (!go) { std::this_thread::yield(); }
+            for (u32 i = 0; i < itemsPerProducer; i++)
+            {
+                while (!queue->push_back((u64)i)) { std::this_thread::yield(); }
+            }
+        });
+    }
+    for (u32 c = 0; c < numConsumers; c++)
+    {
+        threads.emplace_back([queue, &go, &numPopped, &poppedSum, totalItems]() {
+            while (!go) { std::this_thread::yield(); }
+            u64 item = 0;
+            u64 sum = 0;
+            while (numPopped.load(std::memory_order_relaxed) < totalItems)
+            {
+                if (queue->pop_front(item))
+                {
+                    sum += item;
+                    numPopped.fetch_add(1, std::memory_order_relaxed);
+                }
+                else
+                {
+                    std::this_thread::yield();
+                }
+            }
+            poppedSum += sum;
+        });
+    }
+    auto start = std::chrono::high_resolution_clock::now();
+    go = true;
+    for (std::thread& thread : threads) thread.join();
+    auto end = std::chrono::high_resolution_clock::now();
+    u64 expectedSum = (u64)numProducers * ((u64)itemsPerProducer * (itemsPerProducer - 1) / 2);
+    TINY_ASSERT(poppedSum.load() == expectedSum);
+    delete queue;
+    f64 seconds = std::chrono::duration<f64>(end - start).count();
+    return (f64)totalItems / seconds;
+}
+
+void QueueContentionBenchmarks()
+{
+    LOG_INFO("Running queue contention benchmarks...");
+    constexpr u32 queueCapacity = 1024;
+    constexpr u32 totalItems = 1 << 20;
+    const u32 mixes[][2] = { {1, 1}, {1, 4}, {4, 1}, {4, 4}, {8, 8} };
+    for (u32 i = 0; i < ARRAY_SIZE(mixes); i++)
+    {
+        u32 numProducers = mixes[i][0];
+        u32 numConsumers = mixes[i][1];
+        f64 mutexItemsPerSec = BenchmarkQueueContention<MutexQueue<u64, queueCapacity>>(numProducers, numConsumers, totalItems);
+        f64 lockFreeItemsPerSec = BenchmarkQueueContention<MPMCQueue<u64, queueCapacity>>(numProducers, numConsumers, totalItems);
+        LOG_INFO("[QUEUE] %u producers / %u consumers | MutexQueue: %12.0f items/s | MPMCQueue: %12.0f items/s | %.2fx",
+            numProducers, numConsumers, mutexItemsPerSec, lockFreeItemsPerSec, lockFreeItemsPerSec / mutexItemsPerSec);
+    }
+    LOG_INFO("Queue contention benchmarks complete");
+}
@@ -0,0 +1,160 @@
+#ifndef MPMC_QUEUE_H
+#define MPMC_QUEUE_H
+
+#include <atomic>
+#include <utility>
+#include "tiny_defines.h"
+#include "tiny_log.h"
+
+// Fixed size lock-free multi producer/multi consumer ring buffer
+// https://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+// Same push_back/pop_front/size surface as MutexQueue, so the two can be swapped through a template parameter.
+// Every cell has a sequence number that says whose turn it is:
+//	sequence == pos		cell is free for the producer that claims pos
+//	sequence == pos+1	cell holds the item for the consumer that claims pos
+// so producers and consumers only contend on their own position counter, and never on each other.
+// Unlike MutexQueue all _capacity cells are usable.
+template <typename T, size_t _capacity>
+class MPMCQueue
+{
+	static_assert(_capacity >= 2 && (_capacity & (_capacity - 1)) == 0, "MPMCQueue capacity must be a power of two");
+public:
+
+	MPMCQueue()
+	{
+		for (size_t i = 0; i < _capacity; i++)
+		{
+			cells[i].sequence.store(i, std::memory_order_relaxed);
+		}
+		enqueuePos.store(0, std::memory_order_relaxed);
+		dequeuePos.store(0, std::memory_order_relaxed);
+	}
+
+	MPMCQueue(const MPMCQueue&) = delete;
+	MPMCQueue& operator=(const MPMCQueue&) = delete;
+
+	// Push an item to the end if there is free space
+	//	Returns true if succesful
+	//	Returns false if there is not enough space
+	inline bool push_back(const T& item)
+	{
+		size_t pos = 0;
+		Cell* cell = ClaimPushCell(pos);
+		if (!cell) return false;
+		cell->data = item;
+		cell->sequence.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	inline bool push_back(T&& item)
+	{
+		size_t pos = 0;
+		Cell* cell = ClaimPushCell(pos);
+		if (!cell) return false;
+		cell->data = std::move(item);
+		cell->sequence.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Get an item if there are any
+	//	Returns true if succesful
+	//	Returns false if there are no items
+	inline bool pop_front(T& item)
+	{
+		size_t pos = dequeuePos.load(std::memory_order_relaxed);
+		Cell* cell = nullptr;
+		for (;;)
+		{
+			cell = &cells[pos & mask];
+			size_t seq = cell->sequence.load(std::memory_order_acquire);
+			intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+			if (diff == 0)
+			{
+				if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					break;
+				}
+			}
+			else if (diff < 0)
+			{
+				return false; // empty
+			}
+			else
+			{
+				pos = dequeuePos.load(std::memory_order_relaxed);
+			}
+		}
+		item = std::move(cell->data);
+		// free the cell for the producer one lap ahead
+		cell->sequence.store(pos + _capacity, std::memory_order_release);
+		return true;
+	}
+
+	inline u32 capacity()
+	{
+		return _capacity;
+	}
+
+	// approximate when called concurrently
+	inline u32 size()
+	{
+		size_t enq = enqueuePos.load(std::memory_order_relaxed);
+		size_t deq = dequeuePos.load(std::memory_order_relaxed);
+		return enq > deq ? (u32)(enq - deq) : 0;
+	}
+
+	// pops everything. Safe to call concurrently with pushes/pops, but then "everything" is a moving target
+	inline void clear()
+	{
+		T item;
+		while (pop_front(item)) {}
+	}
+
+private:
+
+	struct Cell
+	{
+		std::atomic<size_t> sequence;
+		T data;
+	};
+
+	// returns the cell to write into (and its position), or null if the queue is full
+	inline Cell* ClaimPushCell(size_t& pos)
+	{
+		pos = enqueuePos.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			Cell* cell = &cells[pos & mask];
+			size_t seq = cell->sequence.load(std::memory_order_acquire);
+			intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+			if (diff == 0)
+			{
+				if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					return cell;
+				}
+			}
+			else if (diff < 0)
+			{
+				return nullptr; // full
+			}
+			else
+			{
+				pos = enqueuePos.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	static constexpr size_t mask = _capacity - 1;
+	Cell cells[_capacity];
+	// producers and consumers each hammer their own counter, keep them on separate cache lines
+	alignas(64) std::atomic<size_t> enqueuePos;
+	alignas(64) std::atomic<size_t> dequeuePos;
+};
+
+// correctness under multiple producers/consumers, and moving/full/empty edge cases
+TAPI void MPMCQueueTests();
+// throughput of MutexQueue vs MPMCQueue under different producer/consumer mixes
+TAPI void QueueContentionBenchmarks();
+
+#endif
@@ -36,6 +36,21 @@ public:
 		return result;
 	}
 
+	inline bool push_back(T&& item)
+	{
+		bool result = false;
+		lock.lock();
+		size_t next = (head + 1) % _capacity;
+		if (next != tail)
+		{
+			data[head] = std::move(item);
+			head = next;
+			result = true;
+		}
+		lock.unlock();
+		return result;
+	}
+
 	// Get an item if there are any
 	//	Returns true if succesful
 	//	Returns false if there are no items
@@ -45,7 +60,7 @@ public:
 		lock.lock();
 		if (tail != head)
 		{
-			item = data[tail];
+			item = std::move(data[tail]);
 			tail = (tail + 1) % _capacity;
 			result = true;
 		}
@@ -0,0 +1,229 @@
+//#include "pch.h"
+#include "slot_map.h"
+#include "hash_map.h"
+
+#include <unordered_map>
+#include <string>
+#include <vector>
+#include <chrono>
+
+struct SlotMapTestValue
+{
+    static inline s32 numAlive = 0;
+    std::string name = "";
+    u32 value = 0;
+    SlotMapTestValue() { numAlive++; }
+    SlotMapTestValue(const char* name, u32 value) : name(name), value(value) { numAlive++; }
+    SlotMapTestValue(const SlotMapTestValue& other) : name(other.name), value(other.value) { numAlive++; }
+    SlotMapTestValue(SlotMapTestValue&& other) : name(std::move(other.name)), value(other.value) { numAlive++; }
+    SlotMapTestValue& operator=(const SlotMapTestValue&) = default;
+    SlotMapTestValue& operator=(SlotMapTestValue&&) = default;
+    ~SlotMapTestValue() { numAlive--; }
+};
+
+void SlotMapTests()
+{
+    LOG_INFO("Running SlotMap tests...");
+    // random inserts/erases against std::unordered_map, keyed by handle
+    {
+        SlotMap<u32> map;
+        std::unordered_map<u32, u32> reference;
+        std::vector<SlotMapHandle<u32>> handles;
+        std::vector<SlotMapHandle<u32>> erased;
+        TINY_ASSERT(!map.get(SlotMapHandle<u32>()) && !map.erase(SlotMapHandle<u32>()) && map.empty());
+        u32 rng = 0x12345678;
+        for (u32 i = 0; i < 200000; i++)
+        {
+            rng ^= rng << 13; rng ^= rng >> 17; rng ^= rng << 5;
+            if ((rng & 3) != 0 || handles.empty())
+            {
+                SlotMapHandle<u32> handle = map.insert(i);
+                TINY_ASSERT(handle.bits != SLOT_MAP_INVALID_HANDLE && !reference.count(handle.bits));
+                reference[handle.bits] = i;
+                handles.push_back(handle);
+            }
+            else
+            {
+                u32 idx = (rng >> 2) % handles.size();
+                SlotMapHandle<u32> handle = handles[idx];
+                handles[idx] = handles.back();
+                handles.pop_back();
+                TINY_ASSERT(map.erase(handle) && !map.erase(handle));
+                reference.erase(handle.bits);
+                erased.push_back(handle);
+            }
+        }
+        TINY_ASSERT(map.size() == reference.size());
+        for (const auto& [bits, value] : reference)
+        {
+            SlotMapHandle<u32> handle(bits);
+            TINY_ASSERT(map.get(handle) && *map.get(handle) == value && map.at(handle) == value);
+        }
+        // stale handles don't resolve, even though most of their slots got reused
+        for (SlotMapHandle<u32> handle : erased)
+        {
+            TINY_ASSERT(!map.contains(handle));
+        }
+        // dense iteration covers every value once, and the dense handles agree with it
+        u32 visited = 0;
+        for (u32 value : map)
+        {
+            TINY_ASSERT(reference.at(map.handle_at_dense(visited).bits) == value);
+            visited++;
+        }
+        TINY_ASSERT(visited == map.size());
+        // made up handles to slots that are free (or were never used) don't resolve either
+        TINY_ASSERT(!map.get(SlotMapHandle<u32>(SLOT_MAP_MAX_SLOTS - 1, 1)));
+        u32 capacity = map.capacity();
+        map.clear();
+        TINY_ASSERT(map.empty() && map.capacity() == capacity);
+        for (const auto& [bits, value] : reference)
+        {
+            TINY_ASSERT(!map.contains(SlotMapHandle<u32>(bits)));
+        }
+    }
+    // generations wrap around without ever making a 0 handle
+    {
+        SlotMap<u32> map;
+        for (u32 i = 0; i < SLOT_MAP_MAX_GENERATION * 2 + 5; i++)
+        {
+            SlotMapHandle<u32> handle = map.insert(i);
+            TINY_ASSERT(handle.index() == 0 && handle.generation() != 0 && handle.bits != SLOT_MAP_INVALID_HANDLE);
+            TINY_ASSERT(map.erase(handle));
+        }
+    }
+    // non trivial values get constructed/destroyed properly, and pointers survive growing
+    {
+        SlotMap<SlotMapTestValue>* map = new SlotMap<SlotMapTestValue>();
+        SlotMapHandle<SlotMapTestValue> firstHandle = map->emplace("first", 1u);
+        SlotMapTestValue* first = map->get(firstHandle);
+        std::vector<SlotMapHandle<SlotMapTestValue>> handles;
+        for (u32 i = 0; i < 5000; i++)
+        {
+            std::string name = "value" + std::to_string(i);
+            handles.push_back(map->emplace(name.c_str(), i));
+        }
+        TINY_ASSERT(first == map->get(firstHandle) && first->value == 1);
+        TINY_ASSERT(SlotMapTestValue::numAlive == 5001);
+        // erasing pulls the last value into the hole, every handle still finds its own value
+        TINY_ASSERT(map->erase(firstHandle) && !map->get(firstHandle));
+        TINY_ASSERT(map->at(handles[4999]).name == "value4999" && SlotMapTestValue::numAlive == 5000);
+        for (u32 i = 0; i < 5000; i += 3) TINY_ASSERT(map->erase(handles[i]));
+        for (u32 i = 0; i < 5000; i++)
+        {
+            TINY_ASSERT((map->get(handles[i]) != nullptr) == (i % 3 != 0));
+            TINY_ASSERT(!map->get(handles[i]) || map->get(handles[i])->value == i);
+        }
+        // moving hands over the memory
+        u32 numLeft = map->size();
+        SlotMap<SlotMapTestValue> moved = std::move(*map);
+        TINY_ASSERT(map->empty() && moved.size() == numLeft && moved.at(handles[1]).name == "value1");
+        delete map;
+        TINY_ASSERT(SlotMapTestValue::numAlive == (s32)numLeft);
+        moved.clear();
+        TINY_ASSERT(SlotMapTestValue::numAlive == 0);
+    }
+    LOG_INFO("SlotMap tests passed");
+}
+
+template <typename Func>
+static f64 TimeMs(Func func)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    func();
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<f64, std::milli>(end - start).count();
+}
+
+// stand in for an entity - transform + a few ids, the rest is cold
+struct SlotMapBenchValue
+{
+    f32 position[3] = {};
+    u32 flags = 0;
+    u8 payload[112] = {};
+};
+
+void SlotMapBenchmarks()
+{
+    LOG_INFO("Running SlotMap benchmarks...");
+    for (u32 numEntries : { 10000u, 100000u, 1000000u })
+    {
+        u32 numRounds = 20000000 / numEntries;
+        // entity ids used to be name hashes or rehashed creation indices, so random 32 bit keys
+        std::vector<u32> keys(numEntries);
+        u32 rng = 0x9E3779B9;
+        for (u32 i = 0; i < numEntries; i++)
+        {
+            rng ^= rng << 13; rng ^= rng >> 17; rng ^= rng << 5;
+            keys[i] = rng;
+        }
+        std::unordered_map<u32, SlotMapBenchValue>* stdMap = new std::unordered_map<u32, SlotMapBenchValue>();
+        HashMap<u32, SlotMapBenchValue>* hashMap = new HashMap<u32, SlotMapBenchValue>();
+        SlotMap<SlotMapBenchValue>* slotMap = new SlotMap<SlotMapBenchValue>();
+        std::vector<SlotMapHandle<SlotMapBenchValue>> handles(numEntries);
+        for (u32 i = 0; i < numEntries; i++)
+        {
+            (*stdMap)[keys[i]].flags = i;
+            (*hashMap)[keys[i]].flags = i;
+            handles[i] = slotMap->emplace();
+            slotMap->at(handles[i]).flags = i;
+        }
+        // churn a bit so the slot map isn't in perfect creation order either
+        for (u32 i = 0; i < numEntries; i += 7)
+        {
+            slotMap->erase(handles[i]);
+            handles[i] = slotMap->emplace();
+            slotMap->at(handles[i]).flags = i;
+        }
+        // lookups go in a shuffled order, like the game poking at entities it holds refs to
+        std::vector<u32> lookupOrder(numEntries);
+        for (u32 i = 0; i < numEntries; i++) lookupOrder[i] = i;
+        for (u32 i = numEntries - 1; i > 0; i--)
+        {
+            rng ^= rng << 13; rng ^= rng >> 17; rng ^= rng << 5;
+            std::swap(lookupOrder[i], lookupOrder[rng % (i + 1)]);
+        }
+
+        u64 sum = 0;
+        f64 stdIterMs = TimeMs([&]() {
+            for (u32 round = 0; round < numRounds; round++)
+                for (const auto& [key, value] : *stdMap) sum += value.flags;
+        });
+        f64 hashMapIterMs = TimeMs([&]() {
+            for (u32 round = 0; round < numRounds; round++)
+                for (const auto& [key, value] : *hashMap) sum += value.flags;
+        });
+        f64 slotMapIterMs = TimeMs([&]() {
+            for (u32 round = 0; round < numRounds; round++)
+                for (const SlotMapBenchValue& value : *slotMap) sum += value.flags;
+        });
+        f64 stdLookupMs = TimeMs([&]() {
+            for (u32 round = 0; round < numRounds; round++)
+                for (u32 i : lookupOrder) sum += stdMap->find(keys[i])->second.flags;
+        });
+        f64 hashMapLookupMs = TimeMs([&]() {
+            for (u32 round = 0; round < numRounds; round++)
+                for (u32 i : lookupOrder) sum += hashMap->find(keys[i])->flags;
+        });
+        f64 slotMapLookupMs = TimeMs([&]() {
+            for (u32 round = 0; round < numRounds; round++)
+                for (u32 i : lookupOrder) sum += slotMap->get(handles[i])->flags;
+        });
+        TINY_ASSERT(sum != 0);
+
+        f64 numOps = (f64)numEntries * numRounds;
+        auto report = [&](const char* opName, f64 stdMs, f64 hashMapMs, f64 slotMapMs) {
+            f64 stdNs = stdMs * 1000000.0 / numOps;
+            f64 hashMapNs = hashMapMs * 1000000.0 / numOps;
+            f64 slotMapNs = slotMapMs * 1000000.0 / numOps;
+            LOG_INFO("[SLOTMAP] %7u entries | %-7s | unordered_map: %6.2f ns | HashMap: %6.2f ns | SlotMap: %6.2f ns | %.2fx / %.2fx",
+                numEntries, opName, stdNs, hashMapNs, slotMapNs, stdNs / slotMapNs, hashMapNs / slotMapNs);
+        };
+        report("iterate", stdIterMs, hashMapIterMs, slotMapIterMs);
+        report("lookup", stdLookupMs, hashMapLookupMs, slotMapLookupMs);
+        delete stdMap;
+        delete hashMap;
+        delete slotMap;
+    }
+    LOG_INFO("SlotMap benchmarks complete");
+}
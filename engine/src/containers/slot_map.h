@@ -0,0 +1,286 @@
+#ifndef SLOT_MAP_H
+#define SLOT_MAP_H
+
+#include <cstddef>
+#include <utility>
+#include <new>
+#include <bit>
+#include <type_traits>
+#include "tiny_defines.h"
+#include "tiny_log.h"
+#include "mem/tiny_mem.h"
+
+// Slot map (sparse set) for things that get referred to by handle instead of by key.
+// Handles are a single u32: slot index in the low SLOT_MAP_INDEX_BITS, generation in the rest. Looking one up is an index into
+// the sparse slot array and a generation compare, no hashing.
+//	- sparse slots hold the index of the value in the dense array, and a generation that's bumped every time the slot is freed.
+//	  A handle to something that's been erased stops resolving, even after its slot is reused (until the generation wraps
+//	  around, which takes SLOT_MAP_MAX_GENERATION reuses of the same slot)
+//	- values are packed densely in fixed size pages, and the dense index -> slot array lets erase move the last value into the hole.
+//	  Iteration is a straight walk over live values. Pages never move, so pointers to values survive inserts, but not erase
+//	  (of that value, or of anything while it's the last value)
+//	- a handle of 0 is never handed out, so zero initialized handles are always invalid
+// Single threaded
+
+#define SLOT_MAP_INDEX_BITS 22
+#define SLOT_MAP_MAX_SLOTS (1u << SLOT_MAP_INDEX_BITS)
+#define SLOT_MAP_MAX_GENERATION ((1u << (32 - SLOT_MAP_INDEX_BITS)) - 1)
+#define SLOT_MAP_INVALID_HANDLE 0
+
+template <typename T>
+struct SlotMapHandle
+{
+	u32 bits = SLOT_MAP_INVALID_HANDLE;
+
+	SlotMapHandle() = default;
+	explicit SlotMapHandle(u32 bits) : bits(bits) {}
+	SlotMapHandle(u32 index, u32 generation) : bits((generation << SLOT_MAP_INDEX_BITS) | index) {}
+	inline u32 index() const { return bits & (SLOT_MAP_MAX_SLOTS - 1); }
+	inline u32 generation() const { return bits >> SLOT_MAP_INDEX_BITS; }
+	inline bool operator==(const SlotMapHandle& other) const { return bits == other.bits; }
+	inline bool operator!=(const SlotMapHandle& other) const { return bits != other.bits; }
+};
+
+template <typename T>
+class SlotMap
+{
+	struct Slot
+	{
+		// index into the dense arrays while the slot is in use. Next free slot while it isn't
+		u32 denseIndex;
+		// generations start at 1 so handles are never 0
+		u32 generation;
+	};
+	// keep pages around 16KB
+	static constexpr u32 VALUES_PER_PAGE = std::bit_floor(sizeof(T) >= KILOBYTES_BYTES(1) ? 16u : (u32)(KILOBYTES_BYTES(16) / sizeof(T)));
+	static constexpr u32 PAGE_SHIFT = std::countr_zero(VALUES_PER_PAGE);
+	static_assert(alignof(T) <= alignof(std::max_align_t), "SlotMap pages come from TSYSALLOC, can't over-align");
+
+public:
+	typedef SlotMapHandle<T> Handle;
+
+	template <bool isConst>
+	struct IteratorBase
+	{
+		using ValueType = std::conditional_t<isConst, const T, T>;
+		T* const* pages;
+		u32 index;
+		inline ValueType& operator*() const { return pages[index >> PAGE_SHIFT][index & (VALUES_PER_PAGE - 1)]; }
+		inline ValueType* operator->() const { return &**this; }
+		inline IteratorBase& operator++() { index++; return *this; }
+		inline bool operator==(const IteratorBase& other) const { return index == other.index; }
+		inline bool operator!=(const IteratorBase& other) const { return index != other.index; }
+	};
+	typedef IteratorBase<false> Iterator;
+	typedef IteratorBase<true> ConstIterator;
+
+	SlotMap() = default;
+	SlotMap(const SlotMap&) = delete;
+	SlotMap& operator=(const SlotMap&) = delete;
+	SlotMap(SlotMap&& other) noexcept { steal(other); }
+	SlotMap& operator=(SlotMap&& other) noexcept
+	{
+		if (this != &other)
+		{
+			release();
+			steal(other);
+		}
+		return *this;
+	}
+	~SlotMap() { release(); }
+
+	// constructs a value from args and returns its handle
+	template <typename... Args>
+	Handle emplace(Args&&... args)
+	{
+		u32 slotIdx = freeHead;
+		if (slotIdx != U32_INVALID_ID)
+		{
+			freeHead = slots[slotIdx].denseIndex;
+		}
+		else
+		{
+			TINY_ASSERT(numSlots < SLOT_MAP_MAX_SLOTS && "SlotMap is out of handle bits");
+			if (numSlots == slotCapacity)
+			{
+				grow_slots(slotCapacity ? slotCapacity * 2 : 64);
+			}
+			slotIdx = numSlots++;
+			slots[slotIdx].generation = 1;
+		}
+		ensure_pages(numValues + 1);
+		u32 denseIdx = numValues;
+		new(&value_at(denseIdx)) T(std::forward<Args>(args)...);
+		denseToSlot[denseIdx] = slotIdx;
+		slots[slotIdx].denseIndex = denseIdx;
+		numValues++;
+		return Handle(slotIdx, slots[slotIdx].generation);
+	}
+	inline Handle insert(const T& value) { return emplace(value); }
+
+	// returns false if the handle is stale
+	bool erase(Handle handle)
+	{
+		u32 denseIdx = dense_index(handle);
+		if (denseIdx == U32_INVALID_ID) return false;
+		// keep values packed, last one fills the hole
+		u32 lastIdx = numValues - 1;
+		if (denseIdx != lastIdx)
+		{
+			value_at(denseIdx) = std::move(value_at(lastIdx));
+			denseToSlot[denseIdx] = denseToSlot[lastIdx];
+			slots[denseToSlot[denseIdx]].denseIndex = denseIdx;
+		}
+		value_at(lastIdx).~T();
+		numValues--;
+		free_slot(handle.index());
+		return true;
+	}
+
+	// null if the handle is stale
+	inline T* get(Handle handle)
+	{
+		u32 denseIdx = dense_index(handle);
+		return denseIdx == U32_INVALID_ID ? nullptr : &value_at(denseIdx);
+	}
+	inline const T* get(Handle handle) const { return const_cast<SlotMap*>(this)->get(handle); }
+	inline bool contains(Handle handle) const { return dense_index(handle) != U32_INVALID_ID; }
+	// handle has to be valid
+	inline T& at(Handle handle)
+	{
+		T* value = get(handle);
+		TINY_ASSERT(value && "SlotMap::at with a stale handle");
+		return *value;
+	}
+	inline const T& at(Handle handle) const { return const_cast<SlotMap*>(this)->at(handle); }
+
+	// dense access, for walking values and their handles together. Indices are only stable until the next erase
+	inline T& value_at_dense(u32 denseIdx) { TINY_ASSERT(denseIdx < numValues); return value_at(denseIdx); }
+	inline Handle handle_at_dense(u32 denseIdx) const
+	{
+		TINY_ASSERT(denseIdx < numValues);
+		u32 slotIdx = denseToSlot[denseIdx];
+		return Handle(slotIdx, slots[slotIdx].generation);
+	}
+
+	// destroys every value and invalidates every handle. Keeps the memory
+	void clear()
+	{
+		for (u32 i = 0; i < numValues; i++)
+		{
+			value_at(i).~T();
+			free_slot(denseToSlot[i]);
+		}
+		numValues = 0;
+	}
+	// makes sure count values fit without allocating
+	void reserve(u32 count)
+	{
+		if (count > slotCapacity) grow_slots(count);
+		ensure_pages(count);
+	}
+
+	inline u32 size() const { return numValues; }
+	inline bool empty() const { return numValues == 0; }
+	inline u32 capacity() const { return numPages * VALUES_PER_PAGE; }
+	inline Iterator begin() { return { pages, 0 }; }
+	inline Iterator end() { return { pages, numValues }; }
+	inline ConstIterator begin() const { return { pages, 0 }; }
+	inline ConstIterator end() const { return { pages, numValues }; }
+
+private:
+	inline T& value_at(u32 index) const { return pages[index >> PAGE_SHIFT][index & (VALUES_PER_PAGE - 1)]; }
+
+	// dense index of the handle's value, or U32_INVALID_ID if it's stale
+	inline u32 dense_index(Handle handle) const
+	{
+		u32 slotIdx = handle.index();
+		if (slotIdx >= numSlots) return U32_INVALID_ID;
+		const Slot& slot = slots[slotIdx];
+		// free slots can still have the handle's generation if it was never handed out, so also check the dense side points back at us
+		if (slot.generation != handle.generation() || slot.denseIndex >= numValues || denseToSlot[slot.denseIndex] != slotIdx)
+		{
+			return U32_INVALID_ID;
+		}
+		return slot.denseIndex;
+	}
+	void free_slot(u32 slotIdx)
+	{
+		Slot& slot = slots[slotIdx];
+		slot.generation = slot.generation == SLOT_MAP_MAX_GENERATION ? 1 : slot.generation + 1;
+		slot.denseIndex = freeHead;
+		freeHead = slotIdx;
+	}
+	void grow_slots(u32 newCapacity)
+	{
+		if (newCapacity > SLOT_MAP_MAX_SLOTS) newCapacity = SLOT_MAP_MAX_SLOTS;
+		slots = (Slot*)TSYSREALLOC(slots, sizeof(Slot) * newCapacity);
+		denseToSlot = (u32*)TSYSREALLOC(denseToSlot, sizeof(u32) * newCapacity);
+		TINY_ASSERT(slots && denseToSlot && "SlotMap failed to grow");
+		slotCapacity = newCapacity;
+	}
+	void ensure_pages(u32 count)
+	{
+		u32 neededPages = (count + VALUES_PER_PAGE - 1) >> PAGE_SHIFT;
+		if (neededPages <= numPages) return;
+		if (neededPages > pageTableCapacity)
+		{
+			u32 newCapacity = pageTableCapacity ? pageTableCapacity : 4;
+			while (newCapacity < neededPages) newCapacity *= 2;
+			pages = (T**)TSYSREALLOC(pages, sizeof(T*) * newCapacity);
+			pageTableCapacity = newCapacity;
+		}
+		while (numPages < neededPages)
+		{
+			pages[numPages++] = (T*)TSYSALLOC_TAGGED(sizeof(T) * VALUES_PER_PAGE, MemTag::CONTAINERS);
+		}
+	}
+	void release()
+	{
+		clear();
+		for (u32 i = 0; i < numPages; i++)
+		{
+			TSYSFREE(pages[i]);
+		}
+		if (pages) TSYSFREE(pages);
+		if (slots) TSYSFREE(slots);
+		if (denseToSlot) TSYSFREE(denseToSlot);
+		numPages = pageTableCapacity = numSlots = slotCapacity = 0;
+		freeHead = U32_INVALID_ID;
+	}
+	void steal(SlotMap& other)
+	{
+		pages = other.pages;
+		slots = other.slots;
+		denseToSlot = other.denseToSlot;
+		numValues = other.numValues;
+		numPages = other.numPages;
+		pageTableCapacity = other.pageTableCapacity;
+		numSlots = other.numSlots;
+		slotCapacity = other.slotCapacity;
+		freeHead = other.freeHead;
+		other.pages = nullptr;
+		other.slots = nullptr;
+		other.denseToSlot = nullptr;
+		other.numValues = other.numPages = other.pageTableCapacity = other.numSlots = other.slotCapacity = 0;
+		other.freeHead = U32_INVALID_ID;
+	}
+
+	T** pages = nullptr;
+	Slot* slots = nullptr;
+	// slot index of each dense value, same order as the values
+	u32* denseToSlot = nullptr;
+	u32 numValues = 0;
+	u32 numPages = 0;
+	u32 pageTableCapacity = 0;
+	// slots [0, numSlots) have been handed out at least once
+	u32 numSlots = 0;
+	u32 slotCapacity = 0;
+	u32 freeHead = U32_INVALID_ID;
+};
+
+TAPI void SlotMapTests();
+// iteration and handle lookup at 10k/100k/1M entries, SlotMap vs HashMap vs std::unordered_map
+TAPI void SlotMapBenchmarks();
+
+#endif
@@ -0,0 +1,113 @@
+#ifndef WORK_STEALING_DEQUE_H
+#define WORK_STEALING_DEQUE_H
+
+#include <atomic>
+#include <type_traits>
+#include "tiny_defines.h"
+
+// Fixed size Chase-Lev work stealing deque
+// https://www.di.ens.fr/~zappa/readings/ppopp13.pdf
+// The owning thread pushes and pops from the bottom (LIFO, good for cache locality),
+// any other thread can steal from the top (FIFO, steals the oldest/biggest chunks of work).
+// Only the owner may call push_back/pop_back. steal may be called from any thread.
+// T must be trivially copyable since thieves may read a slot that is concurrently being overwritten
+// (the read value is thrown away if the steal fails). In practice this stores pointers/indices.
+template <typename T, size_t _capacity>
+class WorkStealingDeque
+{
+	static_assert((_capacity & (_capacity - 1)) == 0, "WorkStealingDeque capacity must be a power of two");
+	static_assert(std::is_trivially_copyable<T>::value, "WorkStealingDeque elements must be trivially copyable");
+public:
+
+	WorkStealingDeque()
+	{
+		top.store(0, std::memory_order_relaxed);
+		bottom.store(0, std::memory_order_relaxed);
+	}
+
+	// Owner only. Push an item to the bottom if there is free space
+	//	Returns true if succesful
+	//	Returns false if there is not enough space
+	inline bool push_back(const T& item)
+	{
+		s64 b = bottom.load(std::memory_order_relaxed);
+		s64 t = top.load(std::memory_order_acquire);
+		if (b - t >= (s64)_capacity)
+		{
+			return false;
+		}
+		data[b & mask].store(item, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		bottom.store(b + 1, std::memory_order_relaxed);
+		return true;
+	}
+
+	// Owner only. Pop the most recently pushed item
+	//	Returns true if succesful
+	//	Returns false if there are no items (or a thief beat us to the last one)
+	inline bool pop_back(T& item)
+	{
+		s64 b = bottom.load(std::memory_order_relaxed) - 1;
+		bottom.store(b, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		s64 t = top.load(std::memory_order_relaxed);
+		if (t > b)
+		{
+			// empty
+			bottom.store(b + 1, std::memory_order_relaxed);
+			return false;
+		}
+		item = data[b & mask].load(std::memory_order_relaxed);
+		if (t == b)
+		{
+			// last item - race against thieves for it
+			bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+			bottom.store(b + 1, std::memory_order_relaxed);
+			return won;
+		}
+		return true;
+	}
+
+	// Any thread. Take the oldest item
+	//	Returns true if succesful
+	//	Returns false if there are no items or we lost the race to another thread
+	inline bool steal(T& item)
+	{
+		s64 t = top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		s64 b = bottom.load(std::memory_order_acquire);
+		if (t >= b)
+		{
+			return false;
+		}
+		T stolen = data[t & mask].load(std::memory_order_relaxed);
+		if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		{
+			return false;
+		}
+		item = stolen;
+		return true;
+	}
+
+	inline u32 capacity()
+	{
+		return _capacity;
+	}
+
+	// approximate when called concurrently
+	inline u32 size()
+	{
+		s64 b = bottom.load(std::memory_order_relaxed);
+		s64 t = top.load(std::memory_order_relaxed);
+		return b > t ? (u32)(b - t) : 0;
+	}
+
+private:
+	static constexpr s64 mask = (s64)_capacity - 1;
+	// top and bottom are written by different threads, keep them on separate cache lines
+	alignas(64) std::atomic<s64> top;
+	alignas(64) std::atomic<s64> bottom;
+	alignas(64) std::atomic<T> data[_capacity];
+};
+
+#endif
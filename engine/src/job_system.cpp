@@ -3,88 +3,1173 @@
 #include "tiny_log.h"
 #include "tiny_thread.h"
 #include "tiny_profiler.h"
+#include "mem/tiny_arena.h"
 
 #include <string>
+#include <chrono>
+#include <math.h>
 
+// which job system (if any) the current thread is a worker of, and its index in that system
+static thread_local JobSystem* tlsJobSystem = nullptr;
+static thread_local s32 tlsWorkerIndex = -1;
+static thread_local u32 tlsStealSeed = 0;
+// jobs this thread is in the middle of running (more than 1 when a job helps out with others while it waits)
+static thread_local u32 tlsNumRunningJobs = 0;
 
-void JobSystem::Initialize() {
-    // get number of threads this system supports
-    u32 numCores = std::thread::hardware_concurrency();
-    // hardware_concurrency may return 0 if it can't query properly.. in that case just use 1
-    // reasonable max concurrent threads... don't want to spin up 12 threads for this engine lol
-    u32 threads = std::min(std::max(1u, numCores), 3u); 
+// xorshift - only used to pick steal victims
+static u32 NextStealVictim(u32 numThreads)
+{
+    u32& x = tlsStealSeed;
+    if (x == 0)
+    {
+        x = (u32)std::hash<std::thread::id>{}(std::this_thread::get_id()) | 1;
+    }
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x % numThreads;
+}
+
+void JobSystem::Initialize(const JobSystemConfig& jobConfig) {
+    config = jobConfig;
+    u32 threads = config.numWorkerThreads;
+    if (threads == 0)
+    {
+        // get number of threads this system supports
+        u32 numCores = std::thread::hardware_concurrency();
+        // hardware_concurrency may return 0 if it can't query properly.. in that case just use 1
+        // idle workers sleep, so it's fine to use every core we aren't reserving for something else
+        threads = numCores > config.reservedCores ? numCores - config.reservedCores : 1;
+        if (config.maxWorkerThreads > 0)
+        {
+            threads = std::min(threads, config.maxWorkerThreads);
+        }
+    }
     this->numThreads = threads;
-    inProgressJobs = std::vector<std::vector<u32>>(numThreads);
     LOG_INFO("[JOBS] Spinning up %i job threads", numThreads);
 
+    // deques are big and hold atomics, so they live outside of the JobSystem struct.
+    // Not TSYSALLOC - that only guarantees 16 byte alignment and the deque's indices are cache line aligned
+    workerQueues = new WorkerQueue[numThreads];
+    TINY_ASSERT(((uintptr_t)workerQueues & (alignof(WorkerQueue) - 1)) == 0);
+    for (u32 i = 0; i < ARRAY_SIZE(frameArenas); i++)
+    {
+        frameArenas[i].mem = (u8*)TSYSALLOC_TAGGED(config.frameArenaSize, MemTag::JOBS);
+        frameArenas[i].size = config.frameArenaSize;
+        frameArenas[i].offset = 0;
+    }
+    running = true;
+    workers.reserve(numThreads);
     for (u32 threadID = 0; threadID < this->numThreads; threadID++) {
-        std::thread worker([this, threadID]{
-
-            Job job;
-            std::vector<u32>& inProgressJobsForThread = inProgressJobs.at(threadID);
-            while (numThreads > 0) { // allows us to shut down all threads when program exits by just setting numthreads to 0
-                if (jobPool.pop_front(job)) {
-                    inProgressJobsForThread.push_back(job.id);
-                    job.func(); // execute the job
-                    inProgressJobsForThread.erase(std::find(inProgressJobsForThread.begin(), inProgressJobsForThread.end(), job.id));
-                    //std::cout << "[JOBS] Thread " << threadID << " finished job " << job.id << ""; 
-                }
-                // might be good in the future to put the thread to sleep when there's no more work
-                // and when we enqueue a new job it'll wake the thread up. Use condition variables for this
+        workers.emplace_back(&JobSystem::WorkerThreadMain, this, threadID);
+        SetThreadName(&workers.back(), ("Job Thread " + std::to_string(threadID)).c_str());
+    }
+}
+
+void JobSystem::Shutdown()
+{
+    if (workers.empty()) return;
+    // don't drop anything that was already submitted (async loads etc), or anything those jobs spawn while we wait
+    while (numUnfinishedJobs.load(std::memory_order_acquire) > 0)
+    {
+        if (!HelpWithJob())
+        {
+            std::this_thread::yield();
+        }
+    }
+    {
+        // under the lock so a worker can't check running and then miss the wakeup
+        std::lock_guard<std::mutex> lock(sleepLock);
+        running = false;
+    }
+    wakeCondition.notify_all();
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+    workers.clear();
+    delete[] workerQueues;
+    workerQueues = nullptr;
+    for (u32 i = 0; i < ARRAY_SIZE(frameArenas); i++)
+    {
+        TINY_ASSERT(frameArenas[i].liveAllocations.load() == 0 && "frame jobs outlived the job system");
+        TSYSFREE(frameArenas[i].mem);
+        frameArenas[i].size = 0;
+        frameArenas[i].offset = 0;
+    }
+    numThreads = 0;
+    LOG_INFO("[JOBS] Shut down job threads");
+}
+
+void JobSystem::WorkerThreadMain(u32 threadIdx)
+{
+    tlsJobSystem = this;
+    tlsWorkerIndex = threadIdx;
+    Job* job = nullptr;
+    u32 idleSpins = 0;
+    while (running) { // allows us to shut down all threads when program exits
+        if (TryGetJob(job)) {
+            RunJob(job);
+            idleSpins = 0;
+        }
+        else if (idleSpins < config.idleSpinCount) {
+            // work tends to come in bursts, so stay awake for a little bit before sleeping
+            idleSpins++;
+            std::this_thread::yield();
+        }
+        else {
+            WaitForWork();
+            idleSpins = 0;
+        }
+    }
+    tlsJobSystem = nullptr;
+    tlsWorkerIndex = -1;
+}
+
+void JobSystem::WaitForWork()
+{
+    PROFILE_SCOPE("Job thread sleeping");
+    std::unique_lock<std::mutex> lock(sleepLock);
+    // numSleepingWorkers is bumped before checking for queued jobs, and submitters bump numQueuedJobs
+    // before checking for sleepers, so at least one side always sees the other
+    numSleepingWorkers++;
+    wakeCondition.wait(lock, [this]{ return !running || numQueuedJobs.load() > 0; });
+    numSleepingWorkers--;
+}
+
+void JobSystem::WakeWorker()
+{
+    numQueuedJobs++;
+    if (numSleepingWorkers.load() > 0)
+    {
+        // taking the lock makes sure a worker that's about to sleep is either already waiting
+        // (and gets notified) or hasn't checked numQueuedJobs yet (and will see our job)
+        { std::lock_guard<std::mutex> lock(sleepLock); }
+        wakeCondition.notify_one();
+    }
+}
+
+s32 JobSystem::GetCurrentWorkerIndex() const
+{
+    return tlsJobSystem == this ? tlsWorkerIndex : -1;
+}
+
+// claimed, but the id isn't written yet. Never a valid job id
+#define JOB_SLOT_RESERVED 0xFFFFFFFFu
+
+Job* JobSystem::AllocateJob(JobFunc&& func, JobCounter* counter)
+{
+    // grab the next free slot. Slots are handed out round robin, but a slot that's still busy
+    // (I.E. the job is running and spawning children) is just skipped over
+    u32 numBlocked = 0; // slots held by the jobs on this thread's stack while we wait for a free one
+    for (;;)
+    {
+        for (u32 attempt = 0; attempt < MAX_JOBS; attempt++)
+        {
+            u32 slotIdx = nextJobSlot++ & (MAX_JOBS-1);
+            JobSlot& slot = jobSlots[slotIdx];
+            u32 expected = U32_INVALID_ID;
+            if (slot.occupantID.load(std::memory_order_relaxed) != U32_INVALID_ID ||
+                !slot.occupantID.compare_exchange_strong(expected, JOB_SLOT_RESERVED, std::memory_order_acquire, std::memory_order_relaxed))
+            {
+                continue;
+            }
+            u32 id = U32_INVALID_ID;
+            while (id == U32_INVALID_ID || id == JOB_SLOT_RESERVED)
+            {
+                id = (++slot.generation << JOB_SLOT_BITS) | slotIdx;
             }
-            //std::cout << "[JOBS] Shutting down job thread " << threadID << "";
+            slot.job.func = std::move(func);
+            slot.job.id = id;
+            slot.job.counter = counter;
+            slot.job.nextWaiting = nullptr;
+            if (counter)
+            {
+                counter->pending.fetch_add(1, std::memory_order_relaxed);
+            }
+            numUnfinishedJobs.fetch_add(1, std::memory_order_relaxed);
+            slot.occupantID.store(id, std::memory_order_release);
+            numJobsBlockedOnAllocate.fetch_sub(numBlocked, std::memory_order_relaxed);
+            return &slot.job;
+        }
+        // pool is saturated, help drain it instead of spinning
+        Job* job = nullptr;
+        if (TryGetJob(job))
+        {
+            // not blocked while running something, and that job may end up in here itself
+            numJobsBlockedOnAllocate.fetch_sub(numBlocked, std::memory_order_relaxed);
+            numBlocked = 0;
+            RunJob(job);
+            continue;
+        }
+        if (numBlocked == 0 && tlsNumRunningJobs > 0)
+        {
+            numBlocked = tlsNumRunningJobs;
+            numJobsBlockedOnAllocate.fetch_add(numBlocked, std::memory_order_relaxed);
+        }
+        // nothing left to run can free a slot - every one is waiting on a counter or on a free slot itself
+        if (numParkedJobs.load(std::memory_order_relaxed) + numJobsBlockedOnAllocate.load(std::memory_order_relaxed) >= MAX_JOBS)
+        {
+            LOG_FATAL("[JOBS] Job pool deadlocked: all %u job slots are held by ExecuteAfter jobs waiting on counters (%u) "
+                "or by jobs waiting for a free slot. Submit dependencies before the jobs that wait on them, or Wait on part of the graph first",
+                MAX_JOBS, numParkedJobs.load());
+            TINY_ASSERT(false && "job pool deadlocked");
+            // retrying can never succeed, drop the job
+            numJobsBlockedOnAllocate.fetch_sub(numBlocked, std::memory_order_relaxed);
+            return nullptr;
+        }
+        std::this_thread::yield();
+    }
+}
 
-        });
-        SetThreadName(&worker, ("Job Thread " + std::to_string(threadID)).c_str());
-        worker.detach(); // set it free
+void JobSystem::SubmitJob(Job* job)
+{
+    s32 workerIdx = GetCurrentWorkerIndex();
+    if (workerIdx < 0 || !workerQueues[workerIdx].push_back(job))
+    {
+        while (!jobPool.push_back(job))
+        {
+            HelpWithJob();
+        }
     }
+    WakeWorker();
 }
 
-void JobSystem::ExecuteOnMainThread(const std::function<void()>& job)
+bool JobSystem::TryGetJob(Job*& job)
 {
-    Job jobWithID;
-    jobWithID.func = job;
-    jobWithID.id = currentJobID++;
-    mainThreadJobPool.push_back(jobWithID);
+    s32 workerIdx = GetCurrentWorkerIndex();
+    bool found = false;
+    // our own work first (most recent = hottest in cache)
+    if (workerIdx >= 0 && workerQueues[workerIdx].pop_back(job))
+    {
+        found = true;
+    }
+    // then anything submitted from outside the workers
+    else if (jobPool.size() > 0 && jobPool.pop_front(job))
+    {
+        found = true;
+    }
+    // then try to steal from someone else
+    else
+    {
+        for (u32 attempt = 0; attempt < numThreads && !found; attempt++)
+        {
+            u32 victim = NextStealVictim(numThreads);
+            if ((s32)victim == workerIdx) continue;
+            found = workerQueues[victim].steal(job);
+        }
+    }
+    if (found)
+    {
+        numQueuedJobs--;
+    }
+    return found;
+}
+
+void JobSystem::RunJob(Job* job)
+{
+    tlsNumRunningJobs++;
+    job->func(); // execute the job
+    tlsNumRunningJobs--;
+    job->func = nullptr; // release anything captured by the job
+    JobCounter* counter = job->counter;
+    JobSlot& slot = jobSlots[job->id & (MAX_JOBS-1)];
+    // the slot can be reused as soon as this store lands, don't touch job after it
+    slot.occupantID.store(U32_INVALID_ID, std::memory_order_release);
+    if (counter)
+    {
+        SignalCounter(counter);
+    }
+    // after signalling, so continuations it released are already counted by the time this job isn't
+    numUnfinishedJobs.fetch_sub(1, std::memory_order_release);
+}
+
+bool JobSystem::HelpWithJob()
+{
+    Job* job = nullptr;
+    if (TryGetJob(job))
+    {
+        RunJob(job);
+        return true;
+    }
+    return false;
+}
+
+static void LockCounter(JobCounter* counter)
+{
+    while (counter->locked.exchange(true, std::memory_order_acquire))
+    {
+        while (counter->locked.load(std::memory_order_relaxed)) { std::this_thread::yield(); }
+    }
+}
+
+static void UnlockCounter(JobCounter* counter)
+{
+    counter->locked.store(false, std::memory_order_release);
+}
+
+void JobSystem::SignalCounter(JobCounter* counter)
+{
+    // fast path - we aren't the last job, nobody can be released yet
+    u32 pending = counter->pending.load(std::memory_order_relaxed);
+    while (pending > 1)
+    {
+        if (counter->pending.compare_exchange_weak(pending, pending - 1, std::memory_order_acq_rel, std::memory_order_relaxed))
+        {
+            return;
+        }
+    }
+    // (probably) the last job. The final decrement happens under the lock so continuations being added
+    // concurrently either see a nonzero count and get flushed by us, or see 0 and submit themselves
+    LockCounter(counter);
+    Job* waiting = nullptr;
+    if (counter->pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        waiting = counter->waitingJobs;
+        counter->waitingJobs = nullptr;
+    }
+    // Wait() also waits for the lock to be released, so this is the last time we touch the counter
+    UnlockCounter(counter);
+    while (waiting)
+    {
+        Job* next = waiting->nextWaiting;
+        waiting->nextWaiting = nullptr;
+        numParkedJobs.fetch_sub(1, std::memory_order_relaxed);
+        SubmitJob(waiting);
+        waiting = next;
+    }
+}
+
+void JobSystem::ExecuteOnMainThread(JobFunc&& job, MainThreadJobPriority priority)
+{
+    MainThreadJob mainThreadJob;
+    mainThreadJob.func = std::move(job);
+    mainThreadJob.priority = priority;
+    // if the flush swaps the queues right after we read the index, the job lands in the queue being drained.
+    // That's fine, it either gets picked up this flush or stays put until that queue is drained again
+    u32 writeQueue = mainThreadWriteQueue.load(std::memory_order_acquire);
+    if (!mainThreadQueues[writeQueue].push_back(std::move(mainThreadJob)))
+    {
+        std::lock_guard<std::mutex> lock(mainThreadOverflowLock);
+        mainThreadOverflow.push_back(std::move(mainThreadJob));
+    }
 }
 
 void JobSystem::FlushMainThreadJobs()
 {
     PROFILE_FUNCTION();
-    mainThreadJobPool.lock.lock();
-    u32 mainThreadJobs = mainThreadJobPool.size();
-    for (u32 i = 0; i < mainThreadJobs; i++)
+    auto start = std::chrono::steady_clock::now();
+    // swap buffers. Jobs queued from here on (including by the jobs we're about to run) go to the next flush
+    u32 readQueue = mainThreadWriteQueue.load(std::memory_order_relaxed);
+    mainThreadWriteQueue.store(readQueue ^ 1, std::memory_order_release);
+    MainThreadJob incoming;
+    while (mainThreadQueues[readQueue].pop_front(incoming))
+    {
+        mainThreadBacklog[(u32)incoming.priority].push_back(std::move(incoming.func));
+    }
+    {
+        std::lock_guard<std::mutex> lock(mainThreadOverflowLock);
+        for (MainThreadJob& overflow : mainThreadOverflow)
+        {
+            mainThreadBacklog[(u32)overflow.priority].push_back(std::move(overflow.func));
+        }
+        mainThreadOverflow.clear();
+    }
+
+    // critical jobs count towards the budget, but never get cut off by it
+    u32 numBudgetedRun = 0;
+    bool budgetSpent = false;
+    for (u32 priority = 0; priority < (u32)MainThreadJobPriority::NUM_PRIORITIES; priority++)
+    {
+        std::vector<JobFunc>& backlog = mainThreadBacklog[priority];
+        u32& head = mainThreadBacklogHead[priority];
+        bool ignoreBudget = priority == (u32)MainThreadJobPriority::CRITICAL;
+        while (head < backlog.size())
+        {
+            // always make some progress, even if critical jobs or a single job blow the budget
+            if (!ignoreBudget && numBudgetedRun > 0)
+            {
+                f64 elapsedMs = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+                if (elapsedMs >= config.mainThreadBudgetMs)
+                {
+                    budgetSpent = true;
+                    break;
+                }
+            }
+            JobFunc job = std::move(backlog[head]);
+            head++;
+            job();
+            numBudgetedRun += ignoreBudget ? 0 : 1;
+        }
+        if (head == backlog.size())
+        {
+            backlog.clear();
+            head = 0;
+        }
+        else if (head > backlog.size() / 2)
+        {
+            // we're behind, don't let the already-run moved-from entries pile up at the front
+            backlog.erase(backlog.begin(), backlog.begin() + head);
+            head = 0;
+        }
+        if (budgetSpent) break;
+    }
+    AdvanceFrameArena();
+}
+
+u32 JobSystem::GetNumDeferredMainThreadJobs() const
+{
+    u32 numDeferred = 0;
+    for (u32 priority = 0; priority < (u32)MainThreadJobPriority::NUM_PRIORITIES; priority++)
     {
-        mainThreadJobPool.get(i).func();
+        numDeferred += (u32)mainThreadBacklog[priority].size() - mainThreadBacklogHead[priority];
     }
-    mainThreadJobPool.lock.unlock();
-    mainThreadJobPool.clear();
+    return numDeferred;
 }
 
-u32 JobSystem::Execute(const std::function<void()>& job) {
-    Job jobWithID;
-    jobWithID.func = job;
-    // because our job id's are "sequential", we can rely on the fact that
-    // if a thread reports that they finished a job with id X, jobs with id <= X 
-    // that were on that same thread have also finished
-    jobWithID.id = currentJobID++;
-    jobPool.push_back(jobWithID); // TODO: this might fail if we've hit MAX_JOBS???
-    return jobWithID.id;
+void* JobSystem::FrameArenaAlloc(size_t size, size_t alignment, std::atomic<u32>** liveAllocations)
+{
+    FrameArena& arena = frameArenas[currentFrameArena];
+    size_t alignedOffset = (arena.offset + (alignment - 1)) & ~(alignment - 1);
+    if (arena.mem && alignedOffset + size <= arena.size)
+    {
+        arena.offset = alignedOffset + size;
+        arena.liveAllocations.fetch_add(1, std::memory_order_relaxed);
+        *liveAllocations = &arena.liveAllocations;
+        return arena.mem + alignedOffset;
+    }
+    LOG_WARN("[JOBS] Frame job arena is full (%llu bytes), falling back to the heap", (u64)arena.size);
+    *liveAllocations = nullptr;
+    return TSYSALLOC_TAGGED(size, MemTag::JOBS);
+}
+
+void JobSystem::AdvanceFrameArena()
+{
+    // the arena we're switching to was used two frames ago. Normally everything from then is done,
+    // if not we just keep appending to it rather than stomping on live captures
+    currentFrameArena = (currentFrameArena + 1) % ARRAY_SIZE(frameArenas);
+    FrameArena& arena = frameArenas[currentFrameArena];
+    u32 liveAllocations = arena.liveAllocations.load(std::memory_order_acquire);
+    if (liveAllocations == 0)
+    {
+        arena.offset = 0;
+    }
+    else
+    {
+        LOG_WARN("[JOBS] %u frame jobs are still alive after a frame, not resetting their arena", liveAllocations);
+    }
+}
+
+u32 JobSystem::Execute(JobFunc&& job, JobCounter* counter) {
+    Job* jobWithID = AllocateJob(std::move(job), counter);
+    if (!jobWithID) return U32_INVALID_ID;
+    u32 id = jobWithID->id;
+    SubmitJob(jobWithID);
+    return id;
+}
+
+u32 JobSystem::ExecuteAfter(JobCounter* dependency, JobFunc&& job, JobCounter* counter) {
+    Job* jobWithID = AllocateJob(std::move(job), counter);
+    if (!jobWithID) return U32_INVALID_ID;
+    u32 id = jobWithID->id;
+    if (dependency)
+    {
+        LockCounter(dependency);
+        if (dependency->pending.load(std::memory_order_acquire) > 0)
+        {
+            // park the job on the counter, whoever finishes the last dependency submits it
+            jobWithID->nextWaiting = dependency->waitingJobs;
+            dependency->waitingJobs = jobWithID;
+            numParkedJobs.fetch_add(1, std::memory_order_relaxed);
+            UnlockCounter(dependency);
+            return id;
+        }
+        UnlockCounter(dependency);
+    }
+    SubmitJob(jobWithID);
+    return id;
+}
+
+void JobSystem::Wait(JobCounter* counter) {
+    if (!counter) return;
+    PROFILE_FUNCTION();
+    // also wait for the lock - the last job may have already brought the count to 0 but still be flushing continuations
+    while (!counter->IsDone() || counter->locked.load(std::memory_order_acquire)) {
+        // don't just spin, help out with other work while we wait
+        if (!HelpWithJob())
+        {
+            std::this_thread::yield();
+        }
+    }
 }
 
 void JobSystem::WaitOnJob(u32 id) {
-    bool jobInProgress = true;
-    // spinlocks until the job is done
-    while (jobInProgress) { // TODO: configurable timeout
-        // if the job id we want to wait on is not "in progress" we can assume it is finished
-        // this relies on the fact that waiting on a job will always happen after the job has been
-        // "dispatched" - and that you are waiting on the intended job id
-        for (s32 threadIdx = 0; threadIdx < inProgressJobs.size(); threadIdx++) {
-            const std::vector<u32>& inProgressJobsForThread = inProgressJobs.at(threadIdx);
-            if (!std::count(inProgressJobsForThread.begin(), inProgressJobsForThread.end(), id)) {
-                jobInProgress = false;
+    // the job is done once its slot no longer holds its id (either freed or reused by a newer job)
+    if (id == U32_INVALID_ID) return;
+    // this relies on the fact that waiting on a job will always happen after the job has been
+    // "dispatched" - and that you are waiting on the intended job id
+    JobSlot& slot = jobSlots[id & (MAX_JOBS-1)];
+    while (slot.occupantID.load(std::memory_order_acquire) == id) { // TODO: configurable timeout
+        // don't just spin, help out with other work while we wait
+        if (!HelpWithJob())
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+u32 JobSystem::DefaultGrainSize(u32 count) const
+{
+    // ~8 pieces per thread (workers + the caller) leaves room for stealing to even things out
+    u32 numPieces = (numThreads + 1) * 8;
+    u32 grainSize = count / numPieces;
+    return grainSize > 0 ? grainSize : 1;
+}
+
+void JobSystem::SplitRange(u32 begin, u32 end, u32 grainSize, const std::function<void(u32, u32)>* fn, JobCounter* counter)
+{
+    // keep handing off the upper half. The first halves we push are the biggest, and those are what thieves take
+    while (end - begin > grainSize)
+    {
+        u32 mid = begin + (end - begin) / 2;
+        Execute([this, mid, end, grainSize, fn, counter]() {
+            SplitRange(mid, end, grainSize, fn, counter);
+        }, counter);
+        end = mid;
+    }
+    (*fn)(begin, end);
+}
+
+void JobSystem::ParallelForRange(u32 begin, u32 end, u32 grainSize, const std::function<void(u32, u32)>& fn)
+{
+    if (end <= begin) return;
+    PROFILE_FUNCTION();
+    u32 count = end - begin;
+    if (grainSize == 0) grainSize = DefaultGrainSize(count);
+    if (numThreads == 0 || count <= grainSize)
+    {
+        // not worth (or not possible) going wide
+        fn(begin, end);
+        return;
+    }
+    JobCounter counter;
+    SplitRange(begin, end, grainSize, &fn, &counter);
+    Wait(&counter);
+}
+
+
+// ================= Benchmarks =================
+
+// counts global operator new calls for the allocations-per-job benchmark.
+// Off by default since it replaces new/delete for the whole engine module
+//#define JOB_SYSTEM_COUNT_ALLOCATIONS
+#ifdef JOB_SYSTEM_COUNT_ALLOCATIONS
+static std::atomic<u64> numHeapAllocations = 0;
+void* operator new(size_t size)
+{
+    numHeapAllocations.fetch_add(1, std::memory_order_relaxed);
+    void* mem = malloc(size);
+    if (!mem) throw std::bad_alloc();
+    return mem;
+}
+void operator delete(void* mem) noexcept { free(mem); }
+void operator delete(void* mem, size_t size) noexcept { free(mem); }
+#endif
+
+// the scheduler we had before work stealing: every thread fights over one MutexQueue of std::function jobs
+struct LegacyJob {
+    std::function<void()> func;
+    u32 id;
+};
+
+struct LegacyJobQueueBench
+{
+    #define LEGACY_MAX_JOBS 256
+    MutexQueue<LegacyJob, LEGACY_MAX_JOBS> jobPool = {};
+    std::atomic<u32> numJobsDone = 0;
+    std::atomic<bool> running = true;
+};
+
+static f64 BenchmarkLegacyJobQueue(u32 numWorkers, u32 numRootJobs, u32 numChildJobs)
+{
+    LegacyJobQueueBench* bench = new LegacyJobQueueBench();
+    std::vector<std::thread> workers;
+    for (u32 i = 0; i < numWorkers; i++)
+    {
+        workers.emplace_back([bench](){
+            LegacyJob job;
+            while (bench->running) {
+                if (bench->jobPool.pop_front(job)) {
+                    job.func();
+                }
+            }
+        });
+    }
+    u32 totalJobs = numRootJobs + (numRootJobs * numChildJobs);
+    auto start = std::chrono::high_resolution_clock::now();
+    for (u32 i = 0; i < numRootJobs; i++)
+    {
+        LegacyJob root;
+        root.id = i;
+        root.func = [bench, numChildJobs]() {
+            for (u32 c = 0; c < numChildJobs; c++)
+            {
+                LegacyJob child;
+                child.id = c;
+                child.func = [bench]() { bench->numJobsDone++; };
+                while (!bench->jobPool.push_back(child))
+                {
+                    // queue is full, run something ourselves so we can't deadlock with 1 worker
+                    LegacyJob other;
+                    if (bench->jobPool.pop_front(other)) other.func();
+                }
+            }
+            bench->numJobsDone++;
+        };
+        while (!bench->jobPool.push_back(root)) { std::this_thread::yield(); }
+    }
+    while (bench->numJobsDone.load() < totalJobs) { std::this_thread::yield(); }
+    auto end = std::chrono::high_resolution_clock::now();
+    bench->running = false;
+    for (std::thread& worker : workers) worker.join();
+    delete bench;
+    f64 seconds = std::chrono::duration<f64>(end - start).count();
+    return (f64)totalJobs / seconds;
+}
+
+static f64 BenchmarkWorkStealingJobSystem(u32 numWorkers, u32 numRootJobs, u32 numChildJobs)
+{
+    // heap allocated, the job pool is too big for the stack
+    JobSystem* js = new JobSystem();
+    js->Initialize({ .numWorkerThreads = numWorkers });
+    std::atomic<u32> numJobsDone = 0;
+    u32 totalJobs = numRootJobs + (numRootJobs * numChildJobs);
+    auto start = std::chrono::high_resolution_clock::now();
+    for (u32 i = 0; i < numRootJobs; i++)
+    {
+        js->Execute([js, &numJobsDone, numChildJobs]() {
+            for (u32 c = 0; c < numChildJobs; c++)
+            {
+                js->Execute([&numJobsDone]() { numJobsDone++; });
             }
+            numJobsDone++;
+        });
+    }
+    while (numJobsDone.load() < totalJobs) { std::this_thread::yield(); }
+    auto end = std::chrono::high_resolution_clock::now();
+    js->Shutdown();
+    delete js;
+    f64 seconds = std::chrono::duration<f64>(end - start).count();
+    return (f64)totalJobs / seconds;
+}
+
+// synthetic workloads for the parallel loop helpers vs the same loop on one thread
+static void BenchmarkParallelLoops(u32 numWorkers)
+{
+    JobSystem* js = new JobSystem();
+    js->Initialize({ .numWorkerThreads = numWorkers });
+    constexpr u32 count = 1 << 22;
+    constexpr u32 numRuns = 5;
+    f32* values = (f32*)TSYSALLOC(sizeof(f32) * count);
+    f32* results = (f32*)TSYSALLOC(sizeof(f32) * count);
+    u32* ints = (u32*)TSYSALLOC(sizeof(u32) * count);
+    u32* scanned = (u32*)TSYSALLOC(sizeof(u32) * count);
+    for (u32 i = 0; i < count; i++)
+    {
+        values[i] = (f32)(i % 1000) * 0.01f;
+        ints[i] = i % 7;
+    }
+    auto timeMs = [](auto&& fn) {
+        auto start = std::chrono::high_resolution_clock::now();
+        for (u32 run = 0; run < numRuns; run++) fn();
+        auto end = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration<f64, std::milli>(end - start).count() / numRuns;
+    };
+    auto transform = [values, results](u32 i) {
+        f32 v = values[i];
+        results[i] = sqrtf(v) * sinf(v) + cosf(v * 0.5f);
+    };
+
+    f64 serialFor = timeMs([&]() { for (u32 i = 0; i < count; i++) transform(i); });
+    f64 parallelFor = timeMs([&]() { js->ParallelFor(0, count, 0, transform); });
+
+    volatile u64 sink = 0;
+    f64 serialReduce = timeMs([&]() {
+        u64 sum = 0;
+        for (u32 i = 0; i < count; i++) sum += ints[i];
+        sink = sum;
+    });
+    f64 parallelReduce = timeMs([&]() {
+        sink = js->ParallelReduce<u64>(0, count, 0, 0,
+            [ints](u32 i) { return (u64)ints[i]; },
+            [](u64 a, u64 b) { return a + b; });
+    });
+
+    f64 serialScan = timeMs([&]() {
+        u32 sum = 0;
+        for (u32 i = 0; i < count; i++) { sum += ints[i]; scanned[i] = sum; }
+    });
+    f64 parallelScan = timeMs([&]() {
+        js->ParallelScan<u32>(ints, scanned, count, 0, 0, [](u32 a, u32 b) { return a + b; });
+    });
+
+    LOG_INFO("[JOBS] %2u workers | for: %7.2fms -> %7.2fms (%.2fx) | reduce: %7.2fms -> %7.2fms (%.2fx) | scan: %7.2fms -> %7.2fms (%.2fx)",
+        numWorkers,
+        serialFor, parallelFor, serialFor / parallelFor,
+        serialReduce, parallelReduce, serialReduce / parallelReduce,
+        serialScan, parallelScan, serialScan / parallelScan);
+
+    TSYSFREE(values);
+    TSYSFREE(results);
+    TSYSFREE(ints);
+    TSYSFREE(scanned);
+    js->Shutdown();
+    delete js;
+}
+
+// heap allocations per submitted job, the old std::function path vs inline JobFuncs
+static void BenchmarkJobAllocations()
+{
+#ifdef JOB_SYSTEM_COUNT_ALLOCATIONS
+    constexpr u32 numJobs = 10000;
+    // about what LoadTextureAsync used to capture (path, props, callback)
+    struct BigCapture { u8 bytes[128]; };
+    BigCapture big = {};
+    std::atomic<u32> sink = 0;
+    auto smallJob = [&sink]() { sink++; };
+    auto bigJob = [&sink, big]() { sink += big.bytes[0] + 1; };
+
+    auto allocsPerJob = [](auto&& submitAll) {
+        u64 before = numHeapAllocations.load();
+        submitAll();
+        return (f64)(numHeapAllocations.load() - before) / (f64)numJobs;
+    };
+    // the old Execute(const std::function<void()>&) built a std::function at the call site and copied it into the queue
+    auto legacySubmit = [](const std::function<void()>& fn, LegacyJob& slot) { slot.func = fn; slot.func(); slot.func = nullptr; };
+    LegacyJob legacySlot;
+    f64 legacySmall = allocsPerJob([&]() { for (u32 i = 0; i < numJobs; i++) legacySubmit(smallJob, legacySlot); });
+    f64 legacyBig = allocsPerJob([&]() { for (u32 i = 0; i < numJobs; i++) legacySubmit(bigJob, legacySlot); });
+
+    JobSystem* js = new JobSystem();
+    js->Initialize({ .numWorkerThreads = 1 });
+    JobCounter counter;
+    f64 inlineSmall = allocsPerJob([&]() {
+        for (u32 i = 0; i < numJobs; i++) js->Execute(smallJob, &counter);
+        js->Wait(&counter);
+    });
+    f64 frameBig = allocsPerJob([&]() {
+        for (u32 i = 0; i < numJobs; i++)
+        {
+            js->Execute(js->FrameJob(bigJob), &counter);
+            if (i % 1000 == 999)
+            {
+                // pretend frames are passing so the frame arenas get recycled
+                js->Wait(&counter);
+                js->FlushMainThreadJobs();
+            }
+        }
+        js->Wait(&counter);
+    });
+    js->Shutdown();
+    delete js;
+    LOG_INFO("[JOBS] heap allocations per job | std::function: %.2f (small capture) %.2f (%u byte capture) | JobFunc: %.2f (inline) %.2f (FrameJob)",
+        legacySmall, legacyBig, (u32)sizeof(BigCapture), inlineSmall, frameBig);
+#else
+    LOG_INFO("[JOBS] define JOB_SYSTEM_COUNT_ALLOCATIONS in job_system.cpp to measure heap allocations per job");
+#endif
+}
+
+void JobSystemBenchmarks()
+{
+    LOG_INFO("Running JobSystem benchmarks...");
+    BenchmarkJobAllocations();
+    constexpr u32 numRootJobs = 64;
+    constexpr u32 numChildJobs = 1000;
+    const u32 workerCounts[] = {1, 2, 4, 8, 16};
+    for (u32 i = 0; i < ARRAY_SIZE(workerCounts); i++)
+    {
+        u32 numWorkers = workerCounts[i];
+        f64 legacyJobsPerSec = BenchmarkLegacyJobQueue(numWorkers, numRootJobs, numChildJobs);
+        f64 stealingJobsPerSec = BenchmarkWorkStealingJobSystem(numWorkers, numRootJobs, numChildJobs);
+        LOG_INFO("[JOBS] %2u workers | mutex queue: %12.0f jobs/s | work stealing: %12.0f jobs/s | %.2fx",
+            numWorkers, legacyJobsPerSec, stealingJobsPerSec, stealingJobsPerSec / legacyJobsPerSec);
+    }
+    LOG_INFO("[JOBS] parallel loops over %u elements (serial -> parallel)", 1 << 22);
+    for (u32 i = 0; i < ARRAY_SIZE(workerCounts); i++)
+    {
+        BenchmarkParallelLoops(workerCounts[i]);
+    }
+    LOG_INFO("JobSystem benchmarks complete");
+}
+
+
+// ================= Tests =================
+
+static void JobCounterTests(JobSystem* js)
+{
+    // fan out / fan in
+    {
+        JobCounter counter;
+        std::atomic<u32> sum = 0;
+        for (u32 i = 0; i < 1000; i++)
+        {
+            js->Execute([&sum, i]() { sum += i; }, &counter);
         }
+        js->Wait(&counter);
+        TINY_ASSERT(counter.IsDone());
+        TINY_ASSERT(sum.load() == (999 * 1000) / 2);
     }
+    // waiting from inside jobs
+    {
+        JobCounter parents;
+        std::atomic<u32> numChildrenDone = 0;
+        for (u32 i = 0; i < 64; i++)
+        {
+            js->Execute([js, &numChildrenDone]() {
+                JobCounter children;
+                std::atomic<u32> localDone = 0;
+                for (u32 c = 0; c < 64; c++)
+                {
+                    js->Execute([&localDone]() { localDone++; }, &children);
+                }
+                js->Wait(&children);
+                TINY_ASSERT(localDone.load() == 64);
+                numChildrenDone += localDone.load();
+            }, &parents);
+        }
+        js->Wait(&parents);
+        TINY_ASSERT(numChildrenDone.load() == 64 * 64);
+    }
+    // diamond: A -> B0..B7 -> C
+    {
+        JobCounter aDone, bDone, cDone;
+        std::atomic<u32> state = 0;
+        js->Execute([&state]() { TINY_ASSERT(state.load() == 0); state++; }, &aDone);
+        for (u32 i = 0; i < 8; i++)
+        {
+            js->ExecuteAfter(&aDone, [&state]() { TINY_ASSERT(state.load() >= 1); state++; }, &bDone);
+        }
+        js->ExecuteAfter(&bDone, [&state]() { TINY_ASSERT(state.load() == 9); state++; }, &cDone);
+        js->Wait(&cDone);
+        TINY_ASSERT(state.load() == 10);
+    }
+}
+
+// numChains independent chains of numStages jobs. Every stage must see the previous stage of its chain
+// done, and a final job waits on the last stage of every chain
+static void JobDependencyFloodTest(JobSystem* js, u32 numChains, u32 numStages)
+{
+    u32 numJobs = numChains * numStages;
+    JobCounter* stageCounters = new JobCounter[numJobs];
+    u32* completionOrder = (u32*)TSYSALLOC(sizeof(u32) * numJobs);
+    std::atomic<u32>* chainProgress = new std::atomic<u32>[numChains];
+    for (u32 i = 0; i < numChains; i++) chainProgress[i] = 0;
+    std::atomic<u32> nextOrder = 0;
+    JobCounter allChainsDone, finalDone;
+    u32 finalOrder = U32_INVALID_ID;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (u32 chain = 0; chain < numChains; chain++)
+    {
+        for (u32 stage = 0; stage < numStages; stage++)
+        {
+            u32 jobIdx = chain * numStages + stage;
+            JobCounter* dependency = stage > 0 ? &stageCounters[jobIdx - 1] : nullptr;
+            // the last stage of every chain feeds the fan-in counter instead of its own
+            JobCounter* signal = stage == numStages - 1 ? &allChainsDone : &stageCounters[jobIdx];
+            js->ExecuteAfter(dependency, [=, &nextOrder]() {
+                TINY_ASSERT(chainProgress[chain].load() == stage);
+                completionOrder[jobIdx] = nextOrder++;
+                chainProgress[chain].store(stage + 1);
+            }, signal);
+        }
+    }
+    js->ExecuteAfter(&allChainsDone, [&]() {
+        for (u32 chain = 0; chain < numChains; chain++)
+        {
+            TINY_ASSERT(chainProgress[chain].load() == numStages);
+        }
+        finalOrder = nextOrder++;
+    }, &finalDone);
+    js->Wait(&finalDone);
+    auto end = std::chrono::high_resolution_clock::now();
+
+    TINY_ASSERT(nextOrder.load() == numJobs + 1);
+    TINY_ASSERT(finalOrder == numJobs);
+    for (u32 chain = 0; chain < numChains; chain++)
+    {
+        for (u32 stage = 1; stage < numStages; stage++)
+        {
+            u32 jobIdx = chain * numStages + stage;
+            TINY_ASSERT(completionOrder[jobIdx - 1] < completionOrder[jobIdx]);
+        }
+    }
+    for (u32 i = 0; i < numJobs; i++)
+    {
+        TINY_ASSERT(stageCounters[i].IsDone());
+    }
+    f64 ms = std::chrono::duration<f64, std::milli>(end - start).count();
+    LOG_INFO("[JOBS] %u workers | %u dependent jobs (%u chains x %u stages) in %.2fms",
+        js->GetNumWorkerThreads(), numJobs, numChains, numStages, ms);
+
+    delete[] stageCounters;
+    delete[] chainProgress;
+    TSYSFREE(completionOrder);
+}
+
+static void ParallelLoopTests(JobSystem* js)
+{
+    constexpr u32 count = 100003; // odd on purpose, chunks won't divide evenly
+    // every index visited exactly once
+    std::atomic<u32>* visits = new std::atomic<u32>[count];
+    for (u32 i = 0; i < count; i++) visits[i] = 0;
+    const u32 grainSizes[] = {0, 1, 7, 1000, count, count * 2};
+    for (u32 g = 0; g < ARRAY_SIZE(grainSizes); g++)
+    {
+        js->ParallelFor(0, count, grainSizes[g], [visits](u32 i) { visits[i]++; });
+    }
+    for (u32 i = 0; i < count; i++)
+    {
+        TINY_ASSERT(visits[i].load() == ARRAY_SIZE(grainSizes));
+    }
+    delete[] visits;
+    // empty/offset ranges
+    std::atomic<u32> calls = 0;
+    js->ParallelFor(10, 10, 0, [&calls](u32 i) { calls++; });
+    js->ParallelFor(20, 10, 0, [&calls](u32 i) { calls++; });
+    TINY_ASSERT(calls.load() == 0);
+    js->ParallelFor(10, 20, 3, [&calls](u32 i) { TINY_ASSERT(i >= 10 && i < 20); calls++; });
+    TINY_ASSERT(calls.load() == 10);
+
+    // reduce matches a plain loop
+    u64 expectedSum = 0;
+    for (u32 i = 0; i < count; i++) expectedSum += i;
+    for (u32 g = 0; g < ARRAY_SIZE(grainSizes); g++)
+    {
+        u64 sum = js->ParallelReduce<u64>(0, count, grainSizes[g], 0,
+            [](u32 i) { return (u64)i; },
+            [](u64 a, u64 b) { return a + b; });
+        TINY_ASSERT(sum == expectedSum);
+    }
+    u32 maxVal = js->ParallelReduce<u32>(0, count, 0, 0,
+        [](u32 i) { return (i * 7919u) % 100000u; },
+        [](u32 a, u32 b) { return a > b ? a : b; });
+    TINY_ASSERT(maxVal == 99999);
+
+    // scan matches a plain loop, including in place
+    u32* input = (u32*)TSYSALLOC(sizeof(u32) * count);
+    u32* output = (u32*)TSYSALLOC(sizeof(u32) * count);
+    for (u32 i = 0; i < count; i++) input[i] = i % 13;
+    for (u32 g = 0; g < ARRAY_SIZE(grainSizes); g++)
+    {
+        js->ParallelScan<u32>(input, output, count, grainSizes[g], 0, [](u32 a, u32 b) { return a + b; });
+        u32 expected = 0;
+        for (u32 i = 0; i < count; i++)
+        {
+            expected += input[i];
+            TINY_ASSERT(output[i] == expected);
+        }
+    }
+    js->ParallelScan<u32>(input, input, count, 0, 0, [](u32 a, u32 b) { return a + b; });
+    TINY_ASSERT(input[count-1] == output[count-1]);
+    TSYSFREE(input);
+    TSYSFREE(output);
+}
+
+static void MainThreadJobTests(JobSystem* js)
+{
+    // jobs queued by a main thread job roll over into the next flush instead of deadlocking
+    u32 ranFirst = 0, ranSecond = 0;
+    js->ExecuteOnMainThread([js, &ranFirst, &ranSecond]() {
+        ranFirst++;
+        js->ExecuteOnMainThread([&ranSecond]() { ranSecond++; });
+    });
+    js->FlushMainThreadJobs();
+    TINY_ASSERT(ranFirst == 1 && ranSecond == 0);
+    js->FlushMainThreadJobs();
+    TINY_ASSERT(ranFirst == 1 && ranSecond == 1);
+
+    // higher priorities run first, queued from a worker thread too
+    std::vector<u32> order;
+    JobCounter counter;
+    js->ExecuteOnMainThread([&order]() { order.push_back(3); }, MainThreadJobPriority::LOW);
+    js->ExecuteOnMainThread([&order]() { order.push_back(2); }, MainThreadJobPriority::NORMAL);
+    js->Execute([js, &order]() {
+        js->ExecuteOnMainThread([&order]() { order.push_back(0); }, MainThreadJobPriority::CRITICAL);
+    }, &counter);
+    js->ExecuteOnMainThread([&order]() { order.push_back(1); }, MainThreadJobPriority::HIGH);
+    js->Wait(&counter);
+    js->FlushMainThreadJobs();
+    TINY_ASSERT(order.size() == 4);
+    for (u32 i = 0; i < order.size(); i++) TINY_ASSERT(order[i] == i);
+
+    // budget: slow jobs get spread over several flushes, critical ones don't
+    f32 oldBudget = js->GetMainThreadBudget();
+    js->SetMainThreadBudget(1.0f);
+    auto busyWaitMs = [](f64 ms) {
+        auto start = std::chrono::steady_clock::now();
+        while (std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count() < ms) {}
+    };
+    constexpr u32 numSlowJobs = 20;
+    u32 numSlowRan = 0, numCriticalRan = 0;
+    for (u32 i = 0; i < numSlowJobs; i++)
+    {
+        js->ExecuteOnMainThread([&numSlowRan, busyWaitMs]() { busyWaitMs(0.4); numSlowRan++; }, MainThreadJobPriority::LOW);
+        js->ExecuteOnMainThread([&numCriticalRan, busyWaitMs]() { busyWaitMs(0.1); numCriticalRan++; }, MainThreadJobPriority::CRITICAL);
+    }
+    js->FlushMainThreadJobs();
+    TINY_ASSERT(numCriticalRan == numSlowJobs);
+    TINY_ASSERT(numSlowRan >= 1 && numSlowRan < numSlowJobs);
+    TINY_ASSERT(js->GetNumDeferredMainThreadJobs() == numSlowJobs - numSlowRan);
+    u32 numFlushes = 1;
+    while (js->GetNumDeferredMainThreadJobs() > 0)
+    {
+        u32 before = numSlowRan;
+        js->FlushMainThreadJobs();
+        TINY_ASSERT(numSlowRan > before); // always makes progress
+        numFlushes++;
+    }
+    TINY_ASSERT(numSlowRan == numSlowJobs);
+    LOG_INFO("[JOBS] %u slow main thread jobs spread over %u flushes with a 1ms budget", numSlowJobs, numFlushes);
+    js->SetMainThreadBudget(oldBudget);
+
+    // more jobs than the queue holds go to the overflow list instead of being dropped
+    u32 numBurstRan = 0;
+    for (u32 i = 0; i < MAX_MAIN_THREAD_JOBS + 100; i++)
+    {
+        js->ExecuteOnMainThread([&numBurstRan]() { numBurstRan++; }, MainThreadJobPriority::CRITICAL);
+    }
+    js->FlushMainThreadJobs();
+    TINY_ASSERT(numBurstRan == MAX_MAIN_THREAD_JOBS + 100);
 }
 
+static void JobFuncTests(JobSystem* js)
+{
+    // captures are moved, never copied, and destroyed exactly once
+    struct Tracker {
+        std::atomic<u32>* destroyed = nullptr;
+        Tracker(std::atomic<u32>* destroyed) : destroyed(destroyed) {}
+        Tracker(Tracker&& other) : destroyed(other.destroyed) { other.destroyed = nullptr; }
+        Tracker(const Tracker&) = delete;
+        ~Tracker() { if (destroyed) (*destroyed)++; }
+    };
+    std::atomic<u32> destroyed = 0;
+    u32 calls = 0;
+    {
+        JobFunc a = [t = Tracker(&destroyed), &calls]() { calls++; };
+        JobFunc b = std::move(a);
+        TINY_ASSERT(!a && b);
+        b();
+        a = std::move(b);
+        a();
+        TINY_ASSERT(calls == 2 && destroyed == 0);
+        a = nullptr;
+        TINY_ASSERT(!a && destroyed == 1);
+    }
+    TINY_ASSERT(destroyed == 1);
+
+    // through the job system, including captures bigger than JOB_INLINE_CAPTURE_SIZE via FrameJob
+    struct BigCapture { u32 values[64]; };
+    BigCapture big = {};
+    for (u32 i = 0; i < ARRAY_SIZE(big.values); i++) big.values[i] = i;
+    std::atomic<u32> sum = 0;
+    JobCounter counter;
+    js->Execute([t = Tracker(&destroyed), &sum]() { sum += 1; }, &counter);
+    for (u32 i = 0; i < 100; i++)
+    {
+        js->Execute(js->FrameJob([big, t = Tracker(&destroyed), &sum]() { sum += big.values[63]; }), &counter);
+    }
+    js->Wait(&counter);
+    TINY_ASSERT(sum.load() == 1 + 100 * 63);
+    // job slots release their captures before signalling the counter
+    TINY_ASSERT(destroyed == 1 + 101);
+    // frame arenas get recycled as frames go by
+    js->FlushMainThreadJobs();
+    js->FlushMainThreadJobs();
+}
+
+static void ScratchArenaJobTests(JobSystem* js)
+{
+    // jobs get per-thread scratch without any locking. A job that waits helps with other jobs on the same thread,
+    // those nest their scratch scopes on top of the waiting job's and end them before it resumes
+    constexpr u32 numParents = 64;
+    constexpr u32 numChildren = 16;
+    constexpr u32 scratchCount = 256;
+    std::atomic<u32> numIntact = 0;
+    JobCounter parents;
+    for (u32 p = 0; p < numParents; p++)
+    {
+        js->Execute([js, p, &numIntact]() {
+            ArenaTemp scratch = scratch_begin();
+            u32* mine = arena_alloc_type(scratch.arena, u32, scratchCount);
+            for (u32 i = 0; i < scratchCount; i++) mine[i] = p;
+            JobCounter children;
+            for (u32 c = 0; c < numChildren; c++)
+            {
+                js->Execute([]() {
+                    ArenaTemp childScratch = scratch_begin();
+                    u32* theirs = arena_alloc_type(childScratch.arena, u32, scratchCount);
+                    for (u32 i = 0; i < scratchCount; i++) theirs[i] = 0xDEADBEEF;
+                    scratch_end(childScratch);
+                }, &children);
+            }
+            js->Wait(&children);
+            bool intact = true;
+            for (u32 i = 0; i < scratchCount; i++) intact &= mine[i] == p;
+            scratch_end(scratch);
+            if (intact) numIntact++;
+        }, &parents);
+    }
+    js->Wait(&parents);
+    TINY_ASSERT(numIntact.load() == numParents);
+}
+
+// jobs that are already running when Shutdown starts can still spawn children and release continuations.
+// Shutdown has to run all of them, not just what was queued when it was called
+static void ShutdownDrainTest(u32 numWorkers)
+{
+    constexpr u32 numChildren = 256;
+    JobSystem* js = new JobSystem();
+    js->Initialize({ .numWorkerThreads = numWorkers });
+    std::atomic<bool> rootStarted = false;
+    std::atomic<u32> numChildrenRan = 0;
+    std::atomic<u32> numContinuationsRan = 0;
+    JobCounter children;
+    js->Execute([js, &rootStarted, &numChildrenRan, &numContinuationsRan, &children]() {
+        rootStarted = true;
+        // give Shutdown time to see the queues empty
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        for (u32 i = 0; i < numChildren; i++)
+        {
+            js->Execute([&numChildrenRan]() { numChildrenRan++; }, &children);
+        }
+        js->ExecuteAfter(&children, [&numContinuationsRan]() { numContinuationsRan++; });
+    });
+    while (!rootStarted.load()) { std::this_thread::yield(); }
+    js->Shutdown();
+    TINY_ASSERT(numChildrenRan.load() == numChildren);
+    TINY_ASSERT(numContinuationsRan.load() == 1);
+    TINY_ASSERT(children.IsDone());
+    delete js;
+}
+
+void JobSystemTests()
+{
+    LOG_INFO("Running JobSystem tests...");
+    const u32 workerCounts[] = {1, 4};
+    for (u32 i = 0; i < ARRAY_SIZE(workerCounts); i++)
+    {
+        JobSystem* js = new JobSystem();
+        js->Initialize({ .numWorkerThreads = workerCounts[i] });
+        JobFuncTests(js);
+        MainThreadJobTests(js);
+        JobCounterTests(js);
+        JobDependencyFloodTest(js, 1000, 100);
+        ParallelLoopTests(js);
+        ScratchArenaJobTests(js);
+        js->Shutdown();
+        delete js;
+        ShutdownDrainTest(workerCounts[i]);
+    }
+    LOG_INFO("JobSystem tests passed");
+}
@@ -4,39 +4,336 @@
 //#include "pch.h"
 #include "tiny_defines.h"
 #include "containers/mutex_queue.h"
+#include "containers/mpmc_queue.h"
+#include "containers/work_stealing_deque.h"
+#include "containers/inline_function.h"
 #include <functional>
 #include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+struct JobCounter;
+
+// captures up to this size are stored inside the job itself, so submitting a job never allocates.
+// Bigger captures fail to compile - capture pointers instead, or use JobSystem::FrameJob
+#define JOB_INLINE_CAPTURE_SIZE 64
+typedef InlineFunction<JOB_INLINE_CAPTURE_SIZE> JobFunc;
+
+// queue type for jobs submitted from outside the workers and for main thread jobs.
+// MutexQueue and MPMCQueue have the same surface, swap this to compare them
+template <typename T, size_t _capacity>
+using JobQueue = MPMCQueue<T, _capacity>;
 
 struct Job {
-    std::function<void()> func;
+    JobFunc func;
     u32 id;
+    JobCounter* counter = nullptr; // decremented when this job finishes
+    Job* nextWaiting = nullptr; // intrusive list of jobs waiting on a counter
+};
+
+// Counts unfinished jobs. Every job executed with a counter bumps it on submission and decrements it when done,
+// so fan-out/fan-in is just "give all the jobs the same counter and Wait on it".
+// Jobs can also be made to wait on a counter (ExecuteAfter), which is how dependency chains are expressed:
+//      JobCounter animDone, transformsDone;
+//      for (...) js.Execute(animJob, &animDone);
+//      js.ExecuteAfter(&animDone, transformJob, &transformsDone);
+//      js.Wait(&transformsDone);
+// Counters are owned by the user and must outlive every job that signals/waits on them (Wait before destroying).
+struct JobCounter {
+    std::atomic<u32> pending = 0;
+    inline bool IsDone() const { return pending.load(std::memory_order_acquire) == 0; }
+
+    // managed by the JobSystem
+    // guards the transition to 0 and the waiting list, so a continuation can't be added after the list was flushed
+    std::atomic<bool> locked = false;
+    Job* waitingJobs = nullptr;
+};
+
+// Main thread jobs are run in priority order by FlushMainThreadJobs, until the frame's time budget is used up.
+// Whatever doesn't fit carries over to the next frame (ahead of newer jobs of the same priority)
+enum class MainThreadJobPriority : u8 {
+    CRITICAL = 0, // always runs in the next flush, ignores the time budget
+    HIGH,
+    NORMAL,
+    LOW, // things like gpu uploads of assets that can pop in a few frames late
+
+    NUM_PRIORITIES
+};
+
+struct MainThreadJob {
+    JobFunc func;
+    MainThreadJobPriority priority = MainThreadJobPriority::NORMAL;
+};
+
+// Work stealing job system
+// every worker thread owns a Chase-Lev deque. Jobs spawned from a worker go onto that worker's deque,
+// jobs spawned from any other thread (main thread) go onto a shared injection queue.
+// Idle workers steal from the top of a random victim's deque.
+// Workers that can't find anything to do spin for a little while, then go to sleep until a job is submitted.
+
+struct JobSystemConfig {
+    // explicit number of worker threads. 0 = derive it from the number of cores
+    u32 numWorkerThreads = 0;
+    // when deriving the worker count, use all cores minus this many (main thread, driver threads, etc)
+    u32 reservedCores = 1;
+    // upper bound on the derived worker count. 0 = no limit
+    u32 maxWorkerThreads = 0;
+    // number of times an idle worker looks for work (yielding in between) before going to sleep
+    u32 idleSpinCount = 64;
+    // size of each of the two per-frame arenas that hold captures too big to store inline (see FrameJob)
+    size_t frameArenaSize = MEGABYTES_BYTES(1);
+    // how long FlushMainThreadJobs may spend on non-critical jobs each frame
+    f32 mainThreadBudgetMs = 2.0f;
 };
 
 struct JobSystem {
 
-    TAPI void Initialize();
-    TAPI void Shutdown() { numThreads = 0; }
-    TAPI u32 Execute(const std::function<void()>& job);
-    TAPI void ExecuteOnMainThread(const std::function<void()>& job);
+    TAPI void Initialize(const JobSystemConfig& config = {});
+    // finishes every submitted job (and whatever those spawn), then wakes and joins all worker threads
+    TAPI void Shutdown();
+    // counter (optional) is incremented now and decremented when the job finishes
+    // jobs that need temporary memory can use scratch_begin/scratch_end (mem/tiny_arena.h), every worker has its own scratch arenas
+    TAPI u32 Execute(JobFunc&& job, JobCounter* counter = nullptr);
+    // same as Execute, but the job isn't started until dependency reaches 0.
+    // A waiting job holds one of the 4096 (MAX_JOBS) job slots until then. Build graphs producers first, or Wait on part
+    // of a graph before adding more - once every slot is held by waiting jobs nothing can run. That asserts, and the job is
+    // dropped (U32_INVALID_ID is returned, same for Execute)
+    TAPI u32 ExecuteAfter(JobCounter* dependency, JobFunc&& job, JobCounter* counter = nullptr);
+    // job runs on the main thread during a later FlushMainThreadJobs. Can be called from any thread, including main thread jobs
+    TAPI void ExecuteOnMainThread(JobFunc&& job, MainThreadJobPriority priority = MainThreadJobPriority::NORMAL);
     TAPI void WaitOnJob(u32 id);
+    // blocks until the counter reaches 0, running other jobs in the meantime. Safe to call from inside a job
+    TAPI void Wait(JobCounter* counter);
+
+    // Parallel loops. The range is split in half recursively, handing the upper half off as a job each time,
+    // until pieces are <= grainSize. Idle workers steal the biggest pieces first, so the split adapts to however
+    // many workers are actually free. The calling thread works on the range too and returns once all of it is done.
+    // grainSize = 0 picks one based on the range and the number of workers.
+    // fn(rangeBegin, rangeEnd) is called on chunks - use this one if there's per-chunk setup
+    TAPI void ParallelForRange(u32 begin, u32 end, u32 grainSize, const std::function<void(u32, u32)>& fn);
+    // fn(i) is called for every i in [begin, end)
+    template <typename Func>
+    void ParallelFor(u32 begin, u32 end, u32 grainSize, Func&& fn);
+    // reduce(reduce(identity, map(begin)), map(begin+1))... Chunks are combined in order, so reduce only needs
+    // to be associative. Results are deterministic for a given grainSize
+    template <typename T, typename MapFunc, typename ReduceFunc>
+    T ParallelReduce(u32 begin, u32 end, u32 grainSize, T identity, MapFunc&& map, ReduceFunc&& reduce);
+    // inclusive scan: output[i] = op(input[0], ..., input[i]). input and output may be the same array
+    template <typename T, typename Op>
+    void ParallelScan(const T* input, T* output, u32 count, u32 grainSize, T identity, Op&& op);
 
     static JobSystem& Instance() {
         static JobSystem js;
         return js;
     }
 
-    // called from engine main loop at the end of a frame
+    // called from engine main loop at the end of a frame.
+    // Runs jobs that were queued before the flush started - anything they queue waits for the next flush
     void FlushMainThreadJobs();
+    inline void SetMainThreadBudget(f32 budgetMs) { config.mainThreadBudgetMs = budgetMs; }
+    inline f32 GetMainThreadBudget() const { return config.mainThreadBudgetMs; }
+    // main thread jobs that have been carried over to the next flush. Main thread only
+    TAPI u32 GetNumDeferredMainThreadJobs() const;
+
+    // Wraps a callable whose captures are too big for JOB_INLINE_CAPTURE_SIZE. The callable is moved into a per-frame arena
+    // (falls back to the heap if that's full). The arenas are double buffered, so the job has to be done by the end
+    // of the next frame - don't use this for long running things like asset loading.
+    // Call from the main thread:   js.Execute(js.FrameJob([bigCapture]() { ... }));
+    template <typename Func>
+    JobFunc FrameJob(Func&& fn);
+
+    inline u32 GetNumWorkerThreads() const { return numThreads; }
 
 private:
 
-    #define MAX_JOBS 256
-    MutexQueue<Job, MAX_JOBS> jobPool = {};
-    MutexQueue<Job, MAX_JOBS> mainThreadJobPool = {};
-    u32 currentJobID = 0; // provides unique identifier for every job
-    std::vector<std::vector<u32>> inProgressJobs = {};
-    u32 numThreads = 1;
+    // job ids are (slot generation << JOB_SLOT_BITS) | slot index, so waiting on an id is a single slot lookup
+    // MAX_JOBS is the max number of jobs that can be in flight at once
+    #define JOB_SLOT_BITS 12
+    #define MAX_JOBS (1u << JOB_SLOT_BITS)
+    #define MAX_MAIN_THREAD_JOBS 1024
+    struct JobSlot {
+        Job job = {};
+        // id of the job currently living in this slot. U32_INVALID_ID when the slot is free
+        std::atomic<u32> occupantID = U32_INVALID_ID;
+        u32 generation = 0;
+    };
+    typedef WorkStealingDeque<Job*, MAX_JOBS> WorkerQueue;
+
+    // null if the pool is deadlocked (see ExecuteAfter)
+    Job* AllocateJob(JobFunc&& func, JobCounter* counter);
+    void SubmitJob(Job* job);
+    bool TryGetJob(Job*& job);
+    void RunJob(Job* job);
+    void WorkerThreadMain(u32 threadIdx);
+    void WaitForWork();
+    void WakeWorker();
+    bool HelpWithJob();
+    void SplitRange(u32 begin, u32 end, u32 grainSize, const std::function<void(u32, u32)>* fn, JobCounter* counter);
+    u32 DefaultGrainSize(u32 count) const;
+    void* FrameArenaAlloc(size_t size, size_t alignment, std::atomic<u32>** liveAllocations);
+    void AdvanceFrameArena();
+    void SignalCounter(JobCounter* counter);
+    s32 GetCurrentWorkerIndex() const;
+
+    JobSlot jobSlots[MAX_JOBS] = {};
+    WorkerQueue* workerQueues = nullptr; // one per worker thread
+    JobQueue<Job*, MAX_JOBS> jobPool = {}; // jobs submitted from non-worker threads
+    // double buffered - other threads push to mainThreadQueues[mainThreadWriteQueue] while the flush drains the other one
+    JobQueue<MainThreadJob, MAX_MAIN_THREAD_JOBS> mainThreadQueues[2] = {};
+    std::atomic<u32> mainThreadWriteQueue = 0;
+    // only used if a queue fills up, so a burst of main thread jobs is never dropped
+    std::mutex mainThreadOverflowLock;
+    std::vector<MainThreadJob> mainThreadOverflow = {};
+    // main thread only. Jobs waiting for their turn, per priority. backlogHead is the first job that hasn't run
+    std::vector<JobFunc> mainThreadBacklog[(u32)MainThreadJobPriority::NUM_PRIORITIES] = {};
+    u32 mainThreadBacklogHead[(u32)MainThreadJobPriority::NUM_PRIORITIES] = {};
+    std::atomic<u32> nextJobSlot = 0; // where to start looking for a free slot
+    std::vector<std::thread> workers = {};
+    std::atomic<bool> running = false;
+    u32 numThreads = 0;
+    JobSystemConfig config = {};
+
+    // sleeping/waking idle workers
+    std::mutex sleepLock;
+    std::condition_variable wakeCondition;
+    std::atomic<u32> numSleepingWorkers = 0;
+    // jobs that have been submitted but not picked up yet. Can briefly dip below 0 since a job may be
+    // popped before the submitter gets to increment this
+    std::atomic<s32> numQueuedJobs = 0;
+    // jobs that have been allocated but haven't finished running, including continuations parked on a counter.
+    // Shutdown drains on this, since a running job can still spawn more work after the queues look empty
+    std::atomic<u32> numUnfinishedJobs = 0;
+    // slots that can't be freed until some other slot is - continuations parked on a counter, and jobs running on a thread
+    // that is stuck in AllocateJob. If these add up to every slot, the pool is deadlocked
+    std::atomic<u32> numParkedJobs = 0;
+    std::atomic<u32> numJobsBlockedOnAllocate = 0;
+
+    struct FrameArena {
+        u8* mem = nullptr;
+        size_t size = 0;
+        size_t offset = 0;
+        // FrameJob captures that haven't been destroyed yet. The arena is only reset once this hits 0
+        std::atomic<u32> liveAllocations = 0;
+    };
+    FrameArena frameArenas[2] = {};
+    u32 currentFrameArena = 0;
 };
 
+// runs a FrameJob capture living in the frame arena (or on the heap) and destroys it when the job is done with
+template <typename Func>
+struct FrameJobThunk {
+    Func* fn = nullptr;
+    std::atomic<u32>* liveAllocations = nullptr; // null when the capture fell back to the heap
+    FrameJobThunk(Func* fn, std::atomic<u32>* liveAllocations) : fn(fn), liveAllocations(liveAllocations) {}
+    FrameJobThunk(FrameJobThunk&& other) : fn(other.fn), liveAllocations(other.liveAllocations) { other.fn = nullptr; }
+    FrameJobThunk(const FrameJobThunk&) = delete;
+    ~FrameJobThunk() {
+        if (!fn) return;
+        fn->~Func();
+        if (liveAllocations) {
+            liveAllocations->fetch_sub(1, std::memory_order_release);
+        }
+        else {
+            TSYSFREE(fn);
+        }
+    }
+    void operator()() { (*fn)(); }
+};
+
+template <typename Func>
+JobFunc JobSystem::FrameJob(Func&& fn)
+{
+    typedef std::decay_t<Func> FuncType;
+    static_assert(alignof(FuncType) <= alignof(std::max_align_t), "FrameJob callable is over-aligned");
+    std::atomic<u32>* liveAllocations = nullptr;
+    void* mem = FrameArenaAlloc(sizeof(FuncType), alignof(FuncType), &liveAllocations);
+    FuncType* callable = new(mem) FuncType(std::forward<Func>(fn));
+    return JobFunc(FrameJobThunk<FuncType>(callable, liveAllocations));
+}
+
+template <typename Func>
+void JobSystem::ParallelFor(u32 begin, u32 end, u32 grainSize, Func&& fn)
+{
+    ParallelForRange(begin, end, grainSize, [&fn](u32 rangeBegin, u32 rangeEnd) {
+        for (u32 i = rangeBegin; i < rangeEnd; i++)
+        {
+            fn(i);
+        }
+    });
+}
+
+template <typename T, typename MapFunc, typename ReduceFunc>
+T JobSystem::ParallelReduce(u32 begin, u32 end, u32 grainSize, T identity, MapFunc&& map, ReduceFunc&& reduce)
+{
+    if (end <= begin) return identity;
+    // fixed chunks (rather than adaptive splits) so every chunk has a slot for its partial result
+    u32 count = end - begin;
+    if (grainSize == 0) grainSize = DefaultGrainSize(count);
+    u32 numChunks = (count + grainSize - 1) / grainSize;
+    std::vector<T> partials(numChunks, identity);
+    ParallelFor(0, numChunks, 1, [&](u32 chunk) {
+        u32 chunkBegin = begin + chunk * grainSize;
+        u32 chunkEnd = chunkBegin + grainSize < end ? chunkBegin + grainSize : end;
+        T partial = identity;
+        for (u32 i = chunkBegin; i < chunkEnd; i++)
+        {
+            partial = reduce(partial, map(i));
+        }
+        partials[chunk] = partial;
+    });
+    T result = identity;
+    for (u32 chunk = 0; chunk < numChunks; chunk++)
+    {
+        result = reduce(result, partials[chunk]);
+    }
+    return result;
+}
+
+template <typename T, typename Op>
+void JobSystem::ParallelScan(const T* input, T* output, u32 count, u32 grainSize, T identity, Op&& op)
+{
+    if (count == 0) return;
+    if (grainSize == 0) grainSize = DefaultGrainSize(count);
+    u32 numChunks = (count + grainSize - 1) / grainSize;
+    // 1. total of every chunk
+    std::vector<T> chunkOffsets(numChunks, identity);
+    ParallelFor(0, numChunks, 1, [&](u32 chunk) {
+        u32 chunkBegin = chunk * grainSize;
+        u32 chunkEnd = chunkBegin + grainSize < count ? chunkBegin + grainSize : count;
+        T sum = identity;
+        for (u32 i = chunkBegin; i < chunkEnd; i++)
+        {
+            sum = op(sum, input[i]);
+        }
+        chunkOffsets[chunk] = sum;
+    });
+    // 2. exclusive scan over the chunk totals (there aren't many, do it serially)
+    T running = identity;
+    for (u32 chunk = 0; chunk < numChunks; chunk++)
+    {
+        T chunkTotal = chunkOffsets[chunk];
+        chunkOffsets[chunk] = running;
+        running = op(running, chunkTotal);
+    }
+    // 3. scan every chunk starting from its offset
+    ParallelFor(0, numChunks, 1, [&](u32 chunk) {
+        u32 chunkBegin = chunk * grainSize;
+        u32 chunkEnd = chunkBegin + grainSize < count ? chunkBegin + grainSize : count;
+        T sum = chunkOffsets[chunk];
+        for (u32 i = chunkBegin; i < chunkEnd; i++)
+        {
+            sum = op(sum, input[i]);
+            output[i] = sum;
+        }
+    });
+}
+
+// compares jobs/sec of the work stealing scheduler against the old single MutexQueue scheduler,
+// and ParallelFor/Reduce/Scan against plain loops
+TAPI void JobSystemBenchmarks();
+// counters, nested waits, a 100k job dependency flood that checks completion order, and the parallel loop helpers
+TAPI void JobSystemTests();
 
-#endif
\ No newline at end of file
+#endif
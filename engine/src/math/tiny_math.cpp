@@ -76,6 +76,23 @@ glm::mat4 Position3DToModelMat(const glm::vec3& position, const glm::vec3& scale
     return model;
 }
 
+FrustumPlanes FrustumPlanesFromMatrix(const glm::mat4& viewProjection) {
+    // Gribb & Hartmann: a clip space point is inside when -w <= x,y,z <= w, and each of those is a plane in world space
+    // made of the matrix's rows. glm is column major, so row i is m[0][i], m[1][i]...
+    glm::mat4 rows = glm::transpose(viewProjection);
+    FrustumPlanes result;
+    result.planes[0] = rows[3] + rows[0];
+    result.planes[1] = rows[3] - rows[0];
+    result.planes[2] = rows[3] + rows[1];
+    result.planes[3] = rows[3] - rows[1];
+    result.planes[4] = rows[3] + rows[2];
+    result.planes[5] = rows[3] - rows[2];
+    for (glm::vec4& plane : result.planes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+    return result;
+}
+
 glm::mat4 Position2DToModelMat(const glm::vec2& position, const glm::vec2& scale, f32 rotation, const glm::vec3& rotationAxis) {
     // set up transform of the actual sprite
     glm::mat4 model = glm::mat4(1.0f);
@@ -32,6 +32,13 @@ struct Frustum
     glm::vec4 farBottomRight;
 };
 
+// ax + by + cz + d >= 0 is inside, (a,b,c) normalized so the result is a distance
+// left, right, bottom, top, near, far
+struct FrustumPlanes
+{
+    glm::vec4 planes[6];
+};
+
 namespace Math {
 
 
@@ -75,6 +82,9 @@ TAPI uint32_t hash(const char* message, size_t message_length);
 TAPI u32 countLeadingZeroes(u32 n);
 
 TAPI glm::mat4 Position3DToModelMat(const glm::vec3& position, const glm::vec3& scale = glm::vec3(1), f32 rotation = 0.0, const glm::vec3& rotationAxis = {1,0,0});
+// planes of the frustum a projection * view matrix clips to (OpenGL clip space, -w <= z <= w)
+TAPI FrustumPlanes FrustumPlanesFromMatrix(const glm::mat4& viewProjection);
+
 TAPI glm::mat4 Position2DToModelMat(const glm::vec2& position, const glm::vec2& scale = glm::vec3(1), f32 rotation = 0.0, const glm::vec3& rotationAxis = {0,0,1});
 
 template <typename T>
@@ -0,0 +1,65 @@
+#ifndef TINY_SIMD_H
+#define TINY_SIMD_H
+
+#include "tiny_defines.h"
+
+// Just enough float SIMD for the CPU culling code, SIMD_WIDTH lanes wide: 8 with AVX, 4 with SSE2 (any x64 build),
+// otherwise 1 and none of the SIMD_ macros exist, so code using them needs a scalar path under SIMD_WIDTH == 1.
+// Loads and stores are unaligned
+
+#if defined(__AVX__)
+#define SIMD_WIDTH 8
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_WIDTH 4
+#else
+#define SIMD_WIDTH 1
+#endif
+
+#if SIMD_WIDTH == 8
+#include <immintrin.h>
+typedef __m256 SimdF;
+#define SIMD_SET1 _mm256_set1_ps
+#define SIMD_ZERO _mm256_setzero_ps
+#define SIMD_LOAD _mm256_loadu_ps
+#define SIMD_STORE _mm256_storeu_ps
+#define SIMD_ADD _mm256_add_ps
+#define SIMD_MUL _mm256_mul_ps
+#define SIMD_MIN _mm256_min_ps
+#define SIMD_MAX _mm256_max_ps
+#define SIMD_AND _mm256_and_ps
+#define SIMD_OR _mm256_or_ps
+#define SIMD_ANDNOT _mm256_andnot_ps
+#define SIMD_LESS_THAN(a, b) _mm256_cmp_ps(a, b, _CMP_LT_OQ)
+#define SIMD_GREATER_EQUAL(a, b) _mm256_cmp_ps(a, b, _CMP_GE_OQ)
+#define SIMD_MOVEMASK _mm256_movemask_ps
+// 0, 1, 2... in each lane
+#define SIMD_LANE_INDICES() _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f)
+#elif SIMD_WIDTH == 4
+#include <immintrin.h>
+typedef __m128 SimdF;
+#define SIMD_SET1 _mm_set1_ps
+#define SIMD_ZERO _mm_setzero_ps
+#define SIMD_LOAD _mm_loadu_ps
+#define SIMD_STORE _mm_storeu_ps
+#define SIMD_ADD _mm_add_ps
+#define SIMD_MUL _mm_mul_ps
+#define SIMD_MIN _mm_min_ps
+#define SIMD_MAX _mm_max_ps
+#define SIMD_AND _mm_and_ps
+#define SIMD_OR _mm_or_ps
+#define SIMD_ANDNOT _mm_andnot_ps
+#define SIMD_LESS_THAN(a, b) _mm_cmplt_ps(a, b)
+#define SIMD_GREATER_EQUAL(a, b) _mm_cmpge_ps(a, b)
+#define SIMD_MOVEMASK _mm_movemask_ps
+#define SIMD_LANE_INDICES() _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f)
+#endif
+
+#if SIMD_WIDTH > 1
+// lanes of a where mask is set, b everywhere else. mask lanes are all ones or all zeros (comparison results)
+inline SimdF SimdSelect(SimdF mask, SimdF a, SimdF b)
+{
+    return SIMD_OR(SIMD_AND(mask, a), SIMD_ANDNOT(mask, b));
+}
+#endif
+
+#endif
@@ -3,8 +3,72 @@
 #include "tiny_log.h"
 #include "tiny_profiler.h"
 
+#include <thread>
+
 #define MAX_ARENA_NAME_LEN 30
 
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+// ============ virtual memory ============
+
+static void* os_reserve(size_t size)
+{
+#ifdef _WIN32
+    return VirtualAlloc(nullptr, size, MEM_RESERVE, PAGE_NOACCESS);
+#else
+    void* mem = mmap(nullptr, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    return mem == MAP_FAILED ? nullptr : mem;
+#endif
+}
+
+static bool os_commit(void* mem, size_t size)
+{
+#ifdef _WIN32
+    return VirtualAlloc(mem, size, MEM_COMMIT, PAGE_READWRITE) != nullptr;
+#else
+    return mprotect(mem, size, PROT_READ | PROT_WRITE) == 0;
+#endif
+}
+
+static void os_release(void* mem, size_t size)
+{
+#ifdef _WIN32
+    VirtualFree(mem, 0, MEM_RELEASE);
+#else
+    munmap(mem, size);
+#endif
+}
+
+static size_t align_up(size_t value, size_t alignment)
+{
+    return (value + (alignment - 1)) & ~(alignment - 1);
+}
+
+// makes sure [0, end) of the arena is usable
+static bool arena_ensure_capacity(Arena* arena, size_t end)
+{
+    if (end > arena->backing_mem_size)
+    {
+        return false;
+    }
+    if (arena->is_virtual && end > arena->committed)
+    {
+        size_t new_committed = align_up(end, ARENA_COMMIT_GRANULARITY);
+        if (new_committed > arena->backing_mem_size) new_committed = arena->backing_mem_size;
+        if (!os_commit(arena->backing_mem + arena->committed, new_committed - arena->committed))
+        {
+            LOG_ERROR("Failed to commit %llu bytes in arena %s", (u64)(new_committed - arena->committed), arena_get_name(arena));
+            return false;
+        }
+        arena->committed = new_committed;
+    }
+    return true;
+}
+
 Arena arena_init(void* backing_buffer, size_t arena_size) 
 {
     Arena a;
@@ -24,6 +88,22 @@ Arena arena_init(void* backing_buffer, size_t arena_size, const char* name_ownin
 }
 
 
+Arena arena_init_virtual(size_t reserve_size, const char* name_owning)
+{
+    reserve_size = align_up(reserve_size, ARENA_COMMIT_GRANULARITY);
+    void* reserved = os_reserve(reserve_size);
+    if (!reserved)
+    {
+        LOG_FATAL("Failed to reserve %llu bytes of address space for arena %s", (u64)reserve_size, name_owning);
+        TINY_ASSERT(false);
+        return {};
+    }
+    Arena a = arena_init(reserved, reserve_size, name_owning);
+    a.is_virtual = true;
+    a.committed = 0;
+    return a;
+}
+
 const char* arena_get_name(Arena* arena) 
 {
     return arena->name;
@@ -31,19 +111,24 @@ const char* arena_get_name(Arena* arena)
 
 void* arena_alloc(Arena* arena, size_t alloc_size) 
 {
-    size_t& offset = arena->offset;
-    bool is_out_of_mem = offset + alloc_size > arena->backing_mem_size;
-    if (is_out_of_mem) 
+    return arena_alloc_aligned(arena, alloc_size, ARENA_DEFAULT_ALIGNMENT);
+}
+
+void* arena_alloc_aligned(Arena* arena, size_t alloc_size, size_t alignment)
+{
+    TINY_ASSERT(alignment > 0 && (alignment & (alignment - 1)) == 0 && "arena alignment must be a power of 2");
+    // align the actual address, the backing memory itself might not be aligned as strictly as requested
+    uintptr_t base = (uintptr_t)arena->backing_mem;
+    size_t aligned_offset = align_up(base + arena->offset, alignment) - base;
+    if (!arena_ensure_capacity(arena, aligned_offset + alloc_size))
     {
         LOG_FATAL("Out of memory in arena %s\n", arena_get_name(arena));
         TINY_ASSERT(false);
-        // maybe we automatically resize here?
         return nullptr;
     }
-    // TODO: enforce alignment    
-    void* new_alloc = arena->backing_mem + offset;
-    arena->prev_offset = offset;
-    offset += alloc_size;
+    void* new_alloc = arena->backing_mem + aligned_offset;
+    arena->prev_offset = aligned_offset;
+    arena->offset = aligned_offset + alloc_size;
     PROFILE_ALLOC(new_alloc, alloc_size, arena_get_name(arena));
     return new_alloc;
 }
@@ -60,6 +145,12 @@ void* arena_resize(Arena* arena, void* old_mem, size_t old_size, size_t new_size
         bool is_most_recent_alloc = old_mem_addr == backing_mem_addr + arena->prev_offset;
         if (is_most_recent_alloc) 
         {
+            if (!arena_ensure_capacity(arena, arena->prev_offset + new_size))
+            {
+                LOG_FATAL("Out of memory in arena %s\n", arena_get_name(arena));
+                TINY_ASSERT(false);
+                return nullptr;
+            }
             arena->offset = arena->prev_offset + new_size;
             return old_mem;
         }
@@ -104,8 +195,222 @@ void arena_clear(Arena* arena) {
 void arena_free_all(Arena* arena)
 {
     arena_clear(arena);
+    if (arena->is_virtual)
+    {
+        os_release(arena->backing_mem, arena->backing_mem_size);
+        arena->backing_mem = nullptr;
+        arena->committed = 0;
+    }
+    else
+    {
+        TSYSFREE(arena->backing_mem);
+    }
     arena->backing_mem_size = 0;
-    TSYSFREE(arena->backing_mem);
+}
+
+ArenaTemp arena_temp_begin(Arena* arena)
+{
+    ArenaTemp temp;
+    temp.arena = arena;
+    temp.offset = arena->offset;
+    temp.prev_offset = arena->prev_offset;
+    return temp;
+}
+
+void arena_temp_end(ArenaTemp temp)
+{
+    Arena* arena = temp.arena;
+    TINY_ASSERT(arena && "Ending an ArenaTemp that was never started");
+    // if this hits, an outer temp was ended (or the arena was cleared) before this one
+    TINY_ASSERT(arena->offset >= temp.offset && "ArenaTemps ended out of order");
+    arena->offset = temp.offset;
+    arena->prev_offset = temp.prev_offset;
+}
+
+// ============ scratch ============
+
+struct ScratchArenas
+{
+    Arena arenas[ARENA_NUM_SCRATCH] = {};
+    // runs when the owning thread exits
+    ~ScratchArenas()
+    {
+        for (u32 i = 0; i < ARENA_NUM_SCRATCH; i++)
+        {
+            if (arenas[i].backing_mem)
+            {
+                arena_free_all(&arenas[i]);
+            }
+        }
+    }
+};
+static thread_local ScratchArenas tlsScratch;
+
+ArenaTemp scratch_begin(Arena* const* conflicts, u32 num_conflicts)
+{
+    static const char* scratchNames[ARENA_NUM_SCRATCH] = { "Scratch 0", "Scratch 1" };
+    static_assert(ARRAY_SIZE(scratchNames) == ARENA_NUM_SCRATCH, "Name every scratch arena");
+    for (u32 i = 0; i < ARENA_NUM_SCRATCH; i++)
+    {
+        Arena* scratch = &tlsScratch.arenas[i];
+        bool isConflicting = false;
+        for (u32 c = 0; c < num_conflicts; c++)
+        {
+            if (conflicts[c] == scratch)
+            {
+                isConflicting = true;
+                break;
+            }
+        }
+        if (isConflicting) continue;
+        if (!scratch->backing_mem)
+        {
+            // only reserves address space, pages get committed as the scratch is used
+            *scratch = arena_init_virtual(ARENA_SCRATCH_RESERVE_SIZE, scratchNames[i]);
+        }
+        return arena_temp_begin(scratch);
+    }
+    TINY_ASSERT(false && "Every scratch arena conflicts. Bump ARENA_NUM_SCRATCH");
+    return {};
+}
+
+
+void ArenaTests()
+{
+    LOG_INFO("Running Arena tests...");
+    // alignment on a fixed buffer, starting from a deliberately misaligned base
+    {
+        arena_init_stack_scratch(scratch, 1024);
+        Arena misaligned = arena_init((u8*)scratch.backing_mem + 1, 1000, "Misaligned");
+        const size_t alignments[] = {1, 2, 4, 8, 16, 32, 64, 128};
+        for (u32 i = 0; i < ARRAY_SIZE(alignments); i++)
+        {
+            arena_alloc(&misaligned, 3); // knock the offset off of any nice boundary
+            void* mem = arena_alloc_aligned(&misaligned, 8, alignments[i]);
+            TINY_ASSERT(((uintptr_t)mem & (alignments[i] - 1)) == 0);
+        }
+        void* defaultAligned = arena_alloc(&misaligned, 1);
+        TINY_ASSERT(((uintptr_t)defaultAligned & (ARENA_DEFAULT_ALIGNMENT - 1)) == 0);
+        // typed allocs respect alignof(T)
+        struct alignas(64) CacheLine { u8 bytes[64]; };
+        arena_alloc(&misaligned, 1);
+        CacheLine* lines = arena_alloc_type(&misaligned, CacheLine, 2);
+        TINY_ASSERT(((uintptr_t)lines & 63) == 0);
+        // popping/resizing the latest allocation still works with padding in front of it
+        arena_alloc(&misaligned, 1);
+        u8* latest = (u8*)arena_alloc_aligned(&misaligned, 16, 32);
+        size_t offsetBeforeResize = misaligned.offset;
+        TINY_ASSERT(arena_resize(&misaligned, latest, 16, 32) == latest);
+        TINY_ASSERT(misaligned.offset == offsetBeforeResize + 16);
+        arena_pop_latest(&misaligned, latest);
+        TINY_ASSERT(misaligned.backing_mem + misaligned.offset == latest);
+    }
+    // virtual arenas commit on demand
+    {
+        constexpr size_t reserveSize = MEGABYTES_BYTES(64);
+        Arena varena = arena_init_virtual(reserveSize, "Virtual Test");
+        TINY_ASSERT(varena.is_virtual && varena.backing_mem && varena.backing_mem_size == reserveSize);
+        TINY_ASSERT(varena.committed == 0); // nothing is committed until it's used
+        u8* first = (u8*)arena_alloc(&varena, 100);
+        TINY_ASSERT(varena.committed == ARENA_COMMIT_GRANULARITY);
+        TMEMSET(first, 0xAB, 100);
+        // an allocation straddling the committed boundary commits just enough to cover it
+        arena_alloc_aligned(&varena, ARENA_COMMIT_GRANULARITY - 100 - 8, 1);
+        TINY_ASSERT(varena.committed == ARENA_COMMIT_GRANULARITY);
+        u8* straddle = (u8*)arena_alloc_aligned(&varena, 64, 1);
+        TINY_ASSERT(straddle == varena.backing_mem + ARENA_COMMIT_GRANULARITY - 8);
+        TINY_ASSERT(varena.committed == 2 * ARENA_COMMIT_GRANULARITY);
+        TMEMSET(straddle, 0xCD, 64); // would fault if the second chunk wasn't committed
+        // big allocations commit in one go, and freshly committed memory is zeroed
+        u8* big = (u8*)arena_alloc(&varena, MEGABYTES_BYTES(8));
+        TINY_ASSERT(varena.committed >= varena.offset && varena.committed - varena.offset < ARENA_COMMIT_GRANULARITY);
+        TINY_ASSERT(big[0] == 0 && big[MEGABYTES_BYTES(8) - 1] == 0);
+        big[MEGABYTES_BYTES(8) - 1] = 1;
+        TINY_ASSERT(first[99] == 0xAB);
+        // clearing keeps the committed pages around for reuse
+        size_t committedBeforeClear = varena.committed;
+        arena_clear(&varena);
+        TINY_ASSERT(varena.offset == 0 && varena.committed == committedBeforeClear);
+        arena_alloc(&varena, MEGABYTES_BYTES(1));
+        TINY_ASSERT(varena.committed == committedBeforeClear);
+        // growing the latest allocation in place commits too
+        arena_clear(&varena);
+        u8* growing = (u8*)arena_alloc(&varena, 16);
+        TINY_ASSERT(arena_resize(&varena, growing, 16, MEGABYTES_BYTES(16)) == growing);
+        TINY_ASSERT(varena.committed >= MEGABYTES_BYTES(16));
+        growing[MEGABYTES_BYTES(16) - 1] = 1;
+        // can fill right up to the reservation
+        arena_clear(&varena);
+        u8* everything = (u8*)arena_alloc(&varena, reserveSize);
+        TINY_ASSERT(everything && varena.committed == reserveSize);
+        everything[reserveSize - 1] = 1;
+        arena_free_all(&varena);
+        TINY_ASSERT(varena.backing_mem == nullptr && varena.committed == 0 && varena.backing_mem_size == 0);
+    }
+    // temp scopes roll back any number of nested allocations
+    {
+        Arena varena = arena_init_virtual(MEGABYTES_BYTES(4), "Temp Test");
+        u8* persistent = (u8*)arena_alloc(&varena, 32);
+        size_t offsetBeforeTemps = varena.offset;
+        ArenaTemp outer = arena_temp_begin(&varena);
+        for (u32 i = 0; i < 10; i++) arena_alloc(&varena, 100);
+        size_t offsetBeforeInner = varena.offset;
+        ArenaTemp inner = arena_temp_begin(&varena);
+        arena_alloc(&varena, KILOBYTES_BYTES(200));
+        arena_temp_end(inner);
+        TINY_ASSERT(varena.offset == offsetBeforeInner);
+        arena_temp_end(outer);
+        TINY_ASSERT(varena.offset == offsetBeforeTemps);
+        // latest allocation from before the temp can still be popped
+        arena_pop_latest(&varena, persistent);
+        TINY_ASSERT(varena.offset == 0);
+        arena_free_all(&varena);
+    }
+    // scratch arenas
+    {
+        ArenaTemp a = scratch_begin();
+        TINY_ASSERT(a.arena && a.arena->is_virtual);
+        u8* aMem = (u8*)arena_alloc(a.arena, 64);
+        // conflicting with a gives us a different arena, so allocating in one doesn't stomp the other
+        ArenaTemp b = scratch_begin(a.arena);
+        TINY_ASSERT(b.arena != a.arena);
+        u8* bMem = (u8*)arena_alloc(b.arena, 64);
+        TMEMSET(aMem, 1, 64);
+        TMEMSET(bMem, 2, 64);
+        // no conflicts is allowed to hand back an arena that's already in use, the temp just nests
+        ArenaTemp c = scratch_begin();
+        arena_alloc(c.arena, 1024);
+        scratch_end(c);
+        TINY_ASSERT(c.arena->offset == c.offset);
+        Arena* both[] = { a.arena, b.arena };
+        if (ARENA_NUM_SCRATCH > 2)
+        {
+            ArenaTemp d = scratch_begin(both, ARRAY_SIZE(both));
+            TINY_ASSERT(d.arena != a.arena && d.arena != b.arena);
+            scratch_end(d);
+        }
+        scratch_end(b);
+        scratch_end(a);
+        TINY_ASSERT(aMem[63] == 1 && bMem[63] == 2);
+        TINY_ASSERT(a.arena->offset == a.offset && b.arena->offset == b.offset);
+        // other threads get their own scratch
+        Arena* otherThreadScratch[ARENA_NUM_SCRATCH] = {};
+        std::thread other([&otherThreadScratch]() {
+            for (u32 i = 0; i < ARENA_NUM_SCRATCH; i++)
+            {
+                ArenaTemp scratch = scratch_begin(otherThreadScratch, i);
+                otherThreadScratch[i] = scratch.arena;
+                TMEMSET(arena_alloc(scratch.arena, 256), 3, 256);
+                scratch_end(scratch);
+            }
+        });
+        other.join();
+        for (u32 i = 0; i < ARENA_NUM_SCRATCH; i++)
+        {
+            TINY_ASSERT(otherThreadScratch[i] != a.arena && otherThreadScratch[i] != b.arena);
+        }
+    }
+    LOG_INFO("Arena tests passed");
 }
 
 
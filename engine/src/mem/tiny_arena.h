@@ -3,18 +3,27 @@
 //#include "pch.h"
 #include "tiny_defines.h"
 #include "tiny_mem.h"
+#include <cstddef>
 
 // ARENAS
 
 struct Arena {
     unsigned char* backing_mem = 0;
-    size_t backing_mem_size = 0;
+    size_t backing_mem_size = 0; // for virtual arenas this is the whole reserved range
     size_t offset = 0;
     size_t prev_offset = 0;
     const char* name = "UNNAMED_ARENA";
+    // virtual arenas only - how much of the reserved range is backed by real memory. Grows as the arena fills up
+    size_t committed = 0;
+    bool is_virtual = false;
 };
 
-#define arena_alloc_type(arena, type, num) ((type*)arena_alloc(arena, sizeof(type) * num))
+// arena_alloc hands out memory aligned to this (same guarantee as malloc)
+#define ARENA_DEFAULT_ALIGNMENT alignof(std::max_align_t)
+// virtual arenas commit in chunks of this size. Multiple of the page size on every platform we care about
+#define ARENA_COMMIT_GRANULARITY KILOBYTES_BYTES(64)
+
+#define arena_alloc_type(arena, type, num) ((type*)arena_alloc_aligned(arena, sizeof(type) * (num), alignof(type)))
 
 template <typename T>
 T* arena_alloc_and_init(Arena* arena, u32 numElements = 1)
@@ -26,15 +35,50 @@ T* arena_alloc_and_init(Arena* arena, u32 numElements = 1)
 
 TAPI Arena arena_init(void* backing_buffer, size_t arena_size);
 TAPI Arena arena_init(void* backing_buffer, size_t arena_size, const char* name); // name should be owning. arena takes a cpy of the ptr
+// reserves reserve_size bytes of address space without backing them with memory. Pages get committed as the arena grows,
+// so a virtual arena can be given a huge reserve_size and only costs what is actually used. arena_free_all releases it
+TAPI Arena arena_init_virtual(size_t reserve_size, const char* name);
 TAPI void* arena_alloc(Arena* arena, size_t alloc_size);
+// alignment must be a power of two
+TAPI void* arena_alloc_aligned(Arena* arena, size_t alloc_size, size_t alignment);
 TAPI void* arena_resize(Arena* arena, void* old_mem, size_t old_size, size_t new_size);
 // pops the latest allocation off. Forcing user to pass that allocation to ensure we're popping the right thing
 TAPI void arena_pop_latest(Arena* arena, void* data);
 TAPI void arena_clear(Arena* arena);
 TAPI void arena_free_all(Arena* arena);
 TAPI const char* arena_get_name(Arena* arena);
+TAPI void ArenaTests();
 inline size_t get_free_space(Arena* arena) { return arena->backing_mem_size - arena->offset; }
 
+// TEMP SCOPES
+
+// snapshot of an arena's position. Ending it throws away everything allocated in the arena since it began,
+// no matter how many allocations that was. Temps can nest, but have to be ended in reverse order
+struct ArenaTemp {
+    Arena* arena = nullptr;
+    size_t offset = 0;
+    size_t prev_offset = 0;
+};
+
+TAPI ArenaTemp arena_temp_begin(Arena* arena);
+TAPI void arena_temp_end(ArenaTemp temp);
+
+// SCRATCH
+
+// every thread (main thread, job workers, anything else) gets its own set of scratch arenas, created the first time
+// that thread asks for one. They're never shared between threads so using them doesn't need any locking.
+// scratch_begin hands back a temp scope on one of them, scratch_end rolls it back.
+// If a function allocates its result into an arena it was passed, pass that arena as a conflict.
+// That arena might itself be the caller's scratch, and allocating temporaries on top of the result in the same
+// arena would get the result thrown away by scratch_end (or the temporaries stuck underneath the result)
+#define ARENA_NUM_SCRATCH 2
+#define ARENA_SCRATCH_RESERVE_SIZE GIGABYTES_BYTES((size_t)1)
+
+TAPI ArenaTemp scratch_begin(Arena* const* conflicts, u32 num_conflicts);
+inline ArenaTemp scratch_begin() { return scratch_begin(nullptr, 0); }
+inline ArenaTemp scratch_begin(Arena* conflict) { return scratch_begin(&conflict, 1); }
+inline void scratch_end(ArenaTemp scratch) { arena_temp_end(scratch); }
+
 
 
 #define _arena_init_stack_scratch(arena_name, line, size) \
@@ -1,79 +1,88 @@
 #include "tiny_fixed_alloc.h"
 
 #include "tiny_log.h"
+#include "mem/tiny_mem.h"
 
 // uses a backing memory buffer and allocates fixed-size chunks from it at a time
-// freeing blocks adds them to a linked list of free blocks which can be reclaimed on 
-// subsequent allocations
+// freeing blocks pushes them onto a linked list of free blocks which are reclaimed
+// (most recently freed first, since that's the one most likely to still be in cache) before touching fresh memory
 
 FixedBlockAllocator InitializeFixedBlockAllocator(u8* backingMem, size_t memSize, size_t blockSize)
 {
-    TINY_ASSERT(blockSize >= sizeof(size_t)); // we use size_t bytes to store pointers to the next free blocks
+    TINY_ASSERT(blockSize >= sizeof(u8*)); // free blocks store a pointer to the next free block
     FixedBlockAllocator alloc;
     alloc.mem = backingMem;
     alloc.memSize = memSize;
     alloc.offset = 0;
     alloc.blockSize = blockSize;
     alloc.freeListStart = 0;
-    alloc.freeListEnd = 0;
     return alloc;
 }
 
 void* fixedblock_alloc(FixedBlockAllocator* allocator)
 {
-    size_t& offset = allocator->offset;
-    bool full = offset + allocator->blockSize > allocator->memSize;
-    if (full && allocator->freeListStart != 0)
+    if (allocator->freeListStart != 0)
     {
         // grab freelist block from the start of the chain
         u8* freeBlock = allocator->freeListStart;
-        u8* nextFreeBlock = (u8*) *(size_t*)allocator->freeListStart;
-        if (nextFreeBlock != 0)
-        {
-            // each free list block holds a pointer to the next free block in the first size_t bytes
-            allocator->freeListStart = nextFreeBlock;
-            return freeBlock;
-        }
-        else
-        {
-            TINY_ASSERT(false && "Out of memory in fixed block allocator! (attempted to grab freelist block but failed)");
-        }
+        allocator->freeListStart = *(u8**)freeBlock;
+        return freeBlock;
     }
-    else
+    if (allocator->offset + allocator->blockSize > allocator->memSize)
     {
-        TINY_ASSERT(false && "Out of memory in fixed block allocator!");
+        return nullptr;
     }
-    void* newAlloc = allocator->mem + offset;
-    offset += allocator->blockSize;
+    void* newAlloc = allocator->mem + allocator->offset;
+    allocator->offset += allocator->blockSize;
     return newAlloc;
 }
 
 void fixedblock_free_block(FixedBlockAllocator* allocator, void* block)
 {
-    // block should be within our allocator mem
-    TINY_ASSERT(block >= allocator->mem && block <= allocator->mem + allocator->memSize);
+    // block should be one we've handed out
+    TINY_ASSERT(block >= allocator->mem && (u8*)block < allocator->mem + allocator->offset);
     // make sure block is aligned on blockSize
     TINY_ASSERT( ((size_t)block - (size_t)allocator->mem) % allocator->blockSize == 0 );
-    if (allocator->freeListStart == 0)
-    {
-        allocator->freeListStart = (u8*)block;
-        allocator->freeListEnd = (u8*)block;
-        // storing pointer to next freelist block - in the form of an offset from the mem base address
-        // in first few bytes of the freed block
-        *(size_t*)block = 0;
-    }
-    else
-    {
-        // write the pointer to the next free block to the previous free block in the chain
-        *(size_t*)allocator->freeListEnd = (size_t)block;
-        // advance freelist end pointer to (this) recently freed block
-        u8* nextFreeBlock = (u8*)block;
-        allocator->freeListEnd = nextFreeBlock;
-    }
+    *(u8**)block = allocator->freeListStart;
+    allocator->freeListStart = (u8*)block;
 }
 
 void fixedblock_clear(FixedBlockAllocator* allocator)
 {
     allocator->freeListStart = 0;
     allocator->offset = 0;
-}
\ No newline at end of file
+}
+
+void FixedBlockAllocatorTests()
+{
+    LOG_INFO("Running FixedBlockAllocator tests...");
+    constexpr size_t blockSize = 32;
+    constexpr u32 numBlocks = 16;
+    alignas(16) u8 mem[blockSize * numBlocks];
+    FixedBlockAllocator allocator = InitializeFixedBlockAllocator(mem, sizeof(mem), blockSize);
+    u8* blocks[numBlocks] = {};
+    for (u32 i = 0; i < numBlocks; i++)
+    {
+        blocks[i] = (u8*)fixedblock_alloc(&allocator);
+        TINY_ASSERT(blocks[i] == mem + i * blockSize);
+        TMEMSET(blocks[i], i, blockSize);
+    }
+    TINY_ASSERT(fixedblock_alloc(&allocator) == nullptr);
+    // freed blocks come back most recent first, including the very last one on the list
+    fixedblock_free_block(&allocator, blocks[3]);
+    fixedblock_free_block(&allocator, blocks[9]);
+    TINY_ASSERT(fixedblock_alloc(&allocator) == blocks[9]);
+    TINY_ASSERT(fixedblock_alloc(&allocator) == blocks[3]);
+    TINY_ASSERT(fixedblock_alloc(&allocator) == nullptr);
+    // neighbours of freed blocks aren't touched
+    fixedblock_free_block(&allocator, blocks[5]);
+    TINY_ASSERT(blocks[4][blockSize - 1] == 4 && blocks[6][0] == 6);
+    // the free list is used before the untouched part of the buffer
+    fixedblock_clear(&allocator);
+    u8* first = (u8*)fixedblock_alloc(&allocator);
+    u8* second = (u8*)fixedblock_alloc(&allocator);
+    fixedblock_free_block(&allocator, first);
+    TINY_ASSERT(fixedblock_alloc(&allocator) == first);
+    TINY_ASSERT(fixedblock_alloc(&allocator) == second + blockSize);
+    LOG_INFO("FixedBlockAllocator tests passed");
+}
@@ -4,23 +4,25 @@
 // a simple fixed-size block allocator w/ freelist
 #include "tiny_defines.h"
 
-// TODO: Test this!
-
 struct FixedBlockAllocator
 {
     u8* mem;
     size_t memSize;
     size_t blockSize;
+    // everything past offset has never been handed out
     size_t offset;
+    // most recently freed block. Each free block holds a pointer to the next one in its first bytes
     u8* freeListStart;
-    u8* freeListEnd;
 };
 
 
+// blockSize needs to be big enough to hold a pointer. Blocks are aligned as well as backingMem + a multiple of blockSize is
 FixedBlockAllocator InitializeFixedBlockAllocator(u8* backingMem, size_t memSize, size_t blockSize);
+// returns null when every block is in use
 void* fixedblock_alloc(FixedBlockAllocator* allocator);
 void fixedblock_free_block(FixedBlockAllocator* allocator, void* block);
 void fixedblock_clear(FixedBlockAllocator* allocator);
+TAPI void FixedBlockAllocatorTests();
 
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,746 @@
+//#include "pch.h"
+#include "mem/tiny_heap.h"
+#include "mem/tiny_mem.h"
+#include "mem/tiny_arena.h"
+#include "tiny_log.h"
+#include "tiny_profiler.h"
+
+#include <stdlib.h>
+#include <atomic>
+#include <thread>
+#include <bit>
+
+// sits right in front of every block we hand out
+struct HeapBlockHeader
+{
+    u64 size; // what the caller asked for
+    u8 sizeClass;
+    u8 tag;
+    u8 padding[6];
+};
+static_assert(sizeof(HeapBlockHeader) == HEAP_ALIGNMENT, "Header has to keep user pointers aligned");
+// blocks that came from the system allocator
+#define HEAP_LARGE_CLASS 0xFF
+// set on blocks sitting in a free list. The free list link only overwrites HeapBlockHeader::size, so this survives
+// and lets us catch double frees
+#define HEAP_FREED_CLASS 0xFE
+// smallest size class. Free blocks need room for the batch links below
+#define HEAP_MIN_BLOCK 32
+
+// Free blocks are chained through their own memory, lined up with HeapBlockHeader so sizeClass stays put.
+// Blocks move between threads in batches (null terminated chains). The shared lists are stacks of whole batches, with the
+// batch links kept in each batch's first block, so handing a batch over never walks the chain
+struct HeapFreeBlock
+{
+    HeapFreeBlock* next;
+    u8 sizeClass;
+    u8 padding[3];
+    // only on the first block of a batch that's sitting in a shared list
+    u32 batchCount;
+    HeapFreeBlock* nextBatch;
+};
+static_assert(sizeof(HeapFreeBlock) <= HEAP_MIN_BLOCK, "Free block links don't fit in the smallest block");
+static_assert(offsetof(HeapFreeBlock, sizeClass) == offsetof(HeapBlockHeader, sizeClass), "Free blocks have to keep the freed marker readable");
+
+// spin lock rather than std::mutex since it's trivially destructible. Memory can still get freed from static destructors
+// after ours would've run. Critical sections are a couple of pointer swaps
+struct HeapLock
+{
+    std::atomic<bool> locked = false;
+    inline void lock()
+    {
+        while (locked.exchange(true, std::memory_order_acquire))
+        {
+            while (locked.load(std::memory_order_relaxed)) { std::this_thread::yield(); }
+        }
+    }
+    inline void unlock()
+    {
+        locked.store(false, std::memory_order_release);
+    }
+};
+
+// batches of blocks of one size class that aren't in any thread's cache
+struct HeapSizeClass
+{
+    HeapLock lock;
+    HeapFreeBlock* batches = nullptr;
+};
+
+// only written by the owning thread. Atomics so heap_get_stats can read them from another thread, but the owner just
+// does a relaxed load + store so it's a plain add. Frees on another thread than the alloc make one thread's count go
+// "negative", which wraps around and still sums up right
+// Kept to two counter bumps per alloc/free, they're a good chunk of the cost of a cached alloc
+struct HeapThreadStats
+{
+    std::atomic<u64> liveBytes[(u32)MemTag::NUM_TAGS] = {};
+    std::atomic<u64> numAllocs[(u32)MemTag::NUM_TAGS] = {};
+    std::atomic<u64> numFrees[(u32)MemTag::NUM_TAGS] = {};
+    std::atomic<u64> largeLiveBytes = 0;
+};
+
+// blocks of one size class owned by one thread. hot is what allocs/frees work on. Once it fills up to a batch it becomes
+// the spare, and the old spare goes to the shared list. So a thread holds at most two batches per class, and a thread that
+// alternates allocs and frees right around a batch boundary doesn't bounce batches off the shared list every time
+struct HeapThreadSizeClass
+{
+    HeapFreeBlock* hot = nullptr;
+    HeapFreeBlock* spare = nullptr;
+    u32 numHot = 0;
+    u32 numSpare = 0;
+};
+
+struct HeapThreadCache
+{
+    HeapThreadSizeClass classes[HEAP_NUM_SIZE_CLASSES] = {};
+    HeapThreadStats stats;
+    // every live thread cache is linked up so heap_get_stats can add them together
+    HeapThreadCache* prev = nullptr;
+    HeapThreadCache* next = nullptr;
+    bool isRegistered = false;
+    // set once the owning thread is exiting. Other thread_local destructors can still free after ours ran
+    bool isShutDown = false;
+};
+
+// HeapThreadCache is trivially destructible so touching it is a plain TLS access. A thread_local with a destructor
+// goes through an init check on every access, so the flush at thread exit lives in this instead
+struct HeapThreadCacheFlusher
+{
+    ~HeapThreadCacheFlusher();
+};
+
+static HeapSizeClass heapClasses[HEAP_NUM_SIZE_CLASSES];
+static HeapLock heapCarveLock;
+static Arena heapArena = {};
+static std::atomic<u64> heapSmallBlockBytes = 0;
+// threads that have exited (or are exiting) fold their stats in here
+static HeapLock heapThreadsLock;
+static HeapThreadCache* heapThreads = nullptr;
+static HeapThreadStats heapRetiredStats;
+static thread_local HeapThreadCache tlsHeapCache;
+static thread_local HeapThreadCacheFlusher tlsHeapCacheFlusher;
+
+static const char* heapTagNames[] = { "General", "Containers", "Assets", "Jobs", "Pools", "Game", "Entities" };
+static_assert(ARRAY_SIZE(heapTagNames) == (u32)MemTag::NUM_TAGS, "Name every MemTag");
+
+// ============ size classes ============
+
+// blockSize includes the header, and is in [1, HEAP_MAX_SMALL_BLOCK]
+static inline u32 size_class_index(size_t blockSize)
+{
+    if (blockSize <= 128)
+    {
+        return blockSize <= HEAP_MIN_BLOCK ? 0 : (u32)((blockSize + 15) / 16) - 2;
+    }
+    u32 highBit = std::bit_width((u32)(blockSize - 1)) - 1;
+    u32 quarter = ((u32)(blockSize - 1) >> (highBit - 2)) & 3;
+    return 7 + (highBit - 7) * 4 + quarter;
+}
+
+static constexpr u32 compute_size_class_bytes(u32 classIdx)
+{
+    if (classIdx < 7)
+    {
+        return (classIdx + 2) * 16;
+    }
+    u32 highBit = 7 + (classIdx - 7) / 4;
+    u32 quarter = (classIdx - 7) % 4;
+    return (1u << highBit) + (quarter + 1) * (1u << (highBit - 2));
+}
+
+// how many blocks move between a thread cache and the shared list at once. ~16KB worth
+static constexpr u32 compute_size_class_batch(u32 classIdx)
+{
+    u32 count = KILOBYTES_BYTES(16) / compute_size_class_bytes(classIdx);
+    return count < 2 ? 2 : (count > 64 ? 64 : count);
+}
+
+struct HeapSizeClassTable
+{
+    u32 bytes[HEAP_NUM_SIZE_CLASSES];
+    u32 batch[HEAP_NUM_SIZE_CLASSES];
+    constexpr HeapSizeClassTable() : bytes(), batch()
+    {
+        for (u32 i = 0; i < HEAP_NUM_SIZE_CLASSES; i++)
+        {
+            bytes[i] = compute_size_class_bytes(i);
+            batch[i] = compute_size_class_batch(i);
+        }
+    }
+};
+static constexpr HeapSizeClassTable heapSizeClassTable;
+
+static inline u32 size_class_bytes(u32 classIdx) { return heapSizeClassTable.bytes[classIdx]; }
+static inline u32 size_class_batch(u32 classIdx) { return heapSizeClassTable.batch[classIdx]; }
+
+// ============ stats ============
+
+static inline void stat_add(std::atomic<u64>& counter, u64 amount)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+static void register_thread_cache(HeapThreadCache& cache)
+{
+    // first touch is what schedules the flusher's destructor for when this thread exits
+    (void)&tlsHeapCacheFlusher;
+    heapThreadsLock.lock();
+    cache.next = heapThreads;
+    if (heapThreads) heapThreads->prev = &cache;
+    heapThreads = &cache;
+    cache.isRegistered = true;
+    heapThreadsLock.unlock();
+}
+
+// null once the calling thread's cache is gone. Callers fall back on the shared lists/retired stats
+static inline HeapThreadCache* get_thread_cache()
+{
+    HeapThreadCache& cache = tlsHeapCache;
+    if (!cache.isRegistered)
+    {
+        if (cache.isShutDown) return nullptr;
+        register_thread_cache(cache);
+    }
+    return &cache;
+}
+
+static inline void record_alloc(HeapThreadCache* cache, MemTag tag, u64 size, bool isLarge)
+{
+    if (!cache) heapThreadsLock.lock();
+    HeapThreadStats& stats = cache ? cache->stats : heapRetiredStats;
+    stat_add(stats.liveBytes[(u32)tag], size);
+    stat_add(stats.numAllocs[(u32)tag], 1);
+    if (isLarge) stat_add(stats.largeLiveBytes, size);
+    if (!cache) heapThreadsLock.unlock();
+}
+
+static inline void record_free(HeapThreadCache* cache, MemTag tag, u64 size, bool isLarge)
+{
+    if (!cache) heapThreadsLock.lock();
+    HeapThreadStats& stats = cache ? cache->stats : heapRetiredStats;
+    stat_add(stats.liveBytes[(u32)tag], 0 - size);
+    stat_add(stats.numFrees[(u32)tag], 1);
+    if (isLarge) stat_add(stats.largeLiveBytes, 0 - size);
+    if (!cache) heapThreadsLock.unlock();
+}
+
+static void accumulate_stats(HeapStats* out, const HeapThreadStats& stats)
+{
+    for (u32 i = 0; i < (u32)MemTag::NUM_TAGS; i++)
+    {
+        u64 numAllocs = stats.numAllocs[i].load(std::memory_order_relaxed);
+        out->tags[i].liveBytes += stats.liveBytes[i].load(std::memory_order_relaxed);
+        out->tags[i].liveAllocations += numAllocs - stats.numFrees[i].load(std::memory_order_relaxed);
+        out->tags[i].totalAllocations += numAllocs;
+    }
+    out->largeLiveBytes += stats.largeLiveBytes.load(std::memory_order_relaxed);
+}
+
+// ============ free lists ============
+
+// pushes a null terminated chain of count blocks onto the shared list as one batch
+static void release_batch(u32 classIdx, HeapFreeBlock* first, u32 count)
+{
+    HeapSizeClass& sizeClass = heapClasses[classIdx];
+    first->batchCount = count;
+    sizeClass.lock.lock();
+    first->nextBatch = sizeClass.batches;
+    sizeClass.batches = first;
+    sizeClass.lock.unlock();
+}
+
+// pops a whole batch off the shared list, or carves a fresh one out of the heap arena if there aren't any.
+// Returns how many blocks are chained from first (0 if we're out of memory)
+static u32 acquire_batch(u32 classIdx, HeapFreeBlock*& first)
+{
+    HeapSizeClass& sizeClass = heapClasses[classIdx];
+    sizeClass.lock.lock();
+    first = sizeClass.batches;
+    if (first)
+    {
+        sizeClass.batches = first->nextBatch;
+    }
+    sizeClass.lock.unlock();
+    if (first)
+    {
+        return first->batchCount;
+    }
+
+    u32 blockBytes = size_class_bytes(classIdx);
+    u32 count = size_class_batch(classIdx);
+    heapCarveLock.lock();
+    if (!heapArena.backing_mem)
+    {
+        heapArena = arena_init_virtual(HEAP_RESERVE_SIZE, "Heap");
+    }
+    u8* mem = (u8*)arena_alloc_aligned(&heapArena, (size_t)blockBytes * count, HEAP_ALIGNMENT);
+    heapCarveLock.unlock();
+    if (!mem) return 0;
+    heapSmallBlockBytes.fetch_add((u64)blockBytes * count, std::memory_order_relaxed);
+    // link them up in address order, so a fresh batch gets handed out front to back
+    for (u32 i = 0; i < count - 1; i++)
+    {
+        ((HeapFreeBlock*)(mem + i * blockBytes))->next = (HeapFreeBlock*)(mem + (i + 1) * blockBytes);
+    }
+    ((HeapFreeBlock*)(mem + (count - 1) * blockBytes))->next = nullptr;
+    first = (HeapFreeBlock*)mem;
+    return count;
+}
+
+static HeapFreeBlock* alloc_small_block(HeapThreadCache* cache, u32 classIdx)
+{
+    if (!cache)
+    {
+        // thread is exiting, don't fill a cache nobody will flush. Keep one block and share the rest
+        HeapFreeBlock* first = nullptr;
+        u32 count = acquire_batch(classIdx, first);
+        if (!count) return nullptr;
+        if (count > 1) release_batch(classIdx, first->next, count - 1);
+        return first;
+    }
+    HeapThreadSizeClass& local = cache->classes[classIdx];
+    if (!local.hot)
+    {
+        if (local.spare)
+        {
+            local.hot = local.spare;
+            local.numHot = local.numSpare;
+            local.spare = nullptr;
+            local.numSpare = 0;
+        }
+        else
+        {
+            local.numHot = acquire_batch(classIdx, local.hot);
+            if (!local.numHot) return nullptr;
+        }
+    }
+    HeapFreeBlock* block = local.hot;
+    local.hot = block->next;
+    local.numHot--;
+    return block;
+}
+
+static void free_small_block(HeapThreadCache* cache, u32 classIdx, HeapFreeBlock* block)
+{
+    if (!cache)
+    {
+        block->next = nullptr;
+        release_batch(classIdx, block, 1);
+        return;
+    }
+    HeapThreadSizeClass& local = cache->classes[classIdx];
+    if (local.numHot >= size_class_batch(classIdx))
+    {
+        // hand a batch back so memory freed on this thread can be reused by others (I.E. producer/consumer threads)
+        if (local.spare)
+        {
+            release_batch(classIdx, local.spare, local.numSpare);
+        }
+        local.spare = local.hot;
+        local.numSpare = local.numHot;
+        local.hot = nullptr;
+        local.numHot = 0;
+    }
+    block->next = local.hot;
+    local.hot = block;
+    local.numHot++;
+}
+
+HeapThreadCacheFlusher::~HeapThreadCacheFlusher()
+{
+    HeapThreadCache& cache = tlsHeapCache;
+    HeapThreadStats& stats = cache.stats;
+    for (u32 i = 0; i < HEAP_NUM_SIZE_CLASSES; i++)
+    {
+        HeapThreadSizeClass& local = cache.classes[i];
+        if (local.hot) release_batch(i, local.hot, local.numHot);
+        if (local.spare) release_batch(i, local.spare, local.numSpare);
+        local = {};
+    }
+    if (cache.isRegistered)
+    {
+        heapThreadsLock.lock();
+        for (u32 i = 0; i < (u32)MemTag::NUM_TAGS; i++)
+        {
+            stat_add(heapRetiredStats.liveBytes[i], stats.liveBytes[i].load(std::memory_order_relaxed));
+            stat_add(heapRetiredStats.numAllocs[i], stats.numAllocs[i].load(std::memory_order_relaxed));
+            stat_add(heapRetiredStats.numFrees[i], stats.numFrees[i].load(std::memory_order_relaxed));
+        }
+        stat_add(heapRetiredStats.largeLiveBytes, stats.largeLiveBytes.load(std::memory_order_relaxed));
+        if (cache.prev) cache.prev->next = cache.next;
+        else heapThreads = cache.next;
+        if (cache.next) cache.next->prev = cache.prev;
+        cache.isRegistered = false;
+        heapThreadsLock.unlock();
+    }
+    cache.isShutDown = true;
+}
+
+// ============ api ============
+
+void* heap_alloc(size_t size, MemTag tag)
+{
+    if (size > ((size_t)-1) - sizeof(HeapBlockHeader)) return nullptr;
+    size_t blockSize = size + sizeof(HeapBlockHeader);
+    HeapThreadCache* cache = get_thread_cache();
+    HeapBlockHeader* header = nullptr;
+    bool isLarge = blockSize > HEAP_MAX_SMALL_BLOCK;
+    if (!isLarge)
+    {
+        u32 classIdx = size_class_index(blockSize);
+        header = (HeapBlockHeader*)alloc_small_block(cache, classIdx);
+        if (!header) return nullptr;
+        header->sizeClass = (u8)classIdx;
+    }
+    else
+    {
+        // malloc's alignment (alignof(max_align_t)) covers HEAP_ALIGNMENT everywhere we build
+        header = (HeapBlockHeader*)malloc(blockSize);
+        if (!header) return nullptr;
+        header->sizeClass = HEAP_LARGE_CLASS;
+    }
+    header->size = size;
+    header->tag = (u8)tag;
+    record_alloc(cache, tag, size, isLarge);
+    void* result = header + 1;
+    PROFILE_ALLOC(result, size, heapTagNames[(u32)tag]);
+    return result;
+}
+
+void heap_free(void* ptr)
+{
+    if (!ptr) return;
+    HeapBlockHeader* header = (HeapBlockHeader*)ptr - 1;
+    TINY_ASSERT(header->sizeClass != HEAP_FREED_CLASS && "Double free");
+    TINY_ASSERT((header->sizeClass < HEAP_NUM_SIZE_CLASSES || header->sizeClass == HEAP_LARGE_CLASS) && "Freeing memory that didn't come from heap_alloc");
+    MemTag tag = (MemTag)header->tag;
+    PROFILE_FREE(ptr, heapTagNames[(u32)tag]);
+    HeapThreadCache* cache = get_thread_cache();
+    if (header->sizeClass == HEAP_LARGE_CLASS)
+    {
+        record_free(cache, tag, header->size, true);
+        free(header);
+        return;
+    }
+    u32 classIdx = header->sizeClass;
+    record_free(cache, tag, header->size, false);
+    header->sizeClass = HEAP_FREED_CLASS;
+    free_small_block(cache, classIdx, (HeapFreeBlock*)header);
+}
+
+void* heap_realloc(void* ptr, size_t size)
+{
+    if (!ptr) return heap_alloc(size);
+    if (size == 0)
+    {
+        heap_free(ptr);
+        return nullptr;
+    }
+    HeapBlockHeader* header = (HeapBlockHeader*)ptr - 1;
+    MemTag tag = (MemTag)header->tag;
+    size_t blockSize = size + sizeof(HeapBlockHeader);
+    if (header->sizeClass == HEAP_LARGE_CLASS && blockSize > HEAP_MAX_SMALL_BLOCK)
+    {
+        // stays large, let the system allocator grow it in place if it can
+        u64 oldSize = header->size;
+        PROFILE_FREE(ptr, heapTagNames[(u32)tag]);
+        HeapBlockHeader* newHeader = (HeapBlockHeader*)realloc(header, blockSize);
+        if (!newHeader) return nullptr;
+        newHeader->size = size;
+        HeapThreadCache* cache = get_thread_cache();
+        record_free(cache, tag, oldSize, true);
+        record_alloc(cache, tag, size, true);
+        void* result = newHeader + 1;
+        PROFILE_ALLOC(result, size, heapTagNames[(u32)tag]);
+        return result;
+    }
+    if (header->sizeClass != HEAP_LARGE_CLASS)
+    {
+        // still fits the block, and isn't shrinking so much that it's hogging a block twice its size
+        u32 blockBytes = size_class_bytes(header->sizeClass);
+        if (blockSize <= blockBytes && blockSize * 2 > blockBytes)
+        {
+            HeapThreadCache* cache = get_thread_cache();
+            record_free(cache, tag, header->size, false);
+            record_alloc(cache, tag, size, false);
+            header->size = size;
+            return ptr;
+        }
+    }
+    void* newMem = heap_alloc(size, tag);
+    if (!newMem) return nullptr;
+    TMEMCPY(newMem, ptr, header->size < size ? header->size : size);
+    heap_free(ptr);
+    return newMem;
+}
+
+size_t heap_usable_size(void* ptr)
+{
+    HeapBlockHeader* header = (HeapBlockHeader*)ptr - 1;
+    if (header->sizeClass == HEAP_LARGE_CLASS) return header->size;
+    return size_class_bytes(header->sizeClass) - sizeof(HeapBlockHeader);
+}
+
+void heap_get_stats(HeapStats* stats)
+{
+    *stats = {};
+    heapThreadsLock.lock();
+    accumulate_stats(stats, heapRetiredStats);
+    for (HeapThreadCache* cache = heapThreads; cache; cache = cache->next)
+    {
+        accumulate_stats(stats, cache->stats);
+    }
+    heapThreadsLock.unlock();
+    stats->smallBlockBytes = heapSmallBlockBytes.load(std::memory_order_relaxed);
+}
+
+const char* heap_tag_name(MemTag tag)
+{
+    return (u32)tag < (u32)MemTag::NUM_TAGS ? heapTagNames[(u32)tag] : "Unknown";
+}
+
+// ============ tests ============
+
+#include "containers/mpmc_queue.h"
+#include <vector>
+#include <chrono>
+
+static u64 HeapTagLiveBytes(MemTag tag)
+{
+    HeapStats stats;
+    heap_get_stats(&stats);
+    return stats.tags[(u32)tag].liveBytes;
+}
+
+void HeapTests()
+{
+    LOG_INFO("Running Heap tests...");
+    // size classes cover every small size, are ordered, and every class is its own best fit
+    {
+        for (u32 i = 0; i < HEAP_NUM_SIZE_CLASSES; i++)
+        {
+            TINY_ASSERT(size_class_bytes(i) % HEAP_ALIGNMENT == 0);
+            TINY_ASSERT(size_class_index(size_class_bytes(i)) == i);
+            if (i > 0) TINY_ASSERT(size_class_bytes(i) > size_class_bytes(i - 1));
+        }
+        TINY_ASSERT(size_class_bytes(HEAP_NUM_SIZE_CLASSES - 1) == HEAP_MAX_SMALL_BLOCK);
+        for (u32 blockSize = 1; blockSize <= HEAP_MAX_SMALL_BLOCK; blockSize++)
+        {
+            u32 classIdx = size_class_index(blockSize);
+            TINY_ASSERT(classIdx < HEAP_NUM_SIZE_CLASSES && size_class_bytes(classIdx) >= blockSize);
+            // never more than 25% waste past the first few classes
+            TINY_ASSERT(blockSize <= 128 || size_class_bytes(classIdx) - blockSize < blockSize / 4);
+        }
+    }
+    // alignment, usable size, reuse, stats
+    {
+        u64 liveBefore = HeapTagLiveBytes(MemTag::CONTAINERS);
+        const size_t sizes[] = { 0, 1, 15, 16, 17, 100, 128, 129, 1000, 4096, HEAP_MAX_SMALL_BLOCK - 16, HEAP_MAX_SMALL_BLOCK, MEGABYTES_BYTES(3) };
+        void* allocs[ARRAY_SIZE(sizes)] = {};
+        u64 totalSize = 0;
+        for (u32 i = 0; i < ARRAY_SIZE(sizes); i++)
+        {
+            allocs[i] = heap_alloc(sizes[i], MemTag::CONTAINERS);
+            TINY_ASSERT(allocs[i] && ((uintptr_t)allocs[i] & (HEAP_ALIGNMENT - 1)) == 0);
+            TINY_ASSERT(heap_usable_size(allocs[i]) >= sizes[i]);
+            TMEMSET(allocs[i], (int)i, sizes[i]);
+            totalSize += sizes[i];
+        }
+        TINY_ASSERT(HeapTagLiveBytes(MemTag::CONTAINERS) - liveBefore == totalSize);
+        for (u32 i = 0; i < ARRAY_SIZE(sizes); i++)
+        {
+            if (sizes[i]) TINY_ASSERT(((u8*)allocs[i])[sizes[i] - 1] == (u8)i);
+            heap_free(allocs[i]);
+        }
+        TINY_ASSERT(HeapTagLiveBytes(MemTag::CONTAINERS) == liveBefore);
+        // most recently freed block of a size class is the next one handed out
+        void* a = heap_alloc(48);
+        heap_free(a);
+        void* b = heap_alloc(40);
+        TINY_ASSERT(a == b);
+        heap_free(b);
+        heap_free(nullptr);
+    }
+    // realloc keeps contents and tag across small/large blocks
+    {
+        u64 liveBefore = HeapTagLiveBytes(MemTag::ASSETS);
+        u8* mem = (u8*)heap_realloc(nullptr, 20);
+        heap_free(mem);
+        mem = (u8*)heap_alloc(20, MemTag::ASSETS);
+        for (u32 i = 0; i < 20; i++) mem[i] = (u8)i;
+        u8* same = (u8*)heap_realloc(mem, 24); // same size class, stays put
+        TINY_ASSERT(same == mem);
+        size_t size = 24;
+        while (size < MEGABYTES_BYTES(2))
+        {
+            size *= 3;
+            mem = (u8*)heap_realloc(mem, size);
+            for (u32 i = 0; i < 20; i++) TINY_ASSERT(mem[i] == (u8)i);
+            TINY_ASSERT(HeapTagLiveBytes(MemTag::ASSETS) - liveBefore == size);
+        }
+        mem = (u8*)heap_realloc(mem, 10);
+        for (u32 i = 0; i < 10; i++) TINY_ASSERT(mem[i] == (u8)i);
+        TINY_ASSERT(HeapTagLiveBytes(MemTag::ASSETS) - liveBefore == 10);
+        TINY_ASSERT(heap_realloc(mem, 0) == nullptr);
+        TINY_ASSERT(HeapTagLiveBytes(MemTag::ASSETS) == liveBefore);
+    }
+    // blocks freed on other threads, and by threads that have since exited, get reused instead of carving more
+    {
+        u64 liveBefore = HeapTagLiveBytes(MemTag::JOBS);
+        constexpr u32 numProducers = 2;
+        constexpr u32 numConsumers = 2;
+        constexpr u32 allocsPerProducer = 50000;
+        auto runHandoff = []() {
+            MPMCQueue<void*, 256>* handoff = new MPMCQueue<void*, 256>();
+            std::atomic<u32> numFreed = 0;
+            std::vector<std::thread> threads;
+            for (u32 p = 0; p < numProducers; p++)
+            {
+                threads.emplace_back([handoff, p]() {
+                    for (u32 i = 0; i < allocsPerProducer; i++)
+                    {
+                        u32 size = 8 + ((i * 7919 + p) % 600);
+                        u8* mem = (u8*)heap_alloc(size, MemTag::JOBS);
+                        *(u32*)mem = size;
+                        mem[size - 1] = (u8)size;
+                        while (!handoff->push_back(mem)) { std::this_thread::yield(); }
+                    }
+                });
+            }
+            for (u32 c = 0; c < numConsumers; c++)
+            {
+                threads.emplace_back([handoff, &numFreed]() {
+                    void* mem = nullptr;
+                    while (numFreed.load() < numProducers * allocsPerProducer)
+                    {
+                        if (!handoff->pop_front(mem)) { std::this_thread::yield(); continue; }
+                        u32 size = *(u32*)mem;
+                        TINY_ASSERT(heap_usable_size(mem) >= size && ((u8*)mem)[size - 1] == (u8)size);
+                        heap_free(mem);
+                        numFreed++;
+                    }
+                });
+            }
+            for (std::thread& thread : threads) thread.join();
+            delete handoff;
+        };
+        runHandoff();
+        HeapStats stats;
+        heap_get_stats(&stats);
+        u64 carvedAfterFirst = stats.smallBlockBytes;
+        TINY_ASSERT(stats.tags[(u32)MemTag::JOBS].liveBytes == liveBefore);
+        // same workload on fresh threads runs entirely off the blocks the first run left in the shared lists
+        runHandoff();
+        heap_get_stats(&stats);
+        TINY_ASSERT(stats.tags[(u32)MemTag::JOBS].liveBytes == liveBefore);
+        TINY_ASSERT(stats.smallBlockBytes - carvedAfterFirst < carvedAfterFirst);
+    }
+    LOG_INFO("Heap tests passed");
+}
+
+// ============ benchmarks ============
+
+struct HeapBenchAllocator
+{
+    const char* name;
+    void* (*alloc)(size_t size);
+    void (*free)(void* mem);
+};
+
+static void* HeapBenchHeapAlloc(size_t size) { return heap_alloc(size); }
+static void HeapBenchHeapFree(void* mem) { heap_free(mem); }
+static void* HeapBenchMalloc(size_t size) { return malloc(size); }
+static void HeapBenchFree(void* mem) { free(mem); }
+
+// keeps a working set of live allocations of random small sizes, and keeps replacing random ones. Returns ns per alloc+free
+static f64 BenchmarkHeapChurn(const HeapBenchAllocator& allocator, u32 numThreads, u32 workingSet, u32 opsPerThread, u32 maxSize)
+{
+    std::vector<std::thread> threads;
+    std::atomic<bool> go = false;
+    for (u32 t = 0; t < numThreads; t++)
+    {
+        threads.emplace_back([&allocator, &go, t, workingSet, opsPerThread, maxSize]() {
+            void** live = (void**)malloc(sizeof(void*) * workingSet);
+            u32 rng = 0x12345 + t * 0x9E3779B9;
+            auto next = [&rng]() { rng ^= rng << 13; rng ^= rng >> 17; rng ^= rng << 5; return rng; };
+            for (u32 i = 0; i < workingSet; i++) live[i] = allocator.alloc(8 + next() % maxSize);
+            while (!go) { std::this_thread::yield(); }
+            for (u32 i = 0; i < opsPerThread; i++)
+            {
+                u32 slot = next() % workingSet;
+                allocator.free(live[slot]);
+                u32 size = 8 + next() % maxSize;
+                live[slot] = allocator.alloc(size);
+                *(u32*)live[slot] = size;
+            }
+            for (u32 i = 0; i < workingSet; i++) allocator.free(live[i]);
+            free(live);
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    auto start = std::chrono::high_resolution_clock::now();
+    go = true;
+    for (std::thread& thread : threads) thread.join();
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<f64, std::nano>(end - start).count() / ((f64)numThreads * opsPerThread);
+}
+
+// lots of small arrays growing one element at a time through realloc, like DynArray/FixedGrowableArray spill. Returns ms
+static f64 BenchmarkHeapGrowth(const HeapBenchAllocator& allocator, void* (*reallocFn)(void*, size_t))
+{
+    constexpr u32 numArrays = 2000;
+    constexpr u32 finalSize = 512;
+    void** arrays = (void**)malloc(sizeof(void*) * numArrays);
+    u32* capacities = (u32*)malloc(sizeof(u32) * numArrays);
+    auto start = std::chrono::high_resolution_clock::now();
+    for (u32 i = 0; i < numArrays; i++)
+    {
+        arrays[i] = allocator.alloc(sizeof(u32) * 4);
+        capacities[i] = 4;
+    }
+    for (u32 size = 0; size < finalSize; size++)
+    {
+        for (u32 i = 0; i < numArrays; i++)
+        {
+            if (size == capacities[i])
+            {
+                capacities[i] = capacities[i] + capacities[i] / 2;
+                arrays[i] = reallocFn(arrays[i], sizeof(u32) * capacities[i]);
+            }
+            ((u32*)arrays[i])[size] = size;
+        }
+    }
+    for (u32 i = 0; i < numArrays; i++) allocator.free(arrays[i]);
+    auto end = std::chrono::high_resolution_clock::now();
+    free(arrays);
+    free(capacities);
+    return std::chrono::duration<f64, std::milli>(end - start).count();
+}
+
+void HeapBenchmarks()
+{
+    LOG_INFO("Running Heap benchmarks...");
+    const HeapBenchAllocator heap = { "heap_alloc", HeapBenchHeapAlloc, HeapBenchHeapFree };
+    const HeapBenchAllocator system = { "malloc", HeapBenchMalloc, HeapBenchFree };
+    struct ChurnConfig { u32 numThreads; u32 workingSet; u32 maxSize; };
+    const ChurnConfig configs[] = { {1, 10000, 128}, {1, 10000, 1024}, {1, 100000, 4096}, {4, 10000, 256}, {8, 10000, 256} };
+    constexpr u32 opsPerThread = 1000000;
+    for (u32 i = 0; i < ARRAY_SIZE(configs); i++)
+    {
+        const ChurnConfig& config = configs[i];
+        f64 mallocNs = BenchmarkHeapChurn(system, config.numThreads, config.workingSet, opsPerThread, config.maxSize);
+        f64 heapNs = BenchmarkHeapChurn(heap, config.numThreads, config.workingSet, opsPerThread, config.maxSize);
+        LOG_INFO("[HEAP] churn %u threads, %6u live, 8-%4u bytes | malloc: %6.2f ns | heap_alloc: %6.2f ns | %.2fx",
+            config.numThreads, config.workingSet, config.maxSize + 8, mallocNs, heapNs, mallocNs / heapNs);
+    }
+    // second run of each, once both have the memory mapped in
+    BenchmarkHeapGrowth(system, realloc);
+    f64 mallocGrowthMs = BenchmarkHeapGrowth(system, realloc);
+    BenchmarkHeapGrowth(heap, heap_realloc);
+    f64 heapGrowthMs = BenchmarkHeapGrowth(heap, heap_realloc);
+    LOG_INFO("[HEAP] realloc growth | malloc: %6.2f ms | heap_alloc: %6.2f ms | %.2fx", mallocGrowthMs, heapGrowthMs, mallocGrowthMs / heapGrowthMs);
+    HeapStats stats;
+    heap_get_stats(&stats);
+    LOG_INFO("[HEAP] small blocks carved: %llu KB", stats.smallBlockBytes / 1024);
+    LOG_INFO("Heap benchmarks complete");
+}
@@ -0,0 +1,68 @@
+#ifndef TINY_HEAP_H
+#define TINY_HEAP_H
+
+#include "tiny_defines.h"
+#include <stddef.h>
+
+// General purpose engine heap. Backs TSYSALLOC/TSYSREALLOC/TSYSFREE (see tiny_mem.h)
+// Small allocations (up to HEAP_MAX_SMALL_BLOCK including a 16 byte header) are rounded up to one of HEAP_NUM_SIZE_CLASSES
+// size classes: 16 byte steps from 32 up to 128 bytes, then 4 classes per power of two.
+// Blocks are carved in batches out of one virtual arena, and are never handed back to the OS - a freed block goes back to
+// its size class and gets reused, so a long session settles into a steady set of pages instead of faulting new ones in
+// and fragmenting the system heap.
+// Every thread has a cache of free blocks per size class, so most allocs/frees don't take a lock. Caches trade batches
+// of blocks with a shared per-class list when they run dry or overflow.
+// Anything bigger goes straight to the system allocator.
+
+// who an allocation is for. Each tag gets its own totals in HeapStats
+enum class MemTag : u8
+{
+    GENERAL = 0,
+    CONTAINERS,
+    ASSETS,
+    JOBS,
+    POOLS,
+    GAME,
+    ENTITIES,
+
+    NUM_TAGS,
+};
+
+#define HEAP_ALIGNMENT 16
+#define HEAP_NUM_SIZE_CLASSES 39
+#define HEAP_MAX_SMALL_BLOCK KILOBYTES_BYTES(32)
+// address space reserved for small blocks. Only what's actually carved out gets committed
+#define HEAP_RESERVE_SIZE GIGABYTES_BYTES((size_t)64)
+
+struct HeapTagStats
+{
+    // bytes the caller asked for, not counting headers/size class rounding
+    u64 liveBytes = 0;
+    u64 liveAllocations = 0;
+    u64 totalAllocations = 0;
+};
+
+struct HeapStats
+{
+    HeapTagStats tags[(u32)MemTag::NUM_TAGS] = {};
+    // small block memory carved out of the heap arena so far (live + sitting in free lists). Never goes down
+    u64 smallBlockBytes = 0;
+    u64 largeLiveBytes = 0;
+};
+
+// every pointer handed out is aligned to HEAP_ALIGNMENT. Returns null if the system is out of memory
+TAPI void* heap_alloc(size_t size, MemTag tag = MemTag::GENERAL);
+// same semantics as realloc. Keeps the allocation's tag
+TAPI void* heap_realloc(void* ptr, size_t size);
+// safe to call with null, and from any thread (not just the one that allocated)
+TAPI void heap_free(void* ptr);
+// how many bytes can actually be used at ptr (>= the size that was asked for)
+TAPI size_t heap_usable_size(void* ptr);
+// snapshot of the counters. Not synchronized with other threads allocating, so totals can be off by in-flight allocations
+TAPI void heap_get_stats(HeapStats* stats);
+TAPI const char* heap_tag_name(MemTag tag);
+TAPI void HeapTests();
+// allocation heavy workloads, engine heap vs malloc
+TAPI void HeapBenchmarks();
+
+#endif
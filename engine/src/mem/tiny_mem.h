@@ -2,12 +2,25 @@
 #define TINY_MEM_H
 
 #include <string.h>
+#include "mem/tiny_heap.h"
 
 // TODO: profile allocations
 
+// define to send everything straight to the CRT allocator (I.E. when chasing memory bugs with system tools)
+//#define TINY_USE_SYSTEM_ALLOCATOR
+#ifdef TINY_USE_SYSTEM_ALLOCATOR
+#include <stdlib.h>
 #define TSYSALLOC(size) malloc(size)
+#define TSYSALLOC_TAGGED(size, tag) malloc(size)
 #define TSYSREALLOC(ptr, size) realloc(ptr, size)
 #define TSYSFREE(ptr) { free(ptr); (ptr)=0; }
+#else
+#define TSYSALLOC(size) heap_alloc(size)
+// tag shows up in the per-system totals of heap_get_stats
+#define TSYSALLOC_TAGGED(size, tag) heap_alloc(size, tag)
+#define TSYSREALLOC(ptr, size) heap_realloc(ptr, size)
+#define TSYSFREE(ptr) { heap_free(ptr); (ptr)=0; }
+#endif
 #define TMEMSET(ptr, val, size) memset(ptr, val, size)
 #define TMEMCPY(dst, src, size) memcpy(dst, src, size)
 #define TMEMMOVE(dst, src, size) memmove(dst, src, size)
@@ -0,0 +1,227 @@
+//#include "pch.h"
+#include "mem/tiny_pool.h"
+#include "containers/mpmc_queue.h"
+
+#include <thread>
+#include <vector>
+#include <chrono>
+
+struct PoolTestObject
+{
+    static inline std::atomic<s32> numAlive = 0;
+    u32 value = 0;
+    u8 padding[60] = {};
+    PoolTestObject(u32 value) : value(value) { numAlive++; }
+    ~PoolTestObject() { numAlive--; }
+};
+
+static void SingleThreadedPoolTests()
+{
+    Pool<PoolTestObject, 16> pool;
+    // default handles never resolve
+    TINY_ASSERT(!pool.is_valid(PoolHandle<PoolTestObject>{}));
+    TINY_ASSERT(!pool.destroy(PoolHandle<PoolTestObject>{}));
+    PoolHandle<PoolTestObject> a = pool.create(1u);
+    PoolHandle<PoolTestObject> b = pool.create(2u);
+    TINY_ASSERT(pool.get(a)->value == 1 && pool.get(b)->value == 2);
+    TINY_ASSERT(pool.size() == 2 && PoolTestObject::numAlive == 2);
+    // stale handles are caught, even once the slot has been reused
+    TINY_ASSERT(pool.destroy(a));
+    TINY_ASSERT(PoolTestObject::numAlive == 1);
+    TINY_ASSERT(!pool.is_valid(a));
+    TINY_ASSERT(!pool.destroy(a));
+    PoolHandle<PoolTestObject> c = pool.create(3u);
+    TINY_ASSERT(c.index == a.index && c.generation != a.generation); // freed slot is reused first
+    TINY_ASSERT(!pool.is_valid(a) && pool.get(c)->value == 3);
+    // growing across chunks doesn't move existing objects
+    PoolTestObject* bPtr = pool.get(b);
+    std::vector<PoolHandle<PoolTestObject>> handles;
+    for (u32 i = 0; i < 1000; i++)
+    {
+        handles.push_back(pool.create(100 + i));
+    }
+    TINY_ASSERT(pool.get(b) == bPtr && bPtr->value == 2);
+    TINY_ASSERT(pool.capacity() >= 1002 && pool.size() == 1002);
+    for (u32 i = 0; i < handles.size(); i++)
+    {
+        TINY_ASSERT(pool.get(handles[i])->value == 100 + i);
+    }
+    // free every other one, and make sure for_each only visits the live ones
+    for (u32 i = 0; i < handles.size(); i += 2)
+    {
+        TINY_ASSERT(pool.destroy(handles[i]));
+    }
+    u32 visited = 0;
+    u64 valueSum = 0;
+    pool.for_each([&](PoolHandle<PoolTestObject> handle, PoolTestObject& obj) {
+        TINY_ASSERT(pool.get(handle) == &obj);
+        visited++;
+        valueSum += obj.value;
+    });
+    u64 expectedSum = 2 + 3;
+    for (u32 i = 1; i < handles.size(); i += 2) expectedSum += 100 + i;
+    TINY_ASSERT(visited == pool.size() && visited == 2 + 500 && valueSum == expectedSum);
+    // filling the holes back up doesn't grow the pool
+    u32 capacityBefore = pool.capacity();
+    for (u32 i = 0; i < 500; i++) pool.create(0u);
+    TINY_ASSERT(pool.capacity() == capacityBefore);
+    // clear destroys everything and invalidates all handles
+    pool.clear();
+    TINY_ASSERT(pool.size() == 0 && PoolTestObject::numAlive == 0);
+    TINY_ASSERT(!pool.is_valid(b) && !pool.is_valid(c) && !pool.is_valid(handles[1]));
+    PoolHandle<PoolTestObject> afterClear = pool.create(7u);
+    TINY_ASSERT(!pool.is_valid(b) && pool.get(afterClear)->value == 7);
+}
+
+static void ConcurrentPoolTests()
+{
+    // producers allocate and hand the handles over to consumers, who free them. Every object is freed exactly once on
+    // a different thread than it was made on
+    constexpr u32 numProducers = 4;
+    constexpr u32 numConsumers = 4;
+    constexpr u32 itemsPerProducer = 20000;
+    ConcurrentPool<PoolTestObject, 64>* pool = new ConcurrentPool<PoolTestObject, 64>();
+    MPMCQueue<PoolHandle<PoolTestObject>, 1024>* handoff = new MPMCQueue<PoolHandle<PoolTestObject>, 1024>();
+    std::atomic<u32> numFreed = 0;
+    std::atomic<u32> numCorrupt = 0;
+    std::vector<std::thread> threads;
+    for (u32 p = 0; p < numProducers; p++)
+    {
+        threads.emplace_back([pool, handoff, p]() {
+            for (u32 i = 0; i < itemsPerProducer; i++)
+            {
+                PoolHandle<PoolTestObject> handle = pool->create(p * itemsPerProducer + i);
+                while (!handoff->push_back(handle)) { std::this_thread::yield(); }
+            }
+        });
+    }
+    for (u32 c = 0; c < numConsumers; c++)
+    {
+        threads.emplace_back([pool, handoff, &numFreed, &numCorrupt]() {
+            PoolHandle<PoolTestObject> handle;
+            while (numFreed.load() < numProducers * itemsPerProducer)
+            {
+                if (!handoff->pop_front(handle))
+                {
+                    std::this_thread::yield();
+                    continue;
+                }
+                PoolTestObject* obj = pool->get(handle);
+                // objects are only ever handed to one consumer, so nobody else can have freed or reused this slot
+                if (!obj || obj->value >= numProducers * itemsPerProducer) numCorrupt++;
+                if (!pool->destroy(handle)) numCorrupt++;
+                if (pool->destroy(handle)) numCorrupt++; // double free is rejected
+                numFreed++;
+            }
+        });
+    }
+    for (std::thread& thread : threads) thread.join();
+    TINY_ASSERT(numCorrupt.load() == 0);
+    TINY_ASSERT(pool->size() == 0);
+    // handoff keeps the number of live objects bounded, so slots were recycled instead of growing forever
+    TINY_ASSERT(pool->capacity() < numProducers * itemsPerProducer);
+    delete handoff;
+    delete pool;
+    TINY_ASSERT(PoolTestObject::numAlive == 0);
+
+    // racing frees of the same handle only destroy the object once
+    ConcurrentPool<PoolTestObject>* racePool = new ConcurrentPool<PoolTestObject>();
+    for (u32 round = 0; round < 1000; round++)
+    {
+        PoolHandle<PoolTestObject> handle = racePool->create(round);
+        std::atomic<u32> numWon = 0;
+        std::thread first([&]() { if (racePool->destroy(handle)) numWon++; });
+        std::thread second([&]() { if (racePool->destroy(handle)) numWon++; });
+        first.join();
+        second.join();
+        TINY_ASSERT(numWon.load() == 1);
+    }
+    TINY_ASSERT(racePool->size() == 0 && PoolTestObject::numAlive == 0);
+    delete racePool;
+}
+
+void PoolTests()
+{
+    LOG_INFO("Running Pool tests...");
+    SingleThreadedPoolTests();
+    TINY_ASSERT(PoolTestObject::numAlive == 0);
+    ConcurrentPoolTests();
+    LOG_INFO("Pool tests passed");
+}
+
+// roughly what a texture/material record weighs
+struct PoolBenchObject
+{
+    u32 id = 0;
+    u8 payload[124] = {};
+    PoolBenchObject(u32 id) : id(id) {}
+};
+
+// Allocates numObjects, frees them in a shuffled order, allocates them all again. Repeated a few times,
+// the second time around is the steady state for a pool (everything comes off the free list). Returns ns per alloc+free
+template <typename AllocFunc, typename FreeFunc, typename HandleType>
+static f64 BenchmarkChurn(u32 numObjects, u32 numRounds, const u32* shuffledOrder, HandleType* handles, AllocFunc allocFn, FreeFunc freeFn)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    for (u32 round = 0; round < numRounds; round++)
+    {
+        for (u32 i = 0; i < numObjects; i++)
+        {
+            handles[i] = allocFn(i);
+        }
+        for (u32 i = 0; i < numObjects; i++)
+        {
+            freeFn(handles[shuffledOrder[i]]);
+        }
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    f64 ns = std::chrono::duration<f64, std::nano>(end - start).count();
+    return ns / ((f64)numObjects * numRounds);
+}
+
+void PoolBenchmarks()
+{
+    LOG_INFO("Running Pool benchmarks...");
+    constexpr u32 numObjects = 100000;
+    constexpr u32 numRounds = 10;
+    u32* order = (u32*)TSYSALLOC(sizeof(u32) * numObjects);
+    for (u32 i = 0; i < numObjects; i++) order[i] = i;
+    u32 rng = 0x9E3779B9;
+    for (u32 i = numObjects - 1; i > 0; i--)
+    {
+        rng ^= rng << 13; rng ^= rng >> 17; rng ^= rng << 5;
+        u32 j = rng % (i + 1);
+        u32 tmp = order[i]; order[i] = order[j]; order[j] = tmp;
+    }
+
+    PoolBenchObject** pointers = (PoolBenchObject**)TSYSALLOC(sizeof(PoolBenchObject*) * numObjects);
+    f64 mallocNs = BenchmarkChurn(numObjects, numRounds, order, pointers,
+        [](u32 i) { PoolBenchObject* obj = (PoolBenchObject*)TSYSALLOC(sizeof(PoolBenchObject)); new(obj) PoolBenchObject(i); return obj; },
+        [](PoolBenchObject* obj) { obj->~PoolBenchObject(); TSYSFREE(obj); });
+    f64 newNs = BenchmarkChurn(numObjects, numRounds, order, pointers,
+        [](u32 i) { return new PoolBenchObject(i); },
+        [](PoolBenchObject* obj) { delete obj; });
+    TSYSFREE(pointers);
+
+    PoolHandle<PoolBenchObject>* handles = (PoolHandle<PoolBenchObject>*)TSYSALLOC(sizeof(PoolHandle<PoolBenchObject>) * numObjects);
+    Pool<PoolBenchObject>* pool = new Pool<PoolBenchObject>();
+    f64 poolNs = BenchmarkChurn(numObjects, numRounds, order, handles,
+        [pool](u32 i) { return pool->create(i); },
+        [pool](PoolHandle<PoolBenchObject> handle) { pool->destroy(handle); });
+    delete pool;
+    ConcurrentPool<PoolBenchObject>* concurrentPool = new ConcurrentPool<PoolBenchObject>();
+    f64 concurrentPoolNs = BenchmarkChurn(numObjects, numRounds, order, handles,
+        [concurrentPool](u32 i) { return concurrentPool->create(i); },
+        [concurrentPool](PoolHandle<PoolBenchObject> handle) { concurrentPool->destroy(handle); });
+    delete concurrentPool;
+    TSYSFREE(handles);
+    TSYSFREE(order);
+
+    LOG_INFO("[POOL] %u objects of %u bytes, %u rounds of alloc all/free all in random order (ns per alloc+free)",
+        numObjects, (u32)sizeof(PoolBenchObject), numRounds);
+    LOG_INFO("[POOL] TSYSALLOC/FREE: %6.2f ns", mallocNs);
+    LOG_INFO("[POOL] new/delete:     %6.2f ns", newNs);
+    LOG_INFO("[POOL] Pool:           %6.2f ns | %.2fx vs TSYSALLOC", poolNs, mallocNs / poolNs);
+    LOG_INFO("[POOL] ConcurrentPool: %6.2f ns | %.2fx vs TSYSALLOC", concurrentPoolNs, mallocNs / concurrentPoolNs);
+    LOG_INFO("Pool benchmarks complete");
+}
@@ -0,0 +1,373 @@
+#ifndef TINY_POOL_H
+#define TINY_POOL_H
+
+#include "tiny_defines.h"
+#include "mem/tiny_mem.h"
+#include "tiny_log.h"
+#include <new>
+#include <utility>
+#include <cstddef>
+#include <atomic>
+#include <mutex>
+
+// Typed object pools with generational handles
+// Objects live in fixed size chunks that are only freed with the pool itself, so a pointer from get() stays put for as long
+// as the object is alive and adding objects never moves the existing ones.
+// Free slots are chained through their own storage like FixedBlockAllocator's blocks, but by slot index instead of pointer
+// so the list can span chunks. Both create and destroy are O(1) and nothing is allocated per object.
+// Every slot has a generation that is bumped on create and again on destroy (odd = alive). Handles remember the generation they
+// were made with, so a handle to a destroyed object stops resolving instead of quietly pointing at whatever reused its slot.
+//
+// Pool is single threaded. ConcurrentPool objects can be created and destroyed from any thread without locks
+// (a lock is only taken to add a chunk)
+
+#define POOL_INVALID_INDEX 0xFFFFFFFF
+// ConcurrentPool's chunk table can't be reallocated while other threads are reading it, so it's a fixed size
+#define CONCURRENT_POOL_MAX_CHUNKS 1024
+
+template <typename T>
+struct PoolHandle
+{
+    u32 index = POOL_INVALID_INDEX;
+    // live generations are always odd, so a default handle never resolves
+    u32 generation = 0;
+    inline bool operator==(const PoolHandle& other) const { return index == other.index && generation == other.generation; }
+    inline bool operator!=(const PoolHandle& other) const { return !(*this == other); }
+};
+
+template <typename T, u32 _chunkSize = 256>
+class Pool
+{
+    static_assert(_chunkSize > 0 && (_chunkSize & (_chunkSize - 1)) == 0, "Pool chunk size must be a power of two");
+    static_assert(alignof(T) <= alignof(std::max_align_t), "Pool chunks come from TSYSALLOC, can't over-align");
+public:
+
+    Pool() = default;
+    Pool(const Pool&) = delete;
+    Pool& operator=(const Pool&) = delete;
+    ~Pool()
+    {
+        clear();
+        for (u32 i = 0; i < numChunks; i++)
+        {
+            TSYSFREE(chunks[i]);
+        }
+        if (chunks)
+        {
+            TSYSFREE(chunks);
+        }
+    }
+
+    // constructs a T in a free slot
+    template <typename... Args>
+    PoolHandle<T> create(Args&&... args)
+    {
+        u32 index = freeHead;
+        if (index != POOL_INVALID_INDEX)
+        {
+            freeHead = get_slot(index).nextFree;
+        }
+        else
+        {
+            if (numTouched == numChunks * _chunkSize)
+            {
+                add_chunk();
+            }
+            index = numTouched++;
+        }
+        Slot& slot = get_slot(index);
+        new(slot.storage) T(std::forward<Args>(args)...);
+        slot.generation++;
+        numAlive++;
+        return { index, slot.generation };
+    }
+
+    // destroys the object
+    //	Returns true if succesful
+    //	Returns false if the handle is stale (already destroyed)
+    bool destroy(PoolHandle<T> handle)
+    {
+        T* obj = get(handle);
+        if (!obj) return false;
+        obj->~T();
+        Slot& slot = get_slot(handle.index);
+        slot.generation++;
+        slot.nextFree = freeHead;
+        freeHead = handle.index;
+        numAlive--;
+        return true;
+    }
+
+    // null if the handle is stale
+    inline T* get(PoolHandle<T> handle)
+    {
+        if (handle.index >= numTouched) return nullptr;
+        Slot& slot = get_slot(handle.index);
+        return slot.generation == handle.generation ? (T*)slot.storage : nullptr;
+    }
+    inline const T* get(PoolHandle<T> handle) const
+    {
+        return const_cast<Pool*>(this)->get(handle);
+    }
+
+    inline bool is_valid(PoolHandle<T> handle) const
+    {
+        return get(handle) != nullptr;
+    }
+
+    // calls fn(PoolHandle<T>, T&) for every live object, in slot order
+    template <typename Func>
+    void for_each(Func&& fn)
+    {
+        for (u32 i = 0; i < numTouched; i++)
+        {
+            Slot& slot = get_slot(i);
+            if (slot.generation & 1)
+            {
+                fn(PoolHandle<T>{ i, slot.generation }, *(T*)slot.storage);
+            }
+        }
+    }
+
+    // destroys every live object and invalidates all handles. Keeps the chunks around
+    void clear()
+    {
+        for (u32 i = 0; i < numTouched; i++)
+        {
+            Slot& slot = get_slot(i);
+            if (slot.generation & 1)
+            {
+                ((T*)slot.storage)->~T();
+                slot.generation++;
+            }
+        }
+        // generations stay in the slots, so handed out handles are still stale once slots get reused
+        numTouched = 0;
+        freeHead = POOL_INVALID_INDEX;
+        numAlive = 0;
+    }
+
+    // number of live objects
+    inline u32 size() const { return numAlive; }
+    inline u32 capacity() const { return numChunks * _chunkSize; }
+
+private:
+
+    struct Slot
+    {
+        union
+        {
+            alignas(T) u8 storage[sizeof(T)];
+            u32 nextFree; // while the slot is free
+        };
+        u32 generation;
+    };
+
+    inline Slot& get_slot(u32 index) const
+    {
+        return chunks[index / _chunkSize][index & (_chunkSize - 1)];
+    }
+
+    void add_chunk()
+    {
+        if (numChunks == chunkTableCapacity)
+        {
+            chunkTableCapacity = chunkTableCapacity ? chunkTableCapacity * 2 : 8;
+            chunks = (Slot**)TSYSREALLOC(chunks, sizeof(Slot*) * chunkTableCapacity);
+        }
+        Slot* chunk = (Slot*)TSYSALLOC_TAGGED(sizeof(Slot) * _chunkSize, MemTag::POOLS);
+        TINY_ASSERT(chunk && "Pool failed to allocate a chunk");
+        for (u32 i = 0; i < _chunkSize; i++)
+        {
+            chunk[i].generation = 0;
+        }
+        chunks[numChunks++] = chunk;
+    }
+
+    Slot** chunks = nullptr;
+    u32 numChunks = 0;
+    u32 chunkTableCapacity = 0;
+    // slots [0, numTouched) have been handed out at least once. Everything past that is fresh
+    u32 numTouched = 0;
+    u32 freeHead = POOL_INVALID_INDEX;
+    u32 numAlive = 0;
+};
+
+// Lock-free pool, for when objects get created on one thread and released on another (I.E. from jobs)
+// The free list is a Treiber stack. Its head is tagged with a counter that goes up on every pop so a slot that gets
+// popped, reused and pushed back between another thread's load and compare-exchange doesn't slip through (ABA).
+// get() is safe against concurrent creates/destroys of *other* objects. Destroying an object while another thread is still using
+// it is a bug just like it would be with new/delete
+template <typename T, u32 _chunkSize = 256>
+class ConcurrentPool
+{
+    static_assert(_chunkSize > 1 && (_chunkSize & (_chunkSize - 1)) == 0, "Pool chunk size must be a power of two");
+    static_assert(alignof(T) <= alignof(std::max_align_t), "Pool chunks come from TSYSALLOC, can't over-align");
+public:
+
+    ConcurrentPool()
+    {
+        for (u32 i = 0; i < CONCURRENT_POOL_MAX_CHUNKS; i++)
+        {
+            chunks[i].store(nullptr, std::memory_order_relaxed);
+        }
+    }
+    ConcurrentPool(const ConcurrentPool&) = delete;
+    ConcurrentPool& operator=(const ConcurrentPool&) = delete;
+    // not thread safe, nothing else can be touching the pool
+    ~ConcurrentPool()
+    {
+        u32 chunkCount = numChunks.load(std::memory_order_acquire);
+        for (u32 c = 0; c < chunkCount; c++)
+        {
+            Slot* chunk = chunks[c].load(std::memory_order_relaxed);
+            for (u32 i = 0; i < _chunkSize; i++)
+            {
+                if (chunk[i].generation.load(std::memory_order_relaxed) & 1)
+                {
+                    ((T*)chunk[i].storage)->~T();
+                }
+            }
+            TSYSFREE(chunk);
+        }
+    }
+
+    template <typename... Args>
+    PoolHandle<T> create(Args&&... args)
+    {
+        u32 index = pop_free();
+        while (index == POOL_INVALID_INDEX)
+        {
+            index = add_chunk();
+        }
+        Slot& slot = get_slot(index);
+        new(slot.storage) T(std::forward<Args>(args)...);
+        // release so a thread that gets the handle and sees the new generation also sees the constructed object
+        u32 generation = slot.generation.fetch_add(1, std::memory_order_release) + 1;
+        numAlive.fetch_add(1, std::memory_order_relaxed);
+        return { index, generation };
+    }
+
+    // can be called from any thread
+    //	Returns true if succesful
+    //	Returns false if the handle is stale (already destroyed, possibly by another thread at the same time)
+    bool destroy(PoolHandle<T> handle)
+    {
+        if (handle.index >= numChunks.load(std::memory_order_acquire) * _chunkSize) return false;
+        Slot& slot = get_slot(handle.index);
+        // only one thread can win the generation bump, so racing destroys of the same handle destroy the object once
+        u32 expected = handle.generation;
+        if ((expected & 1) == 0 || !slot.generation.compare_exchange_strong(expected, expected + 1, std::memory_order_acq_rel))
+        {
+            return false;
+        }
+        ((T*)slot.storage)->~T();
+        numAlive.fetch_sub(1, std::memory_order_relaxed);
+        push_free(handle.index, handle.index);
+        return true;
+    }
+
+    // null if the handle is stale
+    inline T* get(PoolHandle<T> handle)
+    {
+        if (handle.index >= numChunks.load(std::memory_order_acquire) * _chunkSize) return nullptr;
+        Slot& slot = get_slot(handle.index);
+        return slot.generation.load(std::memory_order_acquire) == handle.generation ? (T*)slot.storage : nullptr;
+    }
+
+    inline bool is_valid(PoolHandle<T> handle)
+    {
+        return get(handle) != nullptr;
+    }
+
+    // approximate when called concurrently
+    inline u32 size() const { return numAlive.load(std::memory_order_relaxed); }
+    inline u32 capacity() const { return numChunks.load(std::memory_order_relaxed) * _chunkSize; }
+
+private:
+
+    struct Slot
+    {
+        alignas(T) u8 storage[sizeof(T)];
+        std::atomic<u32> generation;
+        // only meaningful while the slot is on the free list. Atomic because a thread that loses a pop race can
+        // still read it after the winner has reused the slot (the value is thrown away when its CAS fails)
+        std::atomic<u32> nextFree;
+    };
+
+    static inline u64 pack_head(u32 index, u32 tag) { return ((u64)tag << 32) | index; }
+
+    inline Slot& get_slot(u32 index)
+    {
+        return chunks[index / _chunkSize].load(std::memory_order_acquire)[index & (_chunkSize - 1)];
+    }
+
+    u32 pop_free()
+    {
+        u64 head = freeHead.load(std::memory_order_acquire);
+        for (;;)
+        {
+            u32 index = (u32)head;
+            if (index == POOL_INVALID_INDEX) return POOL_INVALID_INDEX;
+            u32 next = get_slot(index).nextFree.load(std::memory_order_relaxed);
+            u64 newHead = pack_head(next, (u32)(head >> 32) + 1);
+            if (freeHead.compare_exchange_weak(head, newHead, std::memory_order_acquire, std::memory_order_acquire))
+            {
+                return index;
+            }
+        }
+    }
+
+    // pushes an already linked run of free slots, first..last
+    void push_free(u32 first, u32 last)
+    {
+        Slot& lastSlot = get_slot(last);
+        u64 head = freeHead.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            lastSlot.nextFree.store((u32)head, std::memory_order_relaxed);
+            u64 newHead = pack_head(first, (u32)(head >> 32));
+            if (freeHead.compare_exchange_weak(head, newHead, std::memory_order_release, std::memory_order_relaxed))
+            {
+                return;
+            }
+        }
+    }
+
+    // returns a slot from the new chunk for the caller, the rest go on the free list.
+    // If another thread already grew the pool (or something got freed) while we waited on the lock, returns one of those
+    u32 add_chunk()
+    {
+        std::lock_guard<std::mutex> lock(growLock);
+        u32 index = pop_free();
+        if (index != POOL_INVALID_INDEX) return index;
+        u32 chunkIdx = numChunks.load(std::memory_order_relaxed);
+        TINY_ASSERT(chunkIdx < CONCURRENT_POOL_MAX_CHUNKS && "Out of chunks in ConcurrentPool. Bump the chunk size");
+        Slot* chunk = (Slot*)TSYSALLOC_TAGGED(sizeof(Slot) * _chunkSize, MemTag::POOLS);
+        TINY_ASSERT(chunk && "Pool failed to allocate a chunk");
+        u32 base = chunkIdx * _chunkSize;
+        for (u32 i = 0; i < _chunkSize; i++)
+        {
+            new(&chunk[i].generation) std::atomic<u32>(0);
+            new(&chunk[i].nextFree) std::atomic<u32>(base + i + 1);
+        }
+        chunks[chunkIdx].store(chunk, std::memory_order_release);
+        numChunks.store(chunkIdx + 1, std::memory_order_release);
+        // slot 0 is ours, 1..n-1 are already linked to each other
+        push_free(base + 1, base + _chunkSize - 1);
+        return base;
+    }
+
+    std::atomic<Slot*> chunks[CONCURRENT_POOL_MAX_CHUNKS];
+    std::atomic<u32> numChunks = 0;
+    std::mutex growLock;
+    alignas(64) std::atomic<u64> freeHead = pack_head(POOL_INVALID_INDEX, 0);
+    alignas(64) std::atomic<u32> numAlive = 0;
+};
+
+// handle validation, reuse, growth, clear, and cross-thread frees on ConcurrentPool
+TAPI void PoolTests();
+// alloc/free throughput of Pool/ConcurrentPool vs TSYSALLOC/TSYSFREE and new/delete
+TAPI void PoolBenchmarks();
+
+#endif
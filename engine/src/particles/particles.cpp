@@ -72,7 +72,7 @@ void ParticleSystem::Draw() const {
             LOG_INFO("%f", particle.life);
             //particleModel.cachedShader.use();
             particleModel.cachedShader.setUniform("color", particle.color);
-            particleModel.Draw(particle.GetTransform());
+            particleModel.Draw();
         }
     }
 }
@@ -320,13 +320,11 @@ void DrawWithMaterials(const Shader& shader, const std::vector<Mesh>& meshes)
     }
 }
 
-void Model::Draw(const Shader& shader, const Transform& tf) const 
+void Model::Draw(const Shader& shader) const 
 {
     PROFILE_FUNCTION();
     if (!isValid()) return;
-    Camera& cam = Camera::GetMainCamera();
-    glm::mat4 model = tf.ToModelMatrix();
-    glm::mat3 matNormal = glm::mat3(glm::transpose(glm::inverse(model)));
+    // model/normal matrices come from the per object data in the global buffer (see shader_buffer.cpp)
     SetLightingUniforms(shader);
     DrawWithMaterials(shader, meshes);
 }
@@ -12,10 +12,10 @@ struct Model {
 
     BoundingBox CalculateBoundingBox();
 
-    TAPI void Draw(const Shader& shader, const Transform& tf) const;
-    void Draw(const Transform& tf) const 
+    TAPI void Draw(const Shader& shader) const;
+    void Draw() const 
     {
-        Draw(cachedShader, tf);
+        Draw(cachedShader);
     }
 
     TAPI void DrawMinimal() const;
@@ -5,7 +5,7 @@
 #include "tiny_fs.h"
 #include "tiny_ogl.h"
 #include "tiny_engine.h"
-#include <unordered_map>
+#include "containers/hash_map.h"
 #include <set>
 #include <sstream>
 #include <string>
@@ -60,13 +60,13 @@ struct ShaderInternal
     u32 oglShaderProgram = 0;
     ShaderLocation filepaths = {};
     std::vector<Texture> samplerIDs = {};
-    std::unordered_map<std::string, UniformData> cachedUniforms = {};
+    HashMap<std::string, UniformData> cachedUniforms = {};
 };
 
 struct GlobalShaderState
 {
     ShaderBufferGlobals globals = {};
-    std::unordered_map<u32, ShaderInternal> shaderMap = {};
+    HashMap<u32, ShaderInternal> shaderMap = {};
     Arena globalShaderMem = {};
 };
 
@@ -80,11 +80,10 @@ void InitializeShaderSystem(Arena* arena)
 {
     GlobalShaderState*& gss = GetEngineCtx().shaderSubsystem;
     gss = (GlobalShaderState*)arena_alloc(arena, sizeof(GlobalShaderState));
-    new(&gss->shaderMap) std::unordered_map<u32, ShaderInternal>();
+    new(&gss->shaderMap) HashMap<u32, ShaderInternal>();
 
-    u32 shaderMemBlockSize = Math::PercentOf(get_free_space(arena), 10);;
-    void* globalShaderMem = arena_alloc(arena, shaderMemBlockSize);
-    gss->globalShaderMem = arena_init(globalShaderMem, shaderMemBlockSize, "Shader System");
+    // own virtual arena so uniform data can grow without eating into (or committing) the engine arena up front
+    gss->globalShaderMem = arena_init_virtual(MEGABYTES_BYTES(256), "Shader System");
     InitializeUBOs(gss->globals);
 }
 
@@ -465,13 +464,14 @@ void updateUniformData(
     PROFILE_FUNCTION();
     GlobalShaderState& gss = GetGSS();
     TINY_ASSERT(gss.globalShaderMem.backing_mem_size > 0 && "Make sure to call InitializeShaderSystem before doing any shader calls!");
-    std::unordered_map<std::string, UniformData>& cachedUniforms = gss.shaderMap[ID].cachedUniforms;
+    HashMap<std::string, UniformData>& cachedUniforms = gss.shaderMap[ID].cachedUniforms;
     // if we already have uniform - simply update cached values. If we don't, allocate more mem in our uniform mem block
     // NOTE/TODO: would like to be able to free uniform mem. Rn we just arena alloc new mem and never free it up
     // maybe use our fixed block allocator and have all uniforms be sizeof(mat4) so we can easily free/reuse chunks in the middle
-    if (cachedUniforms.count(uniformName) && overwrite) 
+    UniformData* cachedUniform = cachedUniforms.find(uniformName);
+    if (cachedUniform && overwrite) 
     {
-        UniformData& uniform = cachedUniforms[uniformName];
+        UniformData& uniform = *cachedUniform;
         TINY_ASSERT(dataType == uniform.dataType && uniformSize == uniform.uniformSize);
         TMEMCPY(uniform.uniformData, uniformData, uniformSize);
     }
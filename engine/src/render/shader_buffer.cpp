@@ -96,27 +96,20 @@ bool TryBindUniformBlockToBindingPoint(const char* uniformBlockName, u32 binding
 void UpdateGlobalUBOModelMatrices(UBOGlobals& globs)
 {
     PROFILE_FUNCTION();
-    EngineContext& ctx = GetEngineCtx();
-    u32 numRenderableEntities = 0;
-    Entity::GetRenderableEntities(nullptr, &numRenderableEntities);
-    EntityRef* renderableEntites = arena_alloc_type(&ctx.engineArena, EntityRef, numRenderableEntities);
-    Entity::GetRenderableEntities(renderableEntites, &numRenderableEntities);
+    // world matrices were brought up to date by the engine loop before rendering
+    std::span<const EntityRef> renderableEntities = Entity::GetRenderables();
+    u32 numRenderableEntities = (u32)renderableEntities.size();
     std::set<u32> ensureUniqueIdxs = {};
-    for (u32 i = 0; i < numRenderableEntities; i++)
+    for (EntityRef ent : renderableEntities)
     {
-        EntityRef ent = renderableEntites[i];
-        const EntityData& entityData = Entity::GetEntity(ent);
         u32 idx = (u32)ent % ARRAY_SIZE(globs.objectData);
         ensureUniqueIdxs.insert(idx);
-        glm::mat4 model = entityData.transform.ToModelMatrix();
-        glm::mat3 normal = glm::mat3(glm::transpose(glm::inverse(model)));
         UBOGlobals::GPUPerObjectData& objData = globs.objectData[idx];
-        objData.modelMat = model;
-        objData.normalMat = normal;
+        objData.modelMat = Entity::GetWorldMatrix(ent);
+        objData.normalMat = Entity::GetNormalMatrix(ent);
     }
     // if this hits, we have a hash collision. Each index into our gpu buffer should be unique.
     TINY_ASSERT(ensureUniqueIdxs.size() == numRenderableEntities);
-    arena_pop_latest(&ctx.engineArena, renderableEntites);
 }
 
 void ShaderSystemPreDraw(ShaderBufferGlobals& globals)
@@ -7,14 +7,13 @@
 #include "tiny_fs.h"
 #include "job_system.h"
 #include "math/tiny_math.h"
+#include "containers/hash_map.h"
 
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "external/stb/stb_image.h"
 #undef STB_IMAGE_IMPLEMENTATION
 
-#include <unordered_map>
-
 struct TextureInternal
 {
     u32 oglTexID = 0;
@@ -32,7 +31,7 @@ public:
     }
 };
 
-typedef std::unordered_map<Texture, TextureInternal, TextureHasher> TextureCacheMap;
+typedef HashMap<Texture, TextureInternal, TextureHasher> TextureCacheMap;
 
 struct TextureCache
 {
@@ -63,6 +62,14 @@ static TextureCache& GetTextureCache()
     return *GetEngineCtx().textureCache;
 }
 
+// read only lookup. Unknown textures get a blank (invalid) TextureInternal instead of being added to the cache
+static const TextureInternal& FindTextureInternal(const Texture& tex)
+{
+    static const TextureInternal blankTextureInternal = {};
+    const TextureInternal* ti = GetTextureCache().cachedTextures.find(tex);
+    return ti ? *ti : blankTextureInternal;
+}
+
 Texture GetDummyTexture()
 {
     return GetTextureCache().dummyTexture;
@@ -107,12 +114,8 @@ TextureProperties TextureProperties::None() {
 
 u32 Texture::OglID() const
 {
-    TextureCache& texCache = GetTextureCache();
-    if (texCache.cachedTextures.count(*this))
-    {
-        return texCache.cachedTextures[*this].oglTexID;
-    }
-    return U32_INVALID_ID;
+    const TextureInternal* ti = GetTextureCache().cachedTextures.find(*this);
+    return ti ? ti->oglTexID : U32_INVALID_ID;
 }
 
 void Texture::Delete() 
@@ -127,14 +130,14 @@ void Texture::Delete()
 
 bool Texture::isValid() const 
 { 
-    const TextureInternal& ti = GetTextureCache().cachedTextures[*this];
+    const TextureInternal& ti = FindTextureInternal(*this);
     return id != U32_INVALID_ID && ti.type != 0; 
 }
 
 void Texture::bindUnit(u32 textureUnit) const 
 {
     PROFILE_FUNCTION();
-    const TextureInternal& ti = GetTextureCache().cachedTextures[*this];
+    const TextureInternal& ti = FindTextureInternal(*this);
     if (!isValid() || ti.oglTexID == 0)
     {
         // either an invalid texture, or it's still loading
@@ -152,17 +155,17 @@ void Texture::bindUnit(u32 textureUnit) const
 
 u32 Texture::GetWidth() const
 {
-    const TextureInternal& ti = GetTextureCache().cachedTextures[*this];
+    const TextureInternal& ti = FindTextureInternal(*this);
     return ti.width;
 }
 u32 Texture::GetHeight() const
 {
-    const TextureInternal& ti = GetTextureCache().cachedTextures[*this];
+    const TextureInternal& ti = FindTextureInternal(*this);
     return ti.height;
 }
 u32 Texture::GetType() const
 {
-    const TextureInternal& ti = GetTextureCache().cachedTextures[*this];
+    const TextureInternal& ti = FindTextureInternal(*this);
     return ti.type;
 }
 
@@ -281,11 +284,10 @@ Texture LoadTexture(
     u32 strHash = HashBytes((u8*)imgPath.c_str(), imgPath.size());
     Texture tex = Texture(strHash);
     TextureCacheMap& texCache = GetTextureCache().cachedTextures;
-    if (texCache.count(tex))
+    if (!texCache.try_emplace(tex).second)
     {
         return tex;
     }
-    texCache[tex] = TextureInternal();
 
     s32 width, height, numChannels = 0;
     u8* data = LoadImageData(imgPath.c_str(), &width, &height, &numChannels, flipVertically);
@@ -308,6 +310,19 @@ Texture LoadTexture(
     return tex;
 }
 
+// everything an async texture load needs, carried from the loading job to the main thread job.
+// Lives on the heap for the duration of the load so the jobs only capture a pointer
+struct AsyncTextureLoad
+{
+    std::string imgPath;
+    TextureProperties props;
+    TextureLoadSuccessCallback onSuccess;
+    u32 strHash = 0;
+    bool flipVertically = false;
+    u8* data = nullptr;
+    s32 width = 0, height = 0, numChannels = 0;
+};
+
 Texture LoadTextureAsync(
     const std::string& imgPath, 
     TextureProperties props, 
@@ -318,38 +333,43 @@ Texture LoadTextureAsync(
     u32 strHash = HashBytes((u8*)imgPath.c_str(), imgPath.size());
     Texture tex = Texture(strHash);
     TextureCacheMap& texCache = GetTextureCache().cachedTextures;
-    if (texCache.count(tex))
+    if (!texCache.try_emplace(tex).second)
     {
         return tex;
     }
-    texCache[tex] = TextureInternal();
-    JobSystem::Instance().Execute([strHash, props, imgPath, flipVertically, onSuccess](){
+    AsyncTextureLoad* load = new AsyncTextureLoad();
+    load->imgPath = imgPath;
+    load->props = props;
+    load->onSuccess = std::move(onSuccess);
+    load->strHash = strHash;
+    load->flipVertically = flipVertically;
+    JobSystem::Instance().Execute([load](){
         PROFILE_SCOPE("Load image data");
-        s32 width, height, numChannels;
-        u8* data = LoadImageData(imgPath.c_str(), &width, &height, &numChannels, flipVertically);     
-        JobSystem::Instance().ExecuteOnMainThread([strHash, imgPath, data, width, height, numChannels, props, onSuccess](){
+        load->data = LoadImageData(load->imgPath.c_str(), &load->width, &load->height, &load->numChannels, load->flipVertically);     
+        JobSystem::Instance().ExecuteOnMainThread([load](){
             PROFILE_SCOPE("initialize loaded tex data");
-            TextureProperties newProps = props; // cpy to make mutable, lambda captures are const
-            if (props.isNone)
+            TextureProperties newProps = load->props;
+            if (load->props.isNone)
             {
-                newProps = TexturePropertiesFromImageInfo(numChannels);
+                newProps = TexturePropertiesFromImageInfo(load->numChannels);
             }
             // this also loads in the newly loaded texture id into our global mapping, so the rest of the engine has access to it
-            Texture ret = LoadGPUTextureFromImg(data, width, height, newProps, strHash);
+            Texture ret = LoadGPUTextureFromImg(load->data, load->width, load->height, newProps, load->strHash);
             if (!ret.isValid())
             {
-                LOG_ERROR("Couldn't load %s", imgPath.c_str());
+                LOG_ERROR("Couldn't load %s", load->imgPath.c_str());
                 TINY_ASSERT(false && "failed to load texture!");
             }
             TextureInternal& ti = GetTextureCache().cachedTextures[ret];
-            ti.texpath = imgPath;
-            stbi_image_free(data);
-            LOG_INFO("Loaded texture %s  channels: %i", imgPath.c_str(), numChannels);
-            if (onSuccess)
+            ti.texpath = load->imgPath;
+            stbi_image_free(load->data);
+            LOG_INFO("Loaded texture %s  channels: %i", load->imgPath.c_str(), load->numChannels);
+            if (load->onSuccess)
             {
-                onSuccess(ret);
+                load->onSuccess(ret);
             }
-        });
+            delete load;
+        }, MainThreadJobPriority::LOW); // uploads get spread over a few frames instead of spiking one
     });
     return tex;
 }
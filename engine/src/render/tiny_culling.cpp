@@ -0,0 +1,377 @@
+//#include "pch.h"
+#include "tiny_culling.h"
+
+#include "job_system.h"
+#include "tiny_profiler.h"
+
+void CullingSet::Clear()
+{
+    centerX.clear();
+    centerY.clear();
+    centerZ.clear();
+    extentX.clear();
+    extentY.clear();
+    extentZ.clear();
+    visibility.clear();
+    count = 0;
+}
+
+u32 CullingSet::Add(const BoundingBox& worldBox)
+{
+    u32 index = count++;
+    if (index == visibility.size())
+    {
+        // grow by a whole SIMD block. reserve is exact, so do the doubling here
+        u32 newSize = index + SIMD_WIDTH;
+        if (newSize > visibility.capacity())
+        {
+            u32 newCapacity = Math::Max(newSize, visibility.capacity() * 2);
+            centerX.reserve(newCapacity);
+            centerY.reserve(newCapacity);
+            centerZ.reserve(newCapacity);
+            extentX.reserve(newCapacity);
+            extentY.reserve(newCapacity);
+            extentZ.reserve(newCapacity);
+            visibility.reserve(newCapacity);
+        }
+        centerX.resize(newSize);
+        centerY.resize(newSize);
+        centerZ.resize(newSize);
+        extentX.resize(newSize);
+        extentY.resize(newSize);
+        extentZ.resize(newSize);
+        visibility.resize(newSize);
+    }
+    Set(index, worldBox);
+    visibility[index] = CULL_VIEW_ALL;
+    return index;
+}
+
+void CullingSet::Set(u32 index, const BoundingBox& worldBox)
+{
+    TINY_ASSERT(index < count);
+    glm::vec3 center = (worldBox.min + worldBox.max) * 0.5f;
+    glm::vec3 extents = (worldBox.max - worldBox.min) * 0.5f;
+    centerX[index] = center.x;
+    centerY[index] = center.y;
+    centerZ[index] = center.z;
+    extentX[index] = extents.x;
+    extentY[index] = extents.y;
+    extentZ[index] = extents.z;
+}
+
+// a box is outside when it's entirely behind any one plane: center distance + how far the box reaches towards the
+// plane < 0. Same test as FrustumTestBox, minus telling intersecting and inside apart
+static u32 CullRangeScalar(
+    const FrustumPlanes& frustum, CullView view,
+    const f32* cx, const f32* cy, const f32* cz, const f32* ex, const f32* ey, const f32* ez,
+    u8* visibility, u32 begin, u32 end)
+{
+    u32 numVisible = 0;
+    for (u32 i = begin; i < end; i++)
+    {
+        bool outside = false;
+        for (const glm::vec4& plane : frustum.planes)
+        {
+            f32 distance = plane.x * cx[i] + plane.y * cy[i] + plane.z * cz[i] + plane.w;
+            f32 radius = std::abs(plane.x) * ex[i] + std::abs(plane.y) * ey[i] + std::abs(plane.z) * ez[i];
+            outside |= distance + radius < 0.0f;
+        }
+        visibility[i] = outside ? (visibility[i] & ~view) : (visibility[i] | view);
+        numVisible += !outside;
+    }
+    return numVisible;
+}
+
+#if SIMD_WIDTH > 1
+
+// every plane component splatted across a register, done once per Cull rather than per block
+struct SimdPlane
+{
+    SimdF nx, ny, nz, d;
+    SimdF absNx, absNy, absNz;
+};
+
+// begin is a multiple of SIMD_WIDTH, end can land anywhere (the arrays are padded past it)
+static u32 CullRangeSimd(
+    const SimdPlane* planes, CullView view,
+    const f32* cx, const f32* cy, const f32* cz, const f32* ex, const f32* ey, const f32* ez,
+    u8* visibility, u32 begin, u32 end)
+{
+    u32 numVisible = 0;
+    SimdF zero = SIMD_ZERO();
+    for (u32 i = begin; i < end; i += SIMD_WIDTH)
+    {
+        SimdF centerX = SIMD_LOAD(cx + i);
+        SimdF centerY = SIMD_LOAD(cy + i);
+        SimdF centerZ = SIMD_LOAD(cz + i);
+        SimdF extentX = SIMD_LOAD(ex + i);
+        SimdF extentY = SIMD_LOAD(ey + i);
+        SimdF extentZ = SIMD_LOAD(ez + i);
+        SimdF outside = zero;
+        for (u32 p = 0; p < 6; p++)
+        {
+            const SimdPlane& plane = planes[p];
+            SimdF distance = SIMD_ADD(SIMD_ADD(SIMD_MUL(plane.nx, centerX), SIMD_MUL(plane.ny, centerY)),
+                                      SIMD_ADD(SIMD_MUL(plane.nz, centerZ), plane.d));
+            SimdF radius = SIMD_ADD(SIMD_ADD(SIMD_MUL(plane.absNx, extentX), SIMD_MUL(plane.absNy, extentY)),
+                                    SIMD_MUL(plane.absNz, extentZ));
+            outside = SIMD_OR(outside, SIMD_LESS_THAN(SIMD_ADD(distance, radius), zero));
+        }
+        u32 outsideMask = (u32)SIMD_MOVEMASK(outside);
+        u32 lanes = Math::Min((u32)SIMD_WIDTH, end - i);
+        for (u32 lane = 0; lane < lanes; lane++)
+        {
+            bool laneOutside = (outsideMask >> lane) & 1;
+            u8& bits = visibility[i + lane];
+            bits = laneOutside ? (bits & ~view) : (bits | view);
+            numVisible += !laneOutside;
+        }
+    }
+    return numVisible;
+}
+
+#endif
+
+u32 CullingSet::Cull(const FrustumPlanes& frustum, CullView view, bool parallel)
+{
+    PROFILE_FUNCTION();
+    if (count == 0) return 0;
+    const f32* cx = centerX.data();
+    const f32* cy = centerY.data();
+    const f32* cz = centerZ.data();
+    const f32* ex = extentX.data();
+    const f32* ey = extentY.data();
+    const f32* ez = extentZ.data();
+    u8* bits = visibility.data();
+#if SIMD_WIDTH > 1
+    SimdPlane planes[6];
+    for (u32 p = 0; p < 6; p++)
+    {
+        const glm::vec4& plane = frustum.planes[p];
+        planes[p] = {
+            SIMD_SET1(plane.x), SIMD_SET1(plane.y), SIMD_SET1(plane.z), SIMD_SET1(plane.w),
+            SIMD_SET1(std::abs(plane.x)), SIMD_SET1(std::abs(plane.y)), SIMD_SET1(std::abs(plane.z)),
+        };
+    }
+    auto cullRange = [&](u32 begin, u32 end) {
+        return CullRangeSimd(planes, view, cx, cy, cz, ex, ey, ez, bits, begin, end);
+    };
+#else
+    auto cullRange = [&](u32 begin, u32 end) {
+        return CullRangeScalar(frustum, view, cx, cy, cz, ex, ey, ez, bits, begin, end);
+    };
+#endif
+    if (!parallel || count < CULLING_PARALLEL_MIN_COUNT)
+    {
+        return cullRange(0, count);
+    }
+    // one job per chunk of boxes, each chunk a whole number of SIMD blocks so it starts on one
+    static_assert(CULLING_GRAIN_SIZE % SIMD_WIDTH == 0);
+    u32 numChunks = (count + CULLING_GRAIN_SIZE - 1) / CULLING_GRAIN_SIZE;
+    return JobSystem::Instance().ParallelReduce(0, numChunks, 1, 0u,
+        [&](u32 chunk) {
+            u32 begin = chunk * CULLING_GRAIN_SIZE;
+            return cullRange(begin, Math::Min(begin + CULLING_GRAIN_SIZE, count));
+        },
+        [](u32 a, u32 b) { return a + b; });
+}
+
+u32 CullingSet::CullScalar(const FrustumPlanes& frustum, CullView view)
+{
+    return CullRangeScalar(frustum, view,
+        centerX.data(), centerY.data(), centerZ.data(), extentX.data(), extentY.data(), extentZ.data(),
+        visibility.data(), 0, count);
+}
+
+// ============ tests / benchmarks ============
+
+#include <chrono>
+#include <random>
+#include <vector>
+#include "scene/bvh.h"
+
+static BoundingBox RandomBox(std::mt19937& rng, f32 worldSize, f32 minSize, f32 maxSize)
+{
+    std::uniform_real_distribution<f32> position(-worldSize * 0.5f, worldSize * 0.5f);
+    std::uniform_real_distribution<f32> size(minSize, maxSize);
+    glm::vec3 min = glm::vec3(position(rng), position(rng), position(rng));
+    return BoundingBox(min, min + glm::vec3(size(rng), size(rng), size(rng)));
+}
+
+static FrustumPlanes RandomCameraFrustum(std::mt19937& rng, f32 worldSize)
+{
+    std::uniform_real_distribution<f32> position(-worldSize * 0.5f, worldSize * 0.5f);
+    std::uniform_real_distribution<f32> component(-1.0f, 1.0f);
+    glm::vec3 eye = glm::vec3(position(rng), position(rng), position(rng));
+    glm::vec3 forward;
+    do
+    {
+        forward = glm::vec3(component(rng), component(rng), component(rng));
+    } while (glm::dot(forward, forward) < 0.01f);
+    forward = glm::normalize(forward);
+    glm::vec3 up = std::abs(forward.y) > 0.99f ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0);
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, worldSize * 0.5f);
+    return Math::FrustumPlanesFromMatrix(projection * glm::lookAt(eye, eye + forward, up));
+}
+
+// Cull, CullScalar and FrustumTestBox all have to agree on every box
+static void CheckCull(CullingSet& set, const std::vector<BoundingBox>& boxes, const FrustumPlanes& frustum, CullView view)
+{
+    u32 expectedVisible = 0;
+    for (const BoundingBox& box : boxes) expectedVisible += FrustumTestBox(frustum, box) != FrustumTestResult::OUTSIDE;
+    u32 scalarVisible = set.CullScalar(frustum, view);
+    TINY_ASSERT(scalarVisible == expectedVisible);
+    for (u32 i = 0; i < boxes.size(); i++)
+    {
+        TINY_ASSERT(set.IsVisible(i, view) == (FrustumTestBox(frustum, boxes[i]) != FrustumTestResult::OUTSIDE));
+    }
+    for (bool parallel : { false, true })
+    {
+        // flip every bit first so a Cull that skips boxes doesn't pass by leaving the scalar results behind
+        set.CullScalar(FrustumPlanes{}, view);
+        u32 visible = set.Cull(frustum, view, parallel);
+        TINY_ASSERT(visible == expectedVisible);
+        for (u32 i = 0; i < boxes.size(); i++)
+        {
+            TINY_ASSERT(set.IsVisible(i, view) == (FrustumTestBox(frustum, boxes[i]) != FrustumTestResult::OUTSIDE));
+        }
+    }
+}
+
+void CullingTests()
+{
+    LOG_INFO("Running culling tests...");
+    std::mt19937 rng(1234);
+    CullingSet set;
+
+    // random boxes, sizes that leave the last SIMD block partly empty and ones big enough to go parallel
+    const u32 sizes[] = { 0, 1, 3, 5, 7, 8, 9, 17, 1000, CULLING_PARALLEL_MIN_COUNT + 5, 50000 };
+    for (u32 numBoxes : sizes)
+    {
+        set.Clear();
+        f32 worldSize = 10.0f * std::cbrt((f32)Math::Max(numBoxes, 1u)) + 20.0f;
+        std::vector<BoundingBox> boxes(numBoxes);
+        for (BoundingBox& box : boxes)
+        {
+            box = RandomBox(rng, worldSize, 0.0f, 4.0f);
+            set.Add(box);
+        }
+        TINY_ASSERT(set.GetSize() == numBoxes);
+        for (u32 q = 0; q < 20; q++)
+        {
+            CheckCull(set, boxes, RandomCameraFrustum(rng, worldSize), CULL_VIEW_CAMERA);
+        }
+    }
+
+    // boxes around the near plane of a camera at the origin looking down -z
+    {
+        set.Clear();
+        glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, 1.0f, 100.0f);
+        FrustumPlanes frustum = Math::FrustumPlanesFromMatrix(projection);
+        std::vector<BoundingBox> boxes = {
+            BoundingBox(glm::vec3(-0.1f, -0.1f, -1.1f), glm::vec3(0.1f, 0.1f, -0.9f)), // straddles the near plane
+            BoundingBox(glm::vec3(-0.1f, -0.1f, -0.8f), glm::vec3(0.1f, 0.1f, -0.6f)), // just in front of the camera, before near
+            BoundingBox(glm::vec3(-0.1f, -0.1f, 0.5f), glm::vec3(0.1f, 0.1f, 0.6f)),   // behind the camera
+            BoundingBox(glm::vec3(-1.0f, -1.0f, -50.0f), glm::vec3(1.0f, 1.0f, -40.0f)), // well inside
+            BoundingBox(glm::vec3(-1.0f, -1.0f, -101.0f), glm::vec3(1.0f, 1.0f, -99.0f)), // straddles the far plane
+            BoundingBox(glm::vec3(-1.0f, -1.0f, -120.0f), glm::vec3(1.0f, 1.0f, -110.0f)), // past far
+            BoundingBox(glm::vec3(60.0f, -1.0f, -50.0f), glm::vec3(62.0f, 1.0f, -48.0f)),  // off to the right
+            BoundingBox(glm::vec3(-500.0f, -500.0f, -50.0f), glm::vec3(500.0f, 500.0f, -40.0f)), // bigger than the frustum
+        };
+        const bool expected[] = { true, false, false, true, true, false, false, true };
+        for (const BoundingBox& box : boxes) set.Add(box);
+        CheckCull(set, boxes, frustum, CULL_VIEW_CAMERA);
+        for (u32 i = 0; i < boxes.size(); i++)
+        {
+            TINY_ASSERT(set.IsVisible(i, CULL_VIEW_CAMERA) == expected[i]);
+        }
+    }
+
+    // views only touch their own bit
+    {
+        set.Clear();
+        std::vector<BoundingBox> boxes(5000);
+        for (BoundingBox& box : boxes)
+        {
+            box = RandomBox(rng, 200.0f, 0.5f, 2.0f);
+            set.Add(box);
+        }
+        for (u32 i = 0; i < boxes.size(); i++) TINY_ASSERT(set.IsVisible(i, CULL_VIEW_CAMERA) && set.IsVisible(i, CULL_VIEW_SHADOW));
+        FrustumPlanes camera = RandomCameraFrustum(rng, 200.0f);
+        FrustumPlanes shadow = Math::FrustumPlanesFromMatrix(
+            glm::ortho(-50.0f, 50.0f, -50.0f, 50.0f, 0.01f, 250.0f) * glm::lookAt(glm::vec3(0, 100, 0), glm::vec3(0.2f, 0, 0.1f), glm::vec3(0, 1, 0)));
+        set.Cull(camera, CULL_VIEW_CAMERA);
+        set.Cull(shadow, CULL_VIEW_SHADOW);
+        u32 cameraVisible = 0, shadowVisible = 0;
+        for (u32 i = 0; i < boxes.size(); i++)
+        {
+            bool inCamera = FrustumTestBox(camera, boxes[i]) != FrustumTestResult::OUTSIDE;
+            bool inShadow = FrustumTestBox(shadow, boxes[i]) != FrustumTestResult::OUTSIDE;
+            TINY_ASSERT(set.IsVisible(i, CULL_VIEW_CAMERA) == inCamera);
+            TINY_ASSERT(set.IsVisible(i, CULL_VIEW_SHADOW) == inShadow);
+            cameraVisible += inCamera;
+            shadowVisible += inShadow;
+        }
+        // both frustums see part of the set, otherwise this doesn't test much
+        TINY_ASSERT(cameraVisible > 0 && cameraVisible < boxes.size());
+        TINY_ASSERT(shadowVisible > 0 && shadowVisible < boxes.size());
+    }
+    LOG_INFO("Culling tests passed (simd width %u)", SIMD_WIDTH);
+}
+
+template <typename Func>
+static f64 TimeMs(Func func)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    func();
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<f64, std::milli>(end - start).count();
+}
+
+void CullingBenchmarks()
+{
+    LOG_INFO("Running culling benchmarks (simd width %u)...", SIMD_WIDTH);
+    const u32 sizes[] = { 10000, 100000, 1000000 };
+    for (u32 numBoxes : sizes)
+    {
+        // same density at every size: ~1 box per 10x10x10 units
+        f32 worldSize = 10.0f * std::cbrt((f32)numBoxes);
+        std::mt19937 rng(42);
+        std::vector<BoundingBox> boxes(numBoxes);
+        for (BoundingBox& box : boxes) box = RandomBox(rng, worldSize, 0.5f, 3.0f);
+        constexpr u32 numFrustums = 20;
+        FrustumPlanes frustums[numFrustums];
+        for (FrustumPlanes& frustum : frustums) frustum = RandomCameraFrustum(rng, worldSize);
+
+        CullingSet set;
+        f64 fillMs = TimeMs([&]() {
+            for (const BoundingBox& box : boxes) set.Add(box);
+        });
+        u64 scalarVisible = 0, simdVisible = 0, parallelVisible = 0, bvhVisible = 0;
+        f64 scalarMs = TimeMs([&]() {
+            for (const FrustumPlanes& frustum : frustums) scalarVisible += set.CullScalar(frustum, CULL_VIEW_CAMERA);
+        });
+        f64 simdMs = TimeMs([&]() {
+            for (const FrustumPlanes& frustum : frustums) simdVisible += set.Cull(frustum, CULL_VIEW_CAMERA, false);
+        });
+        f64 parallelMs = TimeMs([&]() {
+            for (const FrustumPlanes& frustum : frustums) parallelVisible += set.Cull(frustum, CULL_VIEW_CAMERA, true);
+        });
+        TINY_ASSERT(scalarVisible == simdVisible && simdVisible == parallelVisible);
+
+        // the tree skips whole subtrees but its boxes are fat, so it can find a few more
+        Bvh* bvh = new Bvh();
+        for (u32 i = 0; i < numBoxes; i++) bvh->CreateProxy(boxes[i], i, true);
+        bvh->Rebuild();
+        f64 bvhMs = TimeMs([&]() {
+            for (const FrustumPlanes& frustum : frustums) bvh->QueryFrustum(frustum, [&](u32) { bvhVisible++; });
+        });
+        delete bvh;
+
+        LOG_INFO("[CULLING] %7u boxes (fill %6.2f ms) | per frustum: scalar %8.3f ms | simd %8.3f ms (%5.2fx) | simd + jobs %8.3f ms (%5.2fx) | bvh %8.3f ms | %5.1f%% visible",
+            numBoxes, fillMs, scalarMs / numFrustums, simdMs / numFrustums, scalarMs / simdMs,
+            parallelMs / numFrustums, scalarMs / parallelMs, bvhMs / numFrustums,
+            100.0 * (f64)simdVisible / ((f64)numBoxes * numFrustums));
+    }
+}
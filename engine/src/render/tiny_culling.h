@@ -0,0 +1,76 @@
+#ifndef TINY_CULLING_H
+#define TINY_CULLING_H
+
+#include "tiny_defines.h"
+#include "tiny_types.h"
+#include "math/tiny_math.h"
+#include "containers/dynarray.h"
+#include "math/tiny_simd.h"
+
+// Frustum culling for a flat list of world space boxes, rebuilt every frame by whoever is pushing things to draw.
+// Boxes are stored as structure of arrays (center/extents per axis) so the plane tests run on SIMD_WIDTH
+// boxes at a time (8 with AVX, 4 with SSE2, one by one anywhere else).
+// Every box has a visibility byte with one bit per CullView, so the camera and the shadow map can each cull the same
+// set and every pass reads the bit it cares about.
+// Cull splits the set over the JobSystem when it's big enough. Nothing else may touch the set while it runs.
+
+// below this many boxes Cull doesn't bother with jobs
+#define CULLING_PARALLEL_MIN_COUNT 8192
+// multiple of SIMD_WIDTH
+#define CULLING_GRAIN_SIZE 4096
+
+enum CullView : u8
+{
+    CULL_VIEW_CAMERA = 1 << 0,
+    CULL_VIEW_SHADOW = 1 << 1,
+
+    CULL_VIEW_ALL = CULL_VIEW_CAMERA | CULL_VIEW_SHADOW,
+};
+
+struct CullingSet
+{
+    // keeps the memory around
+    TAPI void Clear();
+    // returns the box's index. Boxes start out visible in every view
+    TAPI u32 Add(const BoundingBox& worldBox);
+    // moves an existing box. Different threads can set different boxes at once
+    TAPI void Set(u32 index, const BoundingBox& worldBox);
+    // sets or clears view's bit on every box depending on whether it touches the frustum, returns how many do.
+    // Conservative: a box near a corner of the frustum can pass without actually being in it
+    TAPI u32 Cull(const FrustumPlanes& frustum, CullView view, bool parallel = true);
+    // same result as Cull, one box at a time without SIMD. For comparing against
+    TAPI u32 CullScalar(const FrustumPlanes& frustum, CullView view);
+
+    inline bool IsVisible(u32 index, CullView view) const { return (visibility[index] & view) != 0; }
+    // for culling passes of other kinds (see OcclusionBuffer). Different threads can change different boxes at once
+    inline void SetVisible(u32 index, CullView view, bool visible)
+    {
+        visibility[index] = visible ? (visibility[index] | view) : (visibility[index] & ~view);
+    }
+    inline BoundingBox GetBox(u32 index) const
+    {
+        glm::vec3 center = glm::vec3(centerX[index], centerY[index], centerZ[index]);
+        glm::vec3 extents = glm::vec3(extentX[index], extentY[index], extentZ[index]);
+        return BoundingBox(center - extents, center + extents);
+    }
+    inline u32 GetSize() const { return count; }
+
+private:
+    // padded with empty boxes up to a multiple of SIMD_WIDTH, so the SIMD loop never needs a tail
+    DynArray<f32> centerX = {};
+    DynArray<f32> centerY = {};
+    DynArray<f32> centerZ = {};
+    DynArray<f32> extentX = {};
+    DynArray<f32> extentY = {};
+    DynArray<f32> extentZ = {};
+    DynArray<u8> visibility = {};
+    u32 count = 0;
+};
+
+// SIMD and parallel culls against CullScalar and FrustumTestBox, on random boxes, boxes straddling planes,
+// sizes that don't fill the last SIMD block and views that don't touch each other's bits
+TAPI void CullingTests();
+// 10k/100k/1M boxes: scalar vs SIMD vs SIMD + jobs vs Bvh::QueryFrustum, CPU only
+TAPI void CullingBenchmarks();
+
+#endif
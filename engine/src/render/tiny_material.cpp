@@ -62,7 +62,7 @@ Material GetDummyMaterial()
 
 bool DoesMaterialIdExist(u32 materialID)
 {
-    return GetMaterialRegistry().materialRegistry.count(Material(materialID)) > 0;
+    return GetMaterialRegistry().materialRegistry.contains(Material(materialID));
 }
 
 Material NewMaterial(const char* name, u32 materialHash) {
@@ -71,9 +71,9 @@ Material NewMaterial(const char* name, u32 materialHash) {
     TMEMSET((void*)newMaterial.dbgName, 0, nameSize);
     TMEMCPY((void*)newMaterial.dbgName, name, nameSize);
     MaterialRegistry& matRegistry = GetMaterialRegistry();
-    if (matRegistry.materialRegistry.count(newMaterial))
+    if (const MaterialInternal* existingMat = matRegistry.materialRegistry.find(newMaterial))
     {
-        const MaterialInternal& alreadyExistingMat = matRegistry.materialRegistry[newMaterial];
+        const MaterialInternal& alreadyExistingMat = *existingMat;
         bool areNamesSame = strncmp(alreadyExistingMat.name, name, nameSize) == 0;
         if (areNamesSame)
         {
@@ -6,6 +6,7 @@
 #include "math/tiny_math.h"
 #include "render/texture.h"
 #include "tiny_log.h"
+#include "containers/hash_map.h"
 
 #include <set>
 
@@ -96,7 +97,7 @@ struct MaterialHasher {
     }
 };
 
-typedef std::unordered_map<Material, MaterialInternal, MaterialHasher> MaterialMap;
+typedef HashMap<Material, MaterialInternal, MaterialHasher> MaterialMap;
 
 struct MaterialRegistry 
 {
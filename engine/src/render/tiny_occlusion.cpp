@@ -0,0 +1,630 @@
+//#include "pch.h"
+#include "tiny_occlusion.h"
+
+#include "job_system.h"
+#include "mem/tiny_arena.h"
+#include "tiny_profiler.h"
+#include <cfloat>
+
+void OcclusionBuffer::Initialize(u32 bufferWidth, u32 bufferHeight)
+{
+    TINY_ASSERT(bufferWidth > 0 && bufferHeight > 0);
+    // rows are rasterized in whole SIMD blocks
+    width = (bufferWidth + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+    height = bufferHeight;
+    u32 total = 0;
+    u32 mipWidth = width;
+    u32 mipHeight = height;
+    numMips = 0;
+    while (true)
+    {
+        TINY_ASSERT(numMips < OCCLUSION_MAX_MIPS);
+        mipOffsets[numMips] = total;
+        mipWidths[numMips] = mipWidth;
+        mipHeights[numMips] = mipHeight;
+        numMips++;
+        total += mipWidth * mipHeight;
+        if (mipWidth == 1 && mipHeight == 1) break;
+        mipWidth = (mipWidth + 1) / 2;
+        mipHeight = (mipHeight + 1) / 2;
+    }
+    depth.clear();
+    depth.resize(total);
+    Begin(glm::mat4(1.0f));
+}
+
+void OcclusionBuffer::Begin(const glm::mat4& newViewProjection)
+{
+    TINY_ASSERT(numMips > 0 && "OcclusionBuffer used before Initialize");
+    viewProjection = newViewProjection;
+    numOccluderTriangles = 0;
+    // the whole pyramid, so testing without any occluders finds nothing occluded
+    for (f32& d : depth) d = 1.0f;
+}
+
+// Sutherland-Hodgman against one clip space plane, keeps the side where dot(plane, v) >= 0
+static u32 ClipPolygon(const glm::vec4* in, u32 count, const glm::vec4& plane, glm::vec4* out)
+{
+    u32 outCount = 0;
+    for (u32 i = 0; i < count; i++)
+    {
+        const glm::vec4& a = in[i];
+        const glm::vec4& b = in[(i + 1) % count];
+        f32 da = glm::dot(plane, a);
+        f32 db = glm::dot(plane, b);
+        if (da >= 0.0f) out[outCount++] = a;
+        if ((da >= 0.0f) != (db >= 0.0f))
+        {
+            out[outCount++] = a + (b - a) * (da / (da - db));
+        }
+    }
+    return outCount;
+}
+
+void OcclusionBuffer::RasterizeOccluder(
+    const glm::mat4& worldMatrix,
+    const void* vertices, u32 vertexStride, u32 numVertices,
+    const u32* indices, u32 numIndices)
+{
+    PROFILE_FUNCTION();
+    if (!indices) numIndices = numVertices;
+    if (numIndices < 3) return;
+    glm::mat4 toClip = viewProjection * worldMatrix;
+    ArenaTemp scratch = scratch_begin();
+    glm::vec4* clip = arena_alloc_type(scratch.arena, glm::vec4, numVertices);
+    for (u32 i = 0; i < numVertices; i++)
+    {
+        const glm::vec3& position = *(const glm::vec3*)((const u8*)vertices + (size_t)i * vertexStride);
+        clip[i] = toClip * glm::vec4(position, 1.0f);
+    }
+    // near plane (z >= -w) so everything left has w > 0, and the edges of the screen so screen coordinates
+    // stay small enough for f32 edge functions
+    const glm::vec4 clipPlanes[] = {
+        glm::vec4(0, 0, 1, 1),
+        glm::vec4(1, 0, 0, 1),
+        glm::vec4(-1, 0, 0, 1),
+        glm::vec4(0, 1, 0, 1),
+        glm::vec4(0, -1, 0, 1),
+    };
+    glm::vec2 screenScale = glm::vec2(width, height) * 0.5f;
+    for (u32 t = 0; t + 2 < numIndices; t += 3)
+    {
+        glm::vec4 polygon[2][3 + ARRAY_SIZE(clipPlanes)];
+        u32 count = 3;
+        for (u32 corner = 0; corner < 3; corner++)
+        {
+            u32 index = indices ? indices[t + corner] : t + corner;
+            polygon[0][corner] = clip[index];
+        }
+        // only clip what actually pokes out, which is most triangles
+        u32 current = 0;
+        for (const glm::vec4& plane : clipPlanes)
+        {
+            bool inside = true;
+            for (u32 i = 0; i < count; i++) inside &= glm::dot(plane, polygon[current][i]) >= 0.0f;
+            if (inside) continue;
+            count = ClipPolygon(polygon[current], count, plane, polygon[current ^ 1]);
+            current ^= 1;
+            if (count < 3) break;
+        }
+        if (count < 3) continue;
+        glm::vec3 screen[3 + ARRAY_SIZE(clipPlanes)];
+        for (u32 i = 0; i < count; i++)
+        {
+            const glm::vec4& v = polygon[current][i];
+            glm::vec3 ndc = glm::vec3(v) / v.w;
+            screen[i] = glm::vec3((glm::vec2(ndc) + 1.0f) * screenScale, ndc.z);
+        }
+        for (u32 i = 1; i + 1 < count; i++)
+        {
+            RasterizeTriangle(screen[0], screen[i], screen[i + 1]);
+        }
+        numOccluderTriangles++;
+    }
+    scratch_end(scratch);
+}
+
+// v is (screen x, screen y, depth). Pixels whose center is inside get the farthest depth the triangle's plane reaches
+// inside the pixel, so a box right behind the occluder's surface is never behind the buffer.
+// Center sampling covers up to half a pixel past the triangle's edges, which is why occluders should sit inside what
+// they stand for. Making the edges conservative too would leave a line of empty pixels along every edge two triangles
+// share, with the buffer as coarse as it is that's most of the occlusion gone
+void OcclusionBuffer::RasterizeTriangle(glm::vec3 v0, glm::vec3 v1, glm::vec3 v2)
+{
+    f32 area = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+    if (std::abs(area) < 1e-6f) return;
+    if (area < 0.0f)
+    {
+        std::swap(v1, v2);
+        area = -area;
+    }
+    // edge function of a->b, positive on the triangle's side: a * x + b * y + c
+    auto edge = [](const glm::vec3& a, const glm::vec3& b) {
+        return glm::vec3(a.y - b.y, b.x - a.x, a.x * b.y - a.y * b.x);
+    };
+    // each edge is opposite one vertex, and is that vertex's barycentric weight (times area).
+    // An edge two triangles share comes out exactly negated in the other one, so with >= 0 on both sides there are no gaps
+    glm::vec3 edges[3] = { edge(v1, v2), edge(v2, v0), edge(v0, v1) };
+    glm::vec3 depthPlane = (edges[0] * v0.z + edges[1] * v1.z + edges[2] * v2.z) / area;
+    // moved from the pixel center to its farthest corner
+    depthPlane.z += 0.5f * (std::abs(depthPlane.x) + std::abs(depthPlane.y));
+
+    s32 minX = Math::Max((s32)std::floor(Math::Min(v0.x, Math::Min(v1.x, v2.x))), 0);
+    s32 maxX = Math::Min((s32)std::ceil(Math::Max(v0.x, Math::Max(v1.x, v2.x))), (s32)width - 1);
+    s32 minY = Math::Max((s32)std::floor(Math::Min(v0.y, Math::Min(v1.y, v2.y))), 0);
+    s32 maxY = Math::Min((s32)std::ceil(Math::Max(v0.y, Math::Max(v1.y, v2.y))), (s32)height - 1);
+    if (minX > maxX || minY > maxY) return;
+    // rows start on a SIMD block, the width is a whole number of them
+    minX -= minX % SIMD_WIDTH;
+    f32* buffer = depth.data();
+
+#if SIMD_WIDTH > 1
+    SimdF edgeX[3], edgeRow[3];
+    for (u32 e = 0; e < 3; e++) edgeX[e] = SIMD_SET1(edges[e].x);
+    SimdF depthX = SIMD_SET1(depthPlane.x);
+    SimdF zero = SIMD_ZERO();
+    // pixel centers of the first block in the row
+    SimdF firstX = SIMD_ADD(SIMD_LANE_INDICES(), SIMD_SET1((f32)minX + 0.5f));
+    SimdF blockStep = SIMD_SET1((f32)SIMD_WIDTH);
+    for (s32 y = minY; y <= maxY; y++)
+    {
+        f32 centerY = (f32)y + 0.5f;
+        for (u32 e = 0; e < 3; e++) edgeRow[e] = SIMD_SET1(edges[e].y * centerY + edges[e].z);
+        SimdF depthRow = SIMD_SET1(depthPlane.y * centerY + depthPlane.z);
+        SimdF x = firstX;
+        f32* row = buffer + (size_t)y * width;
+        for (s32 blockX = minX; blockX <= maxX; blockX += SIMD_WIDTH)
+        {
+            SimdF inside = SIMD_GREATER_EQUAL(SIMD_ADD(SIMD_MUL(edgeX[0], x), edgeRow[0]), zero);
+            inside = SIMD_AND(inside, SIMD_GREATER_EQUAL(SIMD_ADD(SIMD_MUL(edgeX[1], x), edgeRow[1]), zero));
+            inside = SIMD_AND(inside, SIMD_GREATER_EQUAL(SIMD_ADD(SIMD_MUL(edgeX[2], x), edgeRow[2]), zero));
+            if (SIMD_MOVEMASK(inside))
+            {
+                SimdF current = SIMD_LOAD(row + blockX);
+                SimdF triangleDepth = SIMD_ADD(SIMD_MUL(depthX, x), depthRow);
+                SIMD_STORE(row + blockX, SimdSelect(inside, SIMD_MIN(current, triangleDepth), current));
+            }
+            x = SIMD_ADD(x, blockStep);
+        }
+    }
+#else
+    for (s32 y = minY; y <= maxY; y++)
+    {
+        f32 centerY = (f32)y + 0.5f;
+        f32* row = buffer + (size_t)y * width;
+        for (s32 x = minX; x <= maxX; x++)
+        {
+            f32 centerX = (f32)x + 0.5f;
+            bool inside = true;
+            for (const glm::vec3& e : edges) inside &= e.x * centerX + e.y * centerY + e.z >= 0.0f;
+            if (inside)
+            {
+                row[x] = Math::Min(row[x], depthPlane.x * centerX + depthPlane.y * centerY + depthPlane.z);
+            }
+        }
+    }
+#endif
+}
+
+void OcclusionBuffer::BuildHiZ()
+{
+    PROFILE_FUNCTION();
+    f32* buffer = depth.data();
+    for (u32 mip = 1; mip < numMips; mip++)
+    {
+        const f32* src = buffer + mipOffsets[mip - 1];
+        f32* dst = buffer + mipOffsets[mip];
+        u32 srcWidth = mipWidths[mip - 1];
+        u32 srcHeight = mipHeights[mip - 1];
+        for (u32 y = 0; y < mipHeights[mip]; y++)
+        {
+            // odd sizes: the last texel only has one row/column under it
+            u32 y0 = y * 2;
+            u32 y1 = Math::Min(y0 + 1, srcHeight - 1);
+            for (u32 x = 0; x < mipWidths[mip]; x++)
+            {
+                u32 x0 = x * 2;
+                u32 x1 = Math::Min(x0 + 1, srcWidth - 1);
+                f32 farthest = Math::Max(
+                    Math::Max(src[y0 * srcWidth + x0], src[y0 * srcWidth + x1]),
+                    Math::Max(src[y1 * srcWidth + x0], src[y1 * srcWidth + x1]));
+                dst[y * mipWidths[mip] + x] = farthest;
+            }
+        }
+    }
+}
+
+bool OcclusionBuffer::IsBoxVisible(const BoundingBox& worldBox) const
+{
+    glm::vec2 minScreen = glm::vec2(FLT_MAX);
+    glm::vec2 maxScreen = glm::vec2(-FLT_MAX);
+    f32 nearestDepth = FLT_MAX;
+    // the corners are the min corner plus any of the box's three edges, which is adds instead of 8 matrix multiplies
+    glm::vec3 size = worldBox.max - worldBox.min;
+    glm::vec4 minCorner = viewProjection * glm::vec4(worldBox.min, 1.0f);
+    glm::vec4 edgeX = viewProjection[0] * size.x;
+    glm::vec4 edgeY = viewProjection[1] * size.y;
+    glm::vec4 edgeZ = viewProjection[2] * size.z;
+    for (u32 corner = 0; corner < 8; corner++)
+    {
+        glm::vec4 clip = minCorner;
+        if (corner & 1) clip += edgeX;
+        if (corner & 2) clip += edgeY;
+        if (corner & 4) clip += edgeZ;
+        // in front of the near plane (or behind the camera), we can't say anything about it
+        if (clip.w <= 0.0f || clip.z < -clip.w) return true;
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        minScreen = glm::min(minScreen, glm::vec2(ndc));
+        maxScreen = glm::max(maxScreen, glm::vec2(ndc));
+        nearestDepth = Math::Min(nearestDepth, ndc.z);
+    }
+    minScreen = (minScreen + 1.0f) * 0.5f * glm::vec2(width, height);
+    maxScreen = (maxScreen + 1.0f) * 0.5f * glm::vec2(width, height);
+    if (maxScreen.x < 0.0f || maxScreen.y < 0.0f || minScreen.x > (f32)width || minScreen.y > (f32)height) return true;
+    // every pixel the box's screen rect touches
+    u32 x0 = (u32)glm::clamp(std::floor(minScreen.x), 0.0f, (f32)width - 1);
+    u32 x1 = (u32)glm::clamp(std::floor(maxScreen.x), 0.0f, (f32)width - 1);
+    u32 y0 = (u32)glm::clamp(std::floor(minScreen.y), 0.0f, (f32)height - 1);
+    u32 y1 = (u32)glm::clamp(std::floor(maxScreen.y), 0.0f, (f32)height - 1);
+    // the first mip where that's at most 2x2 texels
+    u32 mip = 0;
+    while (mip + 1 < numMips && ((x1 >> mip) - (x0 >> mip) > 1 || (y1 >> mip) - (y0 >> mip) > 1)) mip++;
+    for (u32 y = y0 >> mip; y <= (y1 >> mip); y++)
+    {
+        for (u32 x = x0 >> mip; x <= (x1 >> mip); x++)
+        {
+            if (nearestDepth <= GetDepth(mip, x, y)) return true;
+        }
+    }
+    return false;
+}
+
+u32 OcclusionBuffer::CullOccluded(CullingSet& set, CullView view, bool parallel) const
+{
+    PROFILE_FUNCTION();
+    u32 count = set.GetSize();
+    auto cullRange = [&](u32 begin, u32 end) {
+        u32 numOccluded = 0;
+        for (u32 i = begin; i < end; i++)
+        {
+            if (set.IsVisible(i, view) && !IsBoxVisible(set.GetBox(i)))
+            {
+                set.SetVisible(i, view, false);
+                numOccluded++;
+            }
+        }
+        return numOccluded;
+    };
+    if (!parallel || count < CULLING_PARALLEL_MIN_COUNT)
+    {
+        return cullRange(0, count);
+    }
+    u32 numChunks = (count + CULLING_GRAIN_SIZE - 1) / CULLING_GRAIN_SIZE;
+    return JobSystem::Instance().ParallelReduce(0, numChunks, 1, 0u,
+        [&](u32 chunk) {
+            u32 begin = chunk * CULLING_GRAIN_SIZE;
+            return cullRange(begin, Math::Min(begin + CULLING_GRAIN_SIZE, count));
+        },
+        [](u32 a, u32 b) { return a + b; });
+}
+
+// ============ tests / benchmarks ============
+
+#include <chrono>
+#include <random>
+#include <vector>
+#include "scene/bvh.h"
+
+struct TestMesh
+{
+    std::vector<glm::vec3> vertices;
+    std::vector<u32> indices;
+};
+
+// wall facing +z
+static TestMesh QuadMesh(glm::vec3 center, glm::vec2 halfSize)
+{
+    TestMesh mesh;
+    mesh.vertices = {
+        center + glm::vec3(-halfSize.x, -halfSize.y, 0), center + glm::vec3(halfSize.x, -halfSize.y, 0),
+        center + glm::vec3(halfSize.x, halfSize.y, 0), center + glm::vec3(-halfSize.x, halfSize.y, 0),
+    };
+    mesh.indices = { 0, 1, 2, 0, 2, 3 };
+    return mesh;
+}
+
+static TestMesh BoxMesh(const BoundingBox& box)
+{
+    TestMesh mesh;
+    for (u32 corner = 0; corner < 8; corner++)
+    {
+        mesh.vertices.push_back(glm::vec3(
+            corner & 1 ? box.max.x : box.min.x,
+            corner & 2 ? box.max.y : box.min.y,
+            corner & 4 ? box.max.z : box.min.z));
+    }
+    mesh.indices = {
+        0, 2, 1, 1, 2, 3, // -z
+        4, 5, 6, 5, 7, 6, // +z
+        0, 1, 4, 1, 5, 4, // -y
+        2, 6, 3, 3, 6, 7, // +y
+        0, 4, 2, 2, 4, 6, // -x
+        1, 3, 5, 3, 7, 5, // +x
+    };
+    return mesh;
+}
+
+static void Rasterize(OcclusionBuffer& buffer, const TestMesh& mesh, const glm::mat4& world = glm::mat4(1.0f))
+{
+    buffer.RasterizeOccluder(world, mesh.vertices.data(), sizeof(glm::vec3), (u32)mesh.vertices.size(), mesh.indices.data(), (u32)mesh.indices.size());
+}
+
+static glm::mat4 TestViewProjection(glm::vec3 eye, glm::vec3 target, f32 farPlane = 200.0f)
+{
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), (f32)OCCLUSION_BUFFER_WIDTH / OCCLUSION_BUFFER_HEIGHT, 0.1f, farPlane);
+    return projection * glm::lookAt(eye, target, glm::vec3(0, 1, 0));
+}
+
+// every full res pixel under the box instead of the pyramid. Same corner projection as IsBoxVisible
+static bool IsBoxVisibleBruteForce(const OcclusionBuffer& buffer, const glm::mat4& viewProjection, const BoundingBox& box)
+{
+    glm::vec2 minScreen = glm::vec2(FLT_MAX), maxScreen = glm::vec2(-FLT_MAX);
+    f32 nearestDepth = FLT_MAX;
+    for (u32 corner = 0; corner < 8; corner++)
+    {
+        glm::vec3 position = glm::vec3(corner & 1 ? box.max.x : box.min.x, corner & 2 ? box.max.y : box.min.y, corner & 4 ? box.max.z : box.min.z);
+        glm::vec4 clip = viewProjection * glm::vec4(position, 1.0f);
+        if (clip.w <= 0.0f || clip.z < -clip.w) return true;
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        minScreen = glm::min(minScreen, glm::vec2(ndc));
+        maxScreen = glm::max(maxScreen, glm::vec2(ndc));
+        nearestDepth = Math::Min(nearestDepth, ndc.z);
+    }
+    glm::vec2 size = glm::vec2(buffer.GetWidth(), buffer.GetHeight());
+    minScreen = (minScreen + 1.0f) * 0.5f * size;
+    maxScreen = (maxScreen + 1.0f) * 0.5f * size;
+    if (maxScreen.x < 0.0f || maxScreen.y < 0.0f || minScreen.x > size.x || minScreen.y > size.y) return true;
+    for (u32 y = (u32)glm::clamp(std::floor(minScreen.y), 0.0f, size.y - 1); y <= (u32)glm::clamp(std::floor(maxScreen.y), 0.0f, size.y - 1); y++)
+    {
+        for (u32 x = (u32)glm::clamp(std::floor(minScreen.x), 0.0f, size.x - 1); x <= (u32)glm::clamp(std::floor(maxScreen.x), 0.0f, size.x - 1); x++)
+        {
+            if (nearestDepth <= buffer.GetDepth(0, x, y)) return true;
+        }
+    }
+    return false;
+}
+
+// Moller-Trumbore, t along the segment (0..1), negative on a miss
+static f32 SegmentTriangle(glm::vec3 start, glm::vec3 delta, glm::vec3 a, glm::vec3 b, glm::vec3 c)
+{
+    glm::vec3 ab = b - a, ac = c - a;
+    glm::vec3 p = glm::cross(delta, ac);
+    f32 det = glm::dot(ab, p);
+    if (std::abs(det) < 1e-12f) return -1.0f;
+    f32 invDet = 1.0f / det;
+    glm::vec3 s = start - a;
+    f32 u = glm::dot(s, p) * invDet;
+    if (u < 0.0f || u > 1.0f) return -1.0f;
+    glm::vec3 q = glm::cross(s, ab);
+    f32 v = glm::dot(delta, q) * invDet;
+    if (v < 0.0f || u + v > 1.0f) return -1.0f;
+    f32 t = glm::dot(ac, q) * invDet;
+    return t >= 0.0f && t <= 1.0f ? t : -1.0f;
+}
+
+void OcclusionTests()
+{
+    LOG_INFO("Running occlusion tests...");
+    OcclusionBuffer buffer;
+    buffer.Initialize();
+    TINY_ASSERT(buffer.GetWidth() % SIMD_WIDTH == 0 && buffer.GetWidth() >= OCCLUSION_BUFFER_WIDTH);
+    TINY_ASSERT(buffer.GetDepth(buffer.GetNumMips() - 1, 0, 0) == 1.0f);
+
+    // one wall 10 units in front of a camera at the origin looking down -z
+    {
+        glm::mat4 viewProjection = TestViewProjection(glm::vec3(0), glm::vec3(0, 0, -1));
+        auto boxAt = [](glm::vec3 center, f32 halfSize) { return BoundingBox(center - glm::vec3(halfSize), center + glm::vec3(halfSize)); };
+        struct Case { BoundingBox box; bool visible; };
+        const Case cases[] = {
+            { boxAt(glm::vec3(0, 0, -20), 1.0f), false },   // right behind it
+            { boxAt(glm::vec3(3, -3, -60), 3.0f), false },  // far behind it
+            { boxAt(glm::vec3(14, 0, -20), 1.0f), true },   // behind, but off to the side
+            { boxAt(glm::vec3(9.5f, 0, -20), 1.0f), true }, // peeking out past the edge
+            { boxAt(glm::vec3(0, 0, -5), 1.0f), true },     // in front of it
+            { boxAt(glm::vec3(0, 0, -10), 1.0f), true },    // sticking through it
+            { boxAt(glm::vec3(0, 0, -30), 20.0f), true },   // bigger than what it hides
+            { boxAt(glm::vec3(0, 0, 0), 1.0f), true },      // around the camera
+            { boxAt(glm::vec3(0, 0, 10), 1.0f), true },     // behind the camera
+        };
+        buffer.Begin(viewProjection);
+        for (const Case& c : cases) TINY_ASSERT(buffer.IsBoxVisible(c.box));
+        Rasterize(buffer, QuadMesh(glm::vec3(0, 0, -10), glm::vec2(5)));
+        TINY_ASSERT(buffer.GetNumOccluderTriangles() == 2);
+        buffer.BuildHiZ();
+        for (const Case& c : cases)
+        {
+            TINY_ASSERT(buffer.IsBoxVisible(c.box) == c.visible);
+            TINY_ASSERT(IsBoxVisibleBruteForce(buffer, viewProjection, c.box) == c.visible);
+        }
+
+        // the same through a CullingSet, and only touching the bit asked for
+        CullingSet set;
+        for (const Case& c : cases) set.Add(c.box);
+        for (bool parallel : { false, true })
+        {
+            set.SetVisible(2, CULL_VIEW_CAMERA, false); // already culled, doesn't count again
+            u32 expected = 0;
+            for (u32 i = 0; i < ARRAY_SIZE(cases); i++) expected += !cases[i].visible && set.IsVisible(i, CULL_VIEW_CAMERA);
+            TINY_ASSERT(buffer.CullOccluded(set, CULL_VIEW_CAMERA, parallel) == expected);
+            for (u32 i = 0; i < ARRAY_SIZE(cases); i++)
+            {
+                TINY_ASSERT(set.IsVisible(i, CULL_VIEW_CAMERA) == (cases[i].visible && i != 2));
+                TINY_ASSERT(set.IsVisible(i, CULL_VIEW_SHADOW));
+                set.SetVisible(i, CULL_VIEW_CAMERA, true);
+            }
+        }
+
+        // without indices, moved by the world matrix, and far enough behind the box that it no longer hides it
+        buffer.Begin(viewProjection);
+        TestMesh wall = QuadMesh(glm::vec3(0), glm::vec2(5));
+        std::vector<glm::vec3> unindexed;
+        for (u32 index : wall.indices) unindexed.push_back(wall.vertices[index]);
+        buffer.RasterizeOccluder(glm::translate(glm::mat4(1.0f), glm::vec3(0, 0, -25)), unindexed.data(), sizeof(glm::vec3), (u32)unindexed.size(), nullptr, 0);
+        buffer.BuildHiZ();
+        TINY_ASSERT(buffer.IsBoxVisible(cases[0].box) && !buffer.IsBoxVisible(cases[1].box));
+    }
+
+    std::mt19937 rng(99);
+    std::uniform_real_distribution<f32> unit(-1.0f, 1.0f);
+    for (u32 round = 0; round < 10; round++)
+    {
+        glm::vec3 eye = glm::vec3(unit(rng), unit(rng), unit(rng)) * 5.0f;
+        glm::vec3 target = eye + glm::vec3(unit(rng), unit(rng) * 0.3f, -1.0f);
+        glm::mat4 viewProjection = TestViewProjection(eye, target, 100.0f);
+        glm::vec3 forward = glm::normalize(target - eye);
+        // random triangles spread out in front of the camera, a few of them through the near plane
+        std::vector<glm::vec3> triangles;
+        for (u32 t = 0; t < 40; t++)
+        {
+            glm::vec3 center = eye + forward * (2.0f + 30.0f * (unit(rng) * 0.5f + 0.5f)) + glm::vec3(unit(rng), unit(rng), unit(rng)) * 12.0f;
+            for (u32 corner = 0; corner < 3; corner++) triangles.push_back(center + glm::vec3(unit(rng), unit(rng), unit(rng)) * 8.0f);
+        }
+        buffer.Begin(viewProjection);
+        buffer.RasterizeOccluder(glm::mat4(1.0f), triangles.data(), sizeof(glm::vec3), (u32)triangles.size(), nullptr, 0);
+        buffer.BuildHiZ();
+
+        // the full res buffer against a ray through every pixel center
+        glm::mat4 inverseViewProjection = glm::inverse(viewProjection);
+        u32 mismatches = 0, covered = 0;
+        for (u32 y = 0; y < buffer.GetHeight(); y++)
+        {
+            for (u32 x = 0; x < buffer.GetWidth(); x++)
+            {
+                glm::vec2 ndc = (glm::vec2(x + 0.5f, y + 0.5f) / glm::vec2(buffer.GetWidth(), buffer.GetHeight())) * 2.0f - 1.0f;
+                glm::vec4 nearPoint = inverseViewProjection * glm::vec4(ndc, -1.0f, 1.0f);
+                glm::vec4 farPoint = inverseViewProjection * glm::vec4(ndc, 1.0f, 1.0f);
+                glm::vec3 start = glm::vec3(nearPoint) / nearPoint.w;
+                glm::vec3 delta = glm::vec3(farPoint) / farPoint.w - start;
+                f32 nearestT = FLT_MAX;
+                for (u32 t = 0; t < triangles.size(); t += 3)
+                {
+                    f32 hit = SegmentTriangle(start, delta, triangles[t], triangles[t + 1], triangles[t + 2]);
+                    if (hit >= 0.0f) nearestT = Math::Min(nearestT, hit);
+                }
+                f32 stored = buffer.GetDepth(0, x, y);
+                if (nearestT == FLT_MAX)
+                {
+                    mismatches += stored != 1.0f;
+                    continue;
+                }
+                covered++;
+                glm::vec4 hitClip = viewProjection * glm::vec4(start + delta * nearestT, 1.0f);
+                // never nearer than what's really there
+                mismatches += stored < hitClip.z / hitClip.w - 1e-4f;
+            }
+        }
+        // pixel centers right on an edge can go either way
+        TINY_ASSERT(covered > 0 && mismatches <= buffer.GetWidth() * buffer.GetHeight() / 1000);
+
+        // the pyramid never hides a box the full res buffer shows, and does hide some
+        u32 hidden = 0;
+        for (u32 b = 0; b < 2000; b++)
+        {
+            glm::vec3 center = eye + forward * (5.0f + 60.0f * (unit(rng) * 0.5f + 0.5f)) + glm::vec3(unit(rng), unit(rng), unit(rng)) * 20.0f;
+            glm::vec3 halfSize = glm::vec3(unit(rng), unit(rng), unit(rng)) * 0.5f + 0.6f;
+            BoundingBox box = BoundingBox(center - halfSize, center + halfSize);
+            bool visible = buffer.IsBoxVisible(box);
+            TINY_ASSERT(visible || !IsBoxVisibleBruteForce(buffer, viewProjection, box));
+            hidden += !visible;
+        }
+        TINY_ASSERT(hidden > 0);
+    }
+    LOG_INFO("Occlusion tests passed (simd width %u)", SIMD_WIDTH);
+}
+
+template <typename Func>
+static f64 TimeMs(Func func)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    func();
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<f64, std::milli>(end - start).count();
+}
+
+void OcclusionBenchmarks()
+{
+    LOG_INFO("Running occlusion benchmarks (simd width %u)...", SIMD_WIDTH);
+    // 40x40 city blocks 20 units apart with 6 unit wide streets, every building a box occluder, and 200k props
+    // (crates, lamps, cars) on the streets and roofs
+    constexpr u32 numBlocks = 40;
+    constexpr f32 blockSpacing = 20.0f;
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<f32> unit(0.0f, 1.0f);
+    std::vector<TestMesh> buildings;
+    for (u32 z = 0; z < numBlocks; z++)
+    {
+        for (u32 x = 0; x < numBlocks; x++)
+        {
+            glm::vec3 corner = glm::vec3(x * blockSpacing, 0.0f, z * blockSpacing);
+            f32 height = 10.0f + 30.0f * unit(rng);
+            buildings.push_back(BoxMesh(BoundingBox(corner, corner + glm::vec3(blockSpacing - 6.0f, height, blockSpacing - 6.0f))));
+        }
+    }
+    constexpr u32 numProps = 200000;
+    f32 citySize = numBlocks * blockSpacing;
+    CullingSet props;
+    for (u32 i = 0; i < numProps; i++)
+    {
+        glm::vec3 position = glm::vec3(unit(rng) * citySize, unit(rng) < 0.8f ? 0.0f : 10.0f + 30.0f * unit(rng), unit(rng) * citySize);
+        glm::vec3 size = glm::vec3(0.5f + 2.0f * unit(rng), 0.5f + 2.0f * unit(rng), 0.5f + 2.0f * unit(rng));
+        props.Add(BoundingBox(position, position + size));
+    }
+
+    const u32 resolutions[][2] = { { 160, 96 }, { OCCLUSION_BUFFER_WIDTH, OCCLUSION_BUFFER_HEIGHT }, { 640, 384 } };
+    for (const auto& resolution : resolutions)
+    {
+        OcclusionBuffer buffer;
+        buffer.Initialize(resolution[0], resolution[1]);
+        constexpr u32 numViews = 20;
+        f64 rasterMs = 0.0, hizMs = 0.0, testMs = 0.0, parallelTestMs = 0.0;
+        u64 inFrustum = 0, occluded = 0, triangles = 0;
+        std::mt19937 viewRng(3);
+        std::uniform_real_distribution<f32> viewUnit(0.0f, 1.0f);
+        for (u32 view = 0; view < numViews; view++)
+        {
+            // standing in a street, looking down it or across the blocks
+            f32 street = (f32)(u32)(viewUnit(viewRng) * numBlocks) * blockSpacing - 3.0f;
+            glm::vec3 eye = glm::vec3(street, 1.8f, viewUnit(viewRng) * citySize);
+            f32 angle = viewUnit(viewRng) * 2.0f * PI_F;
+            glm::mat4 viewProjection = TestViewProjection(eye, eye + glm::vec3(std::sin(angle), 0.0f, std::cos(angle)), 500.0f);
+            FrustumPlanes frustum = Math::FrustumPlanesFromMatrix(viewProjection);
+            inFrustum += props.Cull(frustum, CULL_VIEW_CAMERA);
+
+            rasterMs += TimeMs([&]() {
+                buffer.Begin(viewProjection);
+                for (const TestMesh& building : buildings)
+                {
+                    // the frustum check is what a caller would do first anyway
+                    BoundingBox bounds = BoundingBox(building.vertices[0], building.vertices[7]);
+                    if (FrustumTestBox(frustum, bounds) == FrustumTestResult::OUTSIDE) continue;
+                    Rasterize(buffer, building);
+                }
+            });
+            triangles += buffer.GetNumOccluderTriangles();
+            hizMs += TimeMs([&]() { buffer.BuildHiZ(); });
+            u32 numOccluded = 0;
+            testMs += TimeMs([&]() { numOccluded = buffer.CullOccluded(props, CULL_VIEW_CAMERA, false); });
+            occluded += numOccluded;
+            // same test again with jobs, on the same frustum results
+            props.Cull(frustum, CULL_VIEW_CAMERA);
+            u32 numOccludedParallel = 0;
+            parallelTestMs += TimeMs([&]() { numOccludedParallel = buffer.CullOccluded(props, CULL_VIEW_CAMERA, true); });
+            TINY_ASSERT(numOccluded == numOccludedParallel);
+        }
+        LOG_INFO("[OCCLUSION] %3ux%3u | %5llu occluder tris/view | raster %6.3f ms | hiz %6.3f ms | test %6llu props in the frustum %6.3f ms (jobs %6.3f ms) | %5.1f%% of those occluded, %5.1f%% of all %u culled",
+            buffer.GetWidth(), buffer.GetHeight(), triangles / numViews,
+            rasterMs / numViews, hizMs / numViews, inFrustum / numViews, testMs / numViews, parallelTestMs / numViews,
+            100.0 * (f64)occluded / (f64)Math::Max(inFrustum, (u64)1),
+            100.0 * (f64)((u64)numProps * numViews - inFrustum + occluded) / ((f64)numProps * numViews), numProps);
+    }
+}
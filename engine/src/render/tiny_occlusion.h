@@ -0,0 +1,80 @@
+#ifndef TINY_OCCLUSION_H
+#define TINY_OCCLUSION_H
+
+#include "tiny_defines.h"
+#include "tiny_types.h"
+#include "math/tiny_math.h"
+#include "containers/dynarray.h"
+#include "render/tiny_culling.h"
+
+// Software occlusion culling, entirely on the CPU. A handful of big, low-poly occluders (walls, terrain, buildings) are
+// rasterized into a small depth buffer, SIMD_WIDTH pixels at a time. A max-depth mip pyramid (hierarchical Z) is built
+// over that, and a box is occluded when its nearest depth is behind the farthest occluder depth everywhere it covers
+// on screen. The box test reads 2x2 texels at most, from whichever mip level the box fits in.
+// Occluders cover the pixels whose centers they cover, like the GPU would, so they should sit inside the geometry they
+// stand for (a low-poly hull that's a bit smaller, or a mesh that's a solid wall anyway). Past that it errs towards
+// visible: occluders write the farthest depth they reach inside a pixel, boxes test their nearest depth against the
+// farthest texel they touch, and boxes crossing the near plane are always visible.
+// Depth is OpenGL NDC z (-1 near, 1 far), the buffer starts out at 1 every frame.
+//
+// Per frame: Begin, RasterizeOccluder for every occluder, BuildHiZ, then test. Tests are const, so any number of
+// threads can run them at once (CullOccluded does that), as long as nobody is rasterizing.
+
+// a lot smaller than the screen. Width is rounded up to a multiple of SIMD_WIDTH
+#define OCCLUSION_BUFFER_WIDTH 320
+#define OCCLUSION_BUFFER_HEIGHT 192
+// 320x192 down to 1x1
+#define OCCLUSION_MAX_MIPS 16
+// meshes with more triangles than this aren't worth rasterizing as occluders
+#define OCCLUSION_MAX_OCCLUDER_TRIANGLES 4096
+
+struct OcclusionBuffer
+{
+    TAPI void Initialize(u32 width = OCCLUSION_BUFFER_WIDTH, u32 height = OCCLUSION_BUFFER_HEIGHT);
+    // clears the depth buffer for a new view
+    TAPI void Begin(const glm::mat4& viewProjection);
+    // position is the first 3 floats of every vertex, vertices are vertexStride bytes apart. Without indices every
+    // 3 vertices are a triangle. Both sides of a triangle occlude
+    TAPI void RasterizeOccluder(
+        const glm::mat4& worldMatrix,
+        const void* vertices, u32 vertexStride, u32 numVertices,
+        const u32* indices, u32 numIndices);
+    // after the last occluder, before testing
+    TAPI void BuildHiZ();
+    // false when the whole box is hidden behind occluders. Boxes off screen are reported visible, that's the
+    // frustum's call to make
+    TAPI bool IsBoxVisible(const BoundingBox& worldBox) const;
+    // clears view's bit on every box of set that still has it and is occluded, returns how many that was
+    TAPI u32 CullOccluded(CullingSet& set, CullView view, bool parallel = true) const;
+
+    inline u32 GetWidth() const { return width; }
+    inline u32 GetHeight() const { return height; }
+    inline u32 GetNumMips() const { return numMips; }
+    // the farthest depth in that texel of that mip level
+    inline f32 GetDepth(u32 mip, u32 x, u32 y) const { return depth[mipOffsets[mip] + y * mipWidths[mip] + x]; }
+    // since Begin
+    inline u32 GetNumOccluderTriangles() const { return numOccluderTriangles; }
+
+private:
+    void RasterizeTriangle(glm::vec3 v0, glm::vec3 v1, glm::vec3 v2);
+
+    // every mip level back to back, level 0 is the depth buffer itself
+    DynArray<f32> depth = {};
+    u32 mipOffsets[OCCLUSION_MAX_MIPS] = {};
+    u32 mipWidths[OCCLUSION_MAX_MIPS] = {};
+    u32 mipHeights[OCCLUSION_MAX_MIPS] = {};
+    u32 numMips = 0;
+    u32 width = 0;
+    u32 height = 0;
+    glm::mat4 viewProjection = glm::mat4(1.0f);
+    u32 numOccluderTriangles = 0;
+};
+
+// walls in front of, beside and behind boxes, boxes crossing the near plane, HiZ against the full res buffer, and
+// random occluders/boxes where anything reported occluded is checked by casting rays at it
+TAPI void OcclusionTests();
+// a city block grid seen from the street: rasterize/HiZ/test times and how much of what the frustum let through
+// gets occluded, CPU only
+TAPI void OcclusionBenchmarks();
+
+#endif
@@ -1,7 +1,9 @@
 #include "tiny_renderer.h"
 
 #include "mem/tiny_arena.h"
+#include "mem/tiny_heap.h"
 #include "containers/fixed_growable_array.h"
+#include "containers/hash_map.h"
 #include "tiny_engine.h"
 #include "render/shader.h"
 #include "render/tiny_ogl.h"
@@ -17,8 +19,14 @@
 #include "render/skybox.h"
 #include "tiny_imgui.h"
 #include "render/postprocess.h"
+#include "render/tiny_culling.h"
+#include "render/tiny_occlusion.h"
+#include "containers/dynarray.h"
+#include "job_system.h"
+#include "scene/bvh.h"
 #include "physics/tiny_physics.h"
 #include "res/shaders/shader_defines.glsl"
+#include <chrono>
 
 
 constexpr u32 MAX_NUM_RENDER_PASSES = 10;
@@ -49,6 +57,8 @@ struct RMesh
     BufferView<RMeshVertex> vertices = {};
     BufferView<RMeshIndex> indices = {};
     u32 numInstances = 0;
+    // index of the mesh's world bounds in RendererData::culling, invalid for meshes that are never culled
+    u32 cullIndex = U32_INVALID_ID;
 };
 
 struct MeshBatch
@@ -127,23 +137,50 @@ struct RenderPass
     RenderPassInitialize initializeFunc = nullptr;
     #define RENDERPASS_MAX_NAME_LENGTH 30
     const char* passName = "Unnamed Pass";
+    // CullView a mesh has to be visible in to be drawn in this pass. 0 draws everything
+    u8 cullView = 0;
     bool active = false;
     bool needsLightingMaterialUniforms = false;
 };
 
+struct PushedEntityMesh
+{
+    EntityRef entity;
+    u32 cullIndex;
+    BoundingBox localBounds;
+};
+
+// rasterized at cull time, entity ones with the entity's matrix as of then
+struct PushedOccluder
+{
+    const Mesh* mesh;
+    EntityRef entity;
+    glm::mat4 worldMatrix;
+};
+
 struct RendererData
 {
-    Arena arena = {};
     FixedGrowableArray<RPoint, MAX_NUM_PRIMITIVE_DRAWS> points = {};
     u32 pointsVAO, pointsVBO = 0;
     FixedGrowableArray<RLine, MAX_NUM_PRIMITIVE_DRAWS> lines = {};
     u32 linesVAO, linesVBO = 0;
     FixedGrowableArray<RTriangle, MAX_NUM_PRIMITIVE_DRAWS> triangles = {};
     u32 trianglesVAO, trianglesVBO = 0;
-    typedef std::unordered_map<u64, MeshBatch> BatchMap;
+    typedef HashMap<u64, MeshBatch> BatchMap;
     BatchMap meshesToRender = {};
     u32 indirectGPUBuffer = 0;
     RenderPass outputPasses[MAX_NUM_RENDER_PASSES] = {};
+    // world bounds of the meshes pushed this frame, culled against the camera and the sun before the passes run
+    CullingSet culling = {};
+    // entities can still move between being pushed and the draw, so their bounds are filled in right before culling
+    DynArray<PushedEntityMesh> entityMeshes = {};
+    OcclusionBuffer occlusion = {};
+    DynArray<PushedOccluder> occluders = {};
+    // entity meshes already warned about being over OCCLUSION_MAX_OCCLUDER_TRIANGLES, so the log isn't spammed every frame
+    HashMap<const Mesh*, bool> rejectedOccluders = {};
+    bool occlusionCulling = true;
+    u32 numUncullable = 0;
+    Renderer::CullingStats cullingStats = {};
     //Framebuffer finalOutput = {};
     Skybox skybox = {};
     bool needsSetup = true;
@@ -202,9 +239,8 @@ bool PrepassSetUniformsDirectionalShadows(
 
 void PrepassShadowsPostprocess(
     const RenderPass& pass,
-    u32 passIndex)
+    u32)
 {
-    RendererData& renderer = GetRenderer();
     GetEngineCtx().lightsSubsystem->directionalShadowMap = pass.output;
 }
 
@@ -304,6 +340,7 @@ static RenderPass premadeRenderPrepasses[] =
         .preDrawFunc = PrepassSetUniformsDirectionalShadows,
         .postprocessFunc = PrepassShadowsPostprocess,
         .passName = "Directional Shadows",
+        .cullView = CULL_VIEW_SHADOW,
     },
     {
         .outputProperties = 
@@ -344,6 +381,7 @@ static RenderPass premadeRenderPrepasses[] =
         .preprocessFunc = GbufferPreprocess,
         .postprocessFunc = GbufferPostprocess,
         .passName = "Gbuffer",
+        .cullView = CULL_VIEW_CAMERA,
         .needsLightingMaterialUniforms = true,
     },
     { // SSAO needs to be after depth&normals (FUTURE: rendergraph)
@@ -376,8 +414,7 @@ void InitializeRenderer(Arena* arena)
 {
     RendererData* rendererMem = arena_alloc_and_init<RendererData>(arena);
     GetEngineCtx().renderer = rendererMem;
-    u32 renderingDataSize = Math::PercentOf(get_free_space(arena), 10);
-    rendererMem->arena = arena_init(arena_alloc(arena, renderingDataSize), renderingDataSize, "Rendering Data");
+    rendererMem->occlusion.Initialize();
     glGenBuffers(1, &rendererMem->indirectGPUBuffer);
     glBindBuffer(GL_DRAW_INDIRECT_BUFFER, rendererMem->indirectGPUBuffer);
     glBufferData(GL_DRAW_INDIRECT_BUFFER, MAX_NUM_MESHES_PER_BATCH * sizeof(DrawElementsIndirectCommand), nullptr, GL_DYNAMIC_DRAW);
@@ -554,12 +591,42 @@ void posterizationEffectImGui()
     }
 }
 
+void heapStatsImGui()
+{
+    if (ImGui::CollapsingHeader("Memory"))
+    {
+        HeapStats stats;
+        heap_get_stats(&stats);
+        ImGui::Text("small blocks carved: %.2f MB", (f64)stats.smallBlockBytes / MEGABYTES_BYTES(1.0));
+        ImGui::Text("large blocks live: %.2f MB", (f64)stats.largeLiveBytes / MEGABYTES_BYTES(1.0));
+        for (u32 i = 0; i < (u32)MemTag::NUM_TAGS; i++)
+        {
+            const HeapTagStats& tag = stats.tags[i];
+            ImGui::Text("%-10s %10.2f KB | %8llu live | %10llu total", heap_tag_name((MemTag)i),
+                (f64)tag.liveBytes / KILOBYTES_BYTES(1.0), tag.liveAllocations, tag.totalAllocations);
+        }
+    }
+}
+
 void DebugPreDraw()
 {
     posterizationEffectImGui();
+    heapStatsImGui();
     // collision shapes
     PhysicsDebugRender();
     RendererData& renderer = GetRenderer();
+    if (ImGui::CollapsingHeader("Culling"))
+    {
+        const Renderer::CullingStats& stats = renderer.cullingStats;
+        auto percent = [](u32 part, u32 total) { return total ? 100.0f * (f32)part / (f32)total : 0.0f; };
+        u32 numMeshes = stats.cameraVisible + stats.cameraCulled;
+        ImGui::Checkbox("Occlusion culling", &renderer.occlusionCulling);
+        ImGui::Text("camera: %u visible, %u culled (%.1f%%)", stats.cameraVisible, stats.cameraCulled, percent(stats.cameraCulled, numMeshes));
+        ImGui::Text("  occluded: %u (%.1f%%) by %u occluder triangles", stats.cameraOccluded, percent(stats.cameraOccluded, numMeshes), stats.occluderTriangles);
+        ImGui::Text("shadows: %u visible, %u culled (%.1f%%)", stats.shadowVisible, stats.shadowCulled, percent(stats.shadowCulled, numMeshes));
+        ImGui::Text("never culled: %u", stats.uncullable);
+        ImGui::Text("cull time: %.3f ms (occlusion %.3f ms)", stats.cullMs, stats.occlusionMs);
+    }
     if (ImGui::CollapsingHeader("Render passes"))
     {
         ImGui::SliderInt("Color Attachment Idx", &renderer.debugRenderPassAttachmentIdx, 0, MAX_NUM_COLOR_ATTACHMENTS);
@@ -781,14 +848,37 @@ void DrawBatch(
         // prep draw data
         u32 numMeshes = batch.meshes.size;
         if (numMeshes < 1) return;
+        ArenaTemp drawCommandsTemp = arena_temp_begin(arena);
         DrawElementsIndirectCommand* drawCommands = arena_alloc_type(arena, DrawElementsIndirectCommand, numMeshes);
         TMEMSET(drawCommands, 0, sizeof(DrawElementsIndirectCommand) * numMeshes);
         u64 verticesMemSize = 0;
         u64 indicesMemSize = 0;
         GetDrawData(batch.meshes.get_elements(), numMeshes, drawCommands, verticesMemSize, indicesMemSize);
+        if (pass.cullView)
+        {
+            // culled meshes keep their command (and their spot in the batch's gpu buffers), they just draw 0 instances
+            u32 numVisible = 0;
+            for (u32 i = 0; i < numMeshes; i++)
+            {
+                u32 cullIndex = batch.meshes.at(i).cullIndex;
+                if (cullIndex != U32_INVALID_ID && !renderer.culling.IsVisible(cullIndex, (CullView)pass.cullView))
+                {
+                    drawCommands[i].instanceCount = 0;
+                }
+                else
+                {
+                    numVisible++;
+                }
+            }
+            if (numVisible == 0)
+            {
+                arena_temp_end(drawCommandsTemp);
+                return;
+            }
+        }
         glBindBuffer(GL_DRAW_INDIRECT_BUFFER, renderer.indirectGPUBuffer);
         glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, numMeshes * sizeof(DrawElementsIndirectCommand), drawCommands);
-        arena_pop_latest(arena, drawCommands);
+        arena_temp_end(drawCommandsTemp);
         // use shader & manage automatic uniforms
         if (batch.shader != selectedShader)
         {
@@ -823,14 +913,88 @@ void BatchPreprocessing(
         u32 numMeshes = batch.meshes.size;
         TINY_ASSERT(numMeshes <= MAX_NUM_MESHES_PER_BATCH && numMeshes > 0);
         // get draw commands and check if we need to resize gpu buffers
+        ArenaTemp drawCommandsTemp = arena_temp_begin(arena);
         DrawElementsIndirectCommand* drawCommands = arena_alloc_type(arena, DrawElementsIndirectCommand, numMeshes);
         TMEMSET(drawCommands, 0, sizeof(DrawElementsIndirectCommand) * numMeshes);
         u64 verticesMemSize = 0;
         u64 indicesMemSize = 0;
         GetDrawData(batch.meshes.get_elements(), numMeshes, drawCommands, verticesMemSize, indicesMemSize);
         CheckRegenerateGPUBuffers(batch, drawCommands, verticesMemSize, indicesMemSize);
-        arena_pop_latest(arena, drawCommands);
+        arena_temp_end(drawCommandsTemp);
+    }
+}
+
+// camera and sun frustums against the world bounds of everything pushed this frame
+void CullScene(RendererData& renderer)
+{
+    PROFILE_FUNCTION();
+    auto start = std::chrono::high_resolution_clock::now();
+    Renderer::CullingStats& stats = renderer.cullingStats;
+    stats = {};
+    // transforms are up to date by now (Entity::UpdateTransforms runs before rendering)
+    CullingSet& culling = renderer.culling;
+    const PushedEntityMesh* entityMeshes = renderer.entityMeshes.data();
+    auto setEntityBounds = [&](u32 i) {
+        const PushedEntityMesh& pushed = entityMeshes[i];
+        culling.Set(pushed.cullIndex, TransformBounds(pushed.localBounds, Entity::GetWorldMatrix(pushed.entity)));
+    };
+    u32 numEntityMeshes = renderer.entityMeshes.size();
+    if (numEntityMeshes >= CULLING_PARALLEL_MIN_COUNT)
+    {
+        JobSystem::Instance().ParallelFor(0, numEntityMeshes, CULLING_GRAIN_SIZE, setEntityBounds);
+    }
+    else
+    {
+        for (u32 i = 0; i < numEntityMeshes; i++) setEntityBounds(i);
+    }
+    stats.uncullable = renderer.numUncullable;
+    u32 numCullable = renderer.culling.GetSize();
+    const Camera& camera = Camera::GetMainCamera();
+    glm::mat4 cameraViewProjection = camera.GetProjectionMatrix() * camera.GetViewMatrix();
+    FrustumPlanes cameraFrustum = Math::FrustumPlanesFromMatrix(cameraViewProjection);
+    stats.cameraVisible = renderer.culling.Cull(cameraFrustum, CULL_VIEW_CAMERA);
+    if (renderer.occlusionCulling && !renderer.occluders.empty())
+    {
+        // only the camera, whatever hides behind a wall can still cast a shadow
+        auto occlusionStart = std::chrono::high_resolution_clock::now();
+        OcclusionBuffer& occlusion = renderer.occlusion;
+        occlusion.Begin(cameraViewProjection);
+        static_assert(offsetof(Vertex, position) == 0);
+        for (const PushedOccluder& occluder : renderer.occluders)
+        {
+            const Mesh& mesh = *occluder.mesh;
+            const glm::mat4& worldMatrix = occluder.entity != ENTITY_INVALID_REF ? Entity::GetWorldMatrix(occluder.entity) : occluder.worldMatrix;
+            // offscreen occluders are cheap to throw out here, the rasterizer would clip them triangle by triangle
+            if (FrustumTestBox(cameraFrustum, TransformBounds(mesh.cachedBoundingBox, worldMatrix)) == FrustumTestResult::OUTSIDE) continue;
+            occlusion.RasterizeOccluder(worldMatrix,
+                mesh.vertices.data(), sizeof(Vertex), (u32)mesh.vertices.size(),
+                mesh.indices.empty() ? nullptr : mesh.indices.data(), (u32)mesh.indices.size());
+        }
+        occlusion.BuildHiZ();
+        stats.cameraOccluded = occlusion.CullOccluded(renderer.culling, CULL_VIEW_CAMERA);
+        stats.cameraVisible -= stats.cameraOccluded;
+        stats.occluderTriangles = occlusion.GetNumOccluderTriangles();
+        auto occlusionEnd = std::chrono::high_resolution_clock::now();
+        stats.occlusionMs = std::chrono::duration<f64, std::milli>(occlusionEnd - occlusionStart).count();
+    }
+    stats.cameraCulled = numCullable - stats.cameraVisible;
+    // the shadow map sees whatever is in the sun's ortho box, on screen or not
+    const LightDirectional& sunlight = GetEngineCtx().lightsSubsystem->lights.sunlight;
+    if (sunlight.enabled)
+    {
+        FrustumPlanes shadowFrustum = Math::FrustumPlanesFromMatrix(sunlight.GetLightSpacematrix());
+        stats.shadowVisible = renderer.culling.Cull(shadowFrustum, CULL_VIEW_SHADOW);
     }
+    else
+    {
+        // boxes start out visible in every view
+        stats.shadowVisible = numCullable;
+    }
+    stats.shadowCulled = numCullable - stats.shadowVisible;
+    stats.cameraVisible += stats.uncullable;
+    stats.shadowVisible += stats.uncullable;
+    auto end = std::chrono::high_resolution_clock::now();
+    stats.cullMs = std::chrono::duration<f64, std::milli>(end - start).count();
 }
 
 void DrawScene(RendererData& renderer, Arena* arena)
@@ -840,6 +1004,7 @@ void DrawScene(RendererData& renderer, Arena* arena)
     // if we call RendererDraw and the two generations are different, we know we've pushed a different set of entities and (possibly) need to regenerate our boofers
     // each batch shares the *exact* same material, shader, and instance params/data
     BatchPreprocessing(renderer, arena);
+    CullScene(renderer);
 
     // render passes
     u32 passIndex = 0;
@@ -876,6 +1041,10 @@ void DrawScene(RendererData& renderer, Arena* arena)
     {
         ClearMeshBatch(batch);
     }
+    renderer.culling.Clear();
+    renderer.entityMeshes.clear();
+    renderer.occluders.clear();
+    renderer.numUncullable = 0;
 
     //renderer.finalOutput.Bind();
     // basic shape drawing
@@ -985,7 +1154,9 @@ Framebuffer* RendererDraw()
     }
     ShaderSystemPreDraw(); 
     ClearGLBuffers();
-    DrawScene(renderer, &renderer.arena);
+    ArenaTemp scratch = scratch_begin();
+    DrawScene(renderer, scratch.arena);
+    scratch_end(scratch);
 
     Renderer::PushDebugRenderMarker("Postprocessing");
     Framebuffer* framebuffer = &renderer.outputPasses[PremadeRenderPassType::NUM_PREMADE_RENDER_PASSES-1].output;
@@ -1103,8 +1274,11 @@ static void AddToBatch(
     batch.meshes.push_back(mesh);
 }
 
-void PushModel(const Model& model, const Shader& shader)
+// worldMatrix null means we don't know where the model ends up, so none of its meshes can be culled.
+// With an entity, its world matrix is looked up when culling instead
+static void PushModelMeshes(const Model& model, const Shader& shader, const glm::mat4* worldMatrix, EntityRef entity = ENTITY_INVALID_REF)
 {
+    RendererData& renderer = GetRenderer();
     for (u32 i = 0; i < model.meshes.size(); i++)
     {
         const Mesh& mesh = model.meshes[i];
@@ -1115,17 +1289,69 @@ void PushModel(const Model& model, const Shader& shader)
         rmesh.vertices = {const_cast<RMeshVertex*>(mesh.vertices.data()), mesh.vertices.size() * sizeof(RMeshVertex)};
         rmesh.indices = {const_cast<RMeshIndex*>(mesh.indices.data()), mesh.indices.size() * sizeof(RMeshIndex)};
         rmesh.numInstances = mesh.instanceData.numInstances;
+        // instances are placed by their own matrices, which we don't look into
+        if (entity != ENTITY_INVALID_REF && rmesh.numInstances == 0)
+        {
+            rmesh.cullIndex = renderer.culling.Add(mesh.cachedBoundingBox);
+            renderer.entityMeshes.push_back({ entity, rmesh.cullIndex, mesh.cachedBoundingBox });
+        }
+        else if (worldMatrix && rmesh.numInstances == 0)
+        {
+            rmesh.cullIndex = renderer.culling.Add(TransformBounds(mesh.cachedBoundingBox, *worldMatrix));
+        }
+        else
+        {
+            renderer.numUncullable++;
+        }
         AddToBatch(rmesh, shader, mesh.material, mesh.instanceData);
     }
 }
 
+void PushModel(const Model& model, const Shader& shader)
+{
+    PushModelMeshes(model, shader, nullptr);
+}
+
+void PushModel(const Model& model, const Shader& shader, const glm::mat4& worldMatrix)
+{
+    PushModelMeshes(model, shader, &worldMatrix);
+}
+
 void PushEntity(const EntityRef& entity)
 {
     EntityData& entityData = Entity::GetEntity(entity);
     if (Entity::IsFlag(entityData, EntityFlags::DISABLED)) return;
     const Model& model = entityData.model;
     const Shader& entityShader = model.cachedShader;
-    PushModel(model, entityShader);
+    PushModelMeshes(model, entityShader, nullptr, entity);
+    if (Entity::IsFlag(entityData, EntityFlags::OCCLUDER))
+    {
+        RendererData& renderer = GetRenderer();
+        for (const Mesh& mesh : model.meshes)
+        {
+            if (!mesh.isVisible || mesh.instanceData.numInstances > 0) continue;
+            u32 numTriangles = (u32)(mesh.indices.empty() ? mesh.vertices.size() : mesh.indices.size()) / 3;
+            if (numTriangles > OCCLUSION_MAX_OCCLUDER_TRIANGLES)
+            {
+                if (renderer.rejectedOccluders.try_emplace(&mesh, true).second)
+                {
+                    LOG_WARN("Occluder mesh %s has %u triangles, over the limit of %u. It won't occlude anything", mesh.name.c_str(), numTriangles, OCCLUSION_MAX_OCCLUDER_TRIANGLES);
+                }
+                continue;
+            }
+            renderer.occluders.push_back({ &mesh, entity, glm::mat4(1.0f) });
+        }
+    }
+}
+
+void PushOccluder(const Mesh& mesh, const glm::mat4& worldMatrix)
+{
+    GetRenderer().occluders.push_back({ &mesh, ENTITY_INVALID_REF, worldMatrix });
+}
+
+const CullingStats& GetCullingStats()
+{
+    return GetRenderer().cullingStats;
 }
 
 void PushDebugRenderMarker(const char* name)
@@ -20,11 +20,29 @@
 
 struct Arena;
 struct Model;
+struct Mesh;
 struct Shader;
 struct Framebuffer;
 namespace Renderer
 {
 
+// counted per mesh pushed, for the last frame that was drawn
+struct CullingStats
+{
+    // pushed without a world transform or instanced, so never culled
+    u32 uncullable = 0;
+    u32 cameraVisible = 0;
+    u32 cameraCulled = 0;
+    u32 shadowVisible = 0;
+    u32 shadowCulled = 0;
+    // the part of cameraCulled that was in the frustum but behind occluders
+    u32 cameraOccluded = 0;
+    u32 occluderTriangles = 0;
+    // all of culling, and the occlusion part of it
+    f64 cullMs = 0.0;
+    f64 occlusionMs = 0.0;
+};
+
 TAPI void InitializeRenderer(Arena* arena);
 
 TAPI Framebuffer* RendererDraw();
@@ -34,7 +52,12 @@ TAPI void PushLine(const glm::vec3& start, const glm::vec3& end, const glm::vec4
 TAPI void PushTriangle(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, const glm::vec4& color);
 TAPI void PushFrustum(const glm::mat4& projection, const glm::mat4& view, glm::vec4 color = glm::vec4(1));
 TAPI void PushModel(const Model& model, const Shader& shader);
+// worldMatrix is what the shader will place the model with. With it the model's meshes can be frustum culled
+TAPI void PushModel(const Model& model, const Shader& shader, const glm::mat4& worldMatrix);
 TAPI void PushEntity(const EntityRef& entity);
+// only hides things this frame, isn't drawn. Entities flagged EntityFlags::OCCLUDER push their own meshes as occluders
+TAPI void PushOccluder(const Mesh& mesh, const glm::mat4& worldMatrix);
+TAPI const CullingStats& GetCullingStats();
 
 TAPI void SetDebugOutputRenderPass(u32 renderpassIdx);
 TAPI const char** GetRenderPassNames(Arena* arena, u32& numNames);
@@ -0,0 +1,832 @@
+//#include "pch.h"
+#include "bvh.h"
+
+#include "mem/tiny_arena.h"
+#include "tiny_profiler.h"
+#include <algorithm>
+
+// Rebuild stops looking for SAH splits below this depth and just halves what's left, which caps how deep a bad
+// distribution can make the tree (this + log2(proxies) < BVH_MAX_DEPTH)
+#define BVH_SAH_MAX_DEPTH 64
+#define BVH_SAH_BINS 16
+
+struct Bvh::BuildRef
+{
+    glm::vec3 centroid;
+    u32 leaf;
+};
+
+static inline BoundingBox Union(const BoundingBox& a, const BoundingBox& b)
+{
+    return BoundingBox(glm::min(a.min, b.min), glm::max(a.max, b.max));
+}
+
+static inline f32 SurfaceArea(const BoundingBox& box)
+{
+    glm::vec3 d = box.max - box.min;
+    return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+static inline bool Contains(const BoundingBox& outer, const BoundingBox& inner)
+{
+    return glm::all(glm::lessThanEqual(outer.min, inner.min)) && glm::all(glm::greaterThanEqual(outer.max, inner.max));
+}
+
+// unions with anything to give that thing back
+static inline BoundingBox EmptyBox()
+{
+    return BoundingBox(glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX));
+}
+
+u32 Bvh::AllocNode()
+{
+    u32 node;
+    if (freeList != BVH_NULL_NODE)
+    {
+        node = freeList;
+        freeList = nodes[node].parent;
+        nodes[node] = Node();
+    }
+    else
+    {
+        node = nodes.size();
+        nodes.push_back(Node());
+    }
+    return node;
+}
+
+void Bvh::FreeNode(u32 node)
+{
+    nodes[node] = Node();
+    nodes[node].parent = freeList;
+    freeList = node;
+}
+
+u32 Bvh::CreateProxy(const BoundingBox& box, u32 userData, bool deferInsert)
+{
+    AssertNoReaders();
+    u32 leaf = AllocNode();
+    Node& node = nodes[leaf];
+    node.box = Fatten(box, margin);
+    node.userData = userData;
+    node.height = 0;
+    numProxies++;
+    if (deferInsert) needsRebuild = true;
+    else InsertLeaf(leaf);
+    return leaf;
+}
+
+void Bvh::DestroyProxy(u32 proxy)
+{
+    AssertNoReaders();
+    TINY_ASSERT(proxy < nodes.size() && nodes[proxy].height == 0 && "Not a proxy");
+    // deferred proxies might not be in the tree yet
+    if (root == proxy || nodes[proxy].parent != BVH_NULL_NODE)
+    {
+        RemoveLeaf(proxy);
+    }
+    FreeNode(proxy);
+    numProxies--;
+}
+
+bool Bvh::MoveProxy(u32 proxy, const BoundingBox& box, bool deferInsert)
+{
+    AssertNoReaders();
+    TINY_ASSERT(proxy < nodes.size() && nodes[proxy].height == 0 && "Not a proxy");
+    // the fat box has to hold the new box, but if it got a lot smaller (or moved a lot inside a big one), refit anyway,
+    // otherwise leaves could stay way bigger than what they hold forever
+    const BoundingBox& fat = nodes[proxy].box;
+    if (Contains(fat, box) && Contains(Fatten(box, 4.0f * margin), fat))
+    {
+        return false;
+    }
+    if (deferInsert)
+    {
+        // parents might not hold it anymore, Rebuild doesn't care
+        nodes[proxy].box = Fatten(box, margin);
+        needsRebuild = true;
+        return true;
+    }
+    if (root == proxy || nodes[proxy].parent != BVH_NULL_NODE)
+    {
+        RemoveLeaf(proxy);
+    }
+    nodes[proxy].box = Fatten(box, margin);
+    InsertLeaf(proxy);
+    return true;
+}
+
+void Bvh::Clear()
+{
+    AssertNoReaders();
+    nodes.clear();
+    root = BVH_NULL_NODE;
+    freeList = BVH_NULL_NODE;
+    numProxies = 0;
+    needsRebuild = false;
+}
+
+void Bvh::InsertLeaf(u32 leaf)
+{
+    if (root == BVH_NULL_NODE)
+    {
+        root = leaf;
+        nodes[leaf].parent = BVH_NULL_NODE;
+        return;
+    }
+    // walk down to the best sibling. At every node, compare pairing the leaf with this node against the cheapest that
+    // going further down could possibly be (everything on the way grows to hold the leaf, so that part is paid either way)
+    BoundingBox leafBox = nodes[leaf].box;
+    u32 index = root;
+    while (!nodes[index].IsLeaf())
+    {
+        const Node& node = nodes[index];
+        f32 area = SurfaceArea(node.box);
+        f32 combinedArea = SurfaceArea(Union(node.box, leafBox));
+        // new parent for this node and the leaf
+        f32 cost = 2.0f * combinedArea;
+        // what pushing the leaf further down costs this node
+        f32 inheritedCost = 2.0f * (combinedArea - area);
+        auto descendCost = [&](u32 child) {
+            const BoundingBox& childBox = nodes[child].box;
+            f32 grownArea = SurfaceArea(Union(childBox, leafBox));
+            return nodes[child].IsLeaf() ? grownArea + inheritedCost : grownArea - SurfaceArea(childBox) + inheritedCost;
+        };
+        f32 leftCost = descendCost(node.left);
+        f32 rightCost = descendCost(node.right);
+        if (cost < leftCost && cost < rightCost) break;
+        index = leftCost < rightCost ? node.left : node.right;
+    }
+
+    u32 sibling = index;
+    u32 oldParent = nodes[sibling].parent;
+    u32 newParent = AllocNode();
+    Node& parent = nodes[newParent];
+    parent.parent = oldParent;
+    parent.box = Union(leafBox, nodes[sibling].box);
+    parent.height = nodes[sibling].height + 1;
+    parent.left = sibling;
+    parent.right = leaf;
+    nodes[sibling].parent = newParent;
+    nodes[leaf].parent = newParent;
+    if (oldParent == BVH_NULL_NODE)
+    {
+        root = newParent;
+    }
+    else if (nodes[oldParent].left == sibling)
+    {
+        nodes[oldParent].left = newParent;
+    }
+    else
+    {
+        nodes[oldParent].right = newParent;
+    }
+    FixUpwards(newParent);
+}
+
+void Bvh::RemoveLeaf(u32 leaf)
+{
+    if (leaf == root)
+    {
+        root = BVH_NULL_NODE;
+        return;
+    }
+    // the parent goes away and the sibling takes its place
+    u32 parent = nodes[leaf].parent;
+    u32 grandParent = nodes[parent].parent;
+    u32 sibling = nodes[parent].left == leaf ? nodes[parent].right : nodes[parent].left;
+    nodes[sibling].parent = grandParent;
+    if (grandParent == BVH_NULL_NODE)
+    {
+        root = sibling;
+    }
+    else if (nodes[grandParent].left == parent)
+    {
+        nodes[grandParent].left = sibling;
+    }
+    else
+    {
+        nodes[grandParent].right = sibling;
+    }
+    FreeNode(parent);
+    nodes[leaf].parent = BVH_NULL_NODE;
+    FixUpwards(grandParent);
+}
+
+void Bvh::FixUpwards(u32 index)
+{
+    while (index != BVH_NULL_NODE)
+    {
+        index = Balance(index);
+        Node& node = nodes[index];
+        const Node& left = nodes[node.left];
+        const Node& right = nodes[node.right];
+        node.height = 1 + std::max(left.height, right.height);
+        node.box = Union(left.box, right.box);
+        index = node.parent;
+    }
+}
+
+u32 Bvh::Balance(u32 a)
+{
+    Node& nodeA = nodes[a];
+    // a's own height isn't refit yet, only its children's
+    if (nodeA.IsLeaf()) return a;
+    u32 b = nodeA.left;
+    u32 c = nodeA.right;
+    s32 balance = nodes[c].height - nodes[b].height;
+    if (balance >= -1 && balance <= 1) return a;
+
+    // the taller child (up) takes a's place, a becomes its child and gets one of up's children in return
+    bool rightIsTaller = balance > 1;
+    u32 up = rightIsTaller ? c : b;
+    u32 stays = rightIsTaller ? b : c;
+    Node& nodeUp = nodes[up];
+    u32 f = nodeUp.left;
+    u32 g = nodeUp.right;
+    nodeUp.left = a;
+    nodeUp.parent = nodeA.parent;
+    nodeA.parent = up;
+    if (nodeUp.parent == BVH_NULL_NODE)
+    {
+        root = up;
+    }
+    else if (nodes[nodeUp.parent].left == a)
+    {
+        nodes[nodeUp.parent].left = up;
+    }
+    else
+    {
+        nodes[nodeUp.parent].right = up;
+    }
+    // the taller grandchild stays with up, the other one moves over to a
+    u32 keep = nodes[f].height > nodes[g].height ? f : g;
+    u32 give = keep == f ? g : f;
+    nodeUp.right = keep;
+    if (rightIsTaller) nodeA.right = give;
+    else nodeA.left = give;
+    nodes[give].parent = a;
+    nodeA.box = Union(nodes[stays].box, nodes[give].box);
+    nodeA.height = 1 + std::max(nodes[stays].height, nodes[give].height);
+    nodeUp.box = Union(nodeA.box, nodes[keep].box);
+    nodeUp.height = 1 + std::max(nodeA.height, nodes[keep].height);
+    return up;
+}
+
+u32 Bvh::BuildRange(BuildRef* refs, u32 count, u32 depth)
+{
+    if (count == 1) return refs[0].leaf;
+    BoundingBox centroidBounds = BoundingBox(refs[0].centroid, refs[0].centroid);
+    for (u32 i = 1; i < count; i++)
+    {
+        centroidBounds.min = glm::min(centroidBounds.min, refs[i].centroid);
+        centroidBounds.max = glm::max(centroidBounds.max, refs[i].centroid);
+    }
+    glm::vec3 extents = centroidBounds.max - centroidBounds.min;
+    u32 axis = extents.x > extents.y ? (extents.x > extents.z ? 0 : 2) : (extents.y > extents.z ? 1 : 2);
+
+    // bin by centroid along the longest axis and split where leftArea * leftCount + rightArea * rightCount is lowest
+    u32 mid = 0;
+    if (extents[axis] > 0.0f && depth < BVH_SAH_MAX_DEPTH)
+    {
+        f32 axisMin = centroidBounds.min[axis];
+        f32 binScale = BVH_SAH_BINS / extents[axis];
+        auto binOf = [=](const BuildRef& ref) {
+            return std::min((u32)((ref.centroid[axis] - axisMin) * binScale), (u32)BVH_SAH_BINS - 1);
+        };
+        u32 binCounts[BVH_SAH_BINS] = {};
+        BoundingBox binBoxes[BVH_SAH_BINS];
+        for (BoundingBox& box : binBoxes) box = EmptyBox();
+        for (u32 i = 0; i < count; i++)
+        {
+            u32 bin = binOf(refs[i]);
+            binCounts[bin]++;
+            binBoxes[bin] = Union(binBoxes[bin], nodes[refs[i].leaf].box);
+        }
+        // everything right of each split
+        f32 rightAreas[BVH_SAH_BINS] = {};
+        u32 rightCounts[BVH_SAH_BINS] = {};
+        BoundingBox side = EmptyBox();
+        u32 sideCount = 0;
+        for (u32 bin = BVH_SAH_BINS - 1; bin > 0; bin--)
+        {
+            side = Union(side, binBoxes[bin]);
+            sideCount += binCounts[bin];
+            rightAreas[bin] = sideCount ? SurfaceArea(side) : 0.0f;
+            rightCounts[bin] = sideCount;
+        }
+        f32 bestCost = FLT_MAX;
+        u32 bestSplit = 0;
+        side = EmptyBox();
+        sideCount = 0;
+        for (u32 split = 1; split < BVH_SAH_BINS; split++)
+        {
+            side = Union(side, binBoxes[split - 1]);
+            sideCount += binCounts[split - 1];
+            if (sideCount == 0 || rightCounts[split] == 0) continue;
+            f32 cost = SurfaceArea(side) * sideCount + rightAreas[split] * rightCounts[split];
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                bestSplit = split;
+            }
+        }
+        if (bestSplit)
+        {
+            mid = (u32)(std::partition(refs, refs + count, [&](const BuildRef& ref) { return binOf(ref) < bestSplit; }) - refs);
+        }
+    }
+    // everything on the same spot, or too deep already
+    if (mid == 0 || mid == count)
+    {
+        mid = count / 2;
+        std::nth_element(refs, refs + mid, refs + count, [axis](const BuildRef& a, const BuildRef& b) {
+            return a.centroid[axis] < b.centroid[axis];
+        });
+    }
+
+    u32 left = BuildRange(refs, mid, depth + 1);
+    u32 right = BuildRange(refs + mid, count - mid, depth + 1);
+    // allocated after the children, free nodes get handed out bottom up so the root ends up late in the array
+    u32 index = AllocNode();
+    Node& node = nodes[index];
+    node.left = left;
+    node.right = right;
+    node.box = Union(nodes[left].box, nodes[right].box);
+    node.height = 1 + std::max(nodes[left].height, nodes[right].height);
+    nodes[left].parent = index;
+    nodes[right].parent = index;
+    return index;
+}
+
+void Bvh::Rebuild()
+{
+    PROFILE_FUNCTION();
+    AssertNoReaders();
+    ArenaTemp scratch = scratch_begin();
+    BuildRef* refs = arena_alloc_type(scratch.arena, BuildRef, numProxies);
+    u32 numRefs = 0;
+    // every internal node gets thrown away. Walking backwards leaves the free list in ascending order
+    root = BVH_NULL_NODE;
+    freeList = BVH_NULL_NODE;
+    for (u32 i = nodes.size(); i-- > 0;)
+    {
+        Node& node = nodes[i];
+        if (node.height == 0)
+        {
+            node.parent = BVH_NULL_NODE;
+            refs[numRefs++] = { (node.box.min + node.box.max) * 0.5f, i };
+        }
+        else
+        {
+            node = Node();
+            node.parent = freeList;
+            freeList = i;
+        }
+    }
+    TINY_ASSERT(numRefs == numProxies);
+    if (numRefs)
+    {
+        root = BuildRange(refs, numRefs, 0);
+        nodes[root].parent = BVH_NULL_NODE;
+    }
+    needsRebuild = false;
+    scratch_end(scratch);
+}
+
+f32 Bvh::ComputeCost() const
+{
+    if (root == BVH_NULL_NODE) return 0.0f;
+    f32 internalArea = 0.0f;
+    for (const Node& node : nodes)
+    {
+        if (node.height > 0) internalArea += SurfaceArea(node.box);
+    }
+    return internalArea / SurfaceArea(nodes[root].box);
+}
+
+void Bvh::Validate() const
+{
+    if (root == BVH_NULL_NODE)
+    {
+        TINY_ASSERT(numProxies == 0);
+        return;
+    }
+    TINY_ASSERT(nodes[root].parent == BVH_NULL_NODE);
+    u32 numLeaves = 0;
+    u32 stack[BVH_MAX_DEPTH];
+    u32 stackSize = 0;
+    stack[stackSize++] = root;
+    while (stackSize)
+    {
+        u32 index = stack[--stackSize];
+        const Node& node = nodes[index];
+        TINY_ASSERT(node.height >= 0);
+        if (node.IsLeaf())
+        {
+            TINY_ASSERT(node.height == 0);
+            numLeaves++;
+            continue;
+        }
+        const Node& left = nodes[node.left];
+        const Node& right = nodes[node.right];
+        TINY_ASSERT(left.parent == index && right.parent == index);
+        TINY_ASSERT(node.height == 1 + std::max(left.height, right.height));
+        TINY_ASSERT(Contains(node.box, left.box) && Contains(node.box, right.box));
+        TINY_ASSERT(stackSize + 2 <= BVH_MAX_DEPTH);
+        stack[stackSize++] = node.left;
+        stack[stackSize++] = node.right;
+    }
+    TINY_ASSERT(numLeaves == numProxies);
+}
+
+// ============ tests ============
+
+#include <chrono>
+#include <random>
+#include <vector>
+#include "job_system.h"
+#include "scene/entity.h"
+
+static BoundingBox RandomBox(std::mt19937& rng, f32 worldSize, f32 minSize, f32 maxSize)
+{
+    std::uniform_real_distribution<f32> position(0.0f, worldSize);
+    std::uniform_real_distribution<f32> size(minSize, maxSize);
+    glm::vec3 min = glm::vec3(position(rng), position(rng), position(rng));
+    return BoundingBox(min, min + glm::vec3(size(rng), size(rng), size(rng)));
+}
+
+static glm::vec3 RandomDirection(std::mt19937& rng)
+{
+    std::uniform_real_distribution<f32> component(-1.0f, 1.0f);
+    glm::vec3 dir;
+    do
+    {
+        dir = glm::vec3(component(rng), component(rng), component(rng));
+    } while (glm::dot(dir, dir) < 0.01f || glm::dot(dir, dir) > 1.0f);
+    return glm::normalize(dir);
+}
+
+static FrustumPlanes CameraFrustum(glm::vec3 position, glm::vec3 forward, f32 farPlane)
+{
+    glm::vec3 up = std::abs(forward.y) > 0.99f ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0);
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, farPlane);
+    return Math::FrustumPlanesFromMatrix(projection * glm::lookAt(position, position + forward, up));
+}
+
+// every query against a linear pass over the same boxes. proxies[userData] is the proxy, boxes[userData] the exact box
+static void CheckQueries(const Bvh& bvh, const std::vector<u32>& proxies, const std::vector<BoundingBox>& boxes, std::mt19937& rng, f32 worldSize)
+{
+    std::vector<u32> found, expected;
+    auto compare = [&]() {
+        std::sort(found.begin(), found.end());
+        std::sort(expected.begin(), expected.end());
+        TINY_ASSERT(found == expected);
+        found.clear();
+        expected.clear();
+    };
+    for (u32 q = 0; q < 50; q++)
+    {
+        BoundingBox area = RandomBox(rng, worldSize, 0.0f, worldSize * 0.2f);
+        bvh.QueryAabb(area, [&](u32 id) { found.push_back(id); });
+        for (u32 id = 0; id < proxies.size(); id++)
+        {
+            if (proxies[id] != BVH_NULL_NODE && BoxesOverlap(bvh.GetFatBox(proxies[id]), area)) expected.push_back(id);
+        }
+        compare();
+
+        glm::vec3 eye = RandomBox(rng, worldSize, 0.0f, 0.0f).min;
+        FrustumPlanes frustum = CameraFrustum(eye, RandomDirection(rng), worldSize * 0.5f);
+        bvh.QueryFrustum(frustum, [&](u32 id) { found.push_back(id); });
+        for (u32 id = 0; id < proxies.size(); id++)
+        {
+            if (proxies[id] != BVH_NULL_NODE && FrustumTestBox(frustum, bvh.GetFatBox(proxies[id])) != FrustumTestResult::OUTSIDE) expected.push_back(id);
+        }
+        compare();
+
+        glm::vec3 dir = RandomDirection(rng) * 2.0f;
+        f32 maxT = worldSize * 0.3f;
+        glm::vec3 invDir = 1.0f / dir;
+        bvh.QueryRay(eye, dir, maxT, [&](u32 id, f32) { found.push_back(id); });
+        BvhHit bruteHit;
+        bruteHit.t = maxT;
+        for (u32 id = 0; id < proxies.size(); id++)
+        {
+            if (proxies[id] == BVH_NULL_NODE) continue;
+            f32 t;
+            if (RayIntersectsBox(bvh.GetFatBox(proxies[id]), eye, invDir, maxT, &t)) expected.push_back(id);
+            if (RayIntersectsBox(boxes[id], eye, invDir, maxT, &t) && t <= bruteHit.t) bruteHit = { id, t };
+        }
+        compare();
+        // the exact boxes through hitTest
+        BvhHit hit = bvh.ClosestHit(eye, dir, maxT, [&](u32 id, f32) {
+            f32 t;
+            return RayIntersectsBox(boxes[id], eye, invDir, maxT, &t) ? t : -1.0f;
+        });
+        TINY_ASSERT(hit.IsHit() == bruteHit.IsHit() && hit.t == bruteHit.t);
+    }
+}
+
+void BvhTests()
+{
+    LOG_INFO("Running Bvh tests...");
+    // frustum planes: in front of the camera is in, behind/past the far plane/off to the side is out
+    {
+        FrustumPlanes frustum = CameraFrustum(glm::vec3(0), glm::vec3(0, 0, -1), 100.0f);
+        auto at = [](glm::vec3 p) { return BoundingBox(p - glm::vec3(0.5f), p + glm::vec3(0.5f)); };
+        TINY_ASSERT(FrustumTestBox(frustum, at(glm::vec3(0, 0, -10))) == FrustumTestResult::INSIDE);
+        TINY_ASSERT(FrustumTestBox(frustum, at(glm::vec3(0, 0, 10))) == FrustumTestResult::OUTSIDE);
+        TINY_ASSERT(FrustumTestBox(frustum, at(glm::vec3(0, 0, -101))) == FrustumTestResult::OUTSIDE);
+        TINY_ASSERT(FrustumTestBox(frustum, at(glm::vec3(50, 0, -10))) == FrustumTestResult::OUTSIDE);
+        TINY_ASSERT(FrustumTestBox(frustum, at(glm::vec3(0, 0, -100))) == FrustumTestResult::INTERSECTING);
+        // rotated box bounds hold all of its corners
+        glm::mat4 matrix = Transform(glm::vec3(1, 2, 3), glm::vec3(2), 45.0f, glm::vec3(0, 1, 0)).ToModelMatrix();
+        BoundingBox local = BoundingBox(glm::vec3(-1, 0, -2), glm::vec3(1, 1, 2));
+        BoundingBox world = TransformBounds(local, matrix);
+        for (u32 corner = 0; corner < 8; corner++)
+        {
+            glm::vec3 c = glm::vec3(corner & 1 ? local.max.x : local.min.x, corner & 2 ? local.max.y : local.min.y, corner & 4 ? local.max.z : local.min.z);
+            glm::vec3 p = glm::vec3(matrix * glm::vec4(c, 1.0f));
+            TINY_ASSERT(Contains(BoundingBox(world.min - glm::vec3(0.001f), world.max + glm::vec3(0.001f)), BoundingBox(p, p)));
+        }
+    }
+
+    constexpr u32 numBoxes = 3000;
+    constexpr f32 worldSize = 100.0f;
+    std::mt19937 rng(1234);
+    Bvh bvh;
+    std::vector<u32> proxies;
+    std::vector<BoundingBox> boxes;
+    TINY_ASSERT(!bvh.ClosestHit(glm::vec3(0), glm::vec3(1, 0, 0), 100.0f).IsHit());
+    for (u32 i = 0; i < numBoxes; i++)
+    {
+        boxes.push_back(RandomBox(rng, worldSize, 0.1f, 3.0f));
+        proxies.push_back(bvh.CreateProxy(boxes.back(), i));
+        TINY_ASSERT(bvh.GetUserData(proxies.back()) == i);
+    }
+    bvh.Validate();
+    TINY_ASSERT(bvh.GetProxyCount() == numBoxes && bvh.GetHeight() < 30);
+    CheckQueries(bvh, proxies, boxes, rng, worldSize);
+
+    // small moves stay inside the fat box, big ones move the leaf. Destroyed proxies are gone from every query
+    u32 numReinserted = 0;
+    for (u32 i = 0; i < numBoxes; i++)
+    {
+        if (i % 7 == 0)
+        {
+            bvh.DestroyProxy(proxies[i]);
+            proxies[i] = BVH_NULL_NODE;
+            continue;
+        }
+        glm::vec3 offset = i % 2 ? glm::vec3(0.01f) : RandomBox(rng, 20.0f, 0.0f, 0.0f).min - glm::vec3(10.0f);
+        boxes[i] = BoundingBox(boxes[i].min + offset, boxes[i].max + offset);
+        numReinserted += bvh.MoveProxy(proxies[i], boxes[i]);
+    }
+    TINY_ASSERT(numReinserted > 0 && numReinserted <= numBoxes / 2 + 1);
+    bvh.Validate();
+    CheckQueries(bvh, proxies, boxes, rng, worldSize);
+
+    // everything moves (and some new ones show up) deferred, then one rebuild. Ids survive
+    f32 incrementalCost = bvh.ComputeCost();
+    for (u32 i = 0; i < numBoxes; i++)
+    {
+        if (proxies[i] == BVH_NULL_NODE) continue;
+        boxes[i] = RandomBox(rng, worldSize, 0.1f, 3.0f);
+        bvh.MoveProxy(proxies[i], boxes[i], true);
+    }
+    for (u32 i = numBoxes; i < numBoxes + 500; i++)
+    {
+        boxes.push_back(RandomBox(rng, worldSize, 0.1f, 3.0f));
+        proxies.push_back(bvh.CreateProxy(boxes.back(), i, true));
+    }
+    // destroying while deferred is fine too
+    bvh.DestroyProxy(proxies[numBoxes]);
+    proxies[numBoxes] = BVH_NULL_NODE;
+    TINY_ASSERT(bvh.NeedsRebuild());
+    bvh.Rebuild();
+    TINY_ASSERT(!bvh.NeedsRebuild());
+    bvh.Validate();
+    for (u32 id = 0; id < proxies.size(); id++)
+    {
+        TINY_ASSERT(proxies[id] == BVH_NULL_NODE || bvh.GetUserData(proxies[id]) == id);
+    }
+    CheckQueries(bvh, proxies, boxes, rng, worldSize);
+    LOG_INFO("[BVH] tree cost | inserted one by one: %.1f | SAH rebuild: %.1f", incrementalCost, bvh.ComputeCost());
+    // and the rebuilt tree still takes regular inserts/removes
+    for (u32 i = 0; i < proxies.size(); i += 3)
+    {
+        if (proxies[i] == BVH_NULL_NODE) continue;
+        bvh.DestroyProxy(proxies[i]);
+        proxies[i] = BVH_NULL_NODE;
+    }
+    bvh.Validate();
+    CheckQueries(bvh, proxies, boxes, rng, worldSize);
+
+    // lots of readers at once get the same answers as one
+    {
+        constexpr u32 numRays = 4096;
+        std::vector<glm::vec3> origins(numRays), dirs(numRays);
+        std::vector<BvhHit> serial(numRays), parallel(numRays);
+        for (u32 i = 0; i < numRays; i++)
+        {
+            origins[i] = RandomBox(rng, worldSize, 0.0f, 0.0f).min;
+            dirs[i] = RandomDirection(rng);
+            serial[i] = bvh.ClosestHit(origins[i], dirs[i], worldSize);
+        }
+        JobSystem::Instance().ParallelFor(0, numRays, 64, [&](u32 i) {
+            parallel[i] = bvh.ClosestHit(origins[i], dirs[i], worldSize);
+        });
+        for (u32 i = 0; i < numRays; i++)
+        {
+            TINY_ASSERT(serial[i].userData == parallel[i].userData && serial[i].t == parallel[i].t);
+        }
+    }
+
+    // entities: world bounds follow SetTransform and parents through UpdateTransforms, destroyed ones leave.
+    // Far away from anything the game might have made
+    {
+        glm::vec3 base = glm::vec3(50000.0f);
+        auto entitiesIn = [](const BoundingBox& area) {
+            std::vector<EntityRef> result;
+            Entity::GetBvh().QueryAabb(area, [&](u32 ent) { result.push_back(ent); });
+            std::sort(result.begin(), result.end());
+            return result;
+        };
+        auto around = [](glm::vec3 p, f32 r) { return BoundingBox(p - glm::vec3(r), p + glm::vec3(r)); };
+        EntityRef parent = Entity::CreateEntity("BvhTestParent", Transform(base));
+        EntityRef child = Entity::CreateEntity("BvhTestChild", Transform(glm::vec3(10, 0, 0)));
+        EntityRef other = Entity::CreateEntity("BvhTestOther", Transform(base + glm::vec3(0, 0, 20)));
+        Entity::GetBounds(parent) = BoundingBox(glm::vec3(-1), glm::vec3(1));
+        Entity::GetBounds(child) = BoundingBox(glm::vec3(-0.5f), glm::vec3(0.5f));
+        Entity::GetBounds(other) = BoundingBox(glm::vec3(-1), glm::vec3(1));
+        Entity::SetParent(child, parent);
+        Entity::UpdateTransforms();
+        TINY_ASSERT(entitiesIn(around(base, 2.0f)) == std::vector<EntityRef>{ parent });
+        TINY_ASSERT(entitiesIn(around(base + glm::vec3(10, 0, 0), 1.0f)) == std::vector<EntityRef>{ child });
+        BoundingBox otherBounds = Entity::GetWorldBounds(other);
+        TINY_ASSERT(otherBounds.min == base + glm::vec3(-1, -1, 19) && otherBounds.max == base + glm::vec3(1, 1, 21));
+
+        // the parent moves, the child comes along
+        Entity::SetTransform(parent, Transform(base + glm::vec3(0, 100, 0)));
+        Entity::UpdateTransforms();
+        TINY_ASSERT(entitiesIn(around(base + glm::vec3(10, 0, 0), 1.0f)).empty());
+        TINY_ASSERT(entitiesIn(around(base + glm::vec3(10, 100, 0), 1.0f)) == std::vector<EntityRef>{ child });
+        // bounds changes count as moving
+        Entity::GetBounds(other) = BoundingBox(glm::vec3(-5), glm::vec3(5));
+        Entity::UpdateTransforms();
+        TINY_ASSERT(entitiesIn(around(base + glm::vec3(4, 0, 20), 0.5f)) == std::vector<EntityRef>{ other });
+
+        // shooting down +y from below hits the parent (its box is closer than the child's), past it only the child
+        f32 t;
+        EntityRef hit = Entity::RaycastBounds(base + glm::vec3(0, 50, 0), glm::vec3(0, 1, 0), 1000.0f, &t);
+        TINY_ASSERT(hit == parent && std::abs(t - 49.0f) < 0.001f);
+        hit = Entity::RaycastBounds(base + glm::vec3(10, 50, 0), glm::vec3(0, 1, 0), 1000.0f, &t);
+        TINY_ASSERT(hit == child && std::abs(t - 49.5f) < 0.001f);
+        TINY_ASSERT(Entity::RaycastBounds(base + glm::vec3(10, 50, 0), glm::vec3(0, 1, 0), 40.0f) == ENTITY_INVALID_REF);
+
+        Entity::DestroyEntity(child);
+        Entity::UpdateTransforms();
+        TINY_ASSERT(entitiesIn(around(base + glm::vec3(10, 100, 0), 1.0f)).empty());
+        Entity::DestroyEntity(parent);
+        Entity::DestroyEntity(other);
+        TINY_ASSERT(entitiesIn(around(base, 200.0f)).empty());
+    }
+    LOG_INFO("Bvh tests passed");
+}
+
+template <typename Func>
+static f64 TimeMs(Func func)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    func();
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<f64, std::milli>(end - start).count();
+}
+
+void BvhBenchmarks()
+{
+    LOG_INFO("Running Bvh benchmarks...");
+    const u32 sizes[] = { 10000, 100000, 1000000 };
+    for (u32 numBoxes : sizes)
+    {
+        // same density at every size: ~1 box per 10x10x10 units
+        f32 worldSize = 10.0f * std::cbrt((f32)numBoxes);
+        std::mt19937 rng(42);
+        std::vector<BoundingBox> boxes(numBoxes);
+        for (BoundingBox& box : boxes) box = RandomBox(rng, worldSize, 0.5f, 3.0f);
+        Bvh* bvh = new Bvh();
+        std::vector<u32> proxies(numBoxes);
+
+        f64 insertMs = TimeMs([&]() {
+            for (u32 i = 0; i < numBoxes; i++) proxies[i] = bvh->CreateProxy(boxes[i], i);
+        });
+        f32 insertCost = bvh->ComputeCost();
+        u32 insertHeight = bvh->GetHeight();
+        bvh->Clear();
+        f64 rebuildMs = TimeMs([&]() {
+            for (u32 i = 0; i < numBoxes; i++) proxies[i] = bvh->CreateProxy(boxes[i], i, true);
+            bvh->Rebuild();
+        });
+        LOG_INFO("[BVH] %7u boxes | build: insert one by one %8.2f ms (cost %.0f, height %u) | SAH rebuild %8.2f ms (cost %.0f, height %u)",
+            numBoxes, insertMs, insertCost, insertHeight, rebuildMs, bvh->ComputeCost(), bvh->GetHeight());
+
+        // queries. Brute force gets fewer runs at the big sizes, everything is reported per query
+        constexpr u32 numQueries = 1000;
+        u32 numBruteQueries = numBoxes >= 1000000 ? 5 : 50;
+        std::vector<BoundingBox> areas(numQueries);
+        std::vector<FrustumPlanes> frustums(numQueries);
+        std::vector<glm::vec3> origins(numQueries), dirs(numQueries);
+        for (u32 q = 0; q < numQueries; q++)
+        {
+            areas[q] = RandomBox(rng, worldSize, 5.0f, 20.0f);
+            origins[q] = RandomBox(rng, worldSize, 0.0f, 0.0f).min;
+            dirs[q] = RandomDirection(rng);
+            frustums[q] = CameraFrustum(origins[q], dirs[q], 150.0f);
+        }
+        u64 found = 0, bruteFound = 0;
+        f64 aabbMs = TimeMs([&]() {
+            for (u32 q = 0; q < numQueries; q++) bvh->QueryAabb(areas[q], [&](u32) { found++; });
+        });
+        f64 bruteAabbMs = TimeMs([&]() {
+            for (u32 q = 0; q < numBruteQueries; q++)
+                for (u32 i = 0; i < numBoxes; i++) bruteFound += BoxesOverlap(boxes[i], areas[q]);
+        });
+        f64 frustumMs = TimeMs([&]() {
+            for (u32 q = 0; q < numQueries; q++) bvh->QueryFrustum(frustums[q], [&](u32) { found++; });
+        });
+        f64 bruteFrustumMs = TimeMs([&]() {
+            for (u32 q = 0; q < numBruteQueries; q++)
+                for (u32 i = 0; i < numBoxes; i++) bruteFound += FrustumTestBox(frustums[q], boxes[i]) != FrustumTestResult::OUTSIDE;
+        });
+        u32 numHits = 0;
+        f64 rayMs = TimeMs([&]() {
+            for (u32 q = 0; q < numQueries; q++)
+            {
+                glm::vec3 invDir = 1.0f / dirs[q];
+                numHits += bvh->ClosestHit(origins[q], dirs[q], worldSize, [&](u32 id, f32) {
+                    f32 t;
+                    return RayIntersectsBox(boxes[id], origins[q], invDir, worldSize, &t) ? t : -1.0f;
+                }).IsHit();
+            }
+        });
+        f64 bruteRayMs = TimeMs([&]() {
+            for (u32 q = 0; q < numBruteQueries; q++)
+            {
+                glm::vec3 invDir = 1.0f / dirs[q];
+                f32 best = worldSize;
+                for (u32 i = 0; i < numBoxes; i++)
+                {
+                    f32 t;
+                    if (RayIntersectsBox(boxes[i], origins[q], invDir, best, &t)) best = t;
+                }
+                bruteFound += best < worldSize;
+            }
+        });
+        // the same rays from job threads
+        std::atomic<u32> parallelHits = 0;
+        f64 parallelRayMs = TimeMs([&]() {
+            JobSystem::Instance().ParallelFor(0, numQueries, 32, [&](u32 q) {
+                parallelHits += bvh->ClosestHit(origins[q], dirs[q], worldSize).IsHit();
+            });
+        });
+        TINY_ASSERT(found > 0 && bruteFound > 0 && numHits > 0 && parallelHits > 0);
+        auto us = [](f64 ms, u32 queries) { return ms * 1000.0 / queries; };
+        LOG_INFO("[BVH] %7u boxes | us per query | aabb %7.2f vs %9.1f brute | frustum %7.2f vs %9.1f brute | closest hit %6.2f vs %9.1f brute, %6.2f from jobs",
+            numBoxes, us(aabbMs, numQueries), us(bruteAabbMs, numBruteQueries), us(frustumMs, numQueries), us(bruteFrustumMs, numBruteQueries),
+            us(rayMs, numQueries), us(bruteRayMs, numBruteQueries), us(parallelRayMs, numQueries));
+
+        // refitting: a tenth of everything drifts a bit (mostly stays inside the fat boxes), then everything jumps somewhere
+        // else, either reinserted one by one or updated deferred + rebuilt
+        u32 numMoved = numBoxes / 10;
+        f64 driftMs = TimeMs([&]() {
+            for (u32 i = 0; i < numMoved; i++)
+            {
+                u32 id = (i * 7919) % numBoxes;
+                boxes[id].min.x += 0.05f;
+                boxes[id].max.x += 0.05f;
+                bvh->MoveProxy(proxies[id], boxes[id]);
+            }
+        });
+        for (BoundingBox& box : boxes)
+        {
+            glm::vec3 offset = RandomDirection(rng) * 15.0f;
+            box = BoundingBox(box.min + offset, box.max + offset);
+        }
+        f64 reinsertMs = TimeMs([&]() {
+            for (u32 i = 0; i < numBoxes; i++) bvh->MoveProxy(proxies[i], boxes[i]);
+        });
+        for (BoundingBox& box : boxes)
+        {
+            glm::vec3 offset = RandomDirection(rng) * 15.0f;
+            box = BoundingBox(box.min + offset, box.max + offset);
+        }
+        f64 deferredMs = TimeMs([&]() {
+            for (u32 i = 0; i < numBoxes; i++) bvh->MoveProxy(proxies[i], boxes[i], true);
+            bvh->Rebuild();
+        });
+        LOG_INFO("[BVH] %7u boxes | %u drift a little: %.2f ms | all move: reinsert %.2f ms vs deferred + rebuild %.2f ms",
+            numBoxes, numMoved, driftMs, reinsertMs, deferredMs);
+        delete bvh;
+    }
+    LOG_INFO("Bvh benchmarks complete");
+}
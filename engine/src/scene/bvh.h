@@ -0,0 +1,348 @@
+#ifndef TINY_BVH_H
+#define TINY_BVH_H
+
+#include <atomic>
+#include <cfloat>
+#include "tiny_defines.h"
+#include "tiny_types.h"
+#include "tiny_log.h"
+#include "containers/dynarray.h"
+
+// Dynamic AABB tree (bounding volume hierarchy) over 3D boxes. Each proxy is one leaf, holding the box grown by margin on
+// every side ("fat"), so something that jiggles around inside that doesn't touch the tree at all. When a proxy does leave
+// its fat box it's taken out and reinserted: the new leaf goes next to the sibling that grows the tree's total surface area
+// the least, and the path back up to the root is refit and rebalanced with AVL style rotations.
+// When most of the tree moves at once, reinserting one by one is slow and leaves a mediocre tree behind. The deferred
+// versions of CreateProxy/MoveProxy only update the leaf, and Rebuild then builds all the internal nodes from scratch,
+// top down with binned SAH (surface area heuristic).
+// Proxy ids are node indices and stay the same across Rebuild.
+//
+// Threads: queries are const, only use their own stack and never allocate, so any number of threads can query at once.
+// Modifying the tree while anyone is querying is not allowed, with assertions on that gets caught.
+
+#define BVH_NULL_NODE U32_INVALID_ID
+// how far a leaf's fat box sticks out past the real one
+#define BVH_DEFAULT_MARGIN 0.1f
+// deepest a query can go. Insertion keeps the tree balanced, and Rebuild stops trusting SAH past BVH_SAH_MAX_DEPTH,
+// so real trees are nowhere near this (1M proxies inserted one by one are ~30 deep)
+#define BVH_MAX_DEPTH 128
+
+enum class FrustumTestResult
+{
+    OUTSIDE,
+    INTERSECTING,
+    INSIDE,
+};
+
+// frustum planes face inwards (see FrustumPlanes)
+inline FrustumTestResult FrustumTestBox(const FrustumPlanes& frustum, const BoundingBox& box)
+{
+    glm::vec3 center = (box.min + box.max) * 0.5f;
+    glm::vec3 extents = (box.max - box.min) * 0.5f;
+    FrustumTestResult result = FrustumTestResult::INSIDE;
+    for (const glm::vec4& plane : frustum.planes)
+    {
+        glm::vec3 normal = glm::vec3(plane);
+        f32 distance = glm::dot(normal, center) + plane.w;
+        // how far the box reaches towards/away from the plane
+        f32 radius = glm::dot(extents, glm::abs(normal));
+        if (distance + radius < 0.0f) return FrustumTestResult::OUTSIDE;
+        if (distance - radius < 0.0f) result = FrustumTestResult::INTERSECTING;
+    }
+    return result;
+}
+
+// slab test. invDir is 1 / ray direction (inf for 0 components is fine). tEnter is 0 if the ray starts inside
+inline bool RayIntersectsBox(const BoundingBox& box, const glm::vec3& origin, const glm::vec3& invDir, f32 maxT, f32* tEnter)
+{
+    glm::vec3 t0 = (box.min - origin) * invDir;
+    glm::vec3 t1 = (box.max - origin) * invDir;
+    glm::vec3 tNear = glm::min(t0, t1);
+    glm::vec3 tFar = glm::max(t0, t1);
+    f32 enter = glm::max(glm::max(tNear.x, tNear.y), glm::max(tNear.z, 0.0f));
+    f32 exit = glm::min(glm::min(tFar.x, tFar.y), glm::min(tFar.z, maxT));
+    *tEnter = enter;
+    return enter <= exit;
+}
+
+inline bool BoxesOverlap(const BoundingBox& a, const BoundingBox& b)
+{
+    return a.min.x <= b.max.x && a.max.x >= b.min.x
+        && a.min.y <= b.max.y && a.max.y >= b.min.y
+        && a.min.z <= b.max.z && a.max.z >= b.min.z;
+}
+
+// box that contains box after it's been transformed by matrix (Arvo)
+inline BoundingBox TransformBounds(const BoundingBox& box, const glm::mat4& matrix)
+{
+    glm::vec3 center = glm::vec3(matrix * glm::vec4((box.min + box.max) * 0.5f, 1.0f));
+    glm::vec3 extents = (box.max - box.min) * 0.5f;
+    glm::mat3 absolute = glm::mat3(glm::abs(glm::vec3(matrix[0])), glm::abs(glm::vec3(matrix[1])), glm::abs(glm::vec3(matrix[2])));
+    glm::vec3 worldExtents = absolute * extents;
+    return BoundingBox(center - worldExtents, center + worldExtents);
+}
+
+struct BvhHit
+{
+    // userData of what was hit, U32_INVALID_ID if nothing was
+    u32 userData = U32_INVALID_ID;
+    f32 t = 0.0f;
+    inline bool IsHit() const { return userData != U32_INVALID_ID; }
+};
+
+struct Bvh
+{
+    struct Node
+    {
+        // fat box for leaves
+        BoundingBox box = {};
+        // next free node while in the free list
+        u32 parent = BVH_NULL_NODE;
+        // BVH_NULL_NODE for leaves
+        u32 left = BVH_NULL_NODE;
+        u32 right = BVH_NULL_NODE;
+        u32 userData = 0;
+        // 0 for leaves, -1 for free nodes
+        s32 height = -1;
+        inline bool IsLeaf() const { return left == BVH_NULL_NODE; }
+    };
+
+    Bvh() = default;
+    explicit Bvh(f32 margin) : margin(margin) {}
+    Bvh(const Bvh&) = delete;
+    Bvh& operator=(const Bvh&) = delete;
+
+    // deferInsert: only create the leaf, it gets into the tree on the next Rebuild
+    TAPI u32 CreateProxy(const BoundingBox& box, u32 userData, bool deferInsert = false);
+    TAPI void DestroyProxy(u32 proxy);
+    // false if box still fits in the proxy's fat box (and that isn't much too big for it), in which case nothing changes.
+    // deferInsert: only update the leaf, the tree catches up on the next Rebuild
+    TAPI bool MoveProxy(u32 proxy, const BoundingBox& box, bool deferInsert = false);
+    // rebuilds every internal node with binned SAH. Leaves (and so proxy ids) stay the same
+    TAPI void Rebuild();
+    // keeps the memory around
+    TAPI void Clear();
+
+    inline u32 GetUserData(u32 proxy) const { return nodes[proxy].userData; }
+    inline const BoundingBox& GetFatBox(u32 proxy) const { return nodes[proxy].box; }
+    inline u32 GetProxyCount() const { return numProxies; }
+    inline u32 GetHeight() const { return root == BVH_NULL_NODE ? 0 : (u32)nodes[root].height; }
+    // true between a deferred CreateProxy/MoveProxy and the Rebuild that puts the tree back in order
+    inline bool NeedsRebuild() const { return needsRebuild; }
+    // summed surface area of the internal nodes over the root's. Lower = fewer nodes visited by an average query
+    TAPI f32 ComputeCost() const;
+    // asserts parent links, heights and that every box holds its children. Slow, for tests
+    TAPI void Validate() const;
+
+    // func(u32 userData) for every proxy whose fat box overlaps box
+    template <typename Func>
+    void QueryAabb(const BoundingBox& box, Func&& func) const;
+    // func(u32 userData) for every proxy whose fat box is at least partly inside the frustum.
+    // Subtrees that are completely inside are reported without testing anything under them
+    template <typename Func>
+    void QueryFrustum(const FrustumPlanes& frustum, Func&& func) const;
+    // func(u32 userData, f32 tEnter) for every proxy whose fat box the ray hits before maxT, in no particular order.
+    // dir doesn't need to be normalized, t is in units of dir
+    template <typename Func>
+    void QueryRay(const glm::vec3& origin, const glm::vec3& dir, f32 maxT, Func&& func) const;
+    // closest hit along the ray. Nodes are visited near to far, and anything that starts further than the best hit so far
+    // is skipped. hitTest(u32 userData, f32 tEnter) does the exact test for a proxy whose fat box the ray hits, and returns
+    // the t of the hit or a negative number for a miss
+    template <typename HitFunc>
+    BvhHit ClosestHit(const glm::vec3& origin, const glm::vec3& dir, f32 maxT, HitFunc&& hitTest) const;
+    // against the fat boxes themselves
+    inline BvhHit ClosestHit(const glm::vec3& origin, const glm::vec3& dir, f32 maxT) const
+    {
+        return ClosestHit(origin, dir, maxT, [](u32, f32 tEnter) { return tEnter; });
+    }
+
+    f32 margin = BVH_DEFAULT_MARGIN;
+
+private:
+    // counts queries in flight, so writers can assert nobody is reading
+    struct ReadScope
+    {
+#ifdef TINY_ASSERTIONS_ENABLED
+        explicit ReadScope(const Bvh& bvh) : bvh(bvh) { bvh.activeQueries.fetch_add(1, std::memory_order_relaxed); }
+        ~ReadScope() { bvh.activeQueries.fetch_sub(1, std::memory_order_relaxed); }
+        const Bvh& bvh;
+#else
+        explicit ReadScope(const Bvh&) {}
+#endif
+    };
+    struct BuildRef;
+
+    u32 AllocNode();
+    void FreeNode(u32 node);
+    void InsertLeaf(u32 leaf);
+    void RemoveLeaf(u32 leaf);
+    // rotates the taller grandchild up if node's children differ in height by more than 1. Returns what's now in node's place
+    u32 Balance(u32 node);
+    // refits and rebalances from node up to the root
+    void FixUpwards(u32 node);
+    u32 BuildRange(BuildRef* refs, u32 count, u32 depth);
+    inline BoundingBox Fatten(const BoundingBox& box, f32 amount) const
+    {
+        return BoundingBox(box.min - glm::vec3(amount), box.max + glm::vec3(amount));
+    }
+    inline void AssertNoReaders() const
+    {
+#ifdef TINY_ASSERTIONS_ENABLED
+        TINY_ASSERT(activeQueries.load(std::memory_order_relaxed) == 0 && "Bvh modified while it's being queried");
+#endif
+    }
+
+    DynArray<Node> nodes = {};
+    u32 root = BVH_NULL_NODE;
+    u32 freeList = BVH_NULL_NODE;
+    u32 numProxies = 0;
+    bool needsRebuild = false;
+#ifdef TINY_ASSERTIONS_ENABLED
+    mutable std::atomic<u32> activeQueries = 0;
+#endif
+};
+
+// ============ queries ============
+
+template <typename Func>
+void Bvh::QueryAabb(const BoundingBox& box, Func&& func) const
+{
+    TINY_ASSERT(!needsRebuild && "Bvh queried between a deferred change and Rebuild");
+    if (root == BVH_NULL_NODE) return;
+    ReadScope scope(*this);
+    u32 stack[BVH_MAX_DEPTH];
+    u32 stackSize = 0;
+    stack[stackSize++] = root;
+    while (stackSize)
+    {
+        const Node& node = nodes[stack[--stackSize]];
+        if (!BoxesOverlap(node.box, box)) continue;
+        if (node.IsLeaf())
+        {
+            func(node.userData);
+            continue;
+        }
+        TINY_ASSERT(stackSize + 2 <= BVH_MAX_DEPTH);
+        stack[stackSize++] = node.right;
+        stack[stackSize++] = node.left;
+    }
+}
+
+template <typename Func>
+void Bvh::QueryFrustum(const FrustumPlanes& frustum, Func&& func) const
+{
+    TINY_ASSERT(!needsRebuild && "Bvh queried between a deferred change and Rebuild");
+    if (root == BVH_NULL_NODE) return;
+    ReadScope scope(*this);
+    // top bit set = the node is already known to be completely inside
+    constexpr u32 insideBit = 1u << 31;
+    u32 stack[BVH_MAX_DEPTH];
+    u32 stackSize = 0;
+    stack[stackSize++] = root;
+    while (stackSize)
+    {
+        u32 entry = stack[--stackSize];
+        const Node& node = nodes[entry & ~insideBit];
+        if (!(entry & insideBit))
+        {
+            FrustumTestResult test = FrustumTestBox(frustum, node.box);
+            if (test == FrustumTestResult::OUTSIDE) continue;
+            if (test == FrustumTestResult::INSIDE) entry |= insideBit;
+        }
+        if (node.IsLeaf())
+        {
+            func(node.userData);
+            continue;
+        }
+        TINY_ASSERT(stackSize + 2 <= BVH_MAX_DEPTH);
+        stack[stackSize++] = node.right | (entry & insideBit);
+        stack[stackSize++] = node.left | (entry & insideBit);
+    }
+}
+
+template <typename Func>
+void Bvh::QueryRay(const glm::vec3& origin, const glm::vec3& dir, f32 maxT, Func&& func) const
+{
+    TINY_ASSERT(!needsRebuild && "Bvh queried between a deferred change and Rebuild");
+    if (root == BVH_NULL_NODE) return;
+    ReadScope scope(*this);
+    glm::vec3 invDir = 1.0f / dir;
+    u32 stack[BVH_MAX_DEPTH];
+    u32 stackSize = 0;
+    stack[stackSize++] = root;
+    while (stackSize)
+    {
+        const Node& node = nodes[stack[--stackSize]];
+        f32 tEnter;
+        if (!RayIntersectsBox(node.box, origin, invDir, maxT, &tEnter)) continue;
+        if (node.IsLeaf())
+        {
+            func(node.userData, tEnter);
+            continue;
+        }
+        TINY_ASSERT(stackSize + 2 <= BVH_MAX_DEPTH);
+        stack[stackSize++] = node.right;
+        stack[stackSize++] = node.left;
+    }
+}
+
+template <typename HitFunc>
+BvhHit Bvh::ClosestHit(const glm::vec3& origin, const glm::vec3& dir, f32 maxT, HitFunc&& hitTest) const
+{
+    TINY_ASSERT(!needsRebuild && "Bvh queried between a deferred change and Rebuild");
+    BvhHit best;
+    best.t = maxT;
+    if (root == BVH_NULL_NODE) return best;
+    ReadScope scope(*this);
+    glm::vec3 invDir = 1.0f / dir;
+    struct Visit
+    {
+        u32 node;
+        f32 tEnter;
+    };
+    Visit stack[BVH_MAX_DEPTH];
+    u32 stackSize = 0;
+    f32 rootT;
+    if (RayIntersectsBox(nodes[root].box, origin, invDir, maxT, &rootT))
+    {
+        stack[stackSize++] = { root, rootT };
+    }
+    while (stackSize)
+    {
+        Visit visit = stack[--stackSize];
+        // something closer was found since this was pushed
+        if (visit.tEnter > best.t) continue;
+        const Node& node = nodes[visit.node];
+        if (node.IsLeaf())
+        {
+            f32 t = hitTest(node.userData, visit.tEnter);
+            if (t >= 0.0f && t <= best.t)
+            {
+                best.userData = node.userData;
+                best.t = t;
+            }
+            continue;
+        }
+        f32 leftT, rightT;
+        bool hitLeft = RayIntersectsBox(nodes[node.left].box, origin, invDir, best.t, &leftT);
+        bool hitRight = RayIntersectsBox(nodes[node.right].box, origin, invDir, best.t, &rightT);
+        TINY_ASSERT(stackSize + 2 <= BVH_MAX_DEPTH);
+        // the nearer child goes on top, so it's visited first
+        if (hitLeft && hitRight)
+        {
+            bool leftFirst = leftT <= rightT;
+            stack[stackSize++] = leftFirst ? Visit{ node.right, rightT } : Visit{ node.left, leftT };
+            stack[stackSize++] = leftFirst ? Visit{ node.left, leftT } : Visit{ node.right, rightT };
+        }
+        else if (hitLeft) stack[stackSize++] = { node.left, leftT };
+        else if (hitRight) stack[stackSize++] = { node.right, rightT };
+    }
+    return best;
+}
+
+// against brute force, deferred changes + rebuild, concurrent queries, entities moving through UpdateTransforms
+TAPI void BvhTests();
+// frustum/box/ray query throughput at 10k - 1M proxies vs brute force, insertion vs SAH rebuild, refitting moved proxies
+TAPI void BvhBenchmarks();
+
+#endif
@@ -0,0 +1,446 @@
+//#include "pch.h"
+#include "ecs.h"
+
+#include "mem/tiny_mem.h"
+#include <mutex>
+#include <cstring>
+#include <cstdlib>
+
+namespace Ecs
+{
+
+static ComponentInfo componentInfos[ECS_MAX_COMPONENT_TYPES] = {};
+static u32 numComponentTypes = 0;
+static std::mutex componentRegistryLock;
+
+u32 RegisterComponent(const ComponentInfo& info)
+{
+    std::lock_guard<std::mutex> lock(componentRegistryLock);
+    for (u32 i = 0; i < numComponentTypes; i++)
+    {
+        if (strcmp(componentInfos[i].name, info.name) == 0)
+        {
+            return i;
+        }
+    }
+    if (numComponentTypes >= ECS_MAX_COMPONENT_TYPES)
+    {
+        LOG_FATAL("Out of ECS component types. Bump ECS_MAX_COMPONENT_TYPES (and Signature with it)");
+        TINY_ASSERT(numComponentTypes < ECS_MAX_COMPONENT_TYPES);
+        // there's no id we could hand out that fits in a Signature, and callers have no way to handle failure
+        std::abort();
+    }
+    componentInfos[numComponentTypes] = info;
+    return numComponentTypes++;
+}
+
+const ComponentInfo& GetComponentInfo(u32 componentId)
+{
+    TINY_ASSERT(componentId < numComponentTypes);
+    return componentInfos[componentId];
+}
+
+static inline u32 AlignUp(u32 value, u32 alignment)
+{
+    return (value + (alignment - 1)) & ~(alignment - 1);
+}
+
+static inline u8* ComponentPtr(const Archetype* archetype, u32 column, u32 chunk, u32 row)
+{
+    const ComponentInfo& info = componentInfos[archetype->componentIds[column]];
+    return archetype->chunks[chunk] + archetype->columnOffsets[column] + (size_t)row * info.size;
+}
+
+static inline void MoveComponent(const ComponentInfo& info, void* dst, void* src)
+{
+    if (info.moveConstruct) info.moveConstruct(dst, src);
+    else TMEMCPY(dst, src, info.size);
+}
+
+Archetype* GetArchetype(World& world, Signature signature)
+{
+    if (Archetype** existing = world.archetypeMap.find(signature))
+    {
+        return *existing;
+    }
+    Archetype* archetype = new(TSYSALLOC_TAGGED(sizeof(Archetype), MemTag::ENTITIES)) Archetype();
+    archetype->signature = signature;
+    TMEMSET(archetype->columnOf, -1, sizeof(archetype->columnOf));
+    u32 rowBytes = sizeof(EntityId);
+    u32 alignmentSlop = 0;
+    for (u32 id = 0; id < ECS_MAX_COMPONENT_TYPES; id++)
+    {
+        if (signature & (Signature{1} << id))
+        {
+            TINY_ASSERT(id < numComponentTypes);
+            archetype->columnOf[id] = (s8)archetype->numComponents;
+            archetype->componentIds[archetype->numComponents++] = (u8)id;
+            rowBytes += componentInfos[id].size;
+            alignmentSlop += componentInfos[id].alignment;
+        }
+    }
+    // big rows get a bigger chunk, so there's always room for at least one
+    archetype->chunkBytes = ECS_CHUNK_SIZE;
+    if (rowBytes + alignmentSlop > archetype->chunkBytes)
+    {
+        archetype->chunkBytes = AlignUp(rowBytes + alignmentSlop, 16);
+    }
+    archetype->chunkCapacity = (archetype->chunkBytes - alignmentSlop) / rowBytes;
+    // entity ids first, then one array per component
+    u32 offset = sizeof(EntityId) * archetype->chunkCapacity;
+    for (u32 column = 0; column < archetype->numComponents; column++)
+    {
+        const ComponentInfo& info = componentInfos[archetype->componentIds[column]];
+        offset = AlignUp(offset, info.alignment);
+        archetype->columnOffsets[column] = offset;
+        offset += info.size * archetype->chunkCapacity;
+    }
+    TINY_ASSERT(offset <= archetype->chunkBytes);
+    world.archetypeMap.insert(signature, archetype);
+    world.archetypes.push_back(archetype);
+    return archetype;
+}
+
+// makes room for one more row at the end. Components are left uninitialized
+static EntityLocation PushRow(Archetype* archetype, EntityId entity)
+{
+    u32 chunk = archetype->numEntities / archetype->chunkCapacity;
+    u32 row = archetype->numEntities % archetype->chunkCapacity;
+    if (chunk == archetype->chunks.size())
+    {
+        u8* chunkMem = (u8*)TSYSALLOC_TAGGED(archetype->chunkBytes, MemTag::ENTITIES);
+        TINY_ASSERT(chunkMem && "Failed to allocate ECS chunk");
+        archetype->chunks.push_back(chunkMem);
+    }
+    ((EntityId*)archetype->chunks[chunk])[row] = entity;
+    archetype->numEntities++;
+    return { archetype, chunk, row };
+}
+
+// destroys the components at a row and moves the last row into its place
+static void RemoveRow(World& world, const EntityLocation& location)
+{
+    Archetype* archetype = location.archetype;
+    u32 lastChunk = (archetype->numEntities - 1) / archetype->chunkCapacity;
+    u32 lastRow = (archetype->numEntities - 1) % archetype->chunkCapacity;
+    bool isLast = lastChunk == location.chunk && lastRow == location.row;
+    for (u32 column = 0; column < archetype->numComponents; column++)
+    {
+        const ComponentInfo& info = componentInfos[archetype->componentIds[column]];
+        u8* hole = ComponentPtr(archetype, column, location.chunk, location.row);
+        if (info.destruct) info.destruct(hole);
+        if (!isLast)
+        {
+            u8* last = ComponentPtr(archetype, column, lastChunk, lastRow);
+            MoveComponent(info, hole, last);
+            if (info.destruct) info.destruct(last);
+        }
+    }
+    if (!isLast)
+    {
+        EntityId movedEntity = ((EntityId*)archetype->chunks[lastChunk])[lastRow];
+        ((EntityId*)archetype->chunks[location.chunk])[location.row] = movedEntity;
+        EntityLocation* movedLocation = world.entities.get(SlotMapHandle<EntityLocation>(movedEntity));
+        movedLocation->chunk = location.chunk;
+        movedLocation->row = location.row;
+    }
+    archetype->numEntities--;
+}
+
+// moves an entity's row to another archetype. Components the new archetype has and the old one doesn't are left uninitialized
+static void MoveEntity(World& world, EntityId entity, EntityLocation* location, Archetype* dst)
+{
+    Archetype* src = location->archetype;
+    EntityLocation newLocation = PushRow(dst, entity);
+    for (u32 column = 0; column < src->numComponents; column++)
+    {
+        u32 componentId = src->componentIds[column];
+        s8 dstColumn = dst->columnOf[componentId];
+        if (dstColumn >= 0)
+        {
+            MoveComponent(componentInfos[componentId],
+                ComponentPtr(dst, dstColumn, newLocation.chunk, newLocation.row),
+                ComponentPtr(src, column, location->chunk, location->row));
+        }
+    }
+    // destroys what's left in the old row (moved from, or components we're dropping)
+    RemoveRow(world, *location);
+    *location = newLocation;
+}
+
+EntityId CreateEntityRaw(World& world, Signature signature)
+{
+    Archetype* archetype = GetArchetype(world, signature);
+    SlotMapHandle<EntityLocation> handle = world.entities.emplace();
+    world.entities.at(handle) = PushRow(archetype, handle.bits);
+    return handle.bits;
+}
+
+bool DestroyEntity(World& world, EntityId entity)
+{
+    SlotMapHandle<EntityLocation> handle(entity);
+    EntityLocation* location = world.entities.get(handle);
+    if (!location) return false;
+    RemoveRow(world, *location);
+    world.entities.erase(handle);
+    return true;
+}
+
+bool IsAlive(const World& world, EntityId entity)
+{
+    return world.entities.contains(SlotMapHandle<EntityLocation>(entity));
+}
+
+void* GetComponentRaw(World& world, EntityId entity, u32 componentId)
+{
+    EntityLocation* location = world.entities.get(SlotMapHandle<EntityLocation>(entity));
+    if (!location) return nullptr;
+    s8 column = location->archetype->columnOf[componentId];
+    if (column < 0) return nullptr;
+    return ComponentPtr(location->archetype, column, location->chunk, location->row);
+}
+
+void* AddComponentRaw(World& world, EntityId entity, u32 componentId)
+{
+    EntityLocation* location = world.entities.get(SlotMapHandle<EntityLocation>(entity));
+    if (!location || location->archetype->columnOf[componentId] >= 0) return nullptr;
+    Archetype* dst = GetArchetype(world, location->archetype->signature | (Signature{1} << componentId));
+    MoveEntity(world, entity, location, dst);
+    return ComponentPtr(dst, dst->columnOf[componentId], location->chunk, location->row);
+}
+
+bool RemoveComponent(World& world, EntityId entity, u32 componentId)
+{
+    EntityLocation* location = world.entities.get(SlotMapHandle<EntityLocation>(entity));
+    if (!location || location->archetype->columnOf[componentId] < 0) return false;
+    Archetype* dst = GetArchetype(world, location->archetype->signature & ~(Signature{1} << componentId));
+    MoveEntity(world, entity, location, dst);
+    return true;
+}
+
+u32 EntityCount(const World& world)
+{
+    return world.entities.size();
+}
+
+World::~World()
+{
+    for (Archetype* archetype : archetypes)
+    {
+        for (u32 column = 0; column < archetype->numComponents; column++)
+        {
+            const ComponentInfo& info = componentInfos[archetype->componentIds[column]];
+            if (!info.destruct) continue;
+            for (u32 i = 0; i < archetype->numEntities; i++)
+            {
+                info.destruct(ComponentPtr(archetype, column, i / archetype->chunkCapacity, i % archetype->chunkCapacity));
+            }
+        }
+        for (u8* chunk : archetype->chunks)
+        {
+            TSYSFREE(chunk);
+        }
+        archetype->~Archetype();
+        TSYSFREE(archetype);
+    }
+}
+
+} // namespace Ecs
+
+// ============ tests ============
+
+#include "tiny_types.h"
+#include "containers/slot_map.h"
+#include <string>
+#include <vector>
+#include <chrono>
+
+namespace Ecs
+{
+
+struct EcsTestName
+{
+    static inline s32 numAlive = 0;
+    std::string name = "";
+    EcsTestName() { numAlive++; }
+    EcsTestName(const char* name) : name(name) { numAlive++; }
+    EcsTestName(const EcsTestName& other) : name(other.name) { numAlive++; }
+    EcsTestName(EcsTestName&& other) : name(std::move(other.name)) { numAlive++; }
+    EcsTestName& operator=(const EcsTestName&) = default;
+    EcsTestName& operator=(EcsTestName&&) = default;
+    ~EcsTestName() { numAlive--; }
+};
+
+struct EcsTestVelocity
+{
+    glm::vec3 value = glm::vec3(0);
+};
+
+void EcsTests()
+{
+    LOG_INFO("Running ECS tests...");
+    {
+        World world;
+        std::vector<EntityId> movers;
+        std::vector<EntityId> statics;
+        // enough to span a bunch of chunks in each archetype
+        for (u32 i = 0; i < 3000; i++)
+        {
+            Transform tf = Transform(glm::vec3((f32)i, 0, 0));
+            if (i % 3 == 0)
+            {
+                movers.push_back(CreateEntity(world, tf, EcsTestVelocity{ glm::vec3(1, 0, 0) }, EcsTestName(std::to_string(i).c_str())));
+            }
+            else
+            {
+                statics.push_back(CreateEntity(world, tf, BoundingBox(glm::vec3(-1), glm::vec3(1))));
+            }
+        }
+        TINY_ASSERT(EntityCount(world) == 3000 && EcsTestName::numAlive == 1000);
+        Query<Transform> transforms(world);
+        Query<Transform, EcsTestVelocity> moving(world);
+        Query<BoundingBox> bounded(world);
+        TINY_ASSERT(transforms.Count() == 3000 && moving.Count() == 1000 && bounded.Count() == 2000);
+        moving.ForEach([](Transform& tf, EcsTestVelocity& velocity) { tf.position += velocity.value; });
+        for (u32 i = 0; i < movers.size(); i++)
+        {
+            TINY_ASSERT(GetComponent<Transform>(world, movers[i])->position.x == (f32)(i * 3 + 1));
+            TINY_ASSERT(GetComponent<EcsTestName>(world, movers[i])->name == std::to_string(i * 3));
+            TINY_ASSERT(!HasComponent<BoundingBox>(world, movers[i]));
+        }
+        // entity ids handed to the callback match the components next to them
+        moving.ForEachWithEntity([&](EntityId entity, Transform& tf, EcsTestVelocity& velocity) {
+            TINY_ASSERT(GetComponent<Transform>(world, entity) == &tf);
+        });
+
+        // destroying swaps the last row in, everything else still finds its own components
+        for (u32 i = 0; i < movers.size(); i += 2)
+        {
+            TINY_ASSERT(DestroyEntity(world, movers[i]) && !DestroyEntity(world, movers[i]));
+            TINY_ASSERT(!IsAlive(world, movers[i]) && !GetComponent<Transform>(world, movers[i]));
+        }
+        TINY_ASSERT(EcsTestName::numAlive == 500 && moving.Count() == 500);
+        for (u32 i = 1; i < movers.size(); i += 2)
+        {
+            TINY_ASSERT(GetComponent<EcsTestName>(world, movers[i])->name == std::to_string(i * 3));
+        }
+
+        // adding/removing components moves entities between archetypes, and queries pick up the new archetypes
+        for (u32 i = 0; i < statics.size(); i += 4)
+        {
+            AddComponent<EcsTestName>(world, statics[i], "added");
+        }
+        TINY_ASSERT(Query<EcsTestName>(world).Count() == 500 + 500 && EcsTestName::numAlive == 1000);
+        TINY_ASSERT(Query<BoundingBox>(world).Count() == 2000 && bounded.Count() == 2000);
+        for (u32 i = 0; i < statics.size(); i += 4)
+        {
+            TINY_ASSERT(GetComponent<EcsTestName>(world, statics[i])->name == "added");
+            TINY_ASSERT(GetComponent<Transform>(world, statics[i])->position.x == (f32)(i / 2 * 3 + 1 + (i % 2)));
+            TINY_ASSERT(RemoveComponent<BoundingBox>(world, statics[i]) && !RemoveComponent<BoundingBox>(world, statics[i]));
+        }
+        TINY_ASSERT(bounded.Count() == 1500 && EcsTestName::numAlive == 1000);
+        // adding something that's already there just overwrites it
+        AddComponent<EcsTestName>(world, statics[0], "overwritten");
+        TINY_ASSERT(GetComponent<EcsTestName>(world, statics[0])->name == "overwritten" && EcsTestName::numAlive == 1000);
+        // stale ids don't do anything
+        TINY_ASSERT(!AddComponent<EcsTestVelocity>(world, movers[0]) && !RemoveComponent<Transform>(world, movers[0]));
+    }
+    // the world cleans up whatever's left in it
+    TINY_ASSERT(EcsTestName::numAlive == 0);
+    LOG_INFO("ECS tests passed");
+}
+
+// what EntityData looked like when everything lived in one struct: transform, a model (shader, cached bounds, vector of meshes),
+// bounds, flags and a name
+struct EcsBenchFatEntity
+{
+    Transform transform = {};
+    u8 model[64] = {};
+    BoundingBox bounds = {};
+    u32 id = 0;
+    u32 flags = 0;
+    s8 name[50] = {};
+};
+
+struct EcsBenchCold
+{
+    u8 model[64] = {};
+    u32 flags = 0;
+    s8 name[50] = {};
+};
+
+template <typename Func>
+static f64 TimeMs(Func func)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    func();
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<f64, std::milli>(end - start).count();
+}
+
+void EcsBenchmarks()
+{
+    LOG_INFO("Running ECS benchmarks...");
+    constexpr u32 numEntities = 1000000;
+    constexpr u32 numRounds = 20;
+    const glm::vec3 delta = glm::vec3(0.01f, 0.02f, 0.03f);
+
+    SlotMap<EcsBenchFatEntity>* fatEntities = new SlotMap<EcsBenchFatEntity>();
+    World* world = new World();
+    for (u32 i = 0; i < numEntities; i++)
+    {
+        Transform tf = Transform(glm::vec3((f32)i, 0, 0));
+        EcsBenchFatEntity fat = {};
+        fat.transform = tf;
+        fatEntities->insert(fat);
+        CreateEntity(*world, tf, BoundingBox(), EcsBenchCold());
+    }
+
+    f64 fatMs = TimeMs([&]() {
+        for (u32 round = 0; round < numRounds; round++)
+        {
+            for (EcsBenchFatEntity& ent : *fatEntities)
+            {
+                ent.transform.position += delta;
+                ent.transform.rotation += 0.01f;
+            }
+        }
+    });
+    Query<Transform> query(*world);
+    f64 queryMs = TimeMs([&]() {
+        for (u32 round = 0; round < numRounds; round++)
+        {
+            query.ForEach([&](Transform& tf) {
+                tf.position += delta;
+                tf.rotation += 0.01f;
+            });
+        }
+    });
+    f64 chunkMs = TimeMs([&]() {
+        for (u32 round = 0; round < numRounds; round++)
+        {
+            query.ForEachChunk([&](u32 count, const EntityId* entities, Transform* tfs) {
+                for (u32 i = 0; i < count; i++)
+                {
+                    tfs[i].position += delta;
+                    tfs[i].rotation += 0.01f;
+                }
+            });
+        }
+    });
+    // both query loops touched every transform
+    u32 numUpdated = 0;
+    query.ForEach([&](Transform& tf) { numUpdated += glm::abs(tf.rotation - 0.01f * numRounds * 2) < 0.001f; });
+    TINY_ASSERT(numUpdated == numEntities);
+
+    f64 numOps = (f64)numEntities * numRounds;
+    LOG_INFO("[ECS] %u transforms, %u rounds (ns per transform)", numEntities, numRounds);
+    LOG_INFO("[ECS] one struct per entity (%3u bytes)  | %6.2f ns", (u32)sizeof(EcsBenchFatEntity), fatMs * 1000000.0 / numOps);
+    LOG_INFO("[ECS] Query<Transform>::ForEach         | %6.2f ns | %.2fx", queryMs * 1000000.0 / numOps, fatMs / queryMs);
+    LOG_INFO("[ECS] Query<Transform>::ForEachChunk    | %6.2f ns | %.2fx", chunkMs * 1000000.0 / numOps, fatMs / chunkMs);
+    delete fatEntities;
+    delete world;
+    LOG_INFO("ECS benchmarks complete");
+}
+
+} // namespace Ecs
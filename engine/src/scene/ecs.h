@@ -0,0 +1,287 @@
+#ifndef TINY_ECS_H
+#define TINY_ECS_H
+
+#include <new>
+#include <utility>
+#include <type_traits>
+#include "tiny_defines.h"
+#include "tiny_log.h"
+#include "containers/slot_map.h"
+#include "containers/hash_map.h"
+#include "containers/dynarray.h"
+
+// Archetype based component storage
+// Every distinct set of component types gets an archetype. Its entities are packed into fixed size chunks, and inside a chunk
+// each component type has its own contiguous array (SoA). Something that only touches Transforms only pulls Transforms
+// through the cache, not whatever else the entities happen to have.
+//	- entity ids are slot map handles (see slot_map.h). The slot holds the archetype/chunk/row the entity currently lives at
+//	- destroying an entity moves the last row of its archetype into the hole
+//	- adding/removing a component moves the entity to another archetype, which invalidates pointers to its components
+//	- creating entities never moves existing rows, so component pointers survive that
+// Queries (Ecs::Query<Ts...>) walk every archetype that has at least Ts, one chunk at a time.
+// Single threaded. Don't create/destroy entities or add/remove components in a world while a query is walking it
+
+#define ECS_MAX_COMPONENT_TYPES 64
+#define ECS_CHUNK_SIZE KILOBYTES_BYTES(16)
+
+namespace Ecs
+{
+
+typedef u32 EntityId;
+#define ECS_INVALID_ENTITY SLOT_MAP_INVALID_HANDLE
+// bit per component id
+typedef u64 Signature;
+
+struct ComponentInfo
+{
+    u32 size;
+    u32 alignment;
+    // null for trivial types, which just get memcpy'd/left alone
+    void (*moveConstruct)(void* dst, void* src);
+    void (*destruct)(void* obj);
+    const char* name;
+};
+
+struct Archetype
+{
+    Signature signature = 0;
+    u32 numComponents = 0;
+    // sorted by component id. Column i holds componentIds[i]
+    u8 componentIds[ECS_MAX_COMPONENT_TYPES];
+    // column of each component id, -1 if this archetype doesn't have it
+    s8 columnOf[ECS_MAX_COMPONENT_TYPES];
+    // byte offset of each column's array from the start of a chunk. The entity id array is at offset 0
+    u32 columnOffsets[ECS_MAX_COMPONENT_TYPES];
+    u32 chunkBytes = 0;
+    u32 chunkCapacity = 0;
+    u32 numEntities = 0;
+    // every chunk but the last one in use is full. Empty chunks are kept around
+    DynArray<u8*> chunks;
+};
+
+struct EntityLocation
+{
+    Archetype* archetype;
+    u32 chunk;
+    u32 row;
+};
+
+struct World
+{
+    SlotMap<EntityLocation> entities;
+    HashMap<Signature, Archetype*> archetypeMap;
+    // never shrinks, queries use this to pick up archetypes made since they last ran
+    DynArray<Archetype*> archetypes;
+
+    World() = default;
+    World(const World&) = delete;
+    World& operator=(const World&) = delete;
+    TAPI ~World();
+};
+
+// a name is only used to find the same type again from another module (the game dll gets its own copies of the template statics)
+TAPI u32 RegisterComponent(const ComponentInfo& info);
+TAPI const ComponentInfo& GetComponentInfo(u32 componentId);
+
+template <typename T>
+constexpr const char* ComponentTypeName()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    return __FUNCSIG__;
+#else
+    return __PRETTY_FUNCTION__;
+#endif
+}
+
+template <typename T>
+inline u32 ComponentId()
+{
+    static_assert(alignof(T) <= 16, "ECS chunks come from TSYSALLOC, can't over-align components");
+    static const u32 id = []() {
+        ComponentInfo info = {};
+        info.size = sizeof(T);
+        info.alignment = alignof(T);
+        if constexpr (!std::is_trivially_copyable_v<T>)
+        {
+            info.moveConstruct = [](void* dst, void* src) { new(dst) T(std::move(*(T*)src)); };
+        }
+        if constexpr (!std::is_trivially_destructible_v<T>)
+        {
+            info.destruct = [](void* obj) { ((T*)obj)->~T(); };
+        }
+        info.name = ComponentTypeName<T>();
+        return RegisterComponent(info);
+    }();
+    return id;
+}
+
+template <typename... Ts>
+inline Signature SignatureOf()
+{
+    return (Signature{0} | ... | (Signature{1} << ComponentId<Ts>()));
+}
+
+// ===== untyped interface, the templates below are thin wrappers over this =====
+
+// finds or makes the archetype for this set of components
+TAPI Archetype* GetArchetype(World& world, Signature signature);
+// components in the new row are left uninitialized. The caller has to construct every one of them
+TAPI EntityId CreateEntityRaw(World& world, Signature signature);
+TAPI bool DestroyEntity(World& world, EntityId entity);
+TAPI bool IsAlive(const World& world, EntityId entity);
+// null if the entity is gone or doesn't have the component
+TAPI void* GetComponentRaw(World& world, EntityId entity, u32 componentId);
+// moves the entity to the archetype with the component added. Returns the new component's memory, uninitialized.
+// Returns null if the entity is gone or already has it
+TAPI void* AddComponentRaw(World& world, EntityId entity, u32 componentId);
+TAPI bool RemoveComponent(World& world, EntityId entity, u32 componentId);
+// number of live entities
+TAPI u32 EntityCount(const World& world);
+
+inline u8* ColumnPtr(const Archetype* archetype, u8* chunk, u32 componentId)
+{
+    return chunk + archetype->columnOffsets[archetype->columnOf[componentId]];
+}
+
+// ===== typed interface =====
+
+// Ecs::CreateEntity(world, Transform(...), BoundingBox(...))
+template <typename... Ts>
+EntityId CreateEntity(World& world, Ts&&... components)
+{
+    EntityId entity = CreateEntityRaw(world, SignatureOf<std::decay_t<Ts>...>());
+    (new(GetComponentRaw(world, entity, ComponentId<std::decay_t<Ts>>())) std::decay_t<Ts>(std::forward<Ts>(components)), ...);
+    return entity;
+}
+
+// null if the entity is gone
+inline EntityLocation* GetLocation(World& world, EntityId entity)
+{
+    return world.entities.get(SlotMapHandle<EntityLocation>(entity));
+}
+
+// for grabbing several components of the same entity with one lookup
+template <typename T>
+inline T* GetComponent(const EntityLocation& location)
+{
+    s8 column = location.archetype->columnOf[ComponentId<T>()];
+    if (column < 0) return nullptr;
+    return (T*)(location.archetype->chunks[location.chunk] + location.archetype->columnOffsets[column]) + location.row;
+}
+
+template <typename T>
+inline T* GetComponent(World& world, EntityId entity)
+{
+    EntityLocation* location = GetLocation(world, entity);
+    return location ? GetComponent<T>(*location) : nullptr;
+}
+
+template <typename T>
+inline bool HasComponent(World& world, EntityId entity)
+{
+    return GetComponentRaw(world, entity, ComponentId<T>()) != nullptr;
+}
+
+// overwrites the component if the entity already has one. Null if the entity is gone
+template <typename T, typename... Args>
+T* AddComponent(World& world, EntityId entity, Args&&... args)
+{
+    if (T* existing = GetComponent<T>(world, entity))
+    {
+        *existing = T(std::forward<Args>(args)...);
+        return existing;
+    }
+    void* mem = AddComponentRaw(world, entity, ComponentId<T>());
+    return mem ? new(mem) T(std::forward<Args>(args)...) : nullptr;
+}
+
+template <typename T>
+inline bool RemoveComponent(World& world, EntityId entity)
+{
+    return RemoveComponent(world, entity, ComponentId<T>());
+}
+
+// Iterates every entity that has (at least) all of Ts
+// Ecs::Query<Transform, BoundingBox> query(world);
+// query.ForEach([](Transform& tf, BoundingBox& bounds) { ... });
+// Matching archetypes are cached, and only archetypes made since the last run get checked again
+template <typename... Ts>
+struct Query
+{
+    explicit Query(World& world) : world(&world), required(SignatureOf<Ts...>()) {}
+
+    // fn(u32 count, const EntityId* entities, Ts*... components) once per chunk. The arrays are contiguous, count long
+    template <typename Func>
+    void ForEachChunk(Func&& fn)
+    {
+        refresh();
+        for (Archetype* archetype : matched)
+        {
+            u32 remaining = archetype->numEntities;
+            for (u32 chunkIdx = 0; remaining; chunkIdx++)
+            {
+                u32 count = remaining < archetype->chunkCapacity ? remaining : archetype->chunkCapacity;
+                u8* chunk = archetype->chunks[chunkIdx];
+                fn(count, (const EntityId*)chunk, (Ts*)ColumnPtr(archetype, chunk, ComponentId<Ts>())...);
+                remaining -= count;
+            }
+        }
+    }
+    // fn(Ts&... components)
+    template <typename Func>
+    void ForEach(Func&& fn)
+    {
+        ForEachChunk([&fn](u32 count, const EntityId*, Ts*... components) {
+            for (u32 i = 0; i < count; i++)
+            {
+                fn(components[i]...);
+            }
+        });
+    }
+    // fn(EntityId entity, Ts&... components)
+    template <typename Func>
+    void ForEachWithEntity(Func&& fn)
+    {
+        ForEachChunk([&fn](u32 count, const EntityId* entities, Ts*... components) {
+            for (u32 i = 0; i < count; i++)
+            {
+                fn(entities[i], components[i]...);
+            }
+        });
+    }
+    u32 Count()
+    {
+        refresh();
+        u32 count = 0;
+        for (Archetype* archetype : matched) count += archetype->numEntities;
+        return count;
+    }
+
+private:
+    void refresh()
+    {
+        u32 numArchetypes = world->archetypes.size();
+        for (; numArchetypesSeen < numArchetypes; numArchetypesSeen++)
+        {
+            Archetype* archetype = world->archetypes[numArchetypesSeen];
+            if ((archetype->signature & required) == required)
+            {
+                matched.push_back(archetype);
+            }
+        }
+    }
+
+    World* world;
+    Signature required;
+    DynArray<Archetype*> matched;
+    u32 numArchetypesSeen = 0;
+};
+
+// create/destroy/add/remove/query, including non trivial components
+TAPI void EcsTests();
+// updating 1M transforms through a query vs the old everything-in-one-struct entity map
+TAPI void EcsBenchmarks();
+
+} // namespace Ecs
+
+#endif
@@ -4,9 +4,12 @@
 #include "tiny_engine.h"
 #include "tiny_log.h"
 #include "render/model.h"
+#include "tiny_profiler.h"
 
-#include <unordered_map>
-
+// UpdateTransforms rebuilds the bvh instead of reinserting what moved, once at least 1/BVH_ENTITY_REBUILD_FRACTION of
+// the entities in it moved. Reinserting everything takes ~3x as long as a rebuild (see BvhBenchmarks)
+#define BVH_ENTITY_REBUILD_FRACTION 3
+#define BVH_ENTITY_REBUILD_MIN_MOVED 256
 
 namespace Entity
 {
@@ -16,42 +19,74 @@ static EntityRegistry& GetRegistry()
     return *GetEngineCtx().entityRegistry;
 }
 
-EntityRef GenerateEntityID(const char* name = nullptr)
+void InitializeEntitySystem(Arena* arena)
 {
-    EntityRef result = 0;
-    EntityRegistry& registry = GetRegistry();
-    if (!name)
-    {
-        EntityRegistry& registry = GetRegistry();
-        result = registry.entityCreationIndex;
-    }
-    else
+    EntityRegistry* registryMem = arena_alloc_and_init<EntityRegistry>(arena);
+    GetEngineCtx().entityRegistry = registryMem;
+    // dummy entity with bad id so we can return it on failure from methods like GetEntity.
+    // SetFlag ignores invalid entities, so set the bit directly
+    SET_NTH_BIT(registryMem->invalidEntity.flags, EntityFlags::DISABLED, true);
+}
+
+static void NotifyRenderableChange(EntityRegistry& registry, EntityRef ent, RenderableChange change)
+{
+    registry.renderablesVersion++;
+    for (const RenderableListener& listener : registry.renderableListeners)
     {
-        result = HashBytes((u8*)name, strnlen(name, ENTITY_NAME_MAX_LENGTH));
+        listener.func(ent, change, listener.userData);
     }
-    TINY_ASSERT(result != U32_INVALID_ID); // TODO: handle this gracefully
-    return result;
 }
 
-void InitializeEntitySystem(Arena* arena)
+// puts the entity in/takes it out of the renderable list if that changed. Call after anything that could change it
+static void UpdateRenderable(EntityData& ent, bool modelChanged = false)
 {
-    EntityRegistry* registryMem = arena_alloc_and_init<EntityRegistry>(arena);
-    GetEngineCtx().entityRegistry = registryMem;
-    // dummy entity with bad id so we can return it on failure from methods like GetEntity
-    registryMem->entMap[U32_INVALID_ID] = {};
-    Entity::SetFlag(U32_INVALID_ID, EntityFlags::DISABLED, true);
+    if (!ent.isValid()) return;
+    EntityRegistry& registry = GetRegistry();
+    bool shouldRender = !IsFlag(ent, EntityFlags::DISABLED) && ent.model.isValid();
+    bool isRendered = ent.renderableIndex != U32_INVALID_ID;
+    if (shouldRender && !isRendered)
+    {
+        ent.renderableIndex = registry.renderables.size();
+        registry.renderables.push_back(ent.id);
+        NotifyRenderableChange(registry, ent.id, RenderableChange::ADDED);
+    }
+    else if (!shouldRender && isRendered)
+    {
+        // last one fills the hole
+        u32 lastIdx = registry.renderables.size() - 1;
+        if (ent.renderableIndex != lastIdx)
+        {
+            EntityRef moved = registry.renderables[lastIdx];
+            registry.renderables[ent.renderableIndex] = moved;
+            GetEntity(moved).renderableIndex = ent.renderableIndex;
+        }
+        registry.renderables.pop_back();
+        ent.renderableIndex = U32_INVALID_ID;
+        NotifyRenderableChange(registry, ent.id, RenderableChange::REMOVED);
+    }
+    else if (shouldRender && modelChanged)
+    {
+        NotifyRenderableChange(registry, ent.id, RenderableChange::MODEL_CHANGED);
+    }
 }
 
 void SetFlag(EntityData& ent, EntityFlags flag, bool enabled)
 {
+    // failed lookups all share the invalid entity, don't let them change it
+    if (!ent.isValid()) return;
     u32& bitfield = ent.flags;
     SET_NTH_BIT(bitfield, flag, enabled);
+    if (flag == EntityFlags::DISABLED)
+    {
+        UpdateRenderable(ent);
+    }
 }
 
 void SetFlag(EntityRef ent, EntityFlags flag, bool enabled)
 {
-    EntityRegistry& registry = GetRegistry();
-    SetFlag(registry.entMap[ent], flag, enabled);
+    EntityData& data = GetEntity(ent);
+    if (!data.isValid()) return;
+    SetFlag(data, flag, enabled);
 }
 
 bool IsFlag(const EntityData& data, EntityFlags flag)
@@ -63,8 +98,7 @@ bool IsFlag(const EntityData& data, EntityFlags flag)
 
 bool IsFlag(EntityRef ent, EntityFlags flag)
 {
-    EntityRegistry& registry = GetRegistry();
-    return IsFlag(registry.entMap[ent], flag);
+    return IsFlag(GetEntity(ent), flag);
 }
 
 EntityRef CreateEntity(
@@ -73,34 +107,18 @@ EntityRef CreateEntity(
     u32 flags)
 {
     EntityRegistry& registry = GetRegistry();
-    EntityData ent = {};
-    ent.transform = tf;
+    EntityRef ref = Ecs::CreateEntity(registry.world, tf, BoundingBox(), EntityData(), TransformNode(), WorldTransform());
+    registry.transforms.MarkDirty(ref);
+    EntityData& ent = *Ecs::GetComponent<EntityData>(registry.world, ref);
     ent.flags = flags;
-    u32 entityID = 0;
-    if (name)
+    ent.id = ref;
+    if (name && name[0])
     {
-        // if this entity has a name, use the name's hash as the id
-        // this is so we can lookup entities by name
-        size_t strlength = strnlen(name, ENTITY_NAME_MAX_LENGTH);
-        TMEMCPY(ent.name, name, strlength);
-        entityID = HashBytes((u8*)name, strlength);
+        // named entities can be looked up by name
+        ent.nameId = InternString(HashedString(name));
+        ent.name = GetInternedString(ent.nameId);
+        registry.nameIndex.try_emplace(ent.nameId, ent.id);
     }
-    else
-    {
-        // if no name, the entity id is just a incrementally increasing num
-        TMEMSET(ent.name, 0, ENTITY_NAME_MAX_LENGTH);
-        entityID = registry.entityCreationIndex;
-    }
-    // hash until we don't collide
-    while (registry.entMap.count(entityID))
-    {
-        entityID = HashBytes((u8*)&entityID, sizeof(entityID));
-    }
-    TINY_ASSERT(entityID != U32_INVALID_ID); // make absolutely sure
-    ent.id = entityID;
-    // we increment this every time, even if it's not what we use for the id.
-    registry.entityCreationIndex++;
-    registry.entMap[ent.id] = ent;
     return ent.id;
 }
 
@@ -108,35 +126,99 @@ bool DestroyEntity(EntityRef ent)
 {
     EntityRegistry& registry = GetRegistry();
     EntityData& entity = GetEntity(ent);
-    if (entity.id == U32_INVALID_ID)
+    if (!entity.isValid())
     {
         return false;
     }
+    // drop out of the renderable list (and tell listeners) while the entity and its model are still around
+    SetFlag(entity, EntityFlags::DISABLED, true);
     entity.model.Delete();
-    registry.entMap.erase(ent);
+    if (entity.nameId != STRING_ID_INVALID)
+    {
+        EntityRef* named = registry.nameIndex.find(entity.nameId);
+        if (named && *named == ent)
+        {
+            registry.nameIndex.erase(entity.nameId);
+        }
+    }
+    if (entity.bvhProxy != BVH_NULL_NODE)
+    {
+        registry.bvh.DestroyProxy(entity.bvhProxy);
+    }
+    // anything attached to it becomes a root, with its world transform baked into its local one so it stays put
+    registry.transforms.UnlinkNode(ent);
+    Ecs::DestroyEntity(registry.world, ent);
     return true;
 }
 
 EntityData& GetEntity(EntityRef ref)
 {
     EntityRegistry& registry = GetRegistry();
-    if (registry.entMap.count(ref) > 0)
+    if (EntityData* ent = Ecs::GetComponent<EntityData>(registry.world, ref))
     {
-        return registry.entMap[ref];
+        return *ent;
     }
-    return registry.entMap[U32_INVALID_ID]; // if doesn't exist, return our dummy
+    return registry.invalidEntity; // if doesn't exist, return our dummy
+}
+
+Transform& GetTransform(EntityRef ref)
+{
+    EntityRegistry& registry = GetRegistry();
+    Transform* tf = Ecs::GetComponent<Transform>(registry.world, ref);
+    if (!tf) return registry.invalidTransform;
+    registry.transforms.MarkDirty(ref);
+    return *tf;
+}
+
+BoundingBox& GetBounds(EntityRef ref)
+{
+    EntityRegistry& registry = GetRegistry();
+    BoundingBox* bounds = Ecs::GetComponent<BoundingBox>(registry.world, ref);
+    if (!bounds) return registry.invalidBounds;
+    // world bounds get refit along with the world matrix
+    registry.transforms.MarkDirty(ref);
+    return *bounds;
+}
+
+BoundingBox GetWorldBounds(EntityRef ref)
+{
+    EntityRegistry& registry = GetRegistry();
+    Ecs::EntityLocation* location = Ecs::GetLocation(registry.world, ref);
+    if (!location) return registry.invalidBounds;
+    return TransformBounds(*Ecs::GetComponent<BoundingBox>(*location), Ecs::GetComponent<WorldTransform>(*location)->world);
+}
+
+const Bvh& GetBvh()
+{
+    return GetRegistry().bvh;
+}
+
+EntityRef RaycastBounds(const glm::vec3& origin, const glm::vec3& dir, f32 maxT, f32* outT)
+{
+    glm::vec3 invDir = 1.0f / dir;
+    BvhHit hit = GetRegistry().bvh.ClosestHit(origin, dir, maxT, [&](u32 ent, f32) {
+        f32 t;
+        return RayIntersectsBox(GetWorldBounds(ent), origin, invDir, maxT, &t) ? t : -1.0f;
+    });
+    if (outT) *outT = hit.t;
+    return hit.IsHit() ? hit.userData : ENTITY_INVALID_REF;
 }
 
-EntityData& GetEntity(const char* name)
+Ecs::World& GetWorld()
+{
+    return GetRegistry().world;
+}
+
+EntityData& GetEntity(HashedString name)
 {
-    u32 namehash = HashBytes((u8*)name, strnlen(name, ENTITY_NAME_MAX_LENGTH));
     EntityRegistry& registry = GetRegistry();
-    if (registry.entMap.count(namehash) > 0)
+    // names nothing was ever called aren't in the string table, no point adding them
+    StringId nameId = FindInternedString(name);
+    if (EntityRef* ref = nameId != STRING_ID_INVALID ? registry.nameIndex.find(nameId) : nullptr)
     {
-        return registry.entMap[namehash];
+        return GetEntity(*ref);
     }
-    return registry.entMap[U32_INVALID_ID]; // if doesn't exist, return our dummy
-
+    return registry.invalidEntity; // if doesn't exist, return our dummy
 }
 
 bool HasRenderable(EntityRef ent)
@@ -149,33 +231,58 @@ bool AddRenderable(EntityRef ent, const Model& model)
 {
     EntityData& entity = GetEntity(ent);
     // if we already have a model, don't overwrite
-    if (entity.model.isValid())
+    if (!entity.isValid() || entity.model.isValid())
     {
         return false;
     }
     entity.model = model;
+    UpdateRenderable(entity);
     return true;
 }
 
 void OverwriteRenderable(EntityRef ent, const Model& model)
 {
     EntityData& entity = GetEntity(ent);
+    if (!entity.isValid()) return;
     entity.model = model;
+    UpdateRenderable(entity, true);
 }
 
-void GetRenderableEntities(EntityRef* dst, u32* numEntities)
+std::span<const EntityRef> GetRenderables()
 {
     EntityRegistry& registry = GetRegistry();
-    *numEntities = 0;
-    for (const auto& [ref, ent] : registry.entMap)
+    return std::span<const EntityRef>(registry.renderables.data(), registry.renderables.size());
+}
+
+u64 GetRenderablesVersion()
+{
+    return GetRegistry().renderablesVersion;
+}
+
+void GetRenderableEntities(EntityRef* dst, u32* numEntities)
+{
+    std::span<const EntityRef> renderables = GetRenderables();
+    *numEntities = (u32)renderables.size();
+    if (dst && !renderables.empty())
+    {
+        TMEMCPY(dst, renderables.data(), renderables.size_bytes());
+    }
+}
+
+void AddRenderableListener(RenderableListenerFunc func, void* userData)
+{
+    GetRegistry().renderableListeners.push_back({ func, userData });
+}
+
+void RemoveRenderableListener(RenderableListenerFunc func, void* userData)
+{
+    FixedGrowableArray<RenderableListener, 4>& listeners = GetRegistry().renderableListeners;
+    for (u32 i = 0; i < listeners.size; i++)
     {
-        if (!IsFlag(ent, EntityFlags::DISABLED) && ent.model.isValid())
+        if (listeners[i].func == func && listeners[i].userData == userData)
         {
-            if (dst)
-            {
-                dst[*numEntities] = ref;
-            }
-            (*numEntities)++;
+            listeners.erase(i);
+            return;
         }
     }
 }
@@ -183,8 +290,80 @@ void GetRenderableEntities(EntityRef* dst, u32* numEntities)
 void SetTransform(EntityRef ent, const Transform& tf)
 {
     EntityRegistry& registry = GetRegistry();
-    registry.entMap[ent].transform = tf;
+    if (Transform* entityTf = Ecs::GetComponent<Transform>(registry.world, ent))
+    {
+        *entityTf = tf;
+        registry.transforms.MarkDirty(ent);
+    }
 }
 
+bool SetParent(EntityRef child, EntityRef parent)
+{
+    return GetRegistry().transforms.SetParent(child, parent);
+}
 
-} // namespace Entity
\ No newline at end of file
+EntityRef GetParent(EntityRef ent)
+{
+    return GetRegistry().transforms.GetParent(ent);
+}
+
+void UpdateTransforms()
+{
+    PROFILE_FUNCTION();
+    EntityRegistry& registry = GetRegistry();
+    registry.transforms.UpdateWorldMatrices();
+    std::span<const EntityRef> moved = registry.transforms.GetUpdatedLastFrame();
+    // when a big part of the world moved (or just got loaded), updating the leaves and rebuilding the whole tree is
+    // cheaper than reinserting them one at a time, and makes a better tree too
+    bool rebuild = moved.size() >= BVH_ENTITY_REBUILD_MIN_MOVED && moved.size() * BVH_ENTITY_REBUILD_FRACTION >= registry.bvh.GetProxyCount();
+    for (EntityRef ent : moved)
+    {
+        const Ecs::EntityLocation& location = *Ecs::GetLocation(registry.world, ent);
+        // only entities made with CreateEntity go in the tree
+        EntityData* data = Ecs::GetComponent<EntityData>(location);
+        if (!data) continue;
+        BoundingBox worldBounds = TransformBounds(*Ecs::GetComponent<BoundingBox>(location), Ecs::GetComponent<WorldTransform>(location)->world);
+        if (data->bvhProxy == BVH_NULL_NODE)
+        {
+            data->bvhProxy = registry.bvh.CreateProxy(worldBounds, ent, rebuild);
+        }
+        else
+        {
+            registry.bvh.MoveProxy(data->bvhProxy, worldBounds, rebuild);
+        }
+    }
+    if (rebuild)
+    {
+        registry.bvh.Rebuild();
+    }
+}
+
+static const WorldTransform& GetWorldTransform(EntityRef ent)
+{
+    EntityRegistry& registry = GetRegistry();
+    WorldTransform* worldTf = Ecs::GetComponent<WorldTransform>(registry.world, ent);
+    return worldTf ? *worldTf : registry.invalidWorldTransform;
+}
+
+const glm::mat4& GetWorldMatrix(EntityRef ent)
+{
+    return GetWorldTransform(ent).world;
+}
+
+const glm::mat3& GetNormalMatrix(EntityRef ent)
+{
+    return GetWorldTransform(ent).normal;
+}
+
+
+} // namespace Entity
+
+Transform& EntityData::GetTransform() const
+{
+    return Entity::GetTransform(id);
+}
+
+BoundingBox& EntityData::GetBounds() const
+{
+    return Entity::GetBounds(id);
+}
\ No newline at end of file
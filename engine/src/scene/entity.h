@@ -4,6 +4,14 @@
 #include "tiny_defines.h"
 #include "render/model.h"
 #include "tiny_types.h"
+#include <span>
+#include "containers/hash_map.h"
+#include "containers/dynarray.h"
+#include "containers/fixed_growable_array.h"
+#include "scene/ecs.h"
+#include "scene/transform_hierarchy.h"
+#include "scene/bvh.h"
+#include "tiny_string_table.h"
 
 // "entities" are just renderable positions with a bounding box right now
 // made this mostly so I could have some engine-side notion of entities for experiments
@@ -12,33 +20,78 @@
 enum EntityFlags
 {
     DISABLED = 1,
+    // the renderer rasterizes its (low-poly) meshes into the CPU occlusion buffer to hide what's behind it
+    OCCLUDER,
 
     NUM_ENTITY_FLAGS,
 };
 STATIC_ASSERT(NUM_ENTITY_FLAGS < 32);
 
-typedef u32 EntityRef;
-#define ENTITY_NAME_MAX_LENGTH 50
+// the entity's id in the registry's ECS world. Stays a plain u32 so it can be passed around as an object id
+typedef Ecs::EntityId EntityRef;
+#define ENTITY_INVALID_REF ECS_INVALID_ENTITY
+// The cold part of an entity. Every entity also has a Transform (local, relative to its parent), a BoundingBox and the
+// TransformNode/WorldTransform pair from transform_hierarchy.h, stored apart from this (see ecs.h) so systems that only
+// need those don't drag models and names through the cache
 struct EntityData
 {
-    Transform transform = {};
-    Model model = {}; // TODO: "renderable" shouldn't hardcoded to Model... Sprites too? this is getting into ECS territory
-    BoundingBox bounds = {};
-    EntityRef id = U32_INVALID_ID;
+    Model model = {}; // TODO: "renderable" shouldn't hardcoded to Model... Sprites too?
+    EntityRef id = ENTITY_INVALID_REF;
     u32 flags = 0;
-    s8 name[ENTITY_NAME_MAX_LENGTH];
+    // where this entity sits in the registry's renderable list, U32_INVALID_ID if it isn't renderable
+    u32 renderableIndex = U32_INVALID_ID;
+    // interned in the engine string table, "" if the entity doesn't have a name
+    const char* name = "";
+    StringId nameId = STRING_ID_INVALID;
+    // this entity's leaf in the registry's bvh, BVH_NULL_NODE until its first UpdateTransforms
+    u32 bvhProxy = BVH_NULL_NODE;
     
     operator bool() { return isValid(); }
     EntityData() = default;
-    inline bool isValid() { return id != U32_INVALID_ID; }
+    inline bool isValid() const { return id != ENTITY_INVALID_REF; }
+    // the entity's other components. The invalid entity hands back dummies. Same as Entity::GetTransform, marks it moved
+    TAPI Transform& GetTransform() const;
+    TAPI BoundingBox& GetBounds() const;
 };
 
-typedef std::unordered_map<u32, EntityData> EntityMap;
+enum class RenderableChange
+{
+    ADDED,
+    REMOVED,
+    // still renderable, but with a different model
+    MODEL_CHANGED,
+};
+// called right after the renderable list changes. For REMOVED the entity is still alive, but no longer in the list
+typedef void (*RenderableListenerFunc)(EntityRef ent, RenderableChange change, void* userData);
+struct RenderableListener
+{
+    RenderableListenerFunc func = nullptr;
+    void* userData = nullptr;
+};
 
 struct EntityRegistry
 {
-    EntityMap entMap = {};
-    u32 entityCreationIndex = 0;
+    // every entity has Transform, BoundingBox and EntityData components. Systems can add their own and query for them
+    Ecs::World world;
+    // parent/child links and cached world matrices for every entity
+    TransformHierarchy transforms{world};
+    // world space bounds of every entity (BoundingBox through the world matrix), userData is the EntityRef.
+    // Refit for whatever UpdateTransforms recomputed
+    Bvh bvh;
+    // interned name -> entity, for GetEntity(name). Separate from entity ids, and ids of interned strings are unique so
+    // different names can't collide. If two entities share a name, the first one wins
+    HashMap<StringId, EntityRef> nameIndex = {};
+    // returned when a lookup fails, so callers can just check the result's isValid
+    EntityData invalidEntity = {};
+    Transform invalidTransform = {};
+    BoundingBox invalidBounds = {};
+    WorldTransform invalidWorldTransform = {};
+    // entities that have a model and aren't disabled. Kept up to date by the Entity functions that can change that,
+    // so nobody has to scan the whole world for them. Unordered, removal swaps the last one in
+    DynArray<EntityRef> renderables = {};
+    // bumped on every change to renderables, for caches that would rather poll than listen
+    u64 renderablesVersion = 0;
+    FixedGrowableArray<RenderableListener, 4> renderableListeners = {};
 };
 
 struct Arena;
@@ -52,20 +105,56 @@ TAPI EntityRef CreateEntity(
     const Transform& tf = {}, 
     u32 flags = 0);
 TAPI bool DestroyEntity(EntityRef ent);
+// refs to destroyed entities stop resolving (you get the invalid dummy back), even if the slot gets reused
+// references stay valid while other entities are created, but not across DestroyEntity
 TAPI EntityData& GetEntity(EntityRef ent);
-TAPI EntityData& GetEntity(const char* name);
+// literals are hashed at compile time: GetEntity("PondEntity"). Runtime strings need GetEntity(HashedString(name))
+TAPI EntityData& GetEntity(HashedString name);
+// local transform. Handing out a mutable ref counts as moving the entity, its world matrix gets recomputed on the next UpdateTransforms
+TAPI Transform& GetTransform(EntityRef ent);
+// local (model space) bounds. Like GetTransform, handing out a mutable ref counts as moving the entity
+TAPI BoundingBox& GetBounds(EntityRef ent);
+// bounds through the world matrix, as of the last UpdateTransforms
+TAPI BoundingBox GetWorldBounds(EntityRef ent);
+// every entity's world bounds as of the last UpdateTransforms, for culling/spatial queries. userData is the EntityRef.
+// Boxes in there are a bit bigger than the real ones (see Bvh), test GetWorldBounds if that matters.
+// Queries are safe from any number of job threads at once, as long as nothing calls UpdateTransforms/DestroyEntity meanwhile
+TAPI const Bvh& GetBvh();
+// closest entity whose world bounds the ray hits before maxT, ENTITY_INVALID_REF if none. outT (optional) is in units of dir
+TAPI EntityRef RaycastBounds(const glm::vec3& origin, const glm::vec3& dir, f32 maxT, f32* outT = nullptr);
+// for running queries over entities, or giving them extra components
+TAPI Ecs::World& GetWorld();
 
+// does nothing for invalid/stale entities
 TAPI void SetFlag(EntityRef ent, EntityFlags flag, bool enabled);
 TAPI void SetFlag(EntityData& ent, EntityFlags flag, bool enabled);
 TAPI bool IsFlag(EntityRef ent, EntityFlags flag);
 TAPI bool IsFlag(const EntityData& ent, EntityFlags flag);
 TAPI void SetTransform(EntityRef ent, const Transform& tf);
+// parent = ENTITY_INVALID_REF detaches it. The child's transform becomes relative to the parent. False if that would make a loop
+TAPI bool SetParent(EntityRef child, EntityRef parent);
+TAPI EntityRef GetParent(EntityRef ent);
+// recomputes world/normal matrices of entities that moved (and everything attached to them) and refits their world bounds
+// in the bvh. Once per frame, before rendering
+TAPI void UpdateTransforms();
+// as of the last UpdateTransforms
+TAPI const glm::mat4& GetWorldMatrix(EntityRef ent);
+TAPI const glm::mat3& GetNormalMatrix(EntityRef ent);
 TAPI bool HasRenderable(EntityRef ent);
 TAPI bool AddRenderable(EntityRef ent, const Model& model);
 TAPI void OverwriteRenderable(EntityRef ent, const Model& model);
+// Enabled entities with a valid model. No copy, but it's invalidated by anything that changes the set
+// (AddRenderable/OverwriteRenderable/DestroyEntity/SetFlag(DISABLED))
+// NOTE: assigning EntityData::model directly bypasses this, go through AddRenderable/OverwriteRenderable
+TAPI std::span<const EntityRef> GetRenderables();
+// changes every time the renderable set does
+TAPI u64 GetRenderablesVersion();
 // if dst is nullptr, this returns the *number* of renderable entities
 // if dst is not nullptr, we fill in the buffer
 TAPI void GetRenderableEntities(EntityRef* dst, u32* numEntities);
+// func gets called for every change to the renderable set, until it's removed
+TAPI void AddRenderableListener(RenderableListenerFunc func, void* userData = nullptr);
+TAPI void RemoveRenderableListener(RenderableListenerFunc func, void* userData = nullptr);
 
 } // namespace Entity
 
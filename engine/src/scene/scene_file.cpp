@@ -0,0 +1,491 @@
+//#include "pch.h"
+#include "scene_file.h"
+
+#include "camera.h"
+#include "tiny_log.h"
+#include "tiny_profiler.h"
+#include "mem/tiny_arena.h"
+
+// the engine's structs are laid out exactly like the .type files say, so they're copied in and out with a single memcpy.
+// If one of these goes off, either the struct or its .type changed. Things still work (member by member), just slower
+static_assert(Transform_MatchesLayout<Transform>());
+static_assert(BoundingBox_MatchesLayout<BoundingBox>());
+static_assert(Camera_MatchesLayout<Camera>());
+static_assert(sizeof(SceneEntityRecord) % 8 == 0 && sizeof(SceneFileHeader) % 8 == 0);
+
+static size_t AlignUp8(size_t value)
+{
+    return (value + 7) & ~(size_t)7;
+}
+
+template <typename T>
+static bool SerializeInto(u8* dst, size_t dstSize, T& value, void (*serialize)(SceneSerializer&, T&))
+{
+    SceneSerializer s = SceneSerializer::Writer(dst, dstSize);
+    serialize(s, value);
+    return !s.failed;
+}
+
+size_t WriteSceneFile(void* dst, size_t dstSize, std::span<const SceneEntityDesc> entities, const Camera* camera)
+{
+    PROFILE_FUNCTION();
+    size_t recordsOffset = sizeof(SceneFileHeader);
+    size_t stringsOffset = recordsOffset + entities.size() * sizeof(SceneEntityRecord);
+    size_t fileSize = stringsOffset;
+    for (const SceneEntityDesc& desc : entities)
+    {
+        fileSize += strlen(Entity::GetEntity(desc.entity).name) + 1;
+        fileSize += desc.modelPath ? strlen(desc.modelPath) + 1 : 0;
+    }
+    fileSize = AlignUp8(fileSize);
+    if (!dst) return fileSize;
+    if (dstSize < fileSize) return 0;
+
+    u8* file = (u8*)dst;
+    TMEMSET(file, 0, fileSize);
+    SceneFileHeader* header = (SceneFileHeader*)file;
+    header->magic = SCENE_FILE_MAGIC;
+    header->version = SCENE_FILE_VERSION;
+    header->fileSize = fileSize;
+    header->numEntities = (u32)entities.size();
+    header->entities.offset = recordsOffset;
+    if (camera)
+    {
+        Camera cam = *camera;
+        SerializeInto<Camera>(header->camera, sizeof(header->camera), cam, Camera_Serialize);
+        header->flags |= SCENE_FILE_HAS_CAMERA;
+    }
+
+    ArenaTemp scratch = scratch_begin();
+    {
+        // entity -> record index, for parent links
+        HashMap<EntityRef, u32> recordIndex(scratch.arena);
+        recordIndex.reserve((u32)entities.size());
+        for (u32 i = 0; i < entities.size(); i++)
+        {
+            recordIndex.try_emplace(entities[i].entity, i);
+        }
+
+        SceneEntityRecord* records = (SceneEntityRecord*)(file + recordsOffset);
+        size_t stringCursor = stringsOffset;
+        auto writeString = [&](const char* str) -> u64
+        {
+            size_t length = strlen(str) + 1;
+            TMEMCPY(file + stringCursor, str, length);
+            u64 offset = stringCursor;
+            stringCursor += length;
+            return offset;
+        };
+        for (u32 i = 0; i < entities.size(); i++)
+        {
+            const SceneEntityDesc& desc = entities[i];
+            const EntityData& ent = Entity::GetEntity(desc.entity);
+            SceneEntityRecord& record = records[i];
+            record.name.offset = writeString(ent.name);
+            record.modelPath.offset = desc.modelPath ? writeString(desc.modelPath) : 0;
+            const u32* parent = recordIndex.find(Entity::GetParent(desc.entity));
+            record.parent = parent ? *parent : U32_INVALID_ID;
+            record.flags = ent.flags;
+            Transform tf = ent.GetTransform();
+            BoundingBox bounds = ent.GetBounds();
+            SerializeInto<Transform>(record.transform, sizeof(record.transform), tf, Transform_Serialize);
+            SerializeInto<BoundingBox>(record.bounds, sizeof(record.bounds), bounds, BoundingBox_Serialize);
+        }
+    }
+    scratch_end(scratch);
+    return fileSize;
+}
+
+bool SaveScene(const char* filepath, std::span<const SceneEntityDesc> entities, const Camera* camera)
+{
+    size_t fileSize = WriteSceneFile(nullptr, 0, entities, camera);
+    ArenaTemp scratch = scratch_begin();
+    void* file = arena_alloc_aligned(scratch.arena, fileSize, 8);
+    bool success = WriteSceneFile(file, fileSize, entities, camera) == fileSize
+        && WriteEntireFileBinary(filepath, file, fileSize);
+    scratch_end(scratch);
+    return success;
+}
+
+// offset -> pointer, if it points at a null terminated string inside the file
+static bool PatchString(SceneFilePtr<const char>& str, u8* file, size_t size, bool optional)
+{
+    if (str.offset == 0)
+    {
+        str.ptr = nullptr;
+        return optional;
+    }
+    if (str.offset >= size || !memchr(file + str.offset, '\0', size - str.offset))
+    {
+        return false;
+    }
+    str.ptr = (const char*)(file + str.offset);
+    return true;
+}
+
+SceneFileHeader* PatchSceneFile(void* data, size_t size)
+{
+    PROFILE_FUNCTION();
+    u8* file = (u8*)data;
+    SceneFileHeader* header = (SceneFileHeader*)file;
+    if (!file || size < sizeof(SceneFileHeader) || ((uintptr_t)file & 7) != 0
+        || header->magic != SCENE_FILE_MAGIC || header->version != SCENE_FILE_VERSION)
+    {
+        LOG_ERROR("Not a scene file (or an old version)");
+        return nullptr;
+    }
+    if (header->flags & SCENE_FILE_PATCHED)
+    {
+        return header;
+    }
+    u64 numEntities = header->numEntities;
+    u64 recordsOffset = header->entities.offset;
+    if (header->fileSize != size || recordsOffset < sizeof(SceneFileHeader) || (recordsOffset & 7) != 0
+        || recordsOffset > size || numEntities > (size - recordsOffset) / sizeof(SceneEntityRecord))
+    {
+        LOG_ERROR("Scene file is truncated or corrupt");
+        return nullptr;
+    }
+    // validate everything before patching anything, a bad file is left as it was
+    SceneEntityRecord* records = (SceneEntityRecord*)(file + recordsOffset);
+    for (u64 i = 0; i < numEntities; i++)
+    {
+        SceneFilePtr<const char> name = records[i].name;
+        SceneFilePtr<const char> modelPath = records[i].modelPath;
+        if (!PatchString(name, file, size, false) || !PatchString(modelPath, file, size, true)
+            || (records[i].parent != U32_INVALID_ID && records[i].parent >= numEntities))
+        {
+            LOG_ERROR("Scene file entity %llu is corrupt", (unsigned long long)i);
+            return nullptr;
+        }
+    }
+    for (u64 i = 0; i < numEntities; i++)
+    {
+        PatchString(records[i].name, file, size, false);
+        PatchString(records[i].modelPath, file, size, true);
+    }
+    header->entities.ptr = records;
+    header->flags |= SCENE_FILE_PATCHED;
+    return header;
+}
+
+bool OpenSceneFile(const char* filepath, SceneFile* scene)
+{
+    *scene = SceneFile();
+    if (!MapFile(filepath, &scene->file))
+    {
+        return false;
+    }
+    scene->header = PatchSceneFile(scene->file.data, scene->file.size);
+    if (!scene->header)
+    {
+        LOG_ERROR("Failed to load scene %s", filepath);
+        CloseSceneFile(scene);
+        return false;
+    }
+    return true;
+}
+
+void CloseSceneFile(SceneFile* scene)
+{
+    UnmapFile(&scene->file);
+    scene->header = nullptr;
+}
+
+bool InstantiateScene(const SceneFileHeader* scene, EntityRef* outEntities, SceneModelLoadFunc loadModel, void* userData, Camera* camera)
+{
+    PROFILE_FUNCTION();
+    if (!scene || !(scene->flags & SCENE_FILE_PATCHED))
+    {
+        LOG_ERROR("Scene files have to go through PatchSceneFile before they can be instantiated");
+        return false;
+    }
+    const SceneEntityRecord* records = scene->entities.ptr;
+    u32 numEntities = scene->numEntities;
+    ArenaTemp scratch = scratch_begin();
+    EntityRef* created = outEntities ? outEntities : arena_alloc_type(scratch.arena, EntityRef, numEntities);
+    for (u32 i = 0; i < numEntities; i++)
+    {
+        const SceneEntityRecord& record = records[i];
+        Transform tf;
+        SceneSerializer transformReader = SceneSerializer::Reader(record.transform, sizeof(record.transform));
+        Transform_Serialize(transformReader, tf);
+        created[i] = Entity::CreateEntity(record.name.ptr, tf, record.flags);
+        SceneSerializer boundsReader = SceneSerializer::Reader(record.bounds, sizeof(record.bounds));
+        BoundingBox_Serialize(boundsReader, Entity::GetBounds(created[i]));
+    }
+    // parents might come after their children in the file, so links go in once everything exists
+    for (u32 i = 0; i < numEntities; i++)
+    {
+        if (records[i].parent != U32_INVALID_ID && !Entity::SetParent(created[i], created[records[i].parent]))
+        {
+            LOG_WARN("Scene entity %s can't be parented to %s, it would make a loop", records[i].name.ptr, records[records[i].parent].name.ptr);
+        }
+    }
+    if (loadModel)
+    {
+        for (u32 i = 0; i < numEntities; i++)
+        {
+            if (records[i].modelPath.ptr) loadModel(created[i], records[i].modelPath.ptr, userData);
+        }
+    }
+    if (camera && (scene->flags & SCENE_FILE_HAS_CAMERA))
+    {
+        SceneSerializer cameraReader = SceneSerializer::Reader(scene->camera, sizeof(scene->camera));
+        Camera_Serialize(cameraReader, *camera);
+    }
+    scratch_end(scratch);
+    return true;
+}
+
+bool LoadScene(const char* filepath, SceneModelLoadFunc loadModel, void* userData, Camera* camera)
+{
+    SceneFile scene;
+    if (!OpenSceneFile(filepath, &scene))
+    {
+        return false;
+    }
+    bool success = InstantiateScene(scene.header, nullptr, loadModel, userData, camera);
+    CloseSceneFile(&scene);
+    return success;
+}
+
+// ============ tests ============
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// nothing like the engine's structs (doubles, different order, bigger ints), so these only go through the generated
+// member by member path
+struct LooseVector3 { f64 z, y, x; };
+struct LooseTransform { f32 rotation; LooseVector3 rotationAxis, scale, position; u32 unrelated; };
+struct LooseCamera
+{
+    s64 projection;
+    u8 isSwivelable;
+    f64 FOV, nearClip, farClip, speed;
+    u64 screenWidth, screenHeight, minScreenWidth, maxScreenWidth, minScreenHeight, maxScreenHeight;
+    LooseVector3 cameraUp, cameraFront, cameraPos;
+};
+static_assert(!Transform_MatchesLayout<LooseTransform>() && !Camera_MatchesLayout<LooseCamera>());
+
+static bool TransformsEqual(const Transform& a, const Transform& b)
+{
+    return a.position == b.position && a.scale == b.scale && a.rotation == b.rotation && a.rotationAxis == b.rotationAxis;
+}
+
+static void CountModelLoads(EntityRef ent, const char* modelPath, void* userData)
+{
+    std::vector<std::string>& loaded = *(std::vector<std::string>*)userData;
+    loaded.push_back(std::string(Entity::GetEntity(ent).name) + ":" + modelPath);
+}
+
+void SceneFileTests()
+{
+    LOG_INFO("Running SceneFile tests...");
+    // ---- generated serializers
+    {
+        Transform tf = Transform(glm::vec3(1, -2, 3.5f), glm::vec3(0.5f, 2, 1), 1.25f, glm::vec3(1, 0, 0));
+        u8 fast[Transform_SERIALIZED_SIZE];
+        u8 slow[Transform_SERIALIZED_SIZE];
+        TINY_ASSERT(SerializeInto<Transform>(fast, sizeof(fast), tf, Transform_Serialize));
+        TINY_ASSERT(memcmp(fast, &tf, sizeof(tf)) == 0);
+        // read back through the slow path, then write that back out, should be byte for byte the same
+        LooseTransform loose = {};
+        SceneSerializer reader = SceneSerializer::Reader(fast, sizeof(fast));
+        Transform_Serialize(reader, loose);
+        TINY_ASSERT(!reader.failed && reader.cursor == reader.end);
+        TINY_ASSERT(loose.position.x == 1.0 && loose.position.z == 3.5 && loose.scale.x == 0.5 && loose.rotation == 1.25f && loose.rotationAxis.x == 1.0);
+        TINY_ASSERT(SerializeInto<LooseTransform>(slow, sizeof(slow), loose, Transform_Serialize));
+        TINY_ASSERT(memcmp(fast, slow, sizeof(fast)) == 0);
+        // too small to hold it
+        TINY_ASSERT(!SerializeInto<Transform>(fast, sizeof(fast) - 1, tf, Transform_Serialize));
+
+        // the camera has a bool + padding + an enum in it. The memcpy path copies the padding too, so start from zeroes
+        alignas(Camera) u8 camStorage[sizeof(Camera)] = {};
+        Camera& cam = *new(camStorage) Camera();
+        cam.cameraPos = glm::vec3(4, 5, 6);
+        cam.screenWidth = 1234;
+        cam.maxScreenHeight = 999;
+        cam.isSwivelable = true;
+        cam.projection = Camera::PERSPECTIVE;
+        cam.farClip = 500.0f;
+        u8 camFast[Camera_SERIALIZED_SIZE];
+        u8 camSlow[Camera_SERIALIZED_SIZE];
+        TINY_ASSERT(SerializeInto<Camera>(camFast, sizeof(camFast), cam, Camera_Serialize));
+        LooseCamera looseCam = {};
+        looseCam.projection = -1;
+        SceneSerializer camReader = SceneSerializer::Reader(camFast, sizeof(camFast));
+        Camera_Serialize(camReader, looseCam);
+        TINY_ASSERT(!camReader.failed && camReader.cursor == camReader.end);
+        TINY_ASSERT(looseCam.cameraPos.y == 5.0 && looseCam.screenWidth == 1234 && looseCam.maxScreenHeight == 999);
+        TINY_ASSERT(looseCam.isSwivelable == 1 && looseCam.projection == Camera::PERSPECTIVE && looseCam.farClip == 500.0);
+        // and back again, padding and all
+        TINY_ASSERT(SerializeInto<LooseCamera>(camSlow, sizeof(camSlow), looseCam, Camera_Serialize));
+        TINY_ASSERT(memcmp(camFast, camSlow, sizeof(camFast)) == 0);
+        Camera roundTrip;
+        SceneSerializer slowReader = SceneSerializer::Reader(camSlow, sizeof(camSlow));
+        Camera_Serialize(slowReader, roundTrip);
+        TINY_ASSERT(roundTrip.cameraPos == cam.cameraPos && roundTrip.screenWidth == 1234 && roundTrip.isSwivelable && roundTrip.projection == Camera::PERSPECTIVE);
+    }
+
+    // ---- save, then load into new entities
+    {
+        EntityRef root = Entity::CreateEntity("SceneTestRoot", Transform(glm::vec3(10, 0, 0)));
+        EntityRef child = Entity::CreateEntity("SceneTestChild", Transform(glm::vec3(0, 1, 0), glm::vec3(2), 0.5f));
+        EntityRef hidden = Entity::CreateEntity("", Transform(glm::vec3(0, 0, -3)));
+        Entity::SetFlag(hidden, EntityFlags::DISABLED, true);
+        EntityRef notSaved = Entity::CreateEntity("SceneTestNotSaved");
+        Entity::SetParent(child, root);
+        Entity::SetParent(root, notSaved);
+        Entity::GetBounds(child) = BoundingBox(glm::vec3(-1), glm::vec3(1, 2, 3));
+        // the child comes first on purpose
+        SceneEntityDesc descs[] = { {child, "models/child.obj"}, {root, "models/root.obj"}, {hidden, nullptr} };
+        Camera cam;
+        cam.cameraPos = glm::vec3(7, 8, 9);
+        cam.FOV = 60.0f;
+
+        std::string path = (std::filesystem::temp_directory_path() / "tiny_scene_file_test.tscn").string();
+        TINY_ASSERT(SaveScene(path.c_str(), descs, &cam));
+
+        // bad files are refused and left alone
+        size_t fileSize = WriteSceneFile(nullptr, 0, descs, &cam);
+        TINY_ASSERT(fileSize == GetFileSize(path.c_str()) && WriteSceneFile(nullptr, 0, descs, &cam) == fileSize);
+        std::vector<u64> buffer(fileSize / 8);
+        TINY_ASSERT(WriteSceneFile(buffer.data(), fileSize - 1, descs, &cam) == 0);
+        TINY_ASSERT(WriteSceneFile(buffer.data(), fileSize, descs, &cam) == fileSize);
+        std::vector<u64> onDisk(fileSize / 8);
+        TINY_ASSERT(ReadFileContentsBinary(path.c_str(), onDisk.data(), fileSize) && onDisk == buffer);
+        std::vector<u64> corrupt = buffer;
+        TINY_ASSERT(!PatchSceneFile(corrupt.data(), fileSize - 8));
+        ((SceneFileHeader*)corrupt.data())->magic = 0;
+        TINY_ASSERT(!PatchSceneFile(corrupt.data(), fileSize));
+        corrupt = buffer;
+        ((SceneFileHeader*)corrupt.data())->numEntities = 1000;
+        TINY_ASSERT(!PatchSceneFile(corrupt.data(), fileSize));
+        corrupt = buffer;
+        SceneEntityRecord* corruptRecords = (SceneEntityRecord*)((u8*)corrupt.data() + sizeof(SceneFileHeader));
+        corruptRecords[2].parent = 3;
+        TINY_ASSERT(!PatchSceneFile(corrupt.data(), fileSize));
+        corruptRecords[2].parent = U32_INVALID_ID;
+        corruptRecords[1].modelPath.offset = fileSize;
+        TINY_ASSERT(!PatchSceneFile(corrupt.data(), fileSize));
+        TINY_ASSERT(corruptRecords[0].name.offset != 0 && !(((SceneFileHeader*)corrupt.data())->flags & SCENE_FILE_PATCHED));
+        // no terminator before the end of the file
+        corrupt = buffer;
+        TMEMSET((u8*)corrupt.data() + fileSize - 16, 'a', 16);
+        TINY_ASSERT(!PatchSceneFile(corrupt.data(), fileSize));
+        // patching twice is fine
+        SceneFileHeader* patched = PatchSceneFile(buffer.data(), fileSize);
+        TINY_ASSERT(patched && PatchSceneFile(buffer.data(), fileSize) == patched);
+        TINY_ASSERT(strcmp(patched->entities.ptr[0].name.ptr, "SceneTestChild") == 0 && patched->entities.ptr[2].modelPath.ptr == nullptr);
+
+        SceneFile scene;
+        TINY_ASSERT(OpenSceneFile(path.c_str(), &scene));
+        TINY_ASSERT(scene.header->numEntities == 3 && (scene.header->flags & SCENE_FILE_HAS_CAMERA));
+        EntityRef loaded[3];
+        std::vector<std::string> modelLoads;
+        Camera loadedCam;
+        TINY_ASSERT(InstantiateScene(scene.header, loaded, CountModelLoads, &modelLoads, &loadedCam));
+        CloseSceneFile(&scene);
+        std::filesystem::remove(path);
+
+        TINY_ASSERT(modelLoads.size() == 2 && modelLoads[0] == "SceneTestChild:models/child.obj" && modelLoads[1] == "SceneTestRoot:models/root.obj");
+        TINY_ASSERT(loadedCam.cameraPos == cam.cameraPos && loadedCam.FOV == 60.0f && loadedCam.projection == cam.projection);
+        // names were interned, they outlive the file
+        TINY_ASSERT(strcmp(Entity::GetEntity(loaded[0]).name, "SceneTestChild") == 0 && Entity::GetEntity(loaded[2]).name[0] == '\0');
+        TINY_ASSERT(TransformsEqual(Entity::GetTransform(loaded[0]), Entity::GetTransform(child)));
+        TINY_ASSERT(TransformsEqual(Entity::GetTransform(loaded[1]), Entity::GetTransform(root)));
+        TINY_ASSERT(Entity::GetBounds(loaded[0]).min == glm::vec3(-1) && Entity::GetBounds(loaded[0]).max == glm::vec3(1, 2, 3));
+        TINY_ASSERT(Entity::IsFlag(loaded[2], EntityFlags::DISABLED) && !Entity::IsFlag(loaded[1], EntityFlags::DISABLED));
+        // the parent that wasn't saved is gone, so the loaded root is a root
+        TINY_ASSERT(Entity::GetParent(loaded[0]) == loaded[1] && Entity::GetParent(loaded[1]) == ENTITY_INVALID_REF);
+        Entity::SetParent(root, ENTITY_INVALID_REF);
+        Entity::UpdateTransforms();
+        TINY_ASSERT(Entity::GetWorldMatrix(loaded[0]) == Entity::GetWorldMatrix(child));
+
+        for (EntityRef ent : loaded) Entity::DestroyEntity(ent);
+        for (EntityRef ent : {child, root, hidden, notSaved}) Entity::DestroyEntity(ent);
+    }
+    LOG_INFO("SceneFile tests passed");
+}
+
+template <typename Func>
+static f64 TimeMs(Func func)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    func();
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<f64, std::milli>(end - start).count();
+}
+
+void SceneFileBenchmarks()
+{
+    LOG_INFO("Running SceneFile benchmarks...");
+    constexpr u32 numEntities = 100000;
+    // every 4th entity is a root, the rest hang off the root before them
+    std::vector<std::string> names(numEntities);
+    std::vector<Transform> transforms(numEntities);
+    for (u32 i = 0; i < numEntities; i++)
+    {
+        names[i] = "bench_entity_" + std::to_string(i);
+        transforms[i] = Transform(glm::vec3((f32)(i % 100), (f32)(i / 100 % 100), (f32)(i / 10000)), glm::vec3(1), 0.1f * (i % 7));
+    }
+    std::vector<EntityRef> fromCode(numEntities);
+    f64 codeMs = TimeMs([&]() {
+        for (u32 i = 0; i < numEntities; i++)
+        {
+            fromCode[i] = Entity::CreateEntity(names[i].c_str(), transforms[i]);
+            Entity::GetBounds(fromCode[i]) = BoundingBox(glm::vec3(-1), glm::vec3(1));
+            if (i % 4) Entity::SetParent(fromCode[i], fromCode[i - i % 4]);
+        }
+    });
+
+    std::vector<SceneEntityDesc> descs(numEntities);
+    for (u32 i = 0; i < numEntities; i++) descs[i].entity = fromCode[i];
+    std::string path = (std::filesystem::temp_directory_path() / "tiny_scene_file_bench.tscn").string();
+    f64 saveMs = TimeMs([&]() { TINY_ASSERT(SaveScene(path.c_str(), descs)); });
+
+    SceneFile scene;
+    f64 openMs = TimeMs([&]() { TINY_ASSERT(OpenSceneFile(path.c_str(), &scene)); });
+    std::vector<EntityRef> fromFile(numEntities);
+    f64 instantiateMs = TimeMs([&]() { TINY_ASSERT(InstantiateScene(scene.header, fromFile.data())); });
+    TINY_ASSERT(TransformsEqual(Entity::GetTransform(fromFile[numEntities - 1]), transforms[numEntities - 1]));
+    TINY_ASSERT(Entity::GetParent(fromFile[numEntities - 1]) == fromFile[numEntities - 4]);
+
+    // just the transforms, straight memcpy vs the member by member path the generated code falls back to
+    std::vector<Transform> decoded(numEntities);
+    std::vector<LooseTransform> decodedLoose(numEntities);
+    const SceneEntityRecord* records = scene.header->entities.ptr;
+    f64 memcpyMs = TimeMs([&]() {
+        for (u32 i = 0; i < numEntities; i++)
+        {
+            SceneSerializer s = SceneSerializer::Reader(records[i].transform, sizeof(records[i].transform));
+            Transform_Serialize(s, decoded[i]);
+        }
+    });
+    f64 memberMs = TimeMs([&]() {
+        for (u32 i = 0; i < numEntities; i++)
+        {
+            SceneSerializer s = SceneSerializer::Reader(records[i].transform, sizeof(records[i].transform));
+            Transform_Serialize(s, decodedLoose[i]);
+        }
+    });
+    TINY_ASSERT(decoded[numEntities - 1].position.x == (f32)decodedLoose[numEntities - 1].position.x);
+    size_t fileSize = scene.file.size;
+    CloseSceneFile(&scene);
+    std::filesystem::remove(path);
+
+    LOG_INFO("[SCENEFILE] %u entities (%.2f MB file) | built in code: %7.2f ms | save: %7.2f ms",
+        numEntities, fileSize / (1024.0 * 1024.0), codeMs, saveMs);
+    LOG_INFO("[SCENEFILE] load | map + patch: %6.2f ms | create entities: %7.2f ms | total: %7.2f ms | %.2fx vs code",
+        openMs, instantiateMs, openMs + instantiateMs, codeMs / (openMs + instantiateMs));
+    LOG_INFO("[SCENEFILE] decode %u transforms | memcpy: %6.3f ms | member by member: %6.3f ms | %.2fx",
+        numEntities, memcpyMs, memberMs, memberMs / memcpyMs);
+
+    for (EntityRef ent : fromFile) Entity::DestroyEntity(ent);
+    for (EntityRef ent : fromCode) Entity::DestroyEntity(ent);
+    LOG_INFO("SceneFile benchmarks complete");
+}
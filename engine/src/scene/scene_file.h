@@ -0,0 +1,179 @@
+#ifndef TINY_SCENE_FILE_H
+#define TINY_SCENE_FILE_H
+
+#include <span>
+#include <type_traits>
+#include "tiny_defines.h"
+#include "tiny_fs.h"
+#include "scene/entity.h"
+// generated from types/types/engine/*.type by the types build
+#include "engine/transform.type.serialize.h"
+#include "engine/camera.type.serialize.h"
+
+// Binary scene files, laid out so loading is: map the file, patch it in place, create the entities.
+// There's no parsing. Anything that would be a pointer is stored as a byte offset from the start of the file (0 = null),
+// and PatchSceneFile overwrites each offset with the pointer it stands for, in the (copy on write) mapped memory.
+// Transforms, bounds and the camera are stored in the layouts described by the .type files and go through the generated
+// X_Serialize functions. The engine structs match those layouts, so each one is a single memcpy
+//
+// file:  SceneFileHeader | SceneEntityRecord[numEntities] | null terminated strings
+
+#define SCENE_FILE_MAGIC 0x4E435354 // "TSCN"
+#define SCENE_FILE_VERSION 1
+
+// offsets get replaced by pointers in place, so they have to be the same size
+STATIC_ASSERT(sizeof(void*) == sizeof(u64));
+
+template <typename T>
+union SceneFilePtr
+{
+    u64 offset;
+    T* ptr;
+};
+
+enum SceneFileFlags
+{
+    SCENE_FILE_HAS_CAMERA = 1,
+    // offsets have been turned into pointers. Only ever set in memory, never in a file on disk
+    SCENE_FILE_PATCHED = 2,
+};
+
+struct SceneEntityRecord
+{
+    SceneFilePtr<const char> name;
+    // whatever was passed to SaveScene for this entity. null if it doesn't have a model
+    SceneFilePtr<const char> modelPath;
+    // index of the parent's record, U32_INVALID_ID for roots
+    u32 parent;
+    // EntityFlags
+    u32 flags;
+    // local Transform/BoundingBox in their serialized layouts
+    u8 transform[Transform_SERIALIZED_SIZE];
+    u8 bounds[BoundingBox_SERIALIZED_SIZE];
+};
+
+struct SceneFileHeader
+{
+    u32 magic;
+    u32 version;
+    u64 fileSize;
+    // SceneFileFlags
+    u32 flags;
+    u32 numEntities;
+    SceneFilePtr<SceneEntityRecord> entities;
+    u8 camera[Camera_SERIALIZED_SIZE];
+};
+
+// what the generated X_Serialize functions read/write through. One serializer either reads a blob into structs or
+// writes structs into a blob. Runs out = failed, nothing past the end is touched
+struct SceneSerializer
+{
+    u8* cursor = nullptr;
+    u8* end = nullptr;
+    bool writing = false;
+    bool failed = false;
+
+    static SceneSerializer Reader(const void* data, size_t size) { return { (u8*)data, (u8*)data + size, false }; }
+    static SceneSerializer Writer(void* data, size_t size) { return { (u8*)data, (u8*)data + size, true }; }
+
+    inline u8* Advance(size_t size)
+    {
+        if (failed || (size_t)(end - cursor) < size)
+        {
+            failed = true;
+            return nullptr;
+        }
+        u8* at = cursor;
+        cursor += size;
+        return at;
+    }
+    inline void Bytes(void* data, size_t size)
+    {
+        if (u8* at = Advance(size))
+        {
+            writing ? TMEMCPY(at, data, size) : TMEMCPY(data, at, size);
+        }
+    }
+    inline void Pad(size_t size)
+    {
+        u8* at = Advance(size);
+        if (at && writing) TMEMSET(at, 0, size);
+    }
+    // integers/bools/enums, converting between the member's size and the serialized one. Little endian, like everything we run on
+    template <typename M>
+    inline void Int(M& member, size_t size)
+    {
+        u64 value = writing ? (u64)member : 0;
+        Bytes(&value, size);
+        if (writing) return;
+        if constexpr (std::is_signed_v<M>)
+        {
+            u32 shift = 64 - (u32)size * 8;
+            value = shift < 64 ? (u64)((s64)(value << shift) >> shift) : value;
+        }
+        member = (M)value;
+    }
+    template <typename M>
+    inline void Float(M& member, size_t size)
+    {
+        if (size == sizeof(f32))
+        {
+            f32 value = (f32)member;
+            Bytes(&value, size);
+            if (!writing) member = (M)value;
+        }
+        else
+        {
+            f64 value = (f64)member;
+            Bytes(&value, size);
+            if (!writing) member = (M)value;
+        }
+    }
+};
+
+struct Camera;
+
+struct SceneEntityDesc
+{
+    EntityRef entity = ENTITY_INVALID_REF;
+    // handed back to the SceneModelLoadFunc on load, nullptr for entities without a model
+    const char* modelPath = nullptr;
+};
+
+// if dst is nullptr, this returns the size the file needs
+// otherwise writes the file into dst and returns its size, or 0 if dstSize is too small
+// Parent links are kept between entities that are both in the list, entities whose parent isn't in it get saved as roots
+// (with their local transform). camera is optional
+TAPI size_t WriteSceneFile(void* dst, size_t dstSize, std::span<const SceneEntityDesc> entities, const Camera* camera = nullptr);
+TAPI bool SaveScene(const char* filepath, std::span<const SceneEntityDesc> entities, const Camera* camera = nullptr);
+
+// checks a scene file in memory and turns its offsets into pointers, in place. nullptr if it isn't a valid scene file
+// Patching an already patched file just hands back its header
+TAPI SceneFileHeader* PatchSceneFile(void* data, size_t size);
+
+// a mapped + patched scene file. Strings point into the mapping, so they die with CloseSceneFile
+struct SceneFile
+{
+    MappedFile file = {};
+    SceneFileHeader* header = nullptr;
+};
+TAPI bool OpenSceneFile(const char* filepath, SceneFile* scene);
+TAPI void CloseSceneFile(SceneFile* scene);
+
+// called for every entity that was saved with a model path, after all the entities exist. Loading models needs shaders and
+// materials the scene file doesn't know about, so that's left to the game
+typedef void (*SceneModelLoadFunc)(EntityRef ent, const char* modelPath, void* userData);
+// creates one entity per record, with its transform/bounds/flags/parent. Names are interned, so nothing points into the
+// file afterwards. outEntities (optional) gets the new entities, in record order, and needs room for numEntities of them.
+// If the file has a camera and camera isn't nullptr, it's overwritten with the saved one
+TAPI bool InstantiateScene(const SceneFileHeader* scene, EntityRef* outEntities = nullptr,
+    SceneModelLoadFunc loadModel = nullptr, void* userData = nullptr, Camera* camera = nullptr);
+// OpenSceneFile + InstantiateScene + CloseSceneFile
+TAPI bool LoadScene(const char* filepath, SceneModelLoadFunc loadModel = nullptr, void* userData = nullptr, Camera* camera = nullptr);
+
+// generated serializers on the engine types (both paths), save -> load round trips, corrupt files
+TAPI void SceneFileTests();
+// loading a scene from a file vs building the same scene in code, memcpy vs member by member serialization
+TAPI void SceneFileBenchmarks();
+
+#endif
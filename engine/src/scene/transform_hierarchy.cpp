@@ -0,0 +1,465 @@
+//#include "pch.h"
+#include "transform_hierarchy.h"
+
+#include "job_system.h"
+#include "tiny_log.h"
+#include "tiny_profiler.h"
+#include <glm/gtc/matrix_inverse.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+using Ecs::EntityId;
+
+// levels smaller than this aren't worth handing out to the job system
+#define TRANSFORM_PARALLEL_MIN_LEVEL_SIZE 2048
+#define TRANSFORM_PARALLEL_GRAIN_SIZE 512
+
+void TransformHierarchy::AddNode(EntityId entity)
+{
+    TINY_ASSERT(Ecs::HasComponent<Transform>(*world, entity) && "Transform hierarchy nodes need a Transform");
+    if (!Ecs::HasComponent<TransformNode>(*world, entity))
+    {
+        Ecs::AddComponent<TransformNode>(*world, entity);
+        Ecs::AddComponent<WorldTransform>(*world, entity);
+    }
+    MarkDirty(entity);
+}
+
+void TransformHierarchy::UnlinkFromParent(TransformNode* node)
+{
+    if (node->prevSibling != ECS_INVALID_ENTITY)
+    {
+        Ecs::GetComponent<TransformNode>(*world, node->prevSibling)->nextSibling = node->nextSibling;
+    }
+    else if (node->parent != ECS_INVALID_ENTITY)
+    {
+        Ecs::GetComponent<TransformNode>(*world, node->parent)->firstChild = node->nextSibling;
+    }
+    if (node->nextSibling != ECS_INVALID_ENTITY)
+    {
+        Ecs::GetComponent<TransformNode>(*world, node->nextSibling)->prevSibling = node->prevSibling;
+    }
+    node->parent = node->prevSibling = node->nextSibling = ECS_INVALID_ENTITY;
+}
+
+// from the local transforms rather than the cached matrices, which may be stale
+static glm::mat4 ComputeWorldMatrix(Ecs::World& world, EntityId entity)
+{
+    glm::mat4 result = glm::mat4(1);
+    for (EntityId node = entity; node != ECS_INVALID_ENTITY; node = Ecs::GetComponent<TransformNode>(world, node)->parent)
+    {
+        result = Ecs::GetComponent<Transform>(world, node)->ToModelMatrix() * result;
+    }
+    return result;
+}
+
+// inverse of Transform::ToModelMatrix (translate * scale * rotate). Transform can't represent shear,
+// so a matrix made from a non-uniformly scaled parent and a rotated child only comes back approximately.
+// Returns false (and leaves result alone) if the matrix is scaled to nothing along some axis, there's no rotation to recover
+static bool TransformFromMatrix(const glm::mat4& mat, Transform& result)
+{
+    glm::mat3 scaleRotation = glm::mat3(mat);
+    // scale is applied after the rotation, so it's the length of each row
+    glm::mat3 rows = glm::transpose(scaleRotation);
+    glm::vec3 scale = glm::vec3(glm::length(rows[0]), glm::length(rows[1]), glm::length(rows[2]));
+    if (scale.x < 1e-6f || scale.y < 1e-6f || scale.z < 1e-6f)
+    {
+        return false;
+    }
+    if (glm::determinant(scaleRotation) < 0.0f)
+    {
+        scale.x = -scale.x;
+    }
+    glm::mat3 rotation = glm::transpose(glm::mat3(rows[0] / scale.x, rows[1] / scale.y, rows[2] / scale.z));
+    glm::quat q = glm::normalize(glm::quat_cast(rotation));
+    result = Transform(glm::vec3(mat[3]), scale, glm::degrees(glm::angle(q)), glm::axis(q));
+    return true;
+}
+
+void TransformHierarchy::UnlinkNode(EntityId entity)
+{
+    TransformNode* node = Ecs::GetComponent<TransformNode>(*world, entity);
+    if (!node) return;
+    glm::mat4 nodeWorld = ComputeWorldMatrix(*world, entity);
+    UnlinkFromParent(node);
+    while (node->firstChild != ECS_INVALID_ENTITY)
+    {
+        // bake where the child is in the world into its local transform, so it doesn't jump once it's a root.
+        // Under a zero scale parent it was collapsed to a point anyway, so it just keeps its local transform
+        EntityId child = node->firstChild;
+        Transform* childLocal = Ecs::GetComponent<Transform>(*world, child);
+        glm::mat4 childWorld = nodeWorld * childLocal->ToModelMatrix();
+        SetParent(child, ECS_INVALID_ENTITY);
+        TransformFromMatrix(childWorld, *childLocal);
+        MarkDirty(child);
+    }
+}
+
+void TransformHierarchy::RemoveNode(EntityId entity)
+{
+    if (!Ecs::HasComponent<TransformNode>(*world, entity)) return;
+    UnlinkNode(entity);
+    Ecs::RemoveComponent<TransformNode>(*world, entity);
+    Ecs::RemoveComponent<WorldTransform>(*world, entity);
+}
+
+bool TransformHierarchy::SetParent(EntityId child, EntityId parent)
+{
+    TransformNode* childNode = Ecs::GetComponent<TransformNode>(*world, child);
+    if (!childNode) return false;
+    TransformNode* parentNode = nullptr;
+    if (parent != ECS_INVALID_ENTITY)
+    {
+        parentNode = Ecs::GetComponent<TransformNode>(*world, parent);
+        if (!parentNode) return false;
+        // parenting something to its own descendant would make a loop
+        for (EntityId ancestor = parent; ancestor != ECS_INVALID_ENTITY; ancestor = Ecs::GetComponent<TransformNode>(*world, ancestor)->parent)
+        {
+            if (ancestor == child)
+            {
+                LOG_ERROR("Can't parent a transform to one of its own children");
+                return false;
+            }
+        }
+    }
+    UnlinkFromParent(childNode);
+    if (parentNode)
+    {
+        childNode->parent = parent;
+        childNode->nextSibling = parentNode->firstChild;
+        if (parentNode->firstChild != ECS_INVALID_ENTITY)
+        {
+            Ecs::GetComponent<TransformNode>(*world, parentNode->firstChild)->prevSibling = child;
+        }
+        parentNode->firstChild = child;
+    }
+    // depths are kept right at all times, so updates can sort by them without walking up to the root
+    u32 depthDelta = (parentNode ? parentNode->depth + 1 : 0) - childNode->depth;
+    stack.clear();
+    stack.push_back(child);
+    while (!stack.empty())
+    {
+        TransformNode* node = Ecs::GetComponent<TransformNode>(*world, stack.pop_back());
+        node->depth += depthDelta;
+        for (EntityId c = node->firstChild; c != ECS_INVALID_ENTITY; c = Ecs::GetComponent<TransformNode>(*world, c)->nextSibling)
+        {
+            stack.push_back(c);
+        }
+    }
+    MarkDirty(child);
+    return true;
+}
+
+EntityId TransformHierarchy::GetParent(EntityId entity)
+{
+    TransformNode* node = Ecs::GetComponent<TransformNode>(*world, entity);
+    return node ? node->parent : ECS_INVALID_ENTITY;
+}
+
+void TransformHierarchy::MarkDirty(EntityId entity)
+{
+    TransformNode* node = Ecs::GetComponent<TransformNode>(*world, entity);
+    if (node && !(node->flags & TRANSFORM_NODE_DIRTY))
+    {
+        node->flags |= TRANSFORM_NODE_DIRTY;
+        dirty.push_back(entity);
+    }
+}
+
+static void UpdateNodeMatrices(const Transform& local, const WorldTransform* parentWorld, WorldTransform& world, TransformNode& node)
+{
+    glm::mat4 localMat = local.ToModelMatrix();
+    // parents are always a level ahead, so theirs is already up to date
+    world.world = parentWorld ? parentWorld->world * localMat : localMat;
+    world.normal = glm::inverseTranspose(glm::mat3(world.world));
+    node.flags &= ~(TRANSFORM_NODE_DIRTY | TRANSFORM_NODE_QUEUED);
+}
+
+void TransformHierarchy::UpdateWorldMatrices(bool parallel)
+{
+    PROFILE_FUNCTION();
+    // gather dirty nodes and their subtrees. A queued node's whole subtree is already queued, so we can stop there
+    queued.clear();
+    updated.clear();
+    u32 maxDepth = 0;
+    for (EntityId root : dirty)
+    {
+        Ecs::EntityLocation* rootLocation = Ecs::GetLocation(*world, root);
+        // destroyed since it was marked
+        if (!rootLocation) continue;
+        TransformNode* rootNode = Ecs::GetComponent<TransformNode>(*rootLocation);
+        if (!rootNode || (rootNode->flags & TRANSFORM_NODE_QUEUED)) continue;
+        const WorldTransform* rootParentWorld = rootNode->parent == ECS_INVALID_ENTITY ? nullptr : Ecs::GetComponent<WorldTransform>(*world, rootNode->parent);
+        pending.clear();
+        pending.push_back({ root, rootParentWorld });
+        while (!pending.empty())
+        {
+            PendingNode next = pending.pop_back();
+            const Ecs::EntityLocation& location = *Ecs::GetLocation(*world, next.entity);
+            TransformNode* node = Ecs::GetComponent<TransformNode>(location);
+            if (node->flags & TRANSFORM_NODE_QUEUED) continue;
+            node->flags |= TRANSFORM_NODE_QUEUED;
+            WorldTransform* worldTf = Ecs::GetComponent<WorldTransform>(location);
+            queued.push_back({ Ecs::GetComponent<Transform>(location), next.parentWorld, worldTf, node });
+            updated.push_back(next.entity);
+            maxDepth = node->depth > maxDepth ? node->depth : maxDepth;
+            for (EntityId c = node->firstChild; c != ECS_INVALID_ENTITY; c = Ecs::GetComponent<TransformNode>(*world, c)->nextSibling)
+            {
+                pending.push_back({ c, worldTf });
+            }
+        }
+    }
+    dirty.clear();
+    numUpdatedLastFrame = queued.size();
+    if (queued.empty()) return;
+
+    // counting sort by depth
+    levelStart.resize(maxDepth + 2);
+    TMEMSET(levelStart.data(), 0, sizeof(u32) * levelStart.size());
+    for (const QueuedNode& queuedNode : queued)
+    {
+        levelStart[queuedNode.node->depth + 1]++;
+    }
+    for (u32 level = 1; level < levelStart.size(); level++)
+    {
+        levelStart[level] += levelStart[level - 1];
+    }
+    sorted.resize(queued.size());
+    for (const QueuedNode& queuedNode : queued)
+    {
+        // levelStart[depth] walks forward as the level gets filled, and ends up at the start of the next level
+        sorted[levelStart[queuedNode.node->depth]++] = queuedNode;
+    }
+
+    u32 levelBegin = 0;
+    for (u32 level = 0; level <= maxDepth; level++)
+    {
+        u32 levelEnd = levelStart[level];
+        if (parallel && levelEnd - levelBegin >= TRANSFORM_PARALLEL_MIN_LEVEL_SIZE)
+        {
+            // only reads parents (previous level) and writes this level's own components
+            QueuedNode* levelNodes = sorted.data();
+            JobSystem::Instance().ParallelFor(levelBegin, levelEnd, TRANSFORM_PARALLEL_GRAIN_SIZE, [levelNodes](u32 i) {
+                const QueuedNode& n = levelNodes[i];
+                UpdateNodeMatrices(*n.local, n.parentWorld, *n.world, *n.node);
+            });
+        }
+        else
+        {
+            for (u32 i = levelBegin; i < levelEnd; i++)
+            {
+                const QueuedNode& n = sorted[i];
+                UpdateNodeMatrices(*n.local, n.parentWorld, *n.world, *n.node);
+            }
+        }
+        levelBegin = levelEnd;
+    }
+}
+
+// ============ tests ============
+
+#include <chrono>
+#include <vector>
+
+static bool MatricesMatch(const glm::mat4& a, const glm::mat4& b)
+{
+    for (u32 col = 0; col < 4; col++)
+        for (u32 row = 0; row < 4; row++)
+            if (glm::abs(a[col][row] - b[col][row]) > 0.001f) return false;
+    return true;
+}
+
+static EntityId CreateNode(Ecs::World& world, TransformHierarchy& hierarchy, const Transform& tf, EntityId parent = ECS_INVALID_ENTITY)
+{
+    EntityId entity = Ecs::CreateEntity(world, Transform(tf), TransformNode(), WorldTransform());
+    hierarchy.MarkDirty(entity);
+    if (parent != ECS_INVALID_ENTITY) hierarchy.SetParent(entity, parent);
+    return entity;
+}
+
+static const glm::mat4& WorldOf(Ecs::World& world, EntityId entity)
+{
+    return Ecs::GetComponent<WorldTransform>(world, entity)->world;
+}
+
+void TransformHierarchyTests()
+{
+    LOG_INFO("Running TransformHierarchy tests...");
+    Ecs::World world;
+    TransformHierarchy hierarchy(world);
+    Transform rootTf = Transform(glm::vec3(10, 0, 0), glm::vec3(2), 90.0f, glm::vec3(0, 1, 0));
+    Transform childTf = Transform(glm::vec3(0, 5, 0), glm::vec3(1), 45.0f, glm::vec3(1, 0, 0));
+    Transform grandchildTf = Transform(glm::vec3(1, 1, 1));
+    EntityId root = CreateNode(world, hierarchy, rootTf);
+    EntityId child = CreateNode(world, hierarchy, childTf, root);
+    EntityId grandchild = CreateNode(world, hierarchy, grandchildTf, child);
+    EntityId other = CreateNode(world, hierarchy, Transform(glm::vec3(-3, 0, 0)));
+    hierarchy.UpdateWorldMatrices(false);
+    TINY_ASSERT(hierarchy.numUpdatedLastFrame == 4);
+    TINY_ASSERT(MatricesMatch(WorldOf(world, root), rootTf.ToModelMatrix()));
+    TINY_ASSERT(MatricesMatch(WorldOf(world, child), rootTf.ToModelMatrix() * childTf.ToModelMatrix()));
+    TINY_ASSERT(MatricesMatch(WorldOf(world, grandchild), rootTf.ToModelMatrix() * childTf.ToModelMatrix() * grandchildTf.ToModelMatrix()));
+    glm::mat3 expectedNormal = glm::transpose(glm::inverse(glm::mat3(WorldOf(world, grandchild))));
+    TINY_ASSERT(MatricesMatch(glm::mat4(Ecs::GetComponent<WorldTransform>(world, grandchild)->normal), glm::mat4(expectedNormal)));
+    TINY_ASSERT(Ecs::GetComponent<TransformNode>(world, grandchild)->depth == 2);
+
+    // nothing moved, nothing to do
+    hierarchy.UpdateWorldMatrices(false);
+    TINY_ASSERT(hierarchy.numUpdatedLastFrame == 0);
+    // moving the root drags the subtree along, but not unrelated nodes. Marking twice/marking children too doesn't double up
+    Ecs::GetComponent<Transform>(world, root)->position.y = 7.0f;
+    rootTf.position.y = 7.0f;
+    hierarchy.MarkDirty(grandchild);
+    hierarchy.MarkDirty(root);
+    hierarchy.MarkDirty(root);
+    hierarchy.UpdateWorldMatrices(false);
+    TINY_ASSERT(hierarchy.numUpdatedLastFrame == 3);
+    TINY_ASSERT(MatricesMatch(WorldOf(world, grandchild), rootTf.ToModelMatrix() * childTf.ToModelMatrix() * grandchildTf.ToModelMatrix()));
+
+    // reparenting moves the whole subtree and fixes up depths
+    TINY_ASSERT(hierarchy.SetParent(child, other) && hierarchy.GetParent(child) == other);
+    hierarchy.UpdateWorldMatrices(false);
+    TINY_ASSERT(Ecs::GetComponent<TransformNode>(world, grandchild)->depth == 2);
+    glm::mat4 otherMat = Transform(glm::vec3(-3, 0, 0)).ToModelMatrix();
+    TINY_ASSERT(MatricesMatch(WorldOf(world, grandchild), otherMat * childTf.ToModelMatrix() * grandchildTf.ToModelMatrix()));
+    // loops are refused
+    TINY_ASSERT(!hierarchy.SetParent(other, grandchild) && hierarchy.GetParent(other) == ECS_INVALID_ENTITY);
+    TINY_ASSERT(!hierarchy.SetParent(child, child));
+    // removing a node turns its children into roots, staying where they were in the world
+    hierarchy.RemoveNode(child);
+    TINY_ASSERT(hierarchy.GetParent(grandchild) == ECS_INVALID_ENTITY && !Ecs::HasComponent<TransformNode>(world, child));
+    TINY_ASSERT(Ecs::GetComponent<TransformNode>(world, other)->firstChild == ECS_INVALID_ENTITY);
+    hierarchy.UpdateWorldMatrices(false);
+    TINY_ASSERT(Ecs::GetComponent<TransformNode>(world, grandchild)->depth == 0);
+    TINY_ASSERT(MatricesMatch(WorldOf(world, grandchild), otherMat * childTf.ToModelMatrix() * grandchildTf.ToModelMatrix()));
+    // same when a moved, rotated and scaled parent is destroyed (the way Entity::DestroyEntity does it), even if it moved
+    // since the last update
+    {
+        EntityId parent = CreateNode(world, hierarchy, Transform(glm::vec3(4, -2, 1), glm::vec3(3), 30.0f, glm::normalize(glm::vec3(1, 1, 0))));
+        Transform orphanTf = Transform(glm::vec3(0, 2, 0), glm::vec3(0.5f), 60.0f, glm::vec3(0, 0, 1));
+        EntityId orphan = CreateNode(world, hierarchy, orphanTf, parent);
+        hierarchy.UpdateWorldMatrices(false);
+        Transform* parentTf = Ecs::GetComponent<Transform>(world, parent);
+        parentTf->position.x += 5.0f;
+        hierarchy.MarkDirty(parent);
+        glm::mat4 expected = parentTf->ToModelMatrix() * orphanTf.ToModelMatrix();
+        hierarchy.UnlinkNode(parent);
+        Ecs::DestroyEntity(world, parent);
+        hierarchy.UpdateWorldMatrices(false);
+        TINY_ASSERT(hierarchy.GetParent(orphan) == ECS_INVALID_ENTITY);
+        TINY_ASSERT(MatricesMatch(WorldOf(world, orphan), expected));
+        // a zero scale parent can't be baked in, the child keeps its local transform instead of going NaN
+        EntityId flatParent = CreateNode(world, hierarchy, Transform(glm::vec3(1, 2, 3), glm::vec3(0)));
+        hierarchy.SetParent(orphan, flatParent);
+        hierarchy.UnlinkNode(flatParent);
+        Ecs::DestroyEntity(world, flatParent);
+        hierarchy.UpdateWorldMatrices(false);
+        TINY_ASSERT(MatricesMatch(WorldOf(world, orphan), expected));
+        Ecs::DestroyEntity(world, orphan);
+    }
+    // destroyed while dirty is fine
+    hierarchy.MarkDirty(other);
+    Ecs::DestroyEntity(world, other);
+    hierarchy.UpdateWorldMatrices(false);
+    TINY_ASSERT(hierarchy.numUpdatedLastFrame == 0);
+
+    // a wide tree big enough to go parallel gives the same answers as a serial one
+    {
+        Ecs::World bigWorld;
+        TransformHierarchy bigHierarchy(bigWorld);
+        std::vector<EntityId> roots;
+        std::vector<EntityId> leaves;
+        for (u32 i = 0; i < 100; i++)
+        {
+            EntityId r = CreateNode(bigWorld, bigHierarchy, Transform(glm::vec3((f32)i, 0, 0), glm::vec3(1), (f32)i, glm::vec3(0, 0, 1)));
+            roots.push_back(r);
+            for (u32 j = 0; j < 50; j++)
+            {
+                leaves.push_back(CreateNode(bigWorld, bigHierarchy, Transform(glm::vec3(0, (f32)j, 0)), r));
+            }
+        }
+        bigHierarchy.UpdateWorldMatrices(true);
+        TINY_ASSERT(bigHierarchy.numUpdatedLastFrame == 5100);
+        for (u32 i = 0; i < leaves.size(); i++)
+        {
+            glm::mat4 expected = Ecs::GetComponent<Transform>(bigWorld, roots[i / 50])->ToModelMatrix() * Transform(glm::vec3(0, (f32)(i % 50), 0)).ToModelMatrix();
+            TINY_ASSERT(MatricesMatch(WorldOf(bigWorld, leaves[i]), expected));
+        }
+    }
+    LOG_INFO("TransformHierarchy tests passed");
+}
+
+template <typename Func>
+static f64 TimeMs(Func func)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    func();
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<f64, std::milli>(end - start).count();
+}
+
+void TransformHierarchyBenchmarks()
+{
+    LOG_INFO("Running TransformHierarchy benchmarks...");
+    // scene-ish shape: 10k props, each with 9 attached children (100k nodes)
+    constexpr u32 numRoots = 10000;
+    constexpr u32 childrenPerRoot = 9;
+    constexpr u32 numFrames = 20;
+    Ecs::World* world = new Ecs::World();
+    TransformHierarchy* hierarchy = new TransformHierarchy(*world);
+    std::vector<EntityId> roots;
+    for (u32 i = 0; i < numRoots; i++)
+    {
+        EntityId r = CreateNode(*world, *hierarchy, Transform(glm::vec3((f32)i, 0, 0), glm::vec3(1), (f32)(i % 360), glm::vec3(0, 1, 0)));
+        roots.push_back(r);
+        for (u32 j = 0; j < childrenPerRoot; j++)
+        {
+            CreateNode(*world, *hierarchy, Transform(glm::vec3(0, (f32)j, 0), glm::vec3(0.5f)), r);
+        }
+    }
+    u32 numNodes = numRoots * (childrenPerRoot + 1);
+    hierarchy->UpdateWorldMatrices(false);
+
+    // what the renderer did before: model matrix + inverse transpose for everything, every frame
+    Ecs::Query<Transform, WorldTransform> flatQuery(*world);
+    f64 flatMs = TimeMs([&]() {
+        for (u32 frame = 0; frame < numFrames; frame++)
+        {
+            flatQuery.ForEach([](Transform& tf, WorldTransform& worldTf) {
+                worldTf.world = tf.ToModelMatrix();
+                worldTf.normal = glm::mat3(glm::transpose(glm::inverse(worldTf.world)));
+            });
+        }
+    });
+    auto moveRoots = [&](u32 numMoved, u32 frame) {
+        for (u32 i = 0; i < numMoved; i++)
+        {
+            EntityId r = roots[(i * 7919 + frame * 31) % numRoots];
+            Ecs::GetComponent<Transform>(*world, r)->position.y += 0.1f;
+            hierarchy->MarkDirty(r);
+        }
+    };
+    f64 movedMs[3] = {};
+    f64 movedParallelMs[3] = {};
+    u32 movedCounts[3] = { numRoots / 100, numRoots / 10, numRoots };
+    for (u32 m = 0; m < 3; m++)
+    {
+        for (u32 frame = 0; frame < numFrames; frame++)
+        {
+            moveRoots(movedCounts[m], frame);
+            movedMs[m] += TimeMs([&]() { hierarchy->UpdateWorldMatrices(false); });
+            moveRoots(movedCounts[m], frame);
+            movedParallelMs[m] += TimeMs([&]() { hierarchy->UpdateWorldMatrices(true); });
+        }
+    }
+    LOG_INFO("[TRANSFORMS] %u nodes (%u roots x %u children), ms per frame", numNodes, numRoots, childrenPerRoot);
+    LOG_INFO("[TRANSFORMS] recompute everything, flat      | %7.3f ms", flatMs / numFrames);
+    for (u32 m = 0; m < 3; m++)
+    {
+        LOG_INFO("[TRANSFORMS] %5u roots moved (%5u nodes) | serial: %7.3f ms | parallel: %7.3f ms | %.2fx vs flat",
+            movedCounts[m], movedCounts[m] * (childrenPerRoot + 1), movedMs[m] / numFrames, movedParallelMs[m] / numFrames,
+            flatMs / movedParallelMs[m]);
+    }
+    delete hierarchy;
+    delete world;
+    LOG_INFO("TransformHierarchy benchmarks complete");
+}
@@ -0,0 +1,95 @@
+#ifndef TINY_TRANSFORM_HIERARCHY_H
+#define TINY_TRANSFORM_HIERARCHY_H
+
+#include "tiny_defines.h"
+#include "tiny_types.h"
+#include "scene/ecs.h"
+#include "containers/dynarray.h"
+#include <span>
+
+// Parent/child transforms on top of the ECS
+// Nodes are entities with a Transform (local, relative to the parent), a TransformNode (links) and a WorldTransform (cached
+// world + normal matrix). Changing a local transform only marks the node dirty. UpdateWorldMatrices then gathers every dirty
+// node and everything under it, sorts them by depth and recomputes them one depth level at a time (in parallel for big levels),
+// so parents are always done before their children. Nodes that didn't move, and aren't under something that did, cost nothing.
+// The cached matrices are only up to date after UpdateWorldMatrices
+
+#define TRANSFORM_NODE_DIRTY  (1 << 0)
+#define TRANSFORM_NODE_QUEUED (1 << 1)
+
+struct TransformNode
+{
+    Ecs::EntityId parent = ECS_INVALID_ENTITY;
+    Ecs::EntityId firstChild = ECS_INVALID_ENTITY;
+    Ecs::EntityId nextSibling = ECS_INVALID_ENTITY;
+    Ecs::EntityId prevSibling = ECS_INVALID_ENTITY;
+    // 0 for roots
+    u32 depth = 0;
+    u32 flags = 0;
+};
+
+struct WorldTransform
+{
+    glm::mat4 world = glm::mat4(1);
+    // inverse transpose of the world matrix, for normals
+    glm::mat3 normal = glm::mat3(1);
+};
+
+struct TransformHierarchy
+{
+    explicit TransformHierarchy(Ecs::World& world) : world(&world) {}
+
+    // gives an entity that already has a Transform the other two components, as a dirty root.
+    // Entities made with TransformNode/WorldTransform from the start just need MarkDirty
+    TAPI void AddNode(Ecs::EntityId entity);
+    // takes the node out of the tree. Its children become roots, with their world transform baked into their local Transform
+    TAPI void UnlinkNode(Ecs::EntityId entity);
+    // UnlinkNode, then drops the TransformNode/WorldTransform components. No need to call this before destroying the entity,
+    // UnlinkNode is enough there
+    TAPI void RemoveNode(Ecs::EntityId entity);
+    // parent = ECS_INVALID_ENTITY makes it a root. Refuses (returns false) if parent is in child's subtree
+    TAPI bool SetParent(Ecs::EntityId child, Ecs::EntityId parent);
+    TAPI Ecs::EntityId GetParent(Ecs::EntityId entity);
+    // call after changing the node's local Transform
+    TAPI void MarkDirty(Ecs::EntityId entity);
+    // recomputes world/normal matrices of everything dirty and their subtrees
+    TAPI void UpdateWorldMatrices(bool parallel = true);
+
+    // nodes recomputed by the last UpdateWorldMatrices
+    u32 numUpdatedLastFrame = 0;
+    // and which ones they were, in no particular order. Valid until the next UpdateWorldMatrices
+    inline std::span<const Ecs::EntityId> GetUpdatedLastFrame() const { return std::span<const Ecs::EntityId>(updated.data(), updated.size()); }
+
+private:
+    // component pointers are looked up once while gathering. Nothing structural happens during the update, so they stay valid
+    struct PendingNode
+    {
+        Ecs::EntityId entity;
+        const WorldTransform* parentWorld;
+    };
+    struct QueuedNode
+    {
+        const Transform* local;
+        const WorldTransform* parentWorld;
+        WorldTransform* world;
+        TransformNode* node;
+    };
+    void UnlinkFromParent(TransformNode* node);
+
+    Ecs::World* world;
+    DynArray<Ecs::EntityId> dirty;
+    DynArray<Ecs::EntityId> updated;
+    // scratch for UpdateWorldMatrices, kept around so updates don't allocate
+    DynArray<Ecs::EntityId> stack;
+    DynArray<PendingNode> pending;
+    DynArray<QueuedNode> queued;
+    DynArray<QueuedNode> sorted;
+    DynArray<u32> levelStart;
+};
+
+// world matrices against plain matrix math, reparenting, cycles, removal
+TAPI void TransformHierarchyTests();
+// recomputing every matrix every frame vs updating only moved subtrees, serial and parallel
+TAPI void TransformHierarchyBenchmarks();
+
+#endif
@@ -23,6 +23,7 @@
 #include "scene/entity.h"
 #include "tiny_thread.h"
 #include "render/postprocess.h"
+#include "tiny_string_table.h"
 
 #include "GLFW/glfw3.h"
 
@@ -195,6 +196,16 @@ Arena* GetFrameAllocator()
     return &globEngineCtx.engineFrameAllocator;
 }
 
+void* FrameAlloc(size_t size)
+{
+    return arena_alloc(GetFrameAllocator(), size);
+}
+
+void FrameFree(void* data)
+{
+    // cleared wholesale at the end of the frame
+}
+
 /// Game loop - while(EngineLoop())
 bool EngineLoop() {
     PROFILE_FUNCTION();
@@ -327,23 +338,17 @@ void InitEngine(
     InitImGui();
 
     // engine memory
-    u32 engineMemorySize = MEGABYTES_BYTES(100); // :/
-    void* engineMemory = TSYSALLOC(engineMemorySize);
-    TMEMSET(engineMemory, 0, engineMemorySize);
-    globEngineCtx.engineArena = arena_init(engineMemory, engineMemorySize, "Engine");
+    // each arena reserves a big chunk of address space and only commits pages as it fills up,
+    // so none of these need to be sized up front. Freshly committed memory is zeroed
+    globEngineCtx.engineArena = arena_init_virtual(GIGABYTES_BYTES((size_t)1), "Engine");
     Arena* engineArena = &globEngineCtx.engineArena;
-    // scene allocator gets some % of engine mem
-    constexpr u32 engineMemoryPercentSceneAllocator = 40;
-    u32 engineSceneAllocatorMemSize = Math::PercentOf(engineMemorySize, engineMemoryPercentSceneAllocator);
-    // frame allocator gets some % of engine mem
-    constexpr u32 engineMemoryPercentFrameAllocator = 40;
-    u32 engineFrameAllocatorMemSize = Math::PercentOf(engineMemorySize, engineMemoryPercentFrameAllocator);
-    globEngineCtx.engineSceneAllocator = arena_init(arena_alloc(engineArena, engineSceneAllocatorMemSize), engineSceneAllocatorMemSize, "Engine Scene");
-    globEngineCtx.engineFrameAllocator = arena_init(arena_alloc(engineArena, engineFrameAllocatorMemSize), engineFrameAllocatorMemSize, "Engine Frame");
+    globEngineCtx.engineSceneAllocator = arena_init_virtual(GIGABYTES_BYTES((size_t)4), "Engine Scene");
+    globEngineCtx.engineFrameAllocator = arena_init_virtual(GIGABYTES_BYTES((size_t)1), "Engine Frame");
 
     // subsystem initialization
     JobSystem::Instance().Initialize();
     InitializeTinyFilesystem(resourceDirectory);
+    InitializeStringTable(engineArena);
     InitializeShaderSystem(engineArena);
     InitializeLightingSystem(engineArena);
     InitializeTextureCache(engineArena);
@@ -365,7 +370,7 @@ void InitEngine(
     
 
     // give a big memory pool to the game. Game shouldn't allocate outside this pool
-    void* gameMemory = TSYSALLOC(requestedGameMemSize);
+    void* gameMemory = TSYSALLOC_TAGGED(requestedGameMemSize, MemTag::GAME);
     TMEMSET(gameMemory, 0, requestedGameMemSize);
     globEngineCtx.gameArena = arena_init(gameMemory, requestedGameMemSize, "Game");
     Arena* gameArena = &globEngineCtx.gameArena;
@@ -384,6 +389,8 @@ void InitEngine(
             gameFuncs.tickFunc(gameArena, GetDeltaTime());
         }
         JobSystem::Instance().FlushMainThreadJobs();
+        // everything that moves entities this frame has run. Only moved subtrees get their matrices recomputed
+        Entity::UpdateTransforms();
         { PROFILE_SCOPE("Engine Render");
             { PROFILE_SCOPE("Game Render");
                 gameFuncs.renderFunc(gameArena);
@@ -407,6 +414,8 @@ void InitEngine(
     JobSystem::Instance().Shutdown();
     TerminateGame();
     arena_free_all(gameArena);
+    arena_free_all(GetSceneAllocator());
+    arena_free_all(GetFrameAllocator());
     arena_free_all(engineArena);
     ImGuiTerminate();
 }
\ No newline at end of file
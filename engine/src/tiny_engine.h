@@ -36,6 +36,7 @@ struct MaterialRegistry;
 struct RendererData;
 struct EntityRegistry;
 struct PostprocessingSystem;
+struct StringTable;
 
 struct EngineContext
 {
@@ -68,6 +69,7 @@ struct EngineContext
     RendererData* renderer = 0;
     EntityRegistry* entityRegistry = 0;
     PostprocessingSystem* postprocessingSystem = 0;
+    StringTable* stringTable = 0;
 };
 
 TAPI EngineContext& GetEngineCtx();
@@ -115,6 +117,10 @@ TAPI u64 HashBytesL(u8* data, u32 size);
 
 TAPI Arena* GetSceneAllocator();
 TAPI Arena* GetFrameAllocator();
+// DynArrayAllocFunc/DynArrayFreeFunc compatible hooks for the frame allocator, I.E. DynArray<T>(FrameAlloc, FrameFree).
+// Main thread only, and the memory is gone at the end of the frame. FrameFree is a no-op
+TAPI void* FrameAlloc(size_t size);
+TAPI void FrameFree(void* data);
 
 struct GLFWwindow;
 TAPI GLFWwindow* GetMainGLFWWindow();
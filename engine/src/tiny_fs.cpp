@@ -7,6 +7,19 @@
 
 #include "tiny_log.h"
 
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#undef NOMINMAX
+#undef WIN32_LEAN_AND_MEAN
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 static const char* glob_resourceDirectory = "";
 
 void InitializeTinyFilesystem(const char* resourceDirectory)
@@ -16,7 +29,7 @@ void InitializeTinyFilesystem(const char* resourceDirectory)
 
 bool ReadFileContentsBinary(const char* filepath, void* backingBuffer, size_t size)
 {
-    std::ifstream file(filepath, std::ios::binary | std::ios::ate);
+    std::ifstream file(filepath, std::ios::binary);
     if (!file.read((char*)backingBuffer, size))
     {
         LOG_ERROR("Failed to read file %s", filepath);
@@ -43,6 +56,75 @@ bool ReadEntireFile(const char* filename, std::string& str) {
     }
     return false;
 }
+bool WriteEntireFileBinary(const char* filepath, const void* data, size_t size)
+{
+    std::ofstream file(filepath, std::ios::binary | std::ios::trunc);
+    if (!file.write((const char*)data, size))
+    {
+        LOG_ERROR("Failed to write file %s", filepath);
+        return false;
+    }
+    return true;
+}
+
+bool MapFile(const char* filepath, MappedFile* file)
+{
+    *file = MappedFile();
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(filepath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE)
+    {
+        LOG_ERROR("Failed to open file %s", filepath);
+        return false;
+    }
+    LARGE_INTEGER size = {};
+    GetFileSizeEx(handle, &size);
+    // PAGE_WRITECOPY + FILE_MAP_COPY = private pages, same as MAP_PRIVATE
+    HANDLE mapping = size.QuadPart ? CreateFileMappingA(handle, nullptr, PAGE_WRITECOPY, 0, 0, nullptr) : nullptr;
+    CloseHandle(handle);
+    void* data = mapping ? MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0) : nullptr;
+    if (!data)
+    {
+        if (mapping) CloseHandle(mapping);
+        LOG_ERROR("Failed to map file %s", filepath);
+        return false;
+    }
+    file->platformHandle = mapping;
+    file->size = (size_t)size.QuadPart;
+#else
+    int fd = open(filepath, O_RDONLY);
+    if (fd < 0)
+    {
+        LOG_ERROR("Failed to open file %s", filepath);
+        return false;
+    }
+    struct stat st = {};
+    fstat(fd, &st);
+    void* data = st.st_size ? mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        LOG_ERROR("Failed to map file %s", filepath);
+        return false;
+    }
+    file->size = (size_t)st.st_size;
+#endif
+    file->data = data;
+    return true;
+}
+
+void UnmapFile(MappedFile* file)
+{
+    if (!file->data) return;
+#ifdef _WIN32
+    UnmapViewOfFile(file->data);
+    CloseHandle((HANDLE)file->platformHandle);
+#else
+    munmap(file->data, file->size);
+#endif
+    *file = MappedFile();
+}
+
 /// appends resource path to provided path
 std::string ResPath(const std::string& path) {
     return glob_resourceDirectory + path;
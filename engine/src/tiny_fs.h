@@ -12,6 +12,18 @@
 TAPI bool ReadFileContentsBinary(const char* filepath, void* backingBuffer, size_t size);
 TAPI size_t GetFileSize(const char* filepath);
 TAPI bool ReadEntireFile(const char* filename, std::string& str);
+TAPI bool WriteEntireFileBinary(const char* filepath, const void* data, size_t size);
+
+// a whole file mapped into memory, copy on write. Writes to data stay in this process and never reach the file
+struct MappedFile
+{
+    void* data = nullptr;
+    size_t size = 0;
+    // windows file mapping handle
+    void* platformHandle = nullptr;
+};
+TAPI bool MapFile(const char* filepath, MappedFile* file);
+TAPI void UnmapFile(MappedFile* file);
 
 /// appends resource path to provided path
 TAPI std::string ResPath(const std::string& path = "");
@@ -0,0 +1,182 @@
+//#include "pch.h"
+#include "tiny_string_table.h"
+
+#include "tiny_engine.h"
+#include "tiny_log.h"
+
+StringTable::StringTable(Arena* arena) : arena(arena), index(arena)
+{
+    strings.push_back(HashedString());
+}
+
+StringId StringTableIntern(StringTable* table, HashedString str)
+{
+    if (str.length == 0) return STRING_ID_INVALID;
+    if (StringId* existing = table->index.find(str))
+    {
+        return *existing;
+    }
+    char* chars = (char*)arena_alloc_aligned(table->arena, str.length + 1, 1);
+    TMEMCPY(chars, str.str, str.length);
+    chars[str.length] = '\0';
+    HashedString interned = str;
+    interned.str = chars;
+    StringId id = table->strings.size();
+    table->strings.push_back(interned);
+    table->index.try_emplace(interned, id);
+    return id;
+}
+
+StringId StringTableFind(const StringTable* table, HashedString str)
+{
+    const StringId* id = table->index.find(str);
+    return id ? *id : STRING_ID_INVALID;
+}
+
+const HashedString& StringTableGet(const StringTable* table, StringId id)
+{
+    return id < table->strings.size() ? table->strings[id] : table->strings[STRING_ID_INVALID];
+}
+
+void InitializeStringTable(Arena* arena)
+{
+    StringTable* table = arena_alloc_type(arena, StringTable, 1);
+    new(table) StringTable(arena);
+    GetEngineCtx().stringTable = table;
+}
+
+StringTable* GetStringTable()
+{
+    return GetEngineCtx().stringTable;
+}
+
+StringId InternString(HashedString str)
+{
+    return StringTableIntern(GetStringTable(), str);
+}
+
+StringId FindInternedString(HashedString str)
+{
+    return StringTableFind(GetStringTable(), str);
+}
+
+const char* GetInternedString(StringId id)
+{
+    return StringTableGet(GetStringTable(), id).str;
+}
+
+// ============ tests ============
+
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+void StringTableTests()
+{
+    LOG_INFO("Running StringTable tests...");
+    // the compile time hash is the same one the rest of the engine uses
+    constexpr HashedString literal = "PondEntity";
+    static_assert(literal.length == 10 && literal.hash == HashStringConst("PondEntity", 10));
+    TINY_ASSERT(literal.hash == HashBytes((u8*)"PondEntity", 10));
+    TINY_ASSERT(HashedString(std::string("PondEntity").c_str()) == literal);
+
+    Arena arena = arena_init_virtual(MEGABYTES_BYTES((size_t)64), "String table test");
+    {
+        StringTable table(&arena);
+        TINY_ASSERT(StringTableIntern(&table, "") == STRING_ID_INVALID && StringTableGet(&table, STRING_ID_INVALID).length == 0);
+        TINY_ASSERT(StringTableFind(&table, "nope") == STRING_ID_INVALID);
+
+        // interning the same text twice gives the same id and storage, no matter where the text came from
+        std::string runtimeName = "Pond";
+        runtimeName += "Entity";
+        StringId pond = StringTableIntern(&table, literal);
+        TINY_ASSERT(pond != STRING_ID_INVALID);
+        TINY_ASSERT(StringTableIntern(&table, HashedString(runtimeName.c_str())) == pond);
+        TINY_ASSERT(StringTableFind(&table, "PondEntity") == pond);
+        const HashedString& stored = StringTableGet(&table, pond);
+        TINY_ASSERT(stored.str != literal.str && strcmp(stored.str, "PondEntity") == 0 && stored.hash == literal.hash);
+        // a prefix isn't the same string
+        TINY_ASSERT(StringTableFind(&table, HashedString(runtimeName.c_str(), 4)) == STRING_ID_INVALID);
+
+        // two names with the same 32 bit hash are still two strings
+        static_assert(HashStringConst("entity_479599", 13) == HashStringConst("entity_662382", 13));
+        StringId collideA = StringTableIntern(&table, "entity_479599");
+        StringId collideB = StringTableIntern(&table, "entity_662382");
+        TINY_ASSERT(collideA != collideB && StringTableFind(&table, "entity_662382") == collideB);
+        TINY_ASSERT(strcmp(StringTableGet(&table, collideA).str, "entity_479599") == 0);
+
+        // lots of names, against std::unordered_map
+        std::unordered_map<std::string, StringId> reference;
+        reference["PondEntity"] = pond;
+        reference["entity_479599"] = collideA;
+        reference["entity_662382"] = collideB;
+        for (u32 i = 0; i < 200000; i++)
+        {
+            std::string name = "entity_" + std::to_string(i * 7 % 150000);
+            StringId id = StringTableIntern(&table, HashedString(name.c_str()));
+            auto [it, inserted] = reference.try_emplace(name, id);
+            TINY_ASSERT(it->second == id);
+        }
+        std::unordered_set<StringId> uniqueIds;
+        for (const auto& [name, id] : reference)
+        {
+            TINY_ASSERT(uniqueIds.insert(id).second);
+            TINY_ASSERT(StringTableFind(&table, HashedString(name.c_str())) == id);
+            TINY_ASSERT(name == StringTableGet(&table, id).str);
+        }
+        // + the empty string
+        TINY_ASSERT(table.strings.size() == reference.size() + 1);
+    }
+    arena_free_all(&arena);
+    LOG_INFO("StringTable tests passed");
+}
+
+template <typename Func>
+static f64 TimeMs(Func func)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    func();
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<f64, std::milli>(end - start).count();
+}
+
+void StringTableBenchmarks()
+{
+    LOG_INFO("Running StringTable benchmarks...");
+    constexpr u32 numStrings = 10000;
+    constexpr u32 numLookups = 10000000;
+    Arena arena = arena_init_virtual(MEGABYTES_BYTES((size_t)64), "String table bench");
+    {
+        StringTable table(&arena);
+        // entity-ish names. The one being looked up is the kind of thing the game asks for every frame
+        for (u32 i = 0; i < numStrings; i++)
+        {
+            std::string name = "scene_object_with_a_longish_name_" + std::to_string(i);
+            StringTableIntern(&table, HashedString(name.c_str()));
+        }
+        StringTableIntern(&table, "WaterfallParticleEmitter");
+        // keep the compiler from hoisting the runtime hash out of the loop
+        const char* volatile runtimeName = "WaterfallParticleEmitter";
+        u64 sum = 0;
+        f64 runtimeMs = TimeMs([&]() {
+            for (u32 i = 0; i < numLookups; i++)
+            {
+                sum += StringTableFind(&table, HashedString(runtimeName));
+            }
+        });
+        f64 literalMs = TimeMs([&]() {
+            for (u32 i = 0; i < numLookups; i++)
+            {
+                sum += StringTableFind(&table, "WaterfallParticleEmitter");
+            }
+        });
+        TINY_ASSERT(sum != 0);
+        f64 runtimeNs = runtimeMs * 1000000.0 / numLookups;
+        f64 literalNs = literalMs * 1000000.0 / numLookups;
+        LOG_INFO("[STRINGTABLE] lookup by name | hashed every call: %6.2f ns | compile time hash: %6.2f ns | %.2fx",
+            runtimeNs, literalNs, runtimeNs / literalNs);
+    }
+    arena_free_all(&arena);
+    LOG_INFO("StringTable benchmarks complete");
+}
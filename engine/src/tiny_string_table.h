@@ -0,0 +1,90 @@
+#ifndef TINY_STRING_TABLE_H
+#define TINY_STRING_TABLE_H
+
+#include <cstring>
+#include "tiny_defines.h"
+#include "mem/tiny_arena.h"
+#include "containers/hash_map.h"
+#include "containers/dynarray.h"
+
+// FNV-1a, gives the same result as HashBytes. constexpr so literals can be hashed by the compiler
+constexpr u32 HashStringConst(const char* str, u32 length)
+{
+    u32 hash = 0x811c9dc5;
+    for (u32 i = 0; i < length; i++)
+    {
+        hash ^= (u8)str[i];
+        hash *= 0x01000193;
+    }
+    return hash;
+}
+
+// a string + its hash, computed once up front. Doesn't own the characters.
+// String literals convert implicitly and are hashed at compile time, so Entity::GetEntity("PondEntity") doesn't hash
+// anything at runtime. Anything else has to be explicit about it: HashedString(name)
+struct HashedString
+{
+    const char* str = "";
+    u32 length = 0;
+    u32 hash = HashStringConst("", 0);
+
+    constexpr HashedString() = default;
+    template <size_t N>
+    consteval HashedString(const char (&literal)[N]) : str(literal), length((u32)N - 1), hash(HashStringConst(literal, (u32)N - 1)) {}
+    explicit HashedString(const char* runtimeStr) : HashedString(runtimeStr, (u32)strlen(runtimeStr)) {}
+    HashedString(const char* runtimeStr, u32 length) : str(runtimeStr), length(length), hash(HashStringConst(runtimeStr, length)) {}
+
+    inline bool operator==(const HashedString& other) const
+    {
+        return hash == other.hash && length == other.length && memcmp(str, other.str, length) == 0;
+    }
+};
+
+struct HashedStringHasher
+{
+    inline size_t operator()(const HashedString& str) const { return str.hash; }
+};
+
+// index into a string table. Equal strings in the same table always get the same id, so ids can be compared/hashed
+// instead of the strings themselves
+typedef u32 StringId;
+// also what the empty string interns to
+#define STRING_ID_INVALID 0
+
+// Interned strings. Each distinct string is stored once, null terminated, in the arena the table was made with, along
+// with its hash. Nothing is freed before the arena is. Not thread safe
+struct StringTable
+{
+    explicit StringTable(Arena* arena);
+    StringTable(const StringTable&) = delete;
+    StringTable& operator=(const StringTable&) = delete;
+
+    // the characters and the index's buckets/pages
+    Arena* arena;
+    // keys point at the interned copies
+    HashMap<HashedString, StringId, HashedStringHasher> index;
+    // StringId -> string. [STRING_ID_INVALID] is ""
+    DynArray<HashedString> strings;
+};
+
+// returns the existing id if the string is already in there
+TAPI StringId StringTableIntern(StringTable* table, HashedString str);
+// doesn't add anything, STRING_ID_INVALID if it isn't interned
+TAPI StringId StringTableFind(const StringTable* table, HashedString str);
+// "" for STRING_ID_INVALID/ids that aren't in the table
+TAPI const HashedString& StringTableGet(const StringTable* table, StringId id);
+
+// engine wide table, lives in the engine arena
+void InitializeStringTable(Arena* arena);
+TAPI StringTable* GetStringTable();
+TAPI StringId InternString(HashedString str);
+TAPI StringId FindInternedString(HashedString str);
+// stays valid until the engine shuts down
+TAPI const char* GetInternedString(StringId id);
+
+// interning/finding against std::unordered_map, compile time hashes, strings whose 32 bit hashes collide
+TAPI void StringTableTests();
+// name lookups with a compile time hash vs hashing the string on every lookup
+TAPI void StringTableBenchmarks();
+
+#endif
@@ -17,6 +17,7 @@
 #include "scene/entity.h"
 #include "render/tiny_ogl.h"
 #include "render/postprocess.h"
+#include "job_system.h"
 
 //#define ISLAND_SCENE
 #define SPONZA_SCENE
@@ -170,12 +171,12 @@ void drawImGuiDebug(GameState& gs) {
         {
             EntityData& ent = Entity::GetEntity(entref);
             const char* entityLabel = TextFormat("Position [%s]", ent.name);
-            ImGui::DragFloat3(entityLabel, &ent.transform.position[0]);
+            ImGui::DragFloat3(entityLabel, &ent.GetTransform().position[0]);
         }
     }
     if (ImGui::Checkbox("Enable grass render", &enableGrassRender))
     {
-        Entity::SetFlag(GetHash("grass"), EntityFlags::DISABLED, !enableGrassRender);
+        Entity::SetFlag(Entity::GetEntity("grass"), EntityFlags::DISABLED, !enableGrassRender);
     }
 
     PostprocessSettings& ppSettings = Postprocess::ModifySettings();
@@ -253,18 +254,33 @@ void drawImGuiDebug(GameState& gs) {
 }
 
 
-glm::vec3 RandomPointBetweenVertices(const std::vector<Vertex>& planeVerts) {
+// GetRandom isn't thread safe (global seed + rand()), so grass spawning uses a tiny xorshift rng per blade
+struct GrassSpawnRng {
+    u32 state = 1;
+    GrassSpawnRng(u32 seed) { state = seed != 0 ? seed : 1; }
+    u32 Next() {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+    // [start, end)
+    u32 Range(u32 start, u32 end) { return start + (Next() % (end - start)); }
+    f32 Rangef(f32 start, f32 end) { return start + ((f32)(Next() & 0xFFFFFF) / (f32)0xFFFFFF) * (end - start); }
+};
+
+glm::vec3 RandomPointBetweenVertices(const std::vector<Vertex>& planeVerts, GrassSpawnRng& rng) {
     // pick two verts and pick a random spot between those two points to spawn it in
-    u32 randPointIdx1 = GetRandom(0, planeVerts.size());
-    u32 randPointIdx2 = GetRandom(0, planeVerts.size());
+    u32 randPointIdx1 = rng.Range(0, planeVerts.size());
+    u32 randPointIdx2 = rng.Range(0, planeVerts.size());
     while (randPointIdx2 == randPointIdx1) {
         // don't pick two of the same vertex
-        randPointIdx2 = GetRandom(0, planeVerts.size());
+        randPointIdx2 = rng.Range(0, planeVerts.size());
     }
     const Vertex& vert1 = planeVerts.at(randPointIdx1);
     const Vertex& vert2 = planeVerts.at(randPointIdx2);
     // after picking two random vertices, pick a random amount [0,1] and lerp between those to find this "random" grass spawn position
-    glm::vec3 point = Math::Lerp(vert1.position, vert2.position, GetRandomf(0.0f, 1.0f));
+    glm::vec3 point = Math::Lerp(vert1.position, vert2.position, rng.Rangef(0.0f, 1.0f));
     return point;
 }
 
@@ -278,18 +294,22 @@ void PopulateGrassTransformsFromSpawnPlane(
     constexpr f32 grassSpawnHeight = 7.6; // ew hardcoded
     glm::vec2 exclusionMin = glm::vec2(spawnExclusion.min.x, spawnExclusion.min.z);
     glm::vec2 exclusionMax = glm::vec2(spawnExclusion.max.x, spawnExclusion.max.z);
-    for (u32 i = 0; i < numGrassInstancesToSpawn; i++) {
+    u32 baseSeed = (u32)GetRandom(1, 0x7FFF);
+    // every blade is independent, spread them across the job threads
+    JobSystem::Instance().ParallelFor(0, numGrassInstancesToSpawn, 0, [&](u32 i) {
+        u32 bladeSeed[2] = { baseSeed, i };
+        GrassSpawnRng rng = GrassSpawnRng(Math::hash((const char*)bladeSeed, sizeof(bladeSeed)));
         glm::vec2 randomPointBetweenVerts = glm::vec2(0);
         // pick random point. If point is within "excluded" region, pick another point
         do {
-            glm::vec3 point = RandomPointBetweenVertices(planeVerts);
+            glm::vec3 point = RandomPointBetweenVertices(planeVerts, rng);
             randomPointBetweenVerts = glm::vec2(point.x, point.z);
         } while (Math::isPointInRectangle(randomPointBetweenVerts, exclusionMin, exclusionMax));
-        f32 randRotation = GetRandomf(0.0f, 360.0f);
-        f32 randScale = GetRandomf(0.3f, 0.7f);
+        f32 randRotation = rng.Rangef(0.0f, 360.0f);
+        f32 randScale = rng.Rangef(0.3f, 0.7f);
         Transform grassTransform = Transform(glm::vec3(randomPointBetweenVerts.x, grassSpawnHeight, randomPointBetweenVerts.y), glm::vec3(randScale), randRotation);
         grassTransforms[i] = grassTransform.ToModelMatrix();
-    }
+    });
 }
 
 void init_grass(GameState& gs) {
@@ -382,9 +402,11 @@ void testbed_init(Arena* gameMem) {
                             ResPath("other/island_wip/").c_str(), 
                             islandEntRef);
     Entity::AddRenderable(islandEntRef, testModel);
+    // the terrain hides most of the props on the far side of the island
+    Entity::SetFlag(islandEntRef, EntityFlags::OCCLUDER, true);
     gs.entities.push_back(islandEntRef);
     EntityData& islandEnt = Entity::GetEntity(islandEntRef);
-    PhysicsAddModel(testModel, islandEnt.transform);
+    PhysicsAddModel(testModel, islandEnt.GetTransform());
 
     EntityRef treeEntRef = Entity::CreateEntity("tree", Transform({10,7.5,3}, glm::vec3(0.7)));
     Model treeModel = Model(lightingShader, 
@@ -394,7 +416,7 @@ void testbed_init(Arena* gameMem) {
     Entity::AddRenderable(treeEntRef, treeModel);
     gs.entities.push_back(treeEntRef);
     EntityData& treeEnt = Entity::GetEntity(treeEntRef);
-    PhysicsAddModel(treeModel, treeEnt.transform);
+    PhysicsAddModel(treeModel, treeEnt.GetTransform());
     
     Transform bushTf = Transform({-10,7.5,3}, glm::vec3(0.75));
     EntityRef bushEntRef = Entity::CreateEntity("bush", bushTf);
@@ -984,6 +984,155 @@ gen_check_complete_map_cases(GEN_FileData* filedata)
     }
 }
 
+// @notes Serialized layouts. Every type gets the size/alignment it would have
+//  as a plain C struct, which is also how it's laid out in a serialized blob
+//  (padding included). That way a struct whose C++ definition has the same
+//  layout can be copied in/out with one memcpy, and anything that doesn't
+//  match falls back to going member by member (see gen_serializers_from_types).
+//  Pointers (voidp, arrays sized by another member) can't go in a blob, so
+//  structs containing them are flagged and get no serializer.
+
+int
+gen_align_up(int value, int align)
+{
+    return (value + align - 1) / align * align;
+}
+
+// the "void*" in @type(basic, void*) voidp: 8;  empty for basics without a typedef
+MD_String8
+gen_basic_type_typedef_name(GEN_TypeInfo *type)
+{
+    MD_String8 result = MD_S8Lit("");
+    MD_Node* basic_type_basic = type->node->first_tag->first_child;
+    if (MD_S8Match(basic_type_basic->string, MD_S8Lit("basic"), 0) && !MD_NodeIsNil(basic_type_basic->next))
+    {
+        // same trick as gen_type_definitions_from_types, the typedef runs up to the closing paren
+        MD_Node* typedef_tag = basic_type_basic->next;
+        result = MD_S8(typedef_tag->string.str, 99);
+        result.size = MD_S8FindSubstring(result, MD_S8Lit(")"), 0, 0);
+    }
+    return(result);
+}
+
+// element type of a fixed size array + how many elements there are over all of its dimensions
+GEN_TypeInfo*
+gen_array_element_type(GEN_TypeInfo *array_type, GEN_FileData* filedata, int *element_count)
+{
+    int count = 1;
+    for (MD_Node* dimension = array_type->underlying_type->node;
+         !MD_NodeIsNil(dimension);
+         dimension = dimension->next)
+    {
+        count *= abs((int)MD_CStyleIntFromString(dimension->string));
+    }
+    *element_count = count;
+    return(gen_resolve_type_info_from_string(array_type->node->string, filedata));
+}
+
+void
+gen_equip_serialized_layout(GEN_TypeInfo *type, GEN_FileData* filedata)
+{
+    if (type->layout_state == 2)
+    {
+        return;
+    }
+    if (type->layout_state == 1)
+    {
+        MD_CodeLoc loc = MD_CodeLocFromNode(type->node);
+        MD_PrintMessage(error_file, loc, MD_MessageKind_Error,
+                        MD_S8Lit("type contains itself"));
+        return;
+    }
+    type->layout_state = 1;
+    
+    int size = 0;
+    int align = 1;
+    int has_pointers = 0;
+    int is_float = 0;
+    switch (type->kind)
+    {
+        default:break;
+        
+        case GEN_TypeKind_Basic:
+        {
+            MD_String8 typedef_name = gen_basic_type_typedef_name(type);
+            size = type->size;
+            align = size < 1 ? 1 : (size > 8 ? 8 : size);
+            has_pointers = MD_S8FindSubstring(typedef_name, MD_S8Lit("*"), 0, 0) < typedef_name.size;
+            is_float = MD_S8Match(typedef_name, MD_S8Lit("float"), 0) || MD_S8Match(typedef_name, MD_S8Lit("double"), 0);
+        } break;
+        
+        case GEN_TypeKind_Enum:
+        {
+            size = 4;
+            align = 4;
+            if (type->underlying_type != 0)
+            {
+                gen_equip_serialized_layout(type->underlying_type, filedata);
+                size = type->underlying_type->serialized_size;
+                align = type->underlying_type->serialized_align;
+            }
+        } break;
+        
+        case GEN_TypeKind_Array:
+        {
+            int element_count = 0;
+            GEN_TypeInfo *element_type = gen_array_element_type(type, filedata, &element_count);
+            if (element_type == 0)
+            {
+                gen_type_resolve_error(type->node);
+                break;
+            }
+            gen_equip_serialized_layout(element_type, filedata);
+            size = element_type->serialized_size * element_count;
+            align = element_type->serialized_align;
+            has_pointers = element_type->has_pointers;
+        } break;
+        
+        case GEN_TypeKind_Struct:
+        {
+            for (GEN_TypeMember *member = type->first_member;
+                 member != 0;
+                 member = member->next)
+            {
+                int member_size = 8;
+                int member_align = 8;
+                if (member->array_count_ref != 0)
+                {
+                    has_pointers = 1;
+                }
+                else
+                {
+                    gen_equip_serialized_layout(member->type, filedata);
+                    member_size = member->type->serialized_size;
+                    member_align = member->type->serialized_align;
+                    has_pointers |= member->type->has_pointers;
+                }
+                size = gen_align_up(size, member_align) + member_size;
+                align = member_align > align ? member_align : align;
+            }
+            size = gen_align_up(size, align);
+        } break;
+    }
+    
+    type->serialized_size = size;
+    type->serialized_align = align;
+    type->has_pointers = has_pointers;
+    type->is_float = is_float;
+    type->layout_state = 2;
+}
+
+void
+gen_equip_serialized_layouts(GEN_FileData* filedata)
+{
+    for (GEN_TypeInfo *type = filedata->first_type;
+         type != 0;
+         type = type->next)
+    {
+        gen_equip_serialized_layout(type, filedata);
+    }
+}
+
 //~ generators ////////////////////////////////////////////////////////////////
 
 // @notes Each generator function handles generating every instance of a
@@ -1398,6 +1547,168 @@ gen_function_definitions_from_maps(FILE *out, GEN_FileData* filedata)
     MD_ReleaseScratch(scratch);
 }
 
+// @notes Serializers go in their own header, <file>.type.serialize.h, which
+//  doesn't pull in the generated type definitions. Code that has its own
+//  definition of a type (the engine's Transform is a glm based struct with
+//  constructors, not the generated one) can include it and serialize its own
+//  struct, as long as the member names match the .type file.
+//
+//  Everything is templated on the struct (T) and on the serializer (S) so the
+//  same function both reads and writes. S needs:
+//      Bytes(void* data, size_t size)  the whole struct in one go
+//      Int(M& member, size_t size)     integers/bools/enums
+//      Float(M& member, size_t size)   f32/f64
+//      Pad(size_t size)
+//  where size is the size in the serialized blob. If T's layout is the same as
+//  the serialized one (checked at compile time by X_MatchesLayout) the struct
+//  is a single Bytes call, otherwise it goes member by member.
+
+void
+gen_serializer_layout_check(FILE *out, GEN_TypeInfo *type, MD_String8 member_type_expr, GEN_FileData* filedata)
+{
+    switch (type->kind)
+    {
+        default:break;
+        
+        case GEN_TypeKind_Basic:
+        case GEN_TypeKind_Enum:
+        {
+            fprintf(out, "sizeof(%.*s) == %d && std::is_floating_point_v<%.*s> == %s",
+                    MD_S8VArg(member_type_expr), type->serialized_size,
+                    MD_S8VArg(member_type_expr), type->is_float ? "true" : "false");
+        } break;
+        
+        case GEN_TypeKind_Struct:
+        {
+            fprintf(out, "%.*s_MatchesLayout<%.*s>()", MD_S8VArg(type->node->string), MD_S8VArg(member_type_expr));
+        } break;
+        
+        case GEN_TypeKind_Array:
+        {
+            int element_count = 0;
+            GEN_TypeInfo *element_type = gen_array_element_type(type, filedata, &element_count);
+            MD_String8 element_type_expr = MD_S8Fmt(filedata->arena, "std::remove_all_extents_t<%.*s>", MD_S8VArg(member_type_expr));
+            fprintf(out, "sizeof(%.*s) == %d && ", MD_S8VArg(member_type_expr), type->serialized_size);
+            gen_serializer_layout_check(out, element_type, element_type_expr, filedata);
+        } break;
+    }
+}
+
+void
+gen_serializer_member_code(FILE *out, GEN_TypeInfo *type, MD_String8 value_expr, MD_String8 member_type_expr, GEN_FileData* filedata)
+{
+    switch (type->kind)
+    {
+        default:break;
+        
+        case GEN_TypeKind_Basic:
+        case GEN_TypeKind_Enum:
+        {
+            fprintf(out, "\t\ts.%s(%.*s, %d);\n", type->is_float ? "Float" : "Int",
+                    MD_S8VArg(value_expr), type->serialized_size);
+        } break;
+        
+        case GEN_TypeKind_Struct:
+        {
+            fprintf(out, "\t\t%.*s_Serialize(s, %.*s);\n", MD_S8VArg(type->node->string), MD_S8VArg(value_expr));
+        } break;
+        
+        case GEN_TypeKind_Array:
+        {
+            // multidimensional arrays are walked as one flat array
+            int element_count = 0;
+            GEN_TypeInfo *element_type = gen_array_element_type(type, filedata, &element_count);
+            MD_String8 element_type_expr = MD_S8Fmt(filedata->arena, "std::remove_all_extents_t<%.*s>", MD_S8VArg(member_type_expr));
+            fprintf(out, "\t\tfor (int i = 0; i < %d; i++)\n", element_count);
+            fprintf(out, "\t\t{\n\t");
+            gen_serializer_member_code(out, element_type,
+                                       MD_S8Fmt(filedata->arena, "((%.*s*)&%.*s)[i]", MD_S8VArg(element_type_expr), MD_S8VArg(value_expr)),
+                                       element_type_expr, filedata);
+            fprintf(out, "\t\t}\n");
+        } break;
+    }
+}
+
+void
+gen_serializers_from_types(FILE *out, GEN_FileData* filedata)
+{
+    MD_PrintGenNoteCComment(out);
+    
+    for (GEN_TypeInfo *type = filedata->first_type;
+         type != 0;
+         type = type->next)
+    {
+        if (type->kind != GEN_TypeKind_Struct)
+        {
+            continue;
+        }
+        MD_String8 struct_name = type->node->string;
+        if (type->has_pointers)
+        {
+            fprintf(out, "// %.*s has pointers in it, no serializer\n\n", MD_S8VArg(struct_name));
+            continue;
+        }
+        
+        fprintf(out, "#define %.*s_SERIALIZED_SIZE %d\n\n", MD_S8VArg(struct_name), type->serialized_size);
+        
+        // layout check
+        fprintf(out, "template <typename T>\n");
+        fprintf(out, "constexpr bool %.*s_MatchesLayout()\n", MD_S8VArg(struct_name));
+        fprintf(out, "{\n");
+        fprintf(out, "\treturn std::is_trivially_copyable_v<T> && sizeof(T) == %d", type->serialized_size);
+        int offset = 0;
+        for (GEN_TypeMember *member = type->first_member;
+             member != 0;
+             member = member->next)
+        {
+            MD_String8 member_name = member->node->string;
+            MD_String8 member_type_expr = MD_S8Fmt(filedata->arena, "decltype(T::%.*s)", MD_S8VArg(member_name));
+            offset = gen_align_up(offset, member->type->serialized_align);
+            fprintf(out, "\n\t\t&& offsetof(T, %.*s) == %d && ", MD_S8VArg(member_name), offset);
+            gen_serializer_layout_check(out, member->type, member_type_expr, filedata);
+            offset += member->type->serialized_size;
+        }
+        fprintf(out, ";\n");
+        fprintf(out, "}\n\n");
+        
+        // serializer
+        fprintf(out, "template <typename S, typename T>\n");
+        fprintf(out, "void %.*s_Serialize(S& s, T& v)\n", MD_S8VArg(struct_name));
+        fprintf(out, "{\n");
+        fprintf(out, "\tif constexpr (%.*s_MatchesLayout<T>())\n", MD_S8VArg(struct_name));
+        fprintf(out, "\t{\n");
+        fprintf(out, "\t\ts.Bytes(&v, %d);\n", type->serialized_size);
+        fprintf(out, "\t}\n");
+        fprintf(out, "\telse\n");
+        fprintf(out, "\t{\n");
+        offset = 0;
+        for (GEN_TypeMember *member = type->first_member;
+             member != 0;
+             member = member->next)
+        {
+            MD_String8 member_name = member->node->string;
+            int aligned_offset = gen_align_up(offset, member->type->serialized_align);
+            if (aligned_offset != offset)
+            {
+                fprintf(out, "\t\ts.Pad(%d);\n", aligned_offset - offset);
+            }
+            gen_serializer_member_code(out, member->type,
+                                       MD_S8Fmt(filedata->arena, "v.%.*s", MD_S8VArg(member_name)),
+                                       MD_S8Fmt(filedata->arena, "decltype(T::%.*s)", MD_S8VArg(member_name)),
+                                       filedata);
+            offset = aligned_offset + member->type->serialized_size;
+        }
+        if (offset != type->serialized_size)
+        {
+            fprintf(out, "\t\ts.Pad(%d);\n", type->serialized_size - offset);
+        }
+        fprintf(out, "\t}\n");
+        fprintf(out, "}\n\n");
+    }
+    
+    fprintf(out, "\n");
+}
+
 void print_parse_analysis(GEN_FileData* filedata)
 {
     // @notes The generated code doesn't go straight to stdout, and has a lot
@@ -1596,6 +1907,7 @@ GEN_FileData* ProcessTypeFile(MD_Arena* arena, MD_String8 filename, MD_String8 o
     gen_equip_map_cases(filedata);
     gen_check_duplicate_cases(filedata);
     gen_check_complete_map_cases(filedata);
+    gen_equip_serialized_layouts(filedata);
 
     // generate phase
     if (!is_include)    
@@ -1637,6 +1949,28 @@ GEN_FileData* ProcessTypeFile(MD_Arena* arena, MD_String8 filename, MD_String8 o
             gen_function_definitions_from_maps(c, filedata);
             fclose(c);
         }
+        
+        // generate serializers, separate from the type definitions (see gen_serializers_from_types)
+        {
+            MD_String8 serialize_header_path = MD_S8Fmt(arena, "%.*s/%.*s.serialize.h", MD_S8VArg(output_dir), MD_S8VArg(filepath));
+            FILE *h = fopen((const char*)serialize_header_path.str, "wb");
+            MD_String8 filename_noext = remove_file_extension(isolate_filename(filename));
+            MD_String8 header_guard_name = MD_S8Stylize(arena, filename_noext, MD_IdentifierStyle_UpperCase, MD_S8Lit(""));
+            fprintf(h, "#if !defined(%.*s_SERIALIZE_H)\n", MD_S8VArg(header_guard_name));
+            fprintf(h, "#define %.*s_SERIALIZE_H\n", MD_S8VArg(header_guard_name));
+            fprintf(h, "#include <cstddef>\n");
+            fprintf(h, "#include <type_traits>\n");
+            for (MD_String8Node* include = filedata->include_list.first; 
+                include != 0; 
+                include = include->next)
+            {
+                MD_String8 include_string_noext = remove_file_extension(include->string);
+                fprintf(h, "#include \"%.*s.type.serialize.h\"\n", MD_S8VArg(include_string_noext));
+            }
+            gen_serializers_from_types(h, filedata);
+            fprintf(h, "#endif // %.*s_SERIALIZE_H\n", MD_S8VArg(header_guard_name));
+            fclose(h);
+        }
 
         #if 0
         print_parse_analysis(&filedata);
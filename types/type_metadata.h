@@ -40,6 +40,14 @@ struct GEN_TypeInfo
     struct GEN_TypeEnumerant *last_enumerant;
     int enumerant_count;
     GEN_TypeInfo *underlying_type;
+    
+    // layout the type gets in a serialized blob (natural C layout)
+    // filled out by gen_equip_serialized_layout
+    int serialized_size;
+    int serialized_align;
+    int has_pointers;
+    int is_float;
+    int layout_state; // 0 = not done, 1 = in progress, 2 = done
 };
 
 typedef struct GEN_TypeMember GEN_TypeMember;
@@ -129,6 +137,8 @@ void gen_equip_map_in_out_types(GEN_FileData* filedata);
 void gen_equip_map_cases(GEN_FileData* filedata);
 void gen_check_duplicate_cases(GEN_FileData* filedata);
 void gen_check_complete_map_cases(GEN_FileData* filedata);
+void gen_equip_serialized_layout(GEN_TypeInfo *type, GEN_FileData* filedata);
+void gen_equip_serialized_layouts(GEN_FileData* filedata);
 
 //~ generators ////////////////////////////////////////////////////////////////
 void gen_type_definitions_from_types(FILE *out, GEN_FileData* filedata);
@@ -138,6 +148,7 @@ void gen_struct_member_tables_from_types(FILE *out, GEN_FileData* filedata);
 void gen_enum_member_tables_from_types(FILE *out, GEN_FileData* filedata);
 void gen_type_info_definitions_from_types(FILE *out, GEN_FileData* filedata);
 void gen_function_definitions_from_maps(FILE *out, GEN_FileData* filedata);
+void gen_serializers_from_types(FILE *out, GEN_FileData* filedata);
 
 
 #endif //TYPE_METADATA_H